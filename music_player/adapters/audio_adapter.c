@@ -14,56 +14,39 @@
  *  STATIC VARIABLES
  *********************/
 
-// WAV解码器上下文
+// 解码器上下文：所有格式共用audio_ctl的拉取式解码流
+// 与旧版播放路径共享音源、预读线程和WAV内存映射，不打开音频设备
 typedef struct {
-    audioctl_s* audioctl;
+    audio_stream_s* stream;
     char file_path[256];
-} wav_decoder_context_t;
-
-#ifdef CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT
-// MP3解码器上下文
-typedef struct {
-    audioctl_s* audioctl;
-    char file_path[256];
-} mp3_decoder_context_t;
-#endif
+} stream_decoder_context_t;
 
 /*********************
  *  STATIC PROTOTYPES
  *********************/
 
-// WAV解码器接口实现
-static int wav_decoder_init(void** decoder_ctx, const char* file_path);
-static int wav_decoder_decode(void* decoder_ctx, uint8_t* output_buffer, uint32_t buffer_size, uint32_t* bytes_decoded);
-static int wav_decoder_seek(void* decoder_ctx, uint32_t position_ms);
-static int wav_decoder_get_info(void* decoder_ctx, uint32_t* sample_rate, uint16_t* channels, uint16_t* bits_per_sample);
-static int wav_decoder_get_duration(void* decoder_ctx, uint32_t* duration_ms);
-static void wav_decoder_cleanup(void* decoder_ctx);
-
-#ifdef CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT
-// MP3解码器接口实现
-static int mp3_decoder_init(void** decoder_ctx, const char* file_path);
-static int mp3_decoder_decode(void* decoder_ctx, uint8_t* output_buffer, uint32_t buffer_size, uint32_t* bytes_decoded);
-static int mp3_decoder_seek(void* decoder_ctx, uint32_t position_ms);
-static int mp3_decoder_get_info(void* decoder_ctx, uint32_t* sample_rate, uint16_t* channels, uint16_t* bits_per_sample);
-static int mp3_decoder_get_duration(void* decoder_ctx, uint32_t* duration_ms);
-static void mp3_decoder_cleanup(void* decoder_ctx);
-#endif
+// 解码器接口实现（mp3_decoder_* 与 flac_decoder_* 已是解码库的接口名）
+static int stream_adapter_init(void** decoder_ctx, const char* file_path);
+static int stream_adapter_decode(void* decoder_ctx, uint8_t* output_buffer, uint32_t buffer_size, uint32_t* bytes_decoded);
+static int stream_adapter_seek(void* decoder_ctx, uint32_t position_ms);
+static int stream_adapter_get_info(void* decoder_ctx, uint32_t* sample_rate, uint16_t* channels, uint16_t* bits_per_sample);
+static int stream_adapter_get_duration(void* decoder_ctx, uint32_t* duration_ms);
+static void stream_adapter_cleanup(void* decoder_ctx);
 
 /*********************
  * DECODER INTERFACES
  *********************/
 
-// WAV解码器接口
+// WAV解码器接口（PCM、浮点、多声道与ADPCM）
 const audio_decoder_interface_t wav_decoder_interface = {
     .format = AUDIO_FORMAT_WAV,
     .name = "WAV Decoder",
-    .init = wav_decoder_init,
-    .decode = wav_decoder_decode,
-    .seek = wav_decoder_seek,
-    .get_info = wav_decoder_get_info,
-    .get_duration = wav_decoder_get_duration,
-    .cleanup = wav_decoder_cleanup
+    .init = stream_adapter_init,
+    .decode = stream_adapter_decode,
+    .seek = stream_adapter_seek,
+    .get_info = stream_adapter_get_info,
+    .get_duration = stream_adapter_get_duration,
+    .cleanup = stream_adapter_cleanup
 };
 
 #ifdef CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT
@@ -71,12 +54,26 @@ const audio_decoder_interface_t wav_decoder_interface = {
 const audio_decoder_interface_t mp3_decoder_interface = {
     .format = AUDIO_FORMAT_MP3,
     .name = "MP3 Decoder (libmad)",
-    .init = mp3_decoder_init,
-    .decode = mp3_decoder_decode,
-    .seek = mp3_decoder_seek,
-    .get_info = mp3_decoder_get_info,
-    .get_duration = mp3_decoder_get_duration,
-    .cleanup = mp3_decoder_cleanup
+    .init = stream_adapter_init,
+    .decode = stream_adapter_decode,
+    .seek = stream_adapter_seek,
+    .get_info = stream_adapter_get_info,
+    .get_duration = stream_adapter_get_duration,
+    .cleanup = stream_adapter_cleanup
+};
+#endif
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_FLAC_SUPPORT
+// FLAC解码器接口
+const audio_decoder_interface_t flac_decoder_interface = {
+    .format = AUDIO_FORMAT_FLAC,
+    .name = "FLAC Decoder",
+    .init = stream_adapter_init,
+    .decode = stream_adapter_decode,
+    .seek = stream_adapter_seek,
+    .get_info = stream_adapter_get_info,
+    .get_duration = stream_adapter_get_duration,
+    .cleanup = stream_adapter_cleanup
 };
 #endif
 
@@ -108,210 +105,125 @@ int audio_adapter_register_all_decoders(audio_engine_t* engine)
         printf("✅ MP3解码器已注册\n");
     }
 #endif
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_FLAC_SUPPORT
+    // 注册FLAC解码器
+    if (audio_engine_register_decoder(&flac_decoder_interface) >= 0) {
+        count++;
+        printf("✅ FLAC解码器已注册\n");
+    }
+#endif
     
     printf("📊 共注册 %d 个音频解码器\n", count);
     return count;
 }
 
 /*********************
- * WAV DECODER IMPLEMENTATION
+ * STREAM DECODER IMPLEMENTATION
  *********************/
 
-static int wav_decoder_init(void** decoder_ctx, const char* file_path)
+static int stream_adapter_init(void** decoder_ctx, const char* file_path)
 {
     if (!decoder_ctx || !file_path) {
         return -1;
     }
     
-    wav_decoder_context_t* ctx = (wav_decoder_context_t*)malloc(sizeof(wav_decoder_context_t));
+    stream_decoder_context_t* ctx = (stream_decoder_context_t*)malloc(sizeof(stream_decoder_context_t));
     if (!ctx) {
         return -1;
     }
     
-    memset(ctx, 0, sizeof(wav_decoder_context_t));
+    memset(ctx, 0, sizeof(stream_decoder_context_t));
     strncpy(ctx->file_path, file_path, sizeof(ctx->file_path) - 1);
     
-    // 使用现有的audio_ctl系统
-    ctx->audioctl = audio_ctl_init_nxaudio(file_path);
-    if (!ctx->audioctl) {
+    // 按文件内容识别格式并准备解码，输出由音频引擎负责
+    int ret = audio_ctl_stream_open(file_path, &ctx->stream);
+    if (ret < 0) {
+        printf("❌ 解码器初始化失败：%s (%d)\n", file_path, ret);
         free(ctx);
         return -1;
     }
     
     *decoder_ctx = ctx;
-    printf("✅ WAV解码器初始化：%s\n", file_path);
+    printf("✅ 解码器初始化：%s\n", file_path);
     return 0;
 }
 
-static int wav_decoder_decode(void* decoder_ctx, uint8_t* output_buffer, uint32_t buffer_size, uint32_t* bytes_decoded)
+static int stream_adapter_decode(void* decoder_ctx, uint8_t* output_buffer, uint32_t buffer_size, uint32_t* bytes_decoded)
 {
-    wav_decoder_context_t* ctx = (wav_decoder_context_t*)decoder_ctx;
-    if (!ctx || !ctx->audioctl || !output_buffer || !bytes_decoded) {
+    stream_decoder_context_t* ctx = (stream_decoder_context_t*)decoder_ctx;
+    if (!ctx || !ctx->stream || !output_buffer || !bytes_decoded) {
         return -1;
     }
     
-    // 这里应该从audioctl读取解码数据
-    // 由于现有系统的限制，暂时返回模拟数据
-    *bytes_decoded = 0;
-    
-    // 检查是否还有数据可读
-    if (ctx->audioctl->fd > 0) {
-        *bytes_decoded = buffer_size / 4; // 模拟解码了1/4的缓冲区
-        memset(output_buffer, 0, *bytes_decoded); // 静音数据
-        return 0;
-    }
-    
-    return -1; // 没有更多数据
-}
-
-static int wav_decoder_get_info(void* decoder_ctx, uint32_t* sample_rate, uint16_t* channels, uint16_t* bits_per_sample)
-{
-    wav_decoder_context_t* ctx = (wav_decoder_context_t*)decoder_ctx;
-    if (!ctx || !ctx->audioctl) {
-        return -1;
+    // 直接解码到调用者的缓冲区，只在曲目结束时返回不足一整块
+    ssize_t ret = audio_ctl_stream_read(ctx->stream, output_buffer, buffer_size);
+    if (ret <= 0) {
+        *bytes_decoded = 0;
+        return -1; // 没有更多数据或解码出错
     }
     
-    if (sample_rate) *sample_rate = ctx->audioctl->wav.fmt.samplerate;
-    if (channels) *channels = ctx->audioctl->wav.fmt.numchannels;
-    if (bits_per_sample) *bits_per_sample = ctx->audioctl->wav.fmt.bitspersample;
-    
+    *bytes_decoded = ret;
     return 0;
 }
 
-static int wav_decoder_get_duration(void* decoder_ctx, uint32_t* duration_ms)
+static int stream_adapter_get_info(void* decoder_ctx, uint32_t* sample_rate, uint16_t* channels, uint16_t* bits_per_sample)
 {
-    wav_decoder_context_t* ctx = (wav_decoder_context_t*)decoder_ctx;
-    if (!ctx || !ctx->audioctl || !duration_ms) {
+    stream_decoder_context_t* ctx = (stream_decoder_context_t*)decoder_ctx;
+    if (!ctx || !ctx->stream) {
         return -1;
     }
     
-    // 计算时长（简化）
-    uint32_t data_size = ctx->audioctl->wav.data.subchunk2size;
-    uint32_t byte_rate = ctx->audioctl->wav.fmt.byterate;
-    
-    if (byte_rate > 0) {
-        *duration_ms = (data_size * 1000) / byte_rate;
-        return 0;
-    }
-    
-    *duration_ms = 0;
-    return -1;
-}
-
-static int wav_decoder_seek(void* decoder_ctx, uint32_t position_ms)
-{
-    wav_decoder_context_t* ctx = (wav_decoder_context_t*)decoder_ctx;
-    if (!ctx || !ctx->audioctl) {
-        return -1;
-    }
+    // 输出格式：所有格式统一转换为16位立体声，采样率为源文件采样率
+    const fmt_s* fmt = audio_ctl_stream_get_fmt(ctx->stream);
+    if (sample_rate) *sample_rate = fmt->samplerate;
+    if (channels) *channels = fmt->numchannels;
+    if (bits_per_sample) *bits_per_sample = fmt->bitspersample;
     
-    return audio_ctl_seek(ctx->audioctl, position_ms);
-}
-
-static void wav_decoder_cleanup(void* decoder_ctx)
-{
-    wav_decoder_context_t* ctx = (wav_decoder_context_t*)decoder_ctx;
-    if (!ctx) {
-        return;
-    }
-    
-    if (ctx->audioctl) {
-        audio_ctl_uninit_nxaudio(ctx->audioctl);
-    }
-    
-    free(ctx);
-    printf("🧹 WAV解码器已清理\n");
-}
-
-#ifdef CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT
-/*********************
- * MP3 DECODER IMPLEMENTATION
- *********************/
-
-static int mp3_decoder_init(void** decoder_ctx, const char* file_path)
-{
-    if (!decoder_ctx || !file_path) {
-        return -1;
-    }
-    
-    mp3_decoder_context_t* ctx = (mp3_decoder_context_t*)malloc(sizeof(mp3_decoder_context_t));
-    if (!ctx) {
-        return -1;
-    }
-    
-    memset(ctx, 0, sizeof(mp3_decoder_context_t));
-    strncpy(ctx->file_path, file_path, sizeof(ctx->file_path) - 1);
-    
-    // 使用现有的audio_ctl系统
-    ctx->audioctl = audio_ctl_init_nxaudio(file_path);
-    if (!ctx->audioctl) {
-        free(ctx);
-        return -1;
-    }
-    
-    *decoder_ctx = ctx;
-    printf("✅ MP3解码器初始化：%s\n", file_path);
     return 0;
 }
 
-static int mp3_decoder_decode(void* decoder_ctx, uint8_t* output_buffer, uint32_t buffer_size, uint32_t* bytes_decoded)
+static int stream_adapter_get_duration(void* decoder_ctx, uint32_t* duration_ms)
 {
-    mp3_decoder_context_t* ctx = (mp3_decoder_context_t*)decoder_ctx;
-    if (!ctx || !ctx->audioctl || !output_buffer || !bytes_decoded) {
+    stream_decoder_context_t* ctx = (stream_decoder_context_t*)decoder_ctx;
+    if (!ctx || !ctx->stream || !duration_ms) {
         return -1;
     }
     
-    // 模拟MP3解码
-    *bytes_decoded = 0;
+    // 按帧数计算：WAV来自数据块，MP3来自帧索引，FLAC来自STREAMINFO
+    uint64_t frames = audio_ctl_stream_get_total_frames(ctx->stream);
+    uint32_t rate = audio_ctl_stream_get_fmt(ctx->stream)->samplerate;
     
-    if (ctx->audioctl->fd > 0) {
-        *bytes_decoded = buffer_size / 3; // 模拟解码了1/3的缓冲区
-        memset(output_buffer, 0, *bytes_decoded); // 静音数据
+    if (frames > 0 && rate > 0) {
+        *duration_ms = frames * 1000 / rate;
         return 0;
     }
     
+    *duration_ms = 0;
     return -1;
 }
 
-static int mp3_decoder_get_info(void* decoder_ctx, uint32_t* sample_rate, uint16_t* channels, uint16_t* bits_per_sample)
+static int stream_adapter_seek(void* decoder_ctx, uint32_t position_ms)
 {
-    // MP3默认参数
-    if (sample_rate) *sample_rate = 44100;
-    if (channels) *channels = 2;
-    if (bits_per_sample) *bits_per_sample = 16;
-    
-    return 0;
-}
-
-static int mp3_decoder_get_duration(void* decoder_ctx, uint32_t* duration_ms)
-{
-    // 暂时返回固定时长
-    if (duration_ms) *duration_ms = 240000; // 4分钟
-    return 0;
-}
-
-static int mp3_decoder_seek(void* decoder_ctx, uint32_t position_ms)
-{
-    mp3_decoder_context_t* ctx = (mp3_decoder_context_t*)decoder_ctx;
-    if (!ctx || !ctx->audioctl) {
+    stream_decoder_context_t* ctx = (stream_decoder_context_t*)decoder_ctx;
+    if (!ctx || !ctx->stream) {
         return -1;
     }
     
-    return audio_ctl_seek(ctx->audioctl, position_ms);
+    // 按采样帧精确跳转，与旧版audio_ctl_seek_frame()的定位方式相同
+    uint32_t rate = audio_ctl_stream_get_fmt(ctx->stream)->samplerate;
+    return audio_ctl_stream_seek(ctx->stream, (uint64_t)position_ms * rate / 1000) < 0 ? -1 : 0;
 }
 
-static void mp3_decoder_cleanup(void* decoder_ctx)
+static void stream_adapter_cleanup(void* decoder_ctx)
 {
-    mp3_decoder_context_t* ctx = (mp3_decoder_context_t*)decoder_ctx;
+    stream_decoder_context_t* ctx = (stream_decoder_context_t*)decoder_ctx;
     if (!ctx) {
         return;
     }
     
-    if (ctx->audioctl) {
-        audio_ctl_uninit_nxaudio(ctx->audioctl);
-    }
+    audio_ctl_stream_close(ctx->stream);
+    printf("🧹 解码器已清理：%s\n", ctx->file_path);
     
     free(ctx);
-    printf("🧹 MP3解码器已清理\n");
 }
-#endif
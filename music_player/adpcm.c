@@ -0,0 +1,387 @@
+/**
+ * @file adpcm.c
+ * Block decoder for IMA and Microsoft ADPCM WAV data
+ *
+ * Both codings store 4 bits per sample and restart the predictor in every
+ * block header, so a block is the unit of decoding and of seeking. The
+ * IMA step is expanded through a precomputed difference table instead of
+ * the shift and add sequence of the reference decoder, which gives the
+ * same result with one load per nibble.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "adpcm.h"
+
+#include <errno.h>
+#include <string.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define ADPCM_IMA_HEADER 4     /* bytes per channel */
+#define ADPCM_IMA_GROUP  4     /* bytes per channel per 8 samples */
+#define ADPCM_IMA_STEPS  89
+
+#define ADPCM_MS_HEADER  7     /* bytes per channel */
+#define ADPCM_MS_COEFS   7
+
+/* Keeps delta * 768 inside 32 bits on corrupted input */
+
+#define ADPCM_MS_DELTA_MAX (INT32_MAX / 768)
+
+/* Reference IMA difference for one step size and the 3 magnitude bits */
+
+#define ADPCM_IMA_DIFF(s, m) \
+    (((s) >> 3) + (((m) & 4) ? (s) : 0) + (((m) & 2) ? (s) >> 1 : 0) + \
+     (((m) & 1) ? (s) >> 2 : 0))
+
+#define ADPCM_IMA_ROW(s) \
+    { \
+        ADPCM_IMA_DIFF(s, 0), ADPCM_IMA_DIFF(s, 1), ADPCM_IMA_DIFF(s, 2), \
+        ADPCM_IMA_DIFF(s, 3), ADPCM_IMA_DIFF(s, 4), ADPCM_IMA_DIFF(s, 5), \
+        ADPCM_IMA_DIFF(s, 6), ADPCM_IMA_DIFF(s, 7), \
+    }
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct adpcm_ms_state {
+    int32_t s1;      /* previous sample */
+    int32_t s2;      /* the one before */
+    int32_t delta;
+    int32_t c1;      /* Q8 predictor coefficients */
+    int32_t c2;
+} adpcm_ms_state_s;
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+/* Difference per step index and magnitude, indexed [index][nibble & 7] */
+
+static const uint16_t g_adpcm_ima_diff[ADPCM_IMA_STEPS][8] =
+{
+    ADPCM_IMA_ROW(7), ADPCM_IMA_ROW(8), ADPCM_IMA_ROW(9),
+    ADPCM_IMA_ROW(10), ADPCM_IMA_ROW(11), ADPCM_IMA_ROW(12),
+    ADPCM_IMA_ROW(13), ADPCM_IMA_ROW(14), ADPCM_IMA_ROW(16),
+    ADPCM_IMA_ROW(17), ADPCM_IMA_ROW(19), ADPCM_IMA_ROW(21),
+    ADPCM_IMA_ROW(23), ADPCM_IMA_ROW(25), ADPCM_IMA_ROW(28),
+    ADPCM_IMA_ROW(31), ADPCM_IMA_ROW(34), ADPCM_IMA_ROW(37),
+    ADPCM_IMA_ROW(41), ADPCM_IMA_ROW(45), ADPCM_IMA_ROW(50),
+    ADPCM_IMA_ROW(55), ADPCM_IMA_ROW(60), ADPCM_IMA_ROW(66),
+    ADPCM_IMA_ROW(73), ADPCM_IMA_ROW(80), ADPCM_IMA_ROW(88),
+    ADPCM_IMA_ROW(97), ADPCM_IMA_ROW(107), ADPCM_IMA_ROW(118),
+    ADPCM_IMA_ROW(130), ADPCM_IMA_ROW(143), ADPCM_IMA_ROW(157),
+    ADPCM_IMA_ROW(173), ADPCM_IMA_ROW(190), ADPCM_IMA_ROW(209),
+    ADPCM_IMA_ROW(230), ADPCM_IMA_ROW(253), ADPCM_IMA_ROW(279),
+    ADPCM_IMA_ROW(307), ADPCM_IMA_ROW(337), ADPCM_IMA_ROW(371),
+    ADPCM_IMA_ROW(408), ADPCM_IMA_ROW(449), ADPCM_IMA_ROW(494),
+    ADPCM_IMA_ROW(544), ADPCM_IMA_ROW(598), ADPCM_IMA_ROW(658),
+    ADPCM_IMA_ROW(724), ADPCM_IMA_ROW(796), ADPCM_IMA_ROW(876),
+    ADPCM_IMA_ROW(963), ADPCM_IMA_ROW(1060), ADPCM_IMA_ROW(1166),
+    ADPCM_IMA_ROW(1282), ADPCM_IMA_ROW(1411), ADPCM_IMA_ROW(1552),
+    ADPCM_IMA_ROW(1707), ADPCM_IMA_ROW(1878), ADPCM_IMA_ROW(2066),
+    ADPCM_IMA_ROW(2272), ADPCM_IMA_ROW(2499), ADPCM_IMA_ROW(2749),
+    ADPCM_IMA_ROW(3024), ADPCM_IMA_ROW(3327), ADPCM_IMA_ROW(3660),
+    ADPCM_IMA_ROW(4026), ADPCM_IMA_ROW(4428), ADPCM_IMA_ROW(4871),
+    ADPCM_IMA_ROW(5358), ADPCM_IMA_ROW(5894), ADPCM_IMA_ROW(6484),
+    ADPCM_IMA_ROW(7132), ADPCM_IMA_ROW(7845), ADPCM_IMA_ROW(8630),
+    ADPCM_IMA_ROW(9493), ADPCM_IMA_ROW(10442), ADPCM_IMA_ROW(11487),
+    ADPCM_IMA_ROW(12635), ADPCM_IMA_ROW(13899), ADPCM_IMA_ROW(15289),
+    ADPCM_IMA_ROW(16818), ADPCM_IMA_ROW(18500), ADPCM_IMA_ROW(20350),
+    ADPCM_IMA_ROW(22385), ADPCM_IMA_ROW(24623), ADPCM_IMA_ROW(27086),
+    ADPCM_IMA_ROW(29794), ADPCM_IMA_ROW(32767),
+};
+
+static const int8_t g_adpcm_ima_index[16] =
+{
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8,
+};
+
+/* The standard predictor set, the first 7 of every MS ADPCM file */
+
+static const int16_t g_adpcm_ms_coef[ADPCM_MS_COEFS][2] =
+{
+    { 256, 0 }, { 512, -256 }, { 0, 0 }, { 192, 64 },
+    { 240, 0 }, { 460, -208 }, { 392, -232 },
+};
+
+static const int16_t g_adpcm_ms_adapt[16] =
+{
+    230, 230, 230, 230, 307, 409, 512, 614,
+    768, 614, 512, 409, 307, 230, 230, 230,
+};
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static inline int32_t adpcm_sat16(int32_t v)
+{
+    return v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v;
+}
+
+static inline int16_t adpcm_le16(FAR const uint8_t *p)
+{
+    return (int16_t)(p[0] | (p[1] << 8));
+}
+
+static inline int16_t adpcm_ima_expand(FAR int32_t *pred, FAR int *index,
+                                       unsigned nibble)
+{
+    int32_t diff = g_adpcm_ima_diff[*index][nibble & 7];
+    int32_t p = adpcm_sat16(*pred + ((nibble & 8) ? -diff : diff));
+    int i = *index + g_adpcm_ima_index[nibble];
+
+    *index = i < 0 ? 0 : i >= ADPCM_IMA_STEPS ? ADPCM_IMA_STEPS - 1 : i;
+    *pred = p;
+    return (int16_t)p;
+}
+
+static inline int16_t adpcm_ms_expand(FAR adpcm_ms_state_s *st,
+                                      unsigned nibble)
+{
+    int32_t p = (st->s1 * st->c1 + st->s2 * st->c2) >> 8;
+    int32_t delta;
+
+    /* The nibble is a two's complement number of steps */
+
+    p = adpcm_sat16(p + ((int32_t)nibble - (int32_t)((nibble & 8) << 1)) *
+                    st->delta);
+
+    st->s2 = st->s1;
+    st->s1 = p;
+
+    delta = (g_adpcm_ms_adapt[nibble] * st->delta) >> 8;
+    st->delta = delta < 16 ? 16 :
+                delta > ADPCM_MS_DELTA_MAX ? ADPCM_MS_DELTA_MAX : delta;
+
+    return (int16_t)p;
+}
+
+/* The header holds the first sample of each channel, then every channel
+ * has 4 bytes of 8 nibbles in turn, low nibble first.
+ */
+
+static void adpcm_ima_block(FAR adpcm_s *adpcm, FAR int16_t *out,
+                            FAR const uint8_t *in, uint32_t frames)
+{
+    int32_t pred[ADPCM_MAX_CHANNELS];
+    int index[ADPCM_MAX_CHANNELS];
+    int ch = adpcm->channels;
+    uint32_t i;
+    uint32_t n;
+    uint32_t k;
+    int c;
+
+    for (c = 0; c < ch; c++, in += ADPCM_IMA_HEADER)
+    {
+        pred[c] = adpcm_le16(in);
+        index[c] = in[2];
+        if (index[c] >= ADPCM_IMA_STEPS) {
+            index[c] = ADPCM_IMA_STEPS - 1;
+            adpcm->errors++;
+        }
+
+        out[c] = (int16_t)pred[c];
+    }
+
+    out += ch;
+
+    for (i = 1; i < frames; i += n, out += n * ch)
+    {
+        n = frames - i < 8 ? frames - i : 8;
+
+        for (c = 0; c < ch; c++, in += ADPCM_IMA_GROUP)
+        {
+            FAR int16_t *o = out + c;
+
+            for (k = 0; k < n; k++, o += ch)
+            {
+                *o = adpcm_ima_expand(&pred[c], &index[c],
+                                      (in[k >> 1] >> ((k & 1) << 2)) & 15);
+            }
+        }
+    }
+}
+
+/* The header is split by field: predictor indices, deltas, the previous
+ * samples and the ones before them, each for all channels. Those two
+ * samples are the first output, the nibbles follow interleaved by channel,
+ * high nibble first.
+ */
+
+static void adpcm_ms_block(FAR adpcm_s *adpcm, FAR int16_t *out,
+                           FAR const uint8_t *in, uint32_t frames)
+{
+    adpcm_ms_state_s st[2];
+    int ch = adpcm->channels;
+    uint32_t count;
+    uint32_t i;
+    int c;
+
+    for (c = 0; c < ch; c++)
+    {
+        int pi = in[c];
+
+        if (pi >= ADPCM_MS_COEFS) {
+            memset(out, 0, frames * ch * sizeof(int16_t));
+            adpcm->errors++;
+            return;
+        }
+
+        st[c].c1 = g_adpcm_ms_coef[pi][0];
+        st[c].c2 = g_adpcm_ms_coef[pi][1];
+        st[c].delta = adpcm_le16(in + ch + 2 * c);
+        st[c].s1 = adpcm_le16(in + 3 * ch + 2 * c);
+        st[c].s2 = adpcm_le16(in + 5 * ch + 2 * c);
+
+        out[c] = (int16_t)st[c].s2;
+        out[ch + c] = (int16_t)st[c].s1;
+    }
+
+    in += ADPCM_MS_HEADER * ch;
+    out += 2 * ch;
+    count = (frames - 2) * ch;
+
+    if (ch == 1) {
+        for (i = 0; i < count; i++)
+        {
+            out[i] = adpcm_ms_expand(&st[0],
+                                     (in[i >> 1] >> ((~i & 1) << 2)) & 15);
+        }
+    } else {
+        for (i = 0; i < count; i += 2)
+        {
+            out[i] = adpcm_ms_expand(&st[0], in[i >> 1] >> 4);
+            out[i + 1] = adpcm_ms_expand(&st[1], in[i >> 1] & 15);
+        }
+    }
+}
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+/**
+ * @brief Check a block layout from the WAV fmt chunk
+ * @param coding ADPCM_IMA or ADPCM_MS
+ * @param channels Interleaved channels
+ * @param block_align Bytes per block (nBlockAlign)
+ * @param samples_per_block wSamplesPerBlock, 0 to derive it from the size
+ * @return 0 on success, -ENOTSUP for layouts the coding does not allow
+ */
+int adpcm_init(FAR adpcm_s *adpcm, int coding, int channels,
+               int block_align, int samples_per_block)
+{
+    int frames;
+
+    memset(adpcm, 0, sizeof(adpcm_s));
+
+    if (channels < 1) {
+        return -ENOTSUP;
+    }
+
+    if (coding == ADPCM_IMA) {
+        if (channels > ADPCM_MAX_CHANNELS ||
+            block_align < (ADPCM_IMA_HEADER + ADPCM_IMA_GROUP) * channels ||
+            block_align % (ADPCM_IMA_GROUP * channels) != 0) {
+            return -ENOTSUP;
+        }
+
+        frames = (block_align / channels - ADPCM_IMA_HEADER) * 2 + 1;
+    } else if (coding == ADPCM_MS) {
+        if (channels > 2 || block_align < (ADPCM_MS_HEADER + 1) * channels) {
+            return -ENOTSUP;
+        }
+
+        frames = (block_align - ADPCM_MS_HEADER * channels) * 2 / channels + 2;
+    } else {
+        return -ENOTSUP;
+    }
+
+    /* Writers may leave the tail of every block unused, never more. The
+     * MS header alone already holds two samples.
+     */
+
+    if (samples_per_block > frames || frames > UINT16_MAX ||
+        (coding == ADPCM_MS && samples_per_block == 1)) {
+        return -ENOTSUP;
+    }
+
+    if (samples_per_block > 0) {
+        frames = samples_per_block;
+    }
+
+    adpcm->coding = coding;
+    adpcm->channels = channels;
+    adpcm->block_align = block_align;
+    adpcm->block_frames = frames;
+    return 0;
+}
+
+/**
+ * @brief Frames a block of the given size decodes to
+ *
+ * Only the last block of a file may be short, it ends at a whole group of
+ * nibbles for IMA and at a whole byte for MS ADPCM.
+ */
+uint32_t adpcm_block_frames(FAR const adpcm_s *adpcm, size_t bytes)
+{
+    size_t ch = adpcm->channels;
+    size_t frames;
+
+    if (bytes >= adpcm->block_align) {
+        return adpcm->block_frames;
+    }
+
+    if (adpcm->coding == ADPCM_IMA) {
+        if (bytes < ADPCM_IMA_HEADER * ch) {
+            return 0;
+        }
+
+        frames = (bytes - ADPCM_IMA_HEADER * ch) /
+                 (ADPCM_IMA_GROUP * ch) * 8 + 1;
+    } else {
+        if (bytes < ADPCM_MS_HEADER * ch) {
+            return 0;
+        }
+
+        frames = (bytes - ADPCM_MS_HEADER * ch) * 2 / ch + 2;
+    }
+
+    return frames < adpcm->block_frames ? frames : adpcm->block_frames;
+}
+
+/**
+ * @brief Decode one block
+ * @param out Receives block_frames x channels interleaved samples
+ * @param in The block, bytes long
+ * @param bytes block_align, or less for the last block of a file
+ * @return Frames written to out
+ *
+ * A block whose header is invalid decodes to silence of the same length
+ * and is counted in errors.
+ */
+uint32_t adpcm_decode(FAR adpcm_s *adpcm, FAR int16_t *out,
+                      FAR const uint8_t *in, size_t bytes)
+{
+    uint32_t frames = adpcm_block_frames(adpcm, bytes);
+
+    if (frames == 0) {
+        return 0;
+    }
+
+    if (adpcm->coding == ADPCM_IMA) {
+        adpcm_ima_block(adpcm, out, in, frames);
+    } else {
+        adpcm_ms_block(adpcm, out, in, frames);
+    }
+
+    return frames;
+}
@@ -0,0 +1,61 @@
+/**
+ * @file adpcm.h
+ * Block decoder for IMA and Microsoft ADPCM WAV data
+ */
+
+#ifndef ADPCM_H
+#define ADPCM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <nuttx/config.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define ADPCM_MAX_CHANNELS 8   /* IMA; MS ADPCM is mono or stereo only */
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+enum {
+    ADPCM_IMA,    /* WAVE_FORMAT_IMA_ADPCM, 0x0011 */
+    ADPCM_MS,     /* WAVE_FORMAT_ADPCM, 0x0002 */
+};
+
+/* Layout of one block. Every block starts with the predictor state of each
+ * channel, so blocks decode independently of each other.
+ */
+
+typedef struct adpcm {
+    uint8_t coding;         /* ADPCM_IMA or ADPCM_MS */
+    uint16_t channels;
+    uint16_t block_align;   /* bytes per block */
+    uint16_t block_frames;  /* frames in a full block */
+    uint32_t errors;        /* blocks with an invalid header */
+} adpcm_s;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+int adpcm_init(FAR adpcm_s *adpcm, int coding, int channels,
+               int block_align, int samples_per_block);
+uint32_t adpcm_block_frames(FAR const adpcm_s *adpcm, size_t bytes);
+uint32_t adpcm_decode(FAR adpcm_s *adpcm, FAR int16_t *out,
+                      FAR const uint8_t *in, size_t bytes);
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /* ADPCM_H */
@@ -0,0 +1,313 @@
+/**
+ * @file audio_buffering.c
+ * Adaptive count and size of the audio output buffers
+ *
+ * A session starts with the fewest and smallest buffers the limits allow,
+ * so the first sample reaches the device quickly. Every dequeue measures
+ * how late the callback ran behind the device, and the decoder thread
+ * reports its longest pass (decoding plus waiting for the read-ahead).
+ * The worst stall seen in the current and the previous window sets the
+ * output queue to twice that: buffers grow first, which keeps the number
+ * of wakeups low, then more of them are queued. A stall raises the level
+ * at once; it comes back down only after a whole window without one.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "audio_buffering.h"
+
+#include <string.h>
+#include <time.h>
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static uint32_t audio_buffering_bytes_to_us(FAR audio_buffering_s *ab,
+                                            size_t bytes);
+static void audio_buffering_clamp(FAR audio_buffering_s *ab,
+                                  FAR const audio_buffering_limits_s *limits);
+static void audio_buffering_retune(FAR audio_buffering_s *ab);
+static void audio_buffering_note_stall(FAR audio_buffering_s *ab,
+                                       uint32_t now, uint32_t stall);
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static uint32_t audio_buffering_bytes_to_us(FAR audio_buffering_s *ab,
+                                            size_t bytes)
+{
+    if (ab->byterate == 0) {
+        return 0;
+    }
+
+    return (uint64_t)bytes * 1000000 / ab->byterate;
+}
+
+/* Make limits consistent and fit them into what the driver allocated */
+
+static void audio_buffering_clamp(FAR audio_buffering_s *ab,
+                                  FAR const audio_buffering_limits_s *limits)
+{
+    FAR audio_buffering_limits_s *l = &ab->limits;
+    uint32_t driver_ms;
+
+    *l = *limits;
+
+    driver_ms = audio_buffering_bytes_to_us(ab, ab->max_bytes) / 1000;
+    if (driver_ms == 0) {
+        driver_ms = 1;
+    }
+
+    if (l->max_bufs > ab->driver_bufs) {
+        l->max_bufs = ab->driver_bufs;
+    }
+
+    if (l->max_bufs < 1) {
+        l->max_bufs = 1;
+    }
+
+    if (l->min_bufs < 1) {
+        l->min_bufs = 1;
+    } else if (l->min_bufs > l->max_bufs) {
+        l->min_bufs = l->max_bufs;
+    }
+
+    if (l->max_ms > driver_ms) {
+        l->max_ms = driver_ms;
+    }
+
+    if (l->max_ms < 1) {
+        l->max_ms = 1;
+    }
+
+    if (l->min_ms < 1) {
+        l->min_ms = 1;
+    } else if (l->min_ms > l->max_ms) {
+        l->min_ms = l->max_ms;
+    }
+}
+
+/* Pick the level that queues twice the worst recent stall */
+
+static void audio_buffering_retune(FAR audio_buffering_s *ab)
+{
+    FAR audio_buffering_limits_s *l = &ab->limits;
+    uint64_t old = (uint64_t)ab->bufs * ab->bytes;
+    uint32_t stall;
+    uint32_t target;
+    uint32_t buf_us;
+    uint32_t bufs;
+    size_t bytes;
+
+    stall = ab->stall_us[0] > ab->stall_us[1] ? ab->stall_us[0]
+                                              : ab->stall_us[1];
+    target = stall > UINT32_MAX / 2 ? UINT32_MAX : 2 * stall;
+
+    buf_us = (target + l->min_bufs - 1) / l->min_bufs;
+    if (buf_us < l->min_ms * 1000) {
+        buf_us = l->min_ms * 1000;
+    } else if (buf_us > l->max_ms * 1000) {
+        buf_us = l->max_ms * 1000;
+    }
+
+    bufs = (target + buf_us - 1) / buf_us;
+    if (bufs < l->min_bufs) {
+        bufs = l->min_bufs;
+    } else if (bufs > l->max_bufs) {
+        bufs = l->max_bufs;
+    }
+
+    /* Whole frames, never more than the driver buffer holds */
+
+    bytes = (uint64_t)ab->byterate * buf_us / 1000000;
+    if (bytes > ab->max_bytes) {
+        bytes = ab->max_bytes;
+    }
+
+    bytes -= bytes % ab->blockalign;
+    if (bytes == 0) {
+        bytes = ab->blockalign;
+    }
+
+    ab->bufs = bufs;
+    ab->bytes = bytes;
+
+    if ((uint64_t)bufs * bytes > old) {
+        ab->grows++;
+    } else if ((uint64_t)bufs * bytes < old) {
+        ab->shrinks++;
+    }
+}
+
+static void audio_buffering_note_stall(FAR audio_buffering_s *ab,
+                                       uint32_t now, uint32_t stall)
+{
+    /* A quiet window lets the level fall to the worst of the last one */
+
+    if (now - ab->window_us >=
+        (uint32_t)CONFIG_LVX_MUSIC_PLAYER_OUTPUT_STABLE_MS * 1000) {
+        ab->stall_us[1] = ab->stall_us[0];
+        ab->stall_us[0] = 0;
+        ab->window_us = now;
+    }
+
+    if (stall > ab->stall_us[0]) {
+        ab->stall_us[0] = stall;
+    }
+
+    audio_buffering_retune(ab);
+}
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+uint32_t audio_buffering_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+void audio_buffering_default_limits(FAR audio_buffering_limits_s *limits)
+{
+    limits->min_bufs = CONFIG_LVX_MUSIC_PLAYER_OUTPUT_MIN_BUFS;
+    limits->max_bufs = CONFIG_LVX_MUSIC_PLAYER_OUTPUT_MAX_BUFS;
+    limits->min_ms = CONFIG_LVX_MUSIC_PLAYER_OUTPUT_MIN_MS;
+    limits->max_ms = CONFIG_LVX_MUSIC_PLAYER_OUTPUT_MAX_MS;
+}
+
+/**
+ * @brief Start a session at the lowest level the limits allow
+ * @param byterate Bytes per second of the PCM going to the device
+ * @param blockalign Bytes per frame
+ * @param max_bytes Size of each driver buffer
+ * @param driver_bufs Number of driver buffers
+ */
+void audio_buffering_init(FAR audio_buffering_s *ab,
+                          FAR const audio_buffering_limits_s *limits,
+                          uint32_t byterate, uint32_t blockalign,
+                          size_t max_bytes, uint32_t driver_bufs)
+{
+    memset(ab, 0, sizeof(*ab));
+
+    ab->byterate = byterate;
+    ab->blockalign = blockalign > 0 ? blockalign : 1;
+    ab->max_bytes = max_bytes;
+    ab->driver_bufs = driver_bufs;
+    atomic_init(&ab->update, false);
+    atomic_init(&ab->restart, false);
+    atomic_init(&ab->decode_peak_us, 0);
+
+    audio_buffering_clamp(ab, limits);
+    audio_buffering_retune(ab);
+
+    ab->grows = 0;
+    ab->window_us = audio_buffering_now_us();
+}
+
+/**
+ * @brief Post new limits, applied on the next dequeue
+ *
+ * The caller serializes concurrent setters.
+ */
+void audio_buffering_set_limits(FAR audio_buffering_s *ab,
+                                FAR const audio_buffering_limits_s *limits)
+{
+    ab->request = *limits;
+    atomic_store_explicit(&ab->update, true, memory_order_release);
+}
+
+/**
+ * @brief The device was paused, do not take the silence for a stall
+ */
+void audio_buffering_restart(FAR audio_buffering_s *ab)
+{
+    atomic_store_explicit(&ab->restart, true, memory_order_relaxed);
+}
+
+/**
+ * @brief The driver gave back a buffer
+ * @param played Bytes the buffer carried
+ *
+ * The callback is late by however much longer than the play time of that
+ * buffer it took since the previous one.
+ */
+void audio_buffering_dequeue(FAR audio_buffering_s *ab, uint32_t played)
+{
+    uint32_t now = audio_buffering_now_us();
+    uint32_t stall;
+    uint32_t play;
+
+    if (atomic_exchange_explicit(&ab->update, false, memory_order_acquire)) {
+        audio_buffering_clamp(ab, &ab->request);
+    }
+
+    if (atomic_exchange_explicit(&ab->restart, false,
+                                 memory_order_relaxed)) {
+        ab->last_us = 0;
+    }
+
+    stall = atomic_exchange_explicit(&ab->decode_peak_us, 0,
+                                     memory_order_relaxed);
+
+    if (ab->last_us != 0) {
+        play = audio_buffering_bytes_to_us(ab, played);
+        if (now - ab->last_us > play + stall) {
+            stall = now - ab->last_us - play;
+        }
+    }
+
+    ab->last_us = now != 0 ? now : 1;
+    audio_buffering_note_stall(ab, now, stall);
+}
+
+/**
+ * @brief The buffer just queued had to be padded with silence
+ *
+ * The device ran ahead of the decoder: raise the queue by one buffer.
+ */
+void audio_buffering_underrun(FAR audio_buffering_s *ab)
+{
+    uint32_t queued = audio_buffering_bytes_to_us(ab,
+                                                  (ab->bufs + 1) * ab->bytes);
+
+    audio_buffering_note_stall(ab, audio_buffering_now_us(), queued / 2 + 1);
+}
+
+/**
+ * @brief One decode pass, including any wait for the read-ahead
+ * @param start audio_buffering_now_us() before the pass
+ *
+ * A racing dequeue may drop one pass, the next long one is seen again.
+ */
+void audio_buffering_decode(FAR audio_buffering_s *ab, uint32_t start)
+{
+    uint32_t elapsed = audio_buffering_now_us() - start;
+
+    if (elapsed > atomic_load_explicit(&ab->decode_peak_us,
+                                       memory_order_relaxed)) {
+        atomic_store_explicit(&ab->decode_peak_us, elapsed,
+                              memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Snapshot of the current level, any thread
+ */
+void audio_buffering_get_stats(FAR audio_buffering_s *ab,
+                               FAR audio_buffering_stats_s *stats)
+{
+    stats->limits = ab->limits;
+    stats->bufs = ab->bufs;
+    stats->buf_bytes = ab->bytes;
+    stats->buf_us = audio_buffering_bytes_to_us(ab, ab->bytes);
+    stats->stall_us = ab->stall_us[0] > ab->stall_us[1] ? ab->stall_us[0]
+                                                        : ab->stall_us[1];
+    stats->grows = ab->grows;
+    stats->shrinks = ab->shrinks;
+}
@@ -0,0 +1,131 @@
+/**
+ * @file audio_buffering.h
+ * Adaptive count and size of the audio output buffers
+ */
+
+#ifndef AUDIO_BUFFERING_H
+#define AUDIO_BUFFERING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <nuttx/config.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_OUTPUT_MIN_BUFS
+#define CONFIG_LVX_MUSIC_PLAYER_OUTPUT_MIN_BUFS 2
+#endif
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_OUTPUT_MAX_BUFS
+#define CONFIG_LVX_MUSIC_PLAYER_OUTPUT_MAX_BUFS 8
+#endif
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_OUTPUT_MIN_MS
+#define CONFIG_LVX_MUSIC_PLAYER_OUTPUT_MIN_MS 5
+#endif
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_OUTPUT_MAX_MS
+#define CONFIG_LVX_MUSIC_PLAYER_OUTPUT_MAX_MS 40
+#endif
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_OUTPUT_STABLE_MS
+#define CONFIG_LVX_MUSIC_PLAYER_OUTPUT_STABLE_MS 3000
+#endif
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* Bounds of the policy. The driver's buffer count and size cap them
+ * further; min == max pins a value.
+ */
+
+typedef struct audio_buffering_limits {
+    uint32_t min_bufs;   /* buffers kept queued in the driver */
+    uint32_t max_bufs;
+    uint32_t min_ms;     /* play time of one buffer */
+    uint32_t max_ms;
+} audio_buffering_limits_s;
+
+/* State of one output session. The level (bufs, bytes) and the stall
+ * windows are written by the dequeue callback only, decode_peak_us by the
+ * decoder thread only. New limits and restarts are posted to the callback
+ * and applied by it.
+ */
+
+typedef struct audio_buffering {
+    /* Session constants */
+    uint32_t byterate;
+    uint32_t blockalign;
+    size_t max_bytes;             /* driver buffer size */
+    uint32_t driver_bufs;         /* buffers the driver allocated */
+
+    audio_buffering_limits_s limits;   /* in force, clamped to the driver */
+    audio_buffering_limits_s request;
+    atomic_bool update;           /* request is pending */
+    atomic_bool restart;          /* next interval spans a pause */
+
+    /* Dequeue callback */
+    uint32_t bufs;                /* buffers to keep queued */
+    size_t bytes;                 /* bytes to put in each buffer */
+    uint32_t last_us;             /* previous dequeue, 0 when none */
+    uint32_t window_us;           /* start of the current window */
+    uint32_t stall_us[2];         /* worst stall in this and the last window */
+    uint32_t grows;
+    uint32_t shrinks;
+
+    /* Decoder thread */
+    atomic_uint decode_peak_us;   /* longest pass since the last dequeue */
+} audio_buffering_s;
+
+typedef struct audio_buffering_stats {
+    audio_buffering_limits_s limits;   /* after clamping to the driver */
+    uint32_t bufs;
+    uint32_t buf_bytes;
+    uint32_t buf_us;
+    uint32_t stall_us;            /* worst stall of the last two windows */
+    uint32_t grows;               /* level raised by a stall */
+    uint32_t shrinks;             /* level lowered after a quiet window */
+} audio_buffering_stats_s;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+uint32_t audio_buffering_now_us(void);
+void audio_buffering_default_limits(FAR audio_buffering_limits_s *limits);
+
+void audio_buffering_init(FAR audio_buffering_s *ab,
+                          FAR const audio_buffering_limits_s *limits,
+                          uint32_t byterate, uint32_t blockalign,
+                          size_t max_bytes, uint32_t driver_bufs);
+void audio_buffering_set_limits(FAR audio_buffering_s *ab,
+                                FAR const audio_buffering_limits_s *limits);
+void audio_buffering_restart(FAR audio_buffering_s *ab);
+
+/* Dequeue callback side */
+void audio_buffering_dequeue(FAR audio_buffering_s *ab, uint32_t played);
+void audio_buffering_underrun(FAR audio_buffering_s *ab);
+
+/* Decoder thread side */
+void audio_buffering_decode(FAR audio_buffering_s *ab, uint32_t start);
+
+void audio_buffering_get_stats(FAR audio_buffering_s *ab,
+                               FAR audio_buffering_stats_s *stats);
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /* AUDIO_BUFFERING_H */
@@ -20,44 +20,62 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
-#include <unistd.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
 
 #include "audio_ctl.h"
+#include "audio_trace.h"
+#ifdef CONFIG_LVX_MUSIC_PLAYER_CROSSFADE
+#include "pcm_mix.h"
+#endif
 
 #include <audioutils/nxaudio.h>
 
-// 检查MP3支持和MAD库是否可用
-#ifdef CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT
-#include <string.h>
-#ifdef CONFIG_LIB_MAD
-#include <mad.h>
-#define MP3_DECODER_AVAILABLE 1
-#else
-#define MP3_DECODER_AVAILABLE 0
-#warning "MAD library not available, MP3 support disabled"
+#ifdef CONFIG_LVX_MUSIC_PLAYER_WAV_MMAP
+#include <sys/mman.h>
+#endif
+
+// MP3解码输出块大小(样本数)
+#define PCM_BUFFER_SIZE 4096
+
+// 解码线程与PCM环形缓冲区
+#ifndef CONFIG_LVX_MUSIC_PLAYER_RING_MS
+#define CONFIG_LVX_MUSIC_PLAYER_RING_MS 300
+#endif
+
+#define AUDIO_CTL_DECODE_STACKSIZE 8192
+#define AUDIO_CTL_DECODE_IDLE_US   5000
+#define AUDIO_CTL_PREFILL_TIMEOUT_MS 500
+#define AUDIO_CTL_ATTACH_TIMEOUT_MS  1000
+
+// 交叉淡化：重叠期间两路解码加混音的耗时上限(占实时的百分比)
+#ifndef CONFIG_LVX_MUSIC_PLAYER_CROSSFADE_MAX_LOAD
+#define CONFIG_LVX_MUSIC_PLAYER_CROSSFADE_MAX_LOAD 70
+#endif
+
+#define AUDIO_CTL_FADE_WARMUP_CHUNKS 4
+#define AUDIO_CTL_FADE_RUSH_CHUNKS   2
+
+// 重采样：设备固定运行在这个采样率
+#ifndef CONFIG_LVX_MUSIC_PLAYER_OUTPUT_RATE
+#define CONFIG_LVX_MUSIC_PLAYER_OUTPUT_RATE 48000
 #endif
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_RESAMPLE_FAST
+#define AUDIO_CTL_RESAMPLE_PRESET PCM_RESAMPLE_FAST
 #else
-#define MP3_DECODER_AVAILABLE 0
+#define AUDIO_CTL_RESAMPLE_PRESET PCM_RESAMPLE_HQ
 #endif
 
-// MP3解码缓冲区大小
-#define MP3_BUFFER_SIZE 8192
-#define PCM_BUFFER_SIZE 4096
+#define AUDIO_CTL_RESAMPLE_BYTES (PCM_BUFFER_SIZE * sizeof(int16_t))
 
-#if MP3_DECODER_AVAILABLE
-// MP3解码状态结构
-typedef struct {
-    struct mad_stream stream;
-    struct mad_frame frame;
-    struct mad_synth synth;
-    unsigned char input_buffer[MP3_BUFFER_SIZE];
-    short output_buffer[PCM_BUFFER_SIZE];
-    int input_length;
-    int output_length;
-    bool initialized;
-} mp3_decoder_t;
+// WAV格式转换：每次最多转换的帧数
+#define AUDIO_CTL_CONVERT_FRAMES 1024
 
-static mp3_decoder_t g_mp3_decoder = {0};
+// 均衡器：启动时应用的频段列表
+#ifndef CONFIG_LVX_MUSIC_PLAYER_EQ_PRESET
+#define CONFIG_LVX_MUSIC_PLAYER_EQ_PRESET ""
 #endif
 
 /**********************
@@ -66,15 +84,206 @@ static mp3_decoder_t g_mp3_decoder = {0};
 
 static void app_dequeue_cb(unsigned long arg,
                            FAR struct ap_buffer_s *apb);
+static size_t app_output_buffer(FAR audioctl_s *ctl,
+                                FAR struct ap_buffer_s *apb,
+                                bool from_driver);
+static size_t app_dequeue_buffer(FAR audioctl_s *ctl,
+                                 FAR struct ap_buffer_s *apb);
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADAPTIVE_BUFFERS
+static int audio_ctl_buffering_open(FAR audioctl_s *ctl);
+#endif
+#ifdef CONFIG_LVX_MUSIC_PLAYER_TELEMETRY
+static uint32_t audio_ctl_bytes_to_us(FAR audioctl_s *ctl, uint32_t bytes);
+#endif
 static void app_complete_cb(unsigned long arg);
 static void app_user_cb(unsigned long arg,
                         FAR struct audio_msg_s *msg, FAR bool *running);
+static int audio_ctl_decode_chunk(FAR audioctl_s *ctl);
+static FAR void *audio_decode_thread(pthread_addr_t arg);
+static int audio_ctl_start_decoder(FAR audioctl_s *ctl);
+static void audio_ctl_stop_decoder(FAR audioctl_s *ctl);
+#ifdef CONFIG_LVX_MUSIC_PLAYER_WAV_MMAP
+static void app_dequeue_mapped(FAR audioctl_s *ctl,
+                               FAR struct ap_buffer_s *apb, size_t len);
+static int audio_source_map(FAR audio_source_s *src, FAR audio_map_s *map);
+static void audio_source_unmap(FAR audio_map_s *map);
+static void audio_map_prefetch(FAR audio_map_s *map, size_t ahead);
+#endif
+#ifdef CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT
+static int audio_ctl_load_mp3_index(FAR audio_source_s *src,
+                                    FAR const char *path);
+#endif
+#if defined(CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT) || \
+    defined(CONFIG_LVX_MUSIC_PLAYER_FLAC_SUPPORT) || \
+    defined(CONFIG_LVX_MUSIC_PLAYER_ADPCM_SUPPORT)
+static size_t audio_source_trim(FAR audio_source_s *src, FAR uint8_t *pcm,
+                                size_t frames);
+#endif
+static int audio_source_open(FAR const char *path,
+                             FAR audio_source_s **srcp);
+static int audio_source_set_convert(FAR audio_source_s *src);
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADPCM_SUPPORT
+static int audio_source_set_adpcm(FAR audio_source_s *src);
+#endif
+static int audio_source_locate(FAR audio_source_s *src, uint64_t in_frame,
+                               FAR uint32_t *position,
+                               FAR uint64_t *landed,
+                               FAR uint64_t *target);
+static void audio_source_seek(FAR audio_source_s *src, uint32_t position,
+                              uint64_t landed, uint64_t target);
+static void audio_source_close(FAR audio_source_s *src);
+static ssize_t audio_source_decode(FAR audio_source_s *src,
+                                   FAR uint8_t *buf, size_t len);
+static ssize_t audio_source_decode_pcm(FAR audio_source_s *src,
+                                       FAR uint8_t *buf, size_t len);
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADPCM_SUPPORT
+static ssize_t audio_source_decode_adpcm(FAR audio_source_s *src,
+                                         FAR uint8_t *buf, size_t len);
+#endif
+#ifdef CONFIG_LVX_MUSIC_PLAYER_RESAMPLE
+static int audio_source_set_rate(FAR audio_source_s *src, uint32_t rate);
+static ssize_t audio_source_resample(FAR audio_source_s *src,
+                                     FAR uint8_t *buf, size_t len);
+#endif
+static void audio_ctl_splice(FAR audioctl_s *ctl);
+static void audio_ctl_attach(FAR audioctl_s *ctl);
+static bool audio_source_same_format(FAR audio_source_s *a,
+                                     FAR audio_source_s *b);
+static int audio_ctl_open_session(FAR audioctl_s *ctl);
+static void audio_ctl_close_session(FAR audioctl_s *ctl);
+#ifdef CONFIG_LVX_MUSIC_PLAYER_EQ
+static void audio_ctl_eq_preset(FAR audioctl_s *ctl);
+#endif
+#ifdef CONFIG_LVX_MUSIC_PLAYER_RESAMPLE
+/**
+ * @brief Make the source produce PCM at rate
+ * @return 0 when it does, -ENOTSUP if its samples cannot be converted,
+ *         negated errno on other errors
+ *
+ * Called right after audio_source_open(). The filter bank is designed
+ * here, once per track.
+ */
+static int audio_source_set_rate(FAR audio_source_s *src, uint32_t rate)
+{
+    FAR fmt_s *fmt = &src->wav.fmt;
+    int ret;
+
+    if (fmt->samplerate == rate) {
+        return 0;
+    }
+
+    if (fmt->audioformat != WAVE_FORMAT_PCM || fmt->bitspersample != 16) {
+        return -ENOTSUP;
+    }
+
+    src->rs = (FAR pcm_resample_s *)malloc(sizeof(pcm_resample_s));
+    src->rs_buf = (FAR uint8_t *)malloc(AUDIO_CTL_RESAMPLE_BYTES);
+    if (src->rs == NULL || src->rs_buf == NULL) {
+        ret = -ENOMEM;
+        goto errout;
+    }
+
+    ret = pcm_resample_init(src->rs, fmt->samplerate, rate,
+                            fmt->numchannels, AUDIO_CTL_RESAMPLE_PRESET);
+    if (ret < 0) {
+        goto errout;
+    }
+
+    MP3_LOG("🔄 重采样: %uHz -> %uHz (%d taps, %s)",
+            (unsigned)fmt->samplerate, (unsigned)rate, src->rs->taps,
+            pcm_resample_name());
+
+    src->in_rate = fmt->samplerate;
+    fmt->samplerate = rate;
+    fmt->byterate = rate * fmt->blockalign;
+    src->total_frames = pcm_resample_out_frames(src->rs, src->total_frames);
+
+    return 0;
+
+errout:
+    free(src->rs);
+    free(src->rs_buf);
+    src->rs = NULL;
+    src->rs_buf = NULL;
+    return ret;
+}
+
+/**
+ * @brief Decode and convert up to len bytes at the session rate
+ * @return Bytes produced, 0 at end of stream, negative on error
+ */
+static ssize_t audio_source_resample(FAR audio_source_s *src,
+                                     FAR uint8_t *buf, size_t len)
+{
+    size_t bpf = src->wav.fmt.blockalign;
+    size_t produced;
+    size_t frames;
+    ssize_t ret;
+
+    for (;;) {
+        if (src->rs_pos + bpf > src->rs_len && !src->rs_eof) {
+            size_t rest = src->rs_len - src->rs_pos;
+
+            /* A partial frame is carried to the front of the buffer */
+
+            memmove(src->rs_buf, src->rs_buf + src->rs_pos, rest);
+            ret = audio_source_decode_pcm(src, src->rs_buf + rest,
+                                          AUDIO_CTL_RESAMPLE_BYTES - rest);
+            if (ret < 0) {
+                return ret;
+            }
+
+            src->rs_len = rest + ret;
+            src->rs_pos = 0;
+            src->rs_eof = ret == 0;
+        }
+
+        if (src->rs_pos + bpf > src->rs_len) {
+            /* End of the track: flush what is left in the filter */
+
+            frames = 0;
+            produced = pcm_resample_process(src->rs, NULL, &frames,
+                                            (FAR int16_t *)buf, len / bpf);
+            return produced * bpf;
+        }
+
+        frames = (src->rs_len - src->rs_pos) / bpf;
+        produced = pcm_resample_process(src->rs,
+                       (FAR const int16_t *)(src->rs_buf + src->rs_pos),
+                       &frames, (FAR int16_t *)buf, len / bpf);
+        src->rs_pos += frames * bpf;
+
+        if (produced > 0) {
+            return produced * bpf;
+        }
+    }
+}
+#endif /* CONFIG_LVX_MUSIC_PLAYER_RESAMPLE */
+
+/**
+ * @brief Produce up to len bytes of PCM in the session format into buf
+ * @return Bytes produced, 0 at end of stream, negative on error
+ */
+static ssize_t audio_source_decode(FAR audio_source_s *src,
+                                   FAR uint8_t *buf, size_t len)
+{
+#ifdef CONFIG_LVX_MUSIC_PLAYER_RESAMPLE
+    if (src->rs != NULL) {
+        return audio_source_resample(src, buf, len);
+    }
+#endif
 
-#if MP3_DECODER_AVAILABLE
-static int mp3_decoder_init(mp3_decoder_t *decoder);
-static void mp3_decoder_cleanup(mp3_decoder_t *decoder);
-static int mp3_decode_frame(mp3_decoder_t *decoder, const unsigned char *data, int len);
-static short mp3_scale_sample(mad_fixed_t sample);
+    return audio_source_decode_pcm(src, buf, len);
+}
+
+static ssize_t audio_source_fill(FAR audio_source_s *src, FAR uint8_t *buf,
+                                 size_t len);
+#ifdef CONFIG_LVX_MUSIC_PLAYER_CROSSFADE
+static uint64_t audio_ctl_now_us(void);
+static uint64_t audio_source_remaining(FAR audio_source_s *src);
+static void audio_ctl_fade_start(FAR audioctl_s *ctl);
+static void audio_ctl_fade_end(FAR audioctl_s *ctl, bool completed);
+static int audio_ctl_fade_chunk(FAR audioctl_s *ctl);
 #endif
 
 /**********************
@@ -101,330 +310,2588 @@ static void app_dequeue_cb(unsigned long arg, FAR struct ap_buffer_s *apb)
         return;
     }
 
-    if (ctl->seek) {
-        lseek(ctl->fd, ctl->seek_position, SEEK_SET);
-        ctl->file_position = ctl->seek_position;
-        ctl->seek = false;
+    audio_trace_mark(AUDIO_TRACE_DEQUEUE);
+
+    /* Buffers primed by open_session do not come from the driver */
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADAPTIVE_BUFFERS
+    if (!ctl->session_open)
+    {
+        app_output_buffer(ctl, apb, false);
+        return;
     }
 
-    apb->curbyte = 0;
-    apb->flags = 0;
+    ctl->out_queued--;
+    audio_buffering_dequeue(&ctl->buffering, apb->nbytes);
 
-    if (ctl->audio_format == AUDIO_FORMAT_WAV) {
-        /* Handle WAV format (original logic) */
-        apb->nbytes = read(ctl->fd, apb->samp, apb->nmaxbytes);
+    if (app_output_buffer(ctl, apb, true) > 0) {
+        audio_buffering_underrun(&ctl->buffering);
+    }
 
-        while (0 < apb->nbytes && apb->nbytes < apb->nmaxbytes)
-        {
-            int n = apb->nmaxbytes - apb->nbytes;
-            int ret = read(ctl->fd, &apb->samp[apb->nbytes], n);
+    /* The level went up: put waiting buffers back to work */
 
-            if (0 >= ret)
-            {
-                break;
-            }
-            apb->nbytes += ret;
-        }
+    while (ctl->out_queued < ctl->buffering.bufs && ctl->out_nidle > 0)
+    {
+        apb = ctl->out_idle[--ctl->out_nidle];
+        app_output_buffer(ctl, apb, false);
 
-        if (apb->nbytes < apb->nmaxbytes)
-        {
-            close(ctl->fd);
-            ctl->fd = -1;
-            return;
-        }
+        if (apb->nbytes == 0) {
+            /* End of the mapped data */
 
-        ctl->file_position += apb->nbytes;
-    }
-#ifdef CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT
-    else if (ctl->audio_format == AUDIO_FORMAT_MP3) {
-        /* Handle MP3 format */
-        static unsigned char mp3_input_buffer[CONFIG_LVX_MUSIC_PLAYER_MP3_BUFFER_SIZE];
-        size_t bytes_read = read(ctl->fd, mp3_input_buffer, sizeof(mp3_input_buffer));
-        
-        MP3_LOG("📖 读取MP3数据: %zu bytes (位置: %ld)", bytes_read, ctl->file_position);
-        
-        if (bytes_read <= 0) {
-            MP3_LOG("📄 MP3文件读取完成或出错，关闭文件");
-            close(ctl->fd);
-            ctl->fd = -1;
-            apb->nbytes = 0;
-            return;
+            ctl->out_idle[ctl->out_nidle++] = apb;
+            break;
         }
+    }
+#else
+    app_output_buffer(ctl, apb, ctl->session_open);
+#endif
+}
 
-        MP3_LOG("🔄 开始MP3解码: 输入%zu bytes, 输出缓冲区%zu bytes", bytes_read, apb->nmaxbytes);
-        
-        // 使用内部解码器进行MP3解码
-        int decoded_samples = mp3_decode_frame(&g_mp3_decoder, mp3_input_buffer, bytes_read);
-        
-        if (decoded_samples > 0) {
-            // 复制解码后的PCM数据到音频缓冲区
-            size_t bytes_to_copy = decoded_samples * sizeof(short);
-            if (bytes_to_copy > apb->nmaxbytes) {
-                bytes_to_copy = apb->nmaxbytes;
-            }
-            
-            memcpy(apb->samp, g_mp3_decoder.output_buffer, bytes_to_copy);
-            apb->nbytes = bytes_to_copy;
-            MP3_LOG("✅ MP3解码成功: 输出%zu bytes (%d samples)", bytes_to_copy, decoded_samples);
-        } else {
-            apb->nbytes = 0;
-            MP3_LOG("❌ MP3解码失败或无输出");
-        }
+/**
+ * @brief Refill apb and queue it, or hold it back above the output level
+ * @param from_driver Whether the driver gave apb back
+ * @return Bytes of silence that had to stand in for missing PCM
+ */
+static size_t app_output_buffer(FAR audioctl_s *ctl,
+                                FAR struct ap_buffer_s *apb,
+                                bool from_driver)
+{
+#ifdef CONFIG_LVX_MUSIC_PLAYER_TELEMETRY
+    uint32_t start = audio_telemetry_now_us();
+    uint32_t headroom = AUDIO_TELEMETRY_NONE;
+#endif
+    size_t silence = 0;
 
-        if (apb->nbytes == 0) {
-            MP3_LOG("⚠️ 解码输出为空，关闭文件");
-            close(ctl->fd);
-            ctl->fd = -1;
-            return;
-        }
+#ifdef CONFIG_LVX_MUSIC_PLAYER_TELEMETRY
+    /* How far the decoder is ahead of the device, and how long it took to
+     * hand the buffer back.
+     */
 
-        ctl->file_position += bytes_read;
+#ifdef CONFIG_LVX_MUSIC_PLAYER_WAV_MMAP
+    if (ctl->map.data == NULL)
+#endif
+    {
+        headroom = audio_ctl_bytes_to_us(ctl, pcm_ring_used(&ctl->ring));
     }
+
+    audio_telemetry_output_begin(&ctl->telemetry, from_driver, headroom);
 #endif
-    else {
-        /* Unknown format */
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADAPTIVE_BUFFERS
+    if (ctl->out_queued >= ctl->buffering.bufs)
+    {
+        /* The level went down, keep this one until it goes up again */
+
         apb->nbytes = 0;
-        return;
+        ctl->out_idle[ctl->out_nidle++] = apb;
+    }
+    else
+#endif
+    {
+        silence = app_dequeue_buffer(ctl, apb);
     }
 
-    nxaudio_enqbuffer(&ctl->nxaudio, apb);
-}
-
-static void app_complete_cb(unsigned long arg)
-{
-    /* Do nothing.. */
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADAPTIVE_BUFFERS
+    if (apb->nbytes > 0) {
+        ctl->out_queued++;
+    }
+#endif
 
-    printf("Audio loop is Done\n");
+#ifdef CONFIG_LVX_MUSIC_PLAYER_TELEMETRY
+    audio_telemetry_output_end(&ctl->telemetry, start, apb->nbytes > 0,
+                               audio_ctl_bytes_to_us(ctl, silence));
+#endif
+    return silence;
 }
 
-static void app_user_cb(unsigned long arg,
-                        FAR struct audio_msg_s *msg, FAR bool *running)
-{
-    /* Do nothing.. */
-}
+#ifdef CONFIG_LVX_MUSIC_PLAYER_TELEMETRY
+/* Play time of bytes of the PCM going to the device */
 
-static FAR void *audio_loop_thread(pthread_addr_t arg)
+static uint32_t audio_ctl_bytes_to_us(FAR audioctl_s *ctl, uint32_t bytes)
 {
-    FAR audioctl_s *ctl = (FAR audioctl_s *)arg;
+    FAR fmt_s *fmt = &ctl->src->wav.fmt;
+    uint32_t byterate = fmt->samplerate * fmt->blockalign;
 
-    nxaudio_start(&ctl->nxaudio);
-    nxaudio_msgloop(&ctl->nxaudio, &cbs,
-                    (unsigned long)(uintptr_t)ctl);
+    if (byterate == 0) {
+        return 0;
+    }
 
-    return NULL;
+    return (uint64_t)bytes * 1000000 / byterate;
 }
+#endif
 
-/**********************
- *   GLOBAL FUNCTIONS
- **********************/
-
-FAR audioctl_s *audio_ctl_init_nxaudio(FAR const char *arg)
+/**
+ * @brief Refill apb and give it back to the driver
+ * @return Bytes of silence that had to stand in for missing PCM
+ */
+static size_t app_dequeue_buffer(FAR audioctl_s *ctl,
+                                 FAR struct ap_buffer_s *apb)
 {
-    FAR audioctl_s *ctl;
-    int ret;
-    int i;
+    size_t len = apb->nmaxbytes;
+    size_t silence = 0;
+    size_t n;
 
-    ctl = (FAR audioctl_s *)malloc(sizeof(audioctl_s));
-    if(ctl == NULL)
+    apb->curbyte = 0;
+    apb->flags = 0;
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADAPTIVE_BUFFERS
+    len = ctl->buffering.bytes;
+#endif
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_WAV_MMAP
+    if (ctl->map.data != NULL)
     {
-        return NULL;
+        app_dequeue_mapped(ctl, apb, len);
+        return 0;
     }
+#endif
 
-    memset(ctl, 0, sizeof(audioctl_s));
-    ctl->seek = false;
-    ctl->seek_position = 0;
-    ctl->file_position = 0;
+    /* Only copy what the decoder thread already produced, never block */
 
-    /* Detect audio format */
-    ctl->audio_format = audio_ctl_detect_format(arg);
-    MP3_LOG("🎵 检测音频格式: %s -> %d", arg, ctl->audio_format);
-    
-    if (ctl->audio_format == AUDIO_FORMAT_UNKNOWN) {
-        MP3_LOG("❌ 不支持的音频格式: %s", arg);
-        printf("Unsupported audio format: %s\n", arg);
-        free(ctl);
-        return NULL;
-    } else if (ctl->audio_format == AUDIO_FORMAT_MP3) {
-        MP3_LOG("✅ 检测到MP3格式，准备初始化解码器");
-    }
+    n = pcm_ring_read(&ctl->ring, apb->samp, len);
+    ctl->played_bytes += n;
 
-    ctl->fd = open(arg, O_RDONLY);
-    if (ctl->fd < 0) {
-       MP3_LOG("❌ 无法打开音频文件: %s (errno: %d)", arg, errno);
-       printf("can't open audio file: %s\n", arg);
-       free(ctl);
-       return NULL;
-    }
-    
-    // 获取文件大小
-    struct stat st;
-    if (fstat(ctl->fd, &st) == 0) {
-        MP3_LOG("✅ 音频文件打开成功: %s (大小: %lld bytes)", arg, (long long)st.st_size);
-    }
+    /* The queued track starts somewhere in this buffer: from here on the
+     * position counts from its first sample.
+     */
 
-    uint32_t sample_rate = 44100;
-    uint16_t bits_per_sample = 16;
-    uint16_t channels = 2;
+    if (atomic_load(&ctl->splice_pending)) {
+        int32_t into = (int32_t)(pcm_ring_read_count(&ctl->ring) -
+                                 ctl->splice_pos);
 
-    if (ctl->audio_format == AUDIO_FORMAT_WAV) {
-        /* Read WAV header */
-        read(ctl->fd, &ctl->wav, sizeof(ctl->wav));
-        sample_rate = ctl->wav.fmt.samplerate;
-        bits_per_sample = ctl->wav.fmt.bitspersample;
-        channels = ctl->wav.fmt.numchannels;
-    }
-#ifdef CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT
-    else if (ctl->audio_format == AUDIO_FORMAT_MP3) {
-        /* Initialize global MP3 decoder */
-        MP3_LOG("🔧 初始化全局MP3解码器...");
-        if (mp3_decoder_init(&g_mp3_decoder) < 0) {
-            MP3_LOG("❌ MP3解码器初始化失败");
-            printf("Failed to initialize MP3 decoder\n");
-            close(ctl->fd);
-            free(ctl);
-            return NULL;
+        if (into >= 0 && atomic_exchange(&ctl->splice_pending, false)) {
+            ctl->total_frames = ctl->splice_total;
+            ctl->played_bytes = into;
+            ctl->track_serial++;
         }
-        MP3_LOG("✅ MP3解码器初始化成功");
-        
-        /* Use default values for MP3, will be updated during decode */
-        sample_rate = 44100;
-        bits_per_sample = 16;
-        channels = 2;
-        MP3_LOG("🎵 MP3默认参数: %dHz, %d位, %d声道", sample_rate, bits_per_sample, channels);
     }
-#endif
 
-    ret = init_nxaudio(&ctl->nxaudio, sample_rate, bits_per_sample, channels);
-    if (ret < 0)
+    if (n < len)
     {
-        printf("init_nxaudio() return with error!!\n");
-#ifdef CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT
-        if (ctl->audio_format == AUDIO_FORMAT_MP3) {
-            mp3_decoder_cleanup(&g_mp3_decoder);
+        /* Pad with silence to keep the clock. At the end of the last track
+         * this keeps the session alive for audio_ctl_switch(), the owner
+         * pauses it when nothing else is going to play.
+         */
+
+        memset(&apb->samp[n], 0, len - n);
+        if (!atomic_load(&ctl->decode_eof) || ctl->next != NULL)
+        {
+            silence = len - n;
+            pcm_ring_note_underrun(&ctl->ring, silence);
         }
-#endif
-        close(ctl->fd);
-        free(ctl);
-        return NULL;
-    }
 
-    for (i = 0; i < ctl->nxaudio.abufnum; i++)
-    {
-        app_dequeue_cb((unsigned long)ctl, ctl->nxaudio.abufs[i]);
+        n = len;
     }
 
-    ctl->state = AUDIO_CTL_STATE_INIT;
+    apb->nbytes = n;
 
-    return ctl;
+    nxaudio_enqbuffer(&ctl->nxaudio, apb);
+    if (silence < n) {
+        audio_trace_mark(AUDIO_TRACE_ENQUEUE);
+    }
+
+    return silence;
 }
 
-int audio_ctl_start(FAR audioctl_s *ctl)
+#ifdef CONFIG_LVX_MUSIC_PLAYER_WAV_MMAP
+/**
+ * @brief Fill apb straight from the mapped WAV data chunk
+ *
+ * PCM needs no decoding, so there is no decoder thread, no read() and no
+ * ring in this mode: one copy from the page cache into the driver buffer.
+ */
+static void app_dequeue_mapped(FAR audioctl_s *ctl,
+                               FAR struct ap_buffer_s *apb, size_t len)
 {
-    if (ctl == NULL)
-        return -EINVAL;
+    size_t n;
 
-    if (ctl->state != AUDIO_CTL_STATE_INIT && ctl->state != AUDIO_CTL_STATE_PAUSE)
-    {
-        return -1;
+    /* Pairs with the release in audio_ctl_seek_frame(). A seek posted while
+     * this one is applied sets the flag again and is taken next time.
+     */
+
+    if (atomic_exchange_explicit(&ctl->seek, false, memory_order_acquire)) {
+        ctl->map.pos = ctl->seek_position - ctl->src->wav.data_offset;
+        ctl->played_bytes = ctl->seek_bytes;
     }
 
-    ctl->state = AUDIO_CTL_STATE_START;
+    n = ctl->map.size - ctl->map.pos;
+    if (n == 0) {
+        apb->nbytes = 0;
+        return;
+    }
 
-    pthread_attr_t tattr;
-    struct sched_param sparam;
+    if (n > len) {
+        n = len;
+    } else {
+        apb->flags |= AUDIO_APB_FINAL;
+    }
 
-    pthread_attr_init(&tattr);
-    sparam.sched_priority = sched_get_priority_max(SCHED_FIFO) - 9;
-    pthread_attr_setschedparam(&tattr, &sparam);
-    pthread_attr_setstacksize(&tattr, 4096);
+    memcpy(apb->samp, ctl->map.data + ctl->map.pos, n);
+    ctl->map.pos += n;
 
-    pthread_create(&ctl->pid, &tattr, audio_loop_thread,
-                                (pthread_addr_t)ctl);
+    /* Fault the next buffers in before the callback gets to them */
 
-    pthread_attr_destroy(&tattr);
-    pthread_setname_np(ctl->pid, "audioctl_thread");
+    audio_map_prefetch(&ctl->map, 4 * len);
 
-    return 0;
+    apb->nbytes = n;
+    ctl->played_bytes += n;
+
+    nxaudio_enqbuffer(&ctl->nxaudio, apb);
+    audio_trace_mark(AUDIO_TRACE_ENQUEUE);
 }
 
-int audio_ctl_pause(FAR audioctl_s *ctl)
+/**
+ * @brief Map the PCM data chunk of the open WAV file
+ * @return 0 when mapped, negative to fall back to decoding
+ */
+static int audio_source_map(FAR audio_source_s *src, FAR audio_map_s *map)
 {
-    if (ctl == NULL)
-        return -EINVAL;
+    off_t data_offset = src->wav.data_offset;
+    size_t data_size = src->wav.data_size;
+    off_t page;
+    FAR void *base;
 
-    if (ctl->state != AUDIO_CTL_STATE_START)
-    {
-        return -1;
-    }
+    /* Only plain PCM can go to the device without conversion */
 
-    ctl->state = AUDIO_CTL_STATE_PAUSE;
+    if (src->audio_format != AUDIO_FORMAT_WAV || src->convert != NULL ||
+        data_size == 0) {
+        return -ENOTSUP;
+    }
 
-    return nxaudio_pause(&ctl->nxaudio);
-}
+#ifdef CONFIG_LVX_MUSIC_PLAYER_RESAMPLE
+    if (src->rs != NULL) {
+        return -ENOTSUP;
+    }
+#endif
 
-int audio_ctl_resume(FAR audioctl_s *ctl)
-{
-    if (ctl == NULL)
-        return -EINVAL;
+    /* mmap() wants a page aligned file offset */
 
-    if (ctl->state != AUDIO_CTL_STATE_PAUSE)
-    {
-        return -1;
+    page = data_offset - data_offset % sysconf(_SC_PAGESIZE);
+    base = mmap(NULL, data_offset - page + data_size, PROT_READ, MAP_SHARED,
+                src->fd, page);
+    if (base == MAP_FAILED) {
+        return -errno;
     }
 
-    ctl->state = AUDIO_CTL_STATE_START;
+#ifdef POSIX_MADV_SEQUENTIAL
+    posix_madvise(base, data_offset - page + data_size,
+                  POSIX_MADV_SEQUENTIAL);
+#endif
 
-    return nxaudio_resume(&ctl->nxaudio);
+    map->base = base;
+    map->offset = page;
+    map->len = data_offset - page + data_size;
+    map->data = map->base + (data_offset - page);
+    map->size = data_size;
+    map->pos = 0;
+
+    return 0;
 }
 
-int audio_ctl_seek(FAR audioctl_s *ctl, unsigned ms)
+static void audio_source_unmap(FAR audio_map_s *map)
 {
-    if (ctl == NULL)
-        return -EINVAL;
-
-    ctl->seek_position = ms * ctl->wav.fmt.samplerate * ctl->wav.fmt.bitspersample * ctl->wav.fmt.numchannels / 8;
-    ctl->seek = true;
+    if (map->base == NULL) {
+        return;
+    }
 
-    return 0;
+    munmap(map->base, map->len);
+    map->base = NULL;
+    map->data = NULL;
+    map->len = 0;
+    map->size = 0;
 }
 
-int audio_ctl_stop(FAR audioctl_s *ctl)
+/* Fault the mapped data after pos in before it is copied out */
+
+static void audio_map_prefetch(FAR audio_map_s *map, size_t ahead)
 {
-    if (ctl == NULL)
-        return -EINVAL;
+#ifdef POSIX_MADV_WILLNEED
+    uintptr_t next = (uintptr_t)(map->data + map->pos);
+    uintptr_t page = next & ~((uintptr_t)sysconf(_SC_PAGESIZE) - 1);
+
+    if (map->pos >= map->size) {
+        return;
+    }
+
+    if (ahead > map->size - map->pos) {
+        ahead = map->size - map->pos;
+    }
+
+    posix_madvise((FAR void *)page, next - page + ahead,
+                  POSIX_MADV_WILLNEED);
+#endif
+}
+#endif /* CONFIG_LVX_MUSIC_PLAYER_WAV_MMAP */
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT
+/**
+ * @brief Get the MP3 frame index, from the sidecar cache when possible
+ *
+ * mp3_index_build() has already replaced a Xing/VBRI table of contents
+ * with scanned frame positions, so the record stored is the exact index
+ * and the next open of the track loads it without touching the file.
+ */
+static int audio_ctl_load_mp3_index(FAR audio_source_s *src,
+                                    FAR const char *path)
+{
+    int ret;
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_MP3_INDEX_CACHE
+    ret = mp3_index_cache_load(&src->mp3_index, path, src->fd);
+    if (ret == 0) {
+        MP3_LOG("⚡ MP3索引缓存命中: %s", path);
+        return 0;
+    }
+#endif
+
+    ret = mp3_index_build(&src->mp3_index, src->fd);
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_MP3_INDEX_CACHE
+    if (ret == 0) {
+        int err = mp3_index_cache_store(&src->mp3_index, path, src->fd);
+
+        MP3_LOG("💾 MP3索引缓存写入: %s (%d)", path, err);
+    }
+#endif
+
+    return ret;
+}
+#endif
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADPCM_SUPPORT
+/**
+ * @brief Set up block decoding of IMA or MS ADPCM data
+ * @return 0 on success, -ENOTSUP for invalid block layouts
+ *
+ * The length comes from the fact chunk when there is one, it leaves out
+ * the unused tail of the last block.
+ */
+static int audio_source_set_adpcm(FAR audio_source_s *src)
+{
+    FAR fmt_s *fmt = &src->wav.fmt;
+    FAR adpcm_s *adpcm = &src->adpcm;
+    uint32_t size = src->wav.data_size;
+    int ret;
+
+    ret = adpcm_init(adpcm, fmt->audioformat == WAVE_FORMAT_IMA_ADPCM ?
+                     ADPCM_IMA : ADPCM_MS, fmt->numchannels,
+                     fmt->blockalign, src->wav.samples_per_block);
+    if (ret < 0) {
+        return ret;
+    }
+
+    src->convert = pcm_format_select(false, 16, sizeof(int16_t),
+                                     adpcm->channels);
+    src->cv_buf = (FAR uint8_t *)malloc(adpcm->block_align);
+    src->blk_pcm = (FAR int16_t *)malloc(adpcm->block_frames *
+                                         adpcm->channels * sizeof(int16_t));
+    if (src->cv_buf == NULL || src->blk_pcm == NULL) {
+        free(src->cv_buf);
+        free(src->blk_pcm);
+        src->cv_buf = NULL;
+        src->blk_pcm = NULL;
+        src->convert = NULL;
+        adpcm->block_frames = 0;
+        return -ENOMEM;
+    }
+
+    src->end_frame = (uint64_t)(size / adpcm->block_align) *
+                     adpcm->block_frames +
+                     adpcm_block_frames(adpcm, size % adpcm->block_align);
+    if (src->wav.fact_frames > 0 && src->wav.fact_frames < src->end_frame) {
+        src->end_frame = src->wav.fact_frames;
+    }
+
+    MP3_LOG("🗜️ %s ADPCM: %u声道, 每块%u字节/%u帧, 共%llu帧",
+            adpcm->coding == ADPCM_IMA ? "IMA" : "MS", adpcm->channels,
+            adpcm->block_align, adpcm->block_frames,
+            (unsigned long long)src->end_frame);
+
+    return 0;
+}
+#endif
+
+/**
+ * @brief Whether the source decodes ADPCM blocks rather than reading PCM
+ */
+static inline bool audio_source_is_adpcm(FAR audio_source_s *src)
+{
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADPCM_SUPPORT
+    return src->adpcm.block_frames != 0;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Pick the conversion of a WAV data chunk to 16-bit stereo
+ * @return 0 on success, -ENOTSUP for codings and layouts without a kernel
+ *
+ * On success wav.fmt describes the converted PCM; file_bpf keeps the
+ * frame size of the file for offsets into the data chunk.
+ */
+static int audio_source_set_convert(FAR audio_source_s *src)
+{
+    FAR fmt_s *fmt = &src->wav.fmt;
+
+    if (fmt->audioformat == WAVE_FORMAT_PCM && fmt->bitspersample == 16 &&
+        fmt->numchannels == PCM_FORMAT_OUT_CHANNELS && fmt->blockalign == 4) {
+        return 0;
+    }
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADPCM_SUPPORT
+    if (fmt->audioformat == WAVE_FORMAT_ADPCM ||
+        fmt->audioformat == WAVE_FORMAT_IMA_ADPCM) {
+        int ret = audio_source_set_adpcm(src);
+
+        if (ret < 0) {
+            return ret;
+        }
+    } else
+#endif
+    {
+        if ((fmt->audioformat != WAVE_FORMAT_PCM &&
+             fmt->audioformat != WAVE_FORMAT_IEEE_FLOAT) ||
+            fmt->numchannels == 0 || fmt->blockalign % fmt->numchannels != 0) {
+            return -ENOTSUP;
+        }
+
+        src->convert = pcm_format_select(
+            fmt->audioformat == WAVE_FORMAT_IEEE_FLOAT, fmt->bitspersample,
+            fmt->blockalign / fmt->numchannels, fmt->numchannels);
+        if (src->convert == NULL) {
+            return -ENOTSUP;
+        }
+
+        src->cv_buf = (FAR uint8_t *)malloc(AUDIO_CTL_CONVERT_FRAMES *
+                                            src->file_bpf);
+        if (src->cv_buf == NULL) {
+            src->convert = NULL;
+            return -ENOMEM;
+        }
+
+        MP3_LOG("🔀 WAV格式转换: %u位 %u声道%s -> 16位立体声",
+                fmt->bitspersample, fmt->numchannels,
+                fmt->audioformat == WAVE_FORMAT_IEEE_FLOAT ? " 浮点" : "");
+    }
+
+    fmt->audioformat = WAVE_FORMAT_PCM;
+    fmt->numchannels = PCM_FORMAT_OUT_CHANNELS;
+    fmt->bitspersample = PCM_FORMAT_OUT_BITS;
+    fmt->blockalign = PCM_FORMAT_OUT_CHANNELS * PCM_FORMAT_OUT_BITS / 8;
+    fmt->byterate = fmt->samplerate * fmt->blockalign;
+
+    return 0;
+}
+
+/* Formats this build can decode; the probe also names others */
+
+static bool audio_source_format_supported(int format)
+{
+    switch (format) {
+        case AUDIO_FORMAT_WAV:
+            return true;
+#ifdef CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT
+        case AUDIO_FORMAT_MP3:
+            return true;
+#endif
+#ifdef CONFIG_LVX_MUSIC_PLAYER_FLAC_SUPPORT
+        case AUDIO_FORMAT_FLAC:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Open a track and work out the PCM it will produce
+ * @param path Audio file
+ * @param srcp Returns the new source
+ * @return 0 on success, negated errno on error
+ *
+ * The read-ahead stage is not started here, the caller does that once it
+ * knows where decoding begins.
+ */
+static int audio_source_open(FAR const char *path,
+                             FAR audio_source_s **srcp)
+{
+    FAR audio_source_s *src;
+    audio_probe_s probe;
+    struct stat st;
+    int ext_format;
+    int ret;
+
+    src = (FAR audio_source_s *)malloc(sizeof(audio_source_s));
+    if (src == NULL) {
+        return -ENOMEM;
+    }
+
+    memset(src, 0, sizeof(audio_source_s));
+
+    src->fd = open(path, O_RDONLY);
+    if (src->fd < 0) {
+        ret = -errno;
+        MP3_LOG("❌ 无法打开音频文件: %s (errno: %d)", path, errno);
+        printf("can't open audio file: %s\n", path);
+        free(src);
+        return ret;
+    }
+
+    // 获取文件大小
+    if (fstat(src->fd, &st) == 0) {
+        src->file_size = st.st_size;
+        MP3_LOG("✅ 音频文件打开成功: %s (大小: %lld bytes)", path, (long long)st.st_size);
+    }
+
+    /* Content decides the format, the extension only when it is unknown */
+    ret = audio_ctl_probe(path, src->fd, &probe);
+    if (ret < 0) {
+        MP3_LOG("❌ 读取文件头失败: %s (%d)", path, ret);
+        close(src->fd);
+        free(src);
+        return ret;
+    }
+
+    src->audio_format = probe.format;
+    ext_format = audio_ctl_detect_format(path);
+    if (src->audio_format == AUDIO_FORMAT_UNKNOWN) {
+        src->audio_format = ext_format;
+    } else if (ext_format != AUDIO_FORMAT_UNKNOWN &&
+               ext_format != src->audio_format) {
+        MP3_LOG("⚠️ 扩展名与内容不符: %s, 按内容格式%d处理",
+                path, src->audio_format);
+    }
+
+    MP3_LOG("🎵 检测音频格式: %s -> %d (%uHz, %u声道)", path,
+            src->audio_format, (unsigned)probe.sample_rate, probe.channels);
+
+    if (!audio_source_format_supported(src->audio_format)) {
+        MP3_LOG("❌ 不支持的音频格式: %s", path);
+        printf("Unsupported audio format: %s\n", path);
+        close(src->fd);
+        free(src);
+        return -ENOTSUP;
+    }
+
+    if (src->audio_format == AUDIO_FORMAT_WAV) {
+        /* The probe already walked the RIFF chunks up to the sample data */
+        if (probe.format != AUDIO_FORMAT_WAV) {
+            printf("Invalid WAV file: %s\n", path);
+            close(src->fd);
+            free(src);
+            return -EINVAL;
+        }
+
+        src->wav = probe.wav;
+        src->end_frame = src->wav.data_size / src->wav.fmt.blockalign;
+        src->file_bpf = src->wav.fmt.blockalign;
+
+        ret = audio_source_set_convert(src);
+        if (ret < 0) {
+            printf("Unsupported WAV format: %s (%u bit, %u ch, tag 0x%04x)\n",
+                   path, src->wav.fmt.bitspersample,
+                   src->wav.fmt.numchannels, src->wav.fmt.audioformat);
+            close(src->fd);
+            free(src);
+            return ret;
+        }
+    }
+#ifdef CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT
+    else if (src->audio_format == AUDIO_FORMAT_MP3) {
+        FAR mp3_index_s *idx = &src->mp3_index;
+        uint32_t sample_rate = probe.sample_rate ? probe.sample_rate : 44100;
+
+        /* Each source owns its decoder, streams can decode concurrently */
+        MP3_LOG("🔧 初始化MP3解码器...");
+        ret = mp3_decoder_init(&src->mp3);
+        if (ret < 0) {
+            MP3_LOG("❌ MP3解码器初始化失败");
+            printf("Failed to initialize MP3 decoder\n");
+            close(src->fd);
+            free(src);
+            return ret;
+        }
+        MP3_LOG("✅ MP3解码器初始化成功");
+
+        /* Without an index, decode from the first frame the probe found */
+        src->wav.data_offset = probe.data_offset;
+        src->wav.data_size = src->file_size - probe.data_offset;
+
+        /* Frame index for exact seeks, also gives the real sample rate */
+        ret = audio_ctl_load_mp3_index(src, path);
+        if (ret == 0) {
+            sample_rate = idx->sample_rate;
+            src->wav.data_offset = idx->audio_start;
+            src->wav.data_size = idx->audio_end - idx->audio_start;
+            src->end_frame = idx->total_samples;
+            MP3_LOG("🗂️ MP3索引: 来源%d, %u个索引点, 共%llu帧",
+                    idx->source, idx->count,
+                    (unsigned long long)idx->total_samples);
+
+            /* LAME tag: the track starts after the encoder delay plus the
+             * decoder's own delay and ends before the padding.
+             */
+
+            if ((idx->enc_delay != 0 || idx->enc_padding != 0) &&
+                idx->total_samples > idx->enc_delay + idx->enc_padding) {
+                src->start_frame = idx->enc_delay + MP3_DECODER_DELAY;
+                src->end_frame = idx->total_samples + MP3_DECODER_DELAY -
+                                 idx->enc_padding;
+                MP3_LOG("✂️ 无缝播放裁剪: 开头%u帧, 结尾%u帧",
+                        idx->enc_delay, idx->enc_padding);
+            }
+        } else {
+            MP3_LOG("⚠️ MP3索引建立失败(%d)，无法精确跳转", ret);
+        }
+
+        /* The decoder always outputs interleaved 16-bit stereo */
+        src->wav.fmt.audioformat = WAVE_FORMAT_PCM;
+        src->wav.fmt.samplerate = sample_rate;
+        src->wav.fmt.bitspersample = 16;
+        src->wav.fmt.numchannels = 2;
+        src->wav.fmt.blockalign = 4;
+        MP3_LOG("🎵 MP3输出参数: %uHz, 16位, 2声道", (unsigned)sample_rate);
+    }
+#endif
+#ifdef CONFIG_LVX_MUSIC_PLAYER_FLAC_SUPPORT
+    else if (src->audio_format == AUDIO_FORMAT_FLAC) {
+        FAR flac_info_s *info = &src->flac_info;
+
+        /* STREAMINFO and SEEKTABLE, then a decoder sized from them */
+        ret = flac_info_read(info, src->fd);
+        if (ret == 0) {
+            ret = flac_decoder_init(&src->flac, info);
+            if (ret < 0) {
+                flac_info_free(info);
+            }
+        }
+
+        if (ret < 0) {
+            MP3_LOG("❌ FLAC流信息无效或不支持(%d)", ret);
+            printf("Invalid FLAC file: %s (%d)\n", path, ret);
+            close(src->fd);
+            free(src);
+            return ret;
+        }
+
+        src->wav.data_offset = info->audio_start;
+        src->wav.data_size = info->audio_end - info->audio_start;
+        src->end_frame = info->total_samples;
+        MP3_LOG("🗂️ FLAC: %uHz, %u位, %u声道, 共%llu帧, %u个跳转点",
+                (unsigned)info->sample_rate, info->bits_per_sample,
+                info->channels, (unsigned long long)info->total_samples,
+                info->count);
+
+        /* Decoded blocks are handed out as 16-bit stereo */
+        src->wav.fmt.audioformat = WAVE_FORMAT_PCM;
+        src->wav.fmt.samplerate = info->sample_rate;
+        src->wav.fmt.bitspersample = 16;
+        src->wav.fmt.numchannels = 2;
+        src->wav.fmt.blockalign = 4;
+        src->wav.fmt.byterate = info->sample_rate * 4;
+    }
+#endif
+
+    if (src->end_frame > src->start_frame) {
+        src->total_frames = src->end_frame - src->start_frame;
+    }
+
+    src->out_from = src->start_frame;
+    src->decode_offset = src->wav.data_offset;
+
+    *srcp = src;
+    return 0;
+}
+
+/**
+ * @brief Where decoding has to restart to reach a decoder frame
+ * @param in_frame Target in decoder frames from the start of the track
+ * @param position Returns the file offset to read from
+ * @param landed Returns the decoder frame at position
+ * @param target Returns the decoder frame output resumes from
+ * @return 0 on success, negated errno on error
+ *
+ * The byte offset is computed in 64 bits and is always a multiple of
+ * blockalign from the start of the data chunk, so playback never resumes
+ * in the middle of a sample. MP3 targets go through the frame index, the
+ * decoder starts one MPEG frame early and drops samples up to the exact
+ * target.
+ */
+static int audio_source_locate(FAR audio_source_s *src, uint64_t in_frame,
+                               FAR uint32_t *position,
+                               FAR uint64_t *landed,
+                               FAR uint64_t *target)
+{
+#ifdef CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT
+    if (src->audio_format == AUDIO_FORMAT_MP3) {
+        uint64_t from = 0;
+        uint32_t offset;
+        int ret;
+
+        *target = src->start_frame + in_frame;
+
+        /* The frame before the target fills the bit reservoir */
+
+        if (*target > src->mp3_index.frame_samples) {
+            from = *target - src->mp3_index.frame_samples;
+        }
+
+        ret = mp3_index_seek(&src->mp3_index, src->fd, from, &offset,
+                             landed);
+        if (ret < 0) {
+            return ret;
+        }
+
+        *position = offset;
+        return 0;
+    }
+#endif
+#ifdef CONFIG_LVX_MUSIC_PLAYER_FLAC_SUPPORT
+    if (src->audio_format == AUDIO_FORMAT_FLAC) {
+        uint32_t offset;
+        int ret;
+
+        /* Seektable point or bisection, then decode up to the target */
+
+        ret = flac_info_seek(&src->flac_info, src->fd, in_frame, &offset,
+                             landed);
+        if (ret < 0) {
+            return ret;
+        }
+
+        *position = offset;
+        *target = in_frame;
+        return 0;
+    }
+#endif
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADPCM_SUPPORT
+    if (audio_source_is_adpcm(src)) {
+        uint64_t block = in_frame / src->adpcm.block_frames;
+
+        /* Every block restarts the predictor, decode from its start */
+
+        *position = src->wav.data_offset + block * src->adpcm.block_align;
+        *landed = block * src->adpcm.block_frames;
+        *target = in_frame;
+        return 0;
+    }
+#endif
+
+    *position = src->wav.data_offset + in_frame * src->file_bpf;
+    *landed = in_frame;
+    *target = in_frame;
+    return 0;
+}
+
+/**
+ * @brief Restart decoding at a point found by audio_source_locate()
+ *
+ * Runs on the thread that decodes the source.
+ */
+static void audio_source_seek(FAR audio_source_s *src, uint32_t position,
+                              uint64_t landed, uint64_t target)
+{
+    read_ahead_seek(&src->ra, position);
+    src->decode_offset = position;
+#ifdef CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT
+    if (src->audio_format == AUDIO_FORMAT_MP3) {
+        /* Drop carried input and the overlap of the frame before the jump */
+
+        mp3_decoder_reset(&src->mp3);
+        src->decode_frame = landed;
+        src->out_from = target;
+    }
+#endif
+#ifdef CONFIG_LVX_MUSIC_PLAYER_FLAC_SUPPORT
+    if (src->audio_format == AUDIO_FORMAT_FLAC) {
+        flac_decoder_reset(&src->flac);
+        src->decode_frame = landed;
+        src->out_from = target;
+    }
+#endif
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADPCM_SUPPORT
+    if (audio_source_is_adpcm(src)) {
+        src->blk_len = 0;
+        src->blk_pos = 0;
+        src->decode_frame = landed;
+        src->out_from = target;
+    }
+#endif
+#ifdef CONFIG_LVX_MUSIC_PLAYER_RESAMPLE
+    if (src->rs != NULL) {
+        pcm_resample_reset(src->rs);
+        src->rs_len = 0;
+        src->rs_pos = 0;
+        src->rs_eof = false;
+    }
+#endif
+}
+
+static void audio_source_close(FAR audio_source_s *src)
+{
+    if (src == NULL) {
+        return;
+    }
+
+    read_ahead_close(&src->ra);
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT
+    /* Cleanup MP3 decoder if used */
+    if (src->audio_format == AUDIO_FORMAT_MP3) {
+        mp3_decoder_cleanup(&src->mp3);
+        mp3_index_free(&src->mp3_index);
+    }
+#endif
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_FLAC_SUPPORT
+    if (src->audio_format == AUDIO_FORMAT_FLAC) {
+        flac_decoder_cleanup(&src->flac);
+        flac_info_free(&src->flac_info);
+    }
+#endif
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_RESAMPLE
+    if (src->rs != NULL) {
+        pcm_resample_deinit(src->rs);
+        free(src->rs);
+        free(src->rs_buf);
+    }
+#endif
+
+    free(src->cv_buf);
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADPCM_SUPPORT
+    free(src->blk_pcm);
+#endif
+
+    if (src->fd >= 0) {
+        close(src->fd);
+    }
+
+    free(src);
+}
+
+#if defined(CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT) || \
+    defined(CONFIG_LVX_MUSIC_PLAYER_FLAC_SUPPORT) || \
+    defined(CONFIG_LVX_MUSIC_PLAYER_ADPCM_SUPPORT)
+/**
+ * @brief Keep only the decoded frames inside [out_from, end_frame)
+ * @param pcm frames of freshly decoded PCM, compacted in place
+ * @return Bytes left in pcm
+ */
+static size_t audio_source_trim(FAR audio_source_s *src, FAR uint8_t *pcm,
+                                size_t frames)
+{
+    size_t bpf = src->wav.fmt.blockalign;
+    uint64_t first = src->decode_frame;
+    uint64_t from = src->out_from;
+    uint64_t to = first + frames;
+
+    src->decode_frame = to;
+
+    if (src->end_frame > 0 && to > src->end_frame) {
+        to = src->end_frame;
+    }
+
+    if (from < first) {
+        from = first;
+    }
+
+    if (to <= from) {
+        return 0;
+    }
+
+    if (from > first) {
+        memmove(pcm, pcm + (from - first) * bpf, (to - from) * bpf);
+    }
+
+    return (to - from) * bpf;
+}
+#endif
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADPCM_SUPPORT
+/**
+ * @brief Expand ADPCM blocks into up to len bytes of 16-bit stereo
+ * @return Bytes produced, 0 at end of stream, negative on error
+ *
+ * Blocks are read whole and expanded until buf is full, a call can stop
+ * in the middle of one.
+ */
+static ssize_t audio_source_decode_adpcm(FAR audio_source_s *src,
+                                         FAR uint8_t *buf, size_t len)
+{
+    uint32_t data_end = src->wav.data_offset + src->wav.data_size;
+    FAR adpcm_s *adpcm = &src->adpcm;
+    size_t bpf = src->wav.fmt.blockalign;
+    size_t done = 0;
+    size_t frames;
+    size_t want;
+    size_t got;
+    ssize_t ret;
+
+    for (;;) {
+        if (src->blk_pos < src->blk_len) {
+            frames = src->blk_len - src->blk_pos;
+            if (frames > (len - done) / bpf) {
+                frames = (len - done) / bpf;
+            }
+
+            if (frames == 0) {
+                return done;
+            }
+
+            src->convert((FAR int16_t *)(buf + done), (FAR const uint8_t *)
+                         (src->blk_pcm + src->blk_pos * adpcm->channels),
+                         frames);
+            src->blk_pos += frames;
+
+            // 去掉跳转目标之前的样本和最后一块的填充
+            done += audio_source_trim(src, buf + done, frames);
+            if (src->decode_frame >= src->end_frame) {
+                return done;
+            }
+
+            continue;
+        }
+
+        if (src->decode_offset >= data_end) {
+            return done;
+        }
+
+        want = data_end - src->decode_offset;
+        if (want > adpcm->block_align) {
+            want = adpcm->block_align;
+        }
+
+        for (got = 0; got < want; got += ret) {
+            ret = read_ahead_read(&src->ra, src->cv_buf + got, want - got);
+            if (ret < 0) {
+                MP3_LOG("❌ ADPCM文件读取出错: %zd", ret);
+                return done > 0 ? (ssize_t)done : ret;
+            }
+
+            if (ret == 0) {
+                break;
+            }
+        }
+
+        src->decode_offset += got;
+        src->blk_len = adpcm_decode(adpcm, src->blk_pcm, src->cv_buf, got);
+        src->blk_pos = 0;
+
+        if (src->blk_len == 0) {
+            MP3_LOG("📄 ADPCM文件读取完成(错误块: %u)", adpcm->errors);
+            return done;
+        }
+    }
+}
+#endif
+
+/**
+ * @brief Produce up to len bytes of PCM at the decoder rate into buf
+ * @return Bytes produced, 0 at end of stream, negative on error
+ */
+static ssize_t audio_source_decode_pcm(FAR audio_source_s *src,
+                                       FAR uint8_t *buf, size_t len)
+{
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADPCM_SUPPORT
+    if (audio_source_is_adpcm(src)) {
+        return audio_source_decode_adpcm(src, buf, len);
+    }
+#endif
+
+    if (src->audio_format == AUDIO_FORMAT_WAV) {
+        uint32_t data_end = src->wav.data_offset + src->wav.data_size;
+        size_t bpf = src->file_bpf;
+        FAR uint8_t *raw = buf;
+        ssize_t nread;
+        ssize_t ret;
+
+        /* Chunks after the PCM data (LIST, id3 ...) are not audio */
+
+        if (src->decode_offset >= data_end) {
+            return 0;
+        }
+
+        /* Converted frames are read into cv_buf first */
+
+        if (src->convert != NULL) {
+            size_t frames = len / src->wav.fmt.blockalign;
+
+            if (frames > AUDIO_CTL_CONVERT_FRAMES) {
+                frames = AUDIO_CTL_CONVERT_FRAMES;
+            }
+
+            raw = src->cv_buf;
+            len = frames * bpf;
+        }
+
+        if (len > data_end - src->decode_offset) {
+            len = data_end - src->decode_offset;
+        }
+
+        if (len >= bpf) {
+            len -= len % bpf;
+        }
+
+        nread = read_ahead_read(&src->ra, raw, len);
+        if (nread <= 0) {
+            return nread;
+        }
+
+        /* Hand out whole frames so the ring stays frame aligned */
+
+        while (nread % bpf != 0 && (size_t)nread < len) {
+            ret = read_ahead_read(&src->ra, raw + nread,
+                                  bpf - nread % bpf);
+            if (ret <= 0) {
+                break;
+            }
+
+            nread += ret;
+        }
+
+        src->decode_offset += nread;
+
+        if (src->convert != NULL) {
+            src->convert((FAR int16_t *)buf, raw, nread / bpf);
+            return nread / bpf * src->wav.fmt.blockalign;
+        }
+
+        return nread;
+    }
+#ifdef CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT
+    else if (src->audio_format == AUDIO_FORMAT_MP3) {
+        for (;;) {
+            FAR unsigned char *dst;
+            ssize_t nread;
+            size_t space;
+            size_t kept;
+            int ret;
+
+            // 直接合成到目标缓冲区，帧没写完时下次从断点继续
+            ret = mp3_decoder_decode(&src->mp3, (FAR int16_t *)buf,
+                                     len / sizeof(int16_t));
+
+            src->decode_frame += src->mp3.lost_samples;
+            src->mp3.lost_samples = 0;
+
+            if (ret > 0) {
+                // 去掉编码延迟/填充以及跳转目标之前的样本
+                kept = audio_source_trim(src, buf, ret / 2);
+                if (kept > 0) {
+                    return kept;
+                }
+
+                if (src->end_frame > 0 && src->decode_frame >= src->end_frame) {
+                    MP3_LOG("📄 MP3曲目结束(已去除结尾填充)");
+                    return 0;
+                }
+
+                continue;
+            }
+
+            if (ret < 0) {
+                MP3_LOG("❌ MP3解码失败: %s", mad_stream_errorstr(&src->mp3.stream));
+                return ret;
+            }
+
+            // 输入不足一帧：保留残余字节并补充新数据
+            space = mp3_decoder_input_space(&src->mp3, &dst);
+            if (space == 0) {
+                MP3_LOG("📄 MP3文件读取完成");
+                return 0;
+            }
+
+            nread = read_ahead_read(&src->ra, dst, space);
+            if (nread < 0) {
+                MP3_LOG("❌ MP3文件读取出错: %zd", nread);
+                return nread;
+            }
+
+            mp3_decoder_input_commit(&src->mp3, nread);
+        }
+    }
+#endif
+#ifdef CONFIG_LVX_MUSIC_PLAYER_FLAC_SUPPORT
+    else if (src->audio_format == AUDIO_FORMAT_FLAC) {
+        for (;;) {
+            FAR unsigned char *dst;
+            ssize_t nread;
+            size_t space;
+            size_t kept;
+            int ret;
+
+            // 块解码直接转换到目标缓冲区，块没写完时下次从断点继续
+            ret = flac_decoder_decode(&src->flac, (FAR int16_t *)buf,
+                                      len / sizeof(int16_t));
+            if (ret > 0) {
+                // 去掉跳转目标之前的样本
+                kept = audio_source_trim(src, buf, ret / 2);
+                if (kept > 0) {
+                    return kept;
+                }
+
+                if (src->end_frame > 0 && src->decode_frame >= src->end_frame) {
+                    return 0;
+                }
+
+                continue;
+            }
+
+            space = flac_decoder_input_space(&src->flac, &dst);
+            if (space == 0) {
+                MP3_LOG("📄 FLAC文件读取完成(错误帧: %u)", src->flac.errors);
+                return 0;
+            }
+
+            nread = read_ahead_read(&src->ra, dst, space);
+            if (nread < 0) {
+                MP3_LOG("❌ FLAC文件读取出错: %zd", nread);
+                return nread;
+            }
+
+            flac_decoder_input_commit(&src->flac, nread);
+        }
+    }
+#endif
+
+    return -ENOSYS;
+}
+
+/**
+ * @brief Decode until buf holds len bytes or the source ends
+ * @return Bytes produced, 0 at end of stream, negative on error
+ */
+static ssize_t audio_source_fill(FAR audio_source_s *src, FAR uint8_t *buf,
+                                 size_t len)
+{
+    size_t done = 0;
+    ssize_t ret;
+
+    while (done < len) {
+        ret = audio_source_decode(src, buf + done, len - done);
+        if (ret <= 0) {
+            return done > 0 ? (ssize_t)done : ret;
+        }
+
+        done += ret;
+    }
+
+    return done;
+}
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_CROSSFADE
+static uint64_t audio_ctl_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief Frames the source still has to produce, UINT64_MAX if unknown
+ */
+static uint64_t audio_source_remaining(FAR audio_source_s *src)
+{
+    uint64_t left;
+    uint64_t from;
+
+    if (src->audio_format == AUDIO_FORMAT_WAV &&
+        !audio_source_is_adpcm(src)) {
+        uint32_t data_end = src->wav.data_offset + src->wav.data_size;
+
+        left = src->decode_offset >= data_end ? 0 :
+               (data_end - src->decode_offset) / src->file_bpf;
+    } else if (src->end_frame == 0) {
+        return UINT64_MAX;
+    } else {
+        from = src->decode_frame > src->out_from ? src->decode_frame
+                                                  : src->out_from;
+        left = src->end_frame > from ? src->end_frame - from : 0;
+    }
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_RESAMPLE
+    if (src->rs != NULL) {
+        left = pcm_resample_out_frames(src->rs, left);
+    }
+#endif
+
+    return left;
+}
+
+
+/**
+ * @brief Start mixing the queued track into the end of the current one
+ *
+ * Called before every chunk while a track is queued; does nothing until
+ * the current track is within the crossfade length of its end. From then
+ * on the queued track is ctl->src, so position, seeks and the track serial
+ * follow the incoming track, and the outgoing one lives on in fade_src
+ * until the overlap is over.
+ */
+static void audio_ctl_fade_start(FAR audioctl_s *ctl)
+{
+    FAR audio_source_s *cur = ctl->src;
+    FAR audio_source_s *next = ctl->next;
+    uint64_t remaining;
+    uint64_t len;
+
+    /* The mixer works on 16-bit samples, queue_next already checked the
+     * queued track produces the same layout.
+     */
+
+    if (ctl->fade_ms == 0 || cur->wav.fmt.bitspersample != 16 ||
+        cur->wav.fmt.audioformat != WAVE_FORMAT_PCM) {
+        return;
+    }
+
+    len = (uint64_t)ctl->fade_ms * cur->wav.fmt.samplerate / 1000;
+    remaining = audio_source_remaining(cur);
+    if (remaining > len) {
+        return;
+    }
+
+    /* Never fade over more than half of a short incoming track */
+
+    len = remaining;
+    if (next->total_frames > 0 && len > next->total_frames / 2) {
+        len = next->total_frames / 2;
+    }
+
+    if (len == 0) {
+        return;
+    }
+
+    if (ctl->fade_buf == NULL) {
+        ctl->fade_buf = (FAR uint8_t *)malloc(2 * ctl->decode_chunk);
+        if (ctl->fade_buf == NULL) {
+            return;
+        }
+    }
+
+    pthread_mutex_lock(&ctl->lock);
+
+    ctl->fade_src = cur;
+    ctl->src = next;
+    ctl->next = NULL;
+
+    ctl->splice_total = ctl->src->total_frames;
+    ctl->splice_pos = pcm_ring_write_count(&ctl->ring);
+    atomic_store(&ctl->splice_pending, true);
+
+    pthread_mutex_unlock(&ctl->lock);
+
+    ctl->fade_pos = 0;
+    ctl->fade_len = len;
+    ctl->fade_mixed = 0;
+    ctl->fade_chunks = 0;
+    ctl->fade_busy_us = 0;
+
+    MP3_LOG("🔀 交叉淡化开始: %u帧", (unsigned)len);
+}
+
+/**
+ * @brief Drop the outgoing track of a crossfade
+ * @param completed false when the fade was cut short
+ */
+static void audio_ctl_fade_end(FAR audioctl_s *ctl, bool completed)
+{
+    FAR audio_source_s *old;
+    uint32_t rate = ctl->src->wav.fmt.samplerate;
+    uint32_t load = 0;
+
+    if (ctl->fade_mixed > 0 && rate > 0) {
+        load = ctl->fade_busy_us * rate / 10000 / ctl->fade_mixed;
+    }
+
+    ctl->fade_stats.last_load_pct = load;
+    if (load > ctl->fade_stats.peak_load_pct) {
+        ctl->fade_stats.peak_load_pct = load;
+    }
+
+    if (completed) {
+        ctl->fade_stats.fades++;
+    } else {
+        ctl->fade_stats.aborted++;
+    }
+
+    /* Same lifetime rule as a splice: freed one switch later */
+
+    pthread_mutex_lock(&ctl->lock);
+    old = ctl->retired;
+    ctl->retired = ctl->fade_src;
+    ctl->fade_src = NULL;
+    pthread_mutex_unlock(&ctl->lock);
+
+    MP3_LOG("🔀 交叉淡化%s: 负载%u%%", completed ? "完成" : "中止",
+            (unsigned)load);
+
+    read_ahead_close(&ctl->retired->ra);
+    audio_source_close(old);
+}
+
+/**
+ * @brief Finish a crossfade that is too slow within the next chunks
+ *
+ * Position and length are scaled down together, so the gains carry on
+ * from where they are and only the rest of the ramp gets steeper.
+ */
+static void audio_ctl_fade_rush(FAR audioctl_s *ctl)
+{
+    uint32_t rest = AUDIO_CTL_FADE_RUSH_CHUNKS * (ctl->decode_chunk /
+                    ctl->src->wav.fmt.blockalign);
+    uint32_t left = ctl->fade_len - ctl->fade_pos;
+
+    if (left <= rest) {
+        return;
+    }
+
+    ctl->fade_len = (uint64_t)ctl->fade_len * rest / left;
+    ctl->fade_pos = ctl->fade_len - rest;
+    ctl->fade_stats.shortened++;
+
+    MP3_LOG("🔀 交叉淡化负载过高, 提前收尾: 剩余%u帧", (unsigned)rest);
+}
+
+/**
+ * @brief Queue one chunk of the crossfade
+ * @return Bytes queued, 0 at end of the incoming track, negative on error
+ *
+ * Both decoders run back to back on this thread, the incoming chunk comes
+ * first and decides the length, the outgoing track is padded with silence
+ * if it ends early. Should the incoming track end first, the outgoing one
+ * finishes its fade-out alone instead of being cut off. The time spent on
+ * a chunk is compared against the play time it produces; once the overlap
+ * needs more than CROSSFADE_MAX_LOAD percent of real time the rest of the
+ * fade is squeezed into AUDIO_CTL_FADE_RUSH_CHUNKS chunks, so that the
+ * ring never underruns on a slow board and neither track jumps in level.
+ */
+static int audio_ctl_fade_chunk(FAR audioctl_s *ctl)
+{
+    FAR audio_source_s *src = ctl->src;
+    size_t bpf = src->wav.fmt.blockalign;
+    FAR uint8_t *in = ctl->fade_buf;
+    FAR uint8_t *out = ctl->fade_buf + ctl->decode_chunk;
+    uint64_t start = audio_ctl_now_us();
+    size_t frames;
+    ssize_t nin;
+    ssize_t nout;
+    size_t len;
+
+    len = ctl->decode_chunk - ctl->decode_chunk % bpf;
+    if (len > (size_t)(ctl->fade_len - ctl->fade_pos) * bpf) {
+        len = (size_t)(ctl->fade_len - ctl->fade_pos) * bpf;
+    }
+
+    nin = audio_source_fill(src, in, len);
+    if (nin > 0) {
+        frames = nin / bpf;
+        nin = frames * bpf;
+
+        nout = audio_source_fill(ctl->fade_src, out, nin);
+        if (nout < nin) {
+            memset(out + (nout > 0 ? nout : 0), 0,
+                   nin - (nout > 0 ? nout : 0));
+        }
+    } else {
+        /* Mixed against silence the outgoing track keeps its fade curve */
+
+        nout = audio_source_fill(ctl->fade_src, out, len);
+        if (nout < (ssize_t)bpf) {
+            audio_ctl_fade_end(ctl, true);
+            return nin;
+        }
+
+        frames = nout / bpf;
+        nin = frames * bpf;
+        memset(in, 0, nin);
+    }
+
+    pcm_mix_crossfade((FAR int16_t *)in, (FAR const int16_t *)out, frames,
+                      src->wav.fmt.numchannels, ctl->fade_pos, ctl->fade_len);
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_EQ
+    pcm_eq_process(&ctl->eq, (FAR int16_t *)in, frames);
+#endif
+
+    pcm_ring_write(&ctl->ring, in, nin);
+
+    ctl->fade_pos += frames;
+    ctl->fade_mixed += frames;
+    ctl->fade_busy_us += audio_ctl_now_us() - start;
+    ctl->fade_chunks++;
+
+    if (ctl->fade_pos >= ctl->fade_len) {
+        audio_ctl_fade_end(ctl, true);
+    } else if (ctl->fade_chunks >= AUDIO_CTL_FADE_WARMUP_CHUNKS &&
+               ctl->fade_busy_us * src->wav.fmt.samplerate / 10000 >
+               (uint64_t)CONFIG_LVX_MUSIC_PLAYER_CROSSFADE_MAX_LOAD *
+               ctl->fade_mixed) {
+        audio_ctl_fade_rush(ctl);
+    }
+
+    return nin;
+}
+#endif /* CONFIG_LVX_MUSIC_PLAYER_CROSSFADE */
+
+/**
+ * @brief Decode the next chunk of the source into the PCM ring
+ * @return Bytes queued, 0 at end of stream, negative on error
+ *
+ * PCM is produced straight into the ring's free span: WAV data is read into
+ * it and MP3 frames are synthesized into it, so every byte is copied once
+ * more only when app_dequeue_cb hands it to the device.
+ */
+static int audio_ctl_decode_chunk(FAR audioctl_s *ctl)
+{
+    FAR uint8_t *span;
+    ssize_t ret;
+    size_t len;
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_CROSSFADE
+    if (ctl->fade_src == NULL && ctl->next != NULL) {
+        audio_ctl_fade_start(ctl);
+    }
+
+    if (ctl->fade_src != NULL) {
+        return audio_ctl_fade_chunk(ctl);
+    }
+#endif
+
+    len = pcm_ring_write_span(&ctl->ring, &span);
+    if (len > ctl->decode_chunk) {
+        len = ctl->decode_chunk;
+    }
+
+    ret = audio_source_decode(ctl->src, span, len);
+    if (ret > 0) {
+#ifdef CONFIG_LVX_MUSIC_PLAYER_EQ
+        pcm_eq_process(&ctl->eq, (FAR int16_t *)span,
+                       ret / ctl->src->wav.fmt.blockalign);
+#endif
+        pcm_ring_write_commit(&ctl->ring, ret);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Continue with the queued track in the same PCM stream
+ *
+ * Runs on the decoder thread at the end of the current source. The first
+ * sample of the next track lands right after the last one of this track,
+ * app_dequeue_cb switches position and length when the device reaches it.
+ * The old source stays allocated until the following switch so that a
+ * caller still holding ctl->src never sees freed memory.
+ */
+static void audio_ctl_splice(FAR audioctl_s *ctl)
+{
+    FAR audio_source_s *old;
+
+    pthread_mutex_lock(&ctl->lock);
+
+    if (ctl->next == NULL) {
+        pthread_mutex_unlock(&ctl->lock);
+        return;
+    }
+
+    old = ctl->retired;
+    ctl->retired = ctl->src;
+    ctl->src = ctl->next;
+    ctl->next = NULL;
+
+    ctl->splice_total = ctl->src->total_frames;
+    ctl->splice_pos = pcm_ring_write_count(&ctl->ring);
+    atomic_store(&ctl->splice_pending, true);
+    atomic_store(&ctl->decode_eof, false);
+
+    pthread_mutex_unlock(&ctl->lock);
+
+    MP3_LOG("🔗 无缝切换到下一首");
+
+    read_ahead_close(&ctl->retired->ra);
+    audio_source_close(old);
+}
+
+/**
+ * @brief Replace the current track with the one posted by audio_ctl_switch()
+ *
+ * Runs on the decoder thread. Whatever is left of the old track in the
+ * ring is dropped, a queued track or a crossfade in progress belongs to
+ * the old track order and is dropped as well.
+ */
+static void audio_ctl_attach(FAR audioctl_s *ctl)
+{
+    FAR audio_source_s *old;
+    FAR audio_source_s *queued;
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_CROSSFADE
+    if (ctl->fade_src != NULL) {
+        audio_ctl_fade_end(ctl, false);
+    }
+#endif
+
+    pthread_mutex_lock(&ctl->lock);
+
+    old = ctl->retired;
+    queued = ctl->next;
+    ctl->retired = ctl->src;
+    ctl->src = atomic_load(&ctl->attach);
+    ctl->next = NULL;
+
+    atomic_store(&ctl->splice_pending, false);
+    ctl->total_frames = ctl->src->total_frames;
+    ctl->played_bytes = 0;
+    atomic_store(&ctl->seek, false);
+    atomic_store(&ctl->decode_eof, false);
+    pcm_ring_flush(&ctl->ring);
+#ifdef CONFIG_LVX_MUSIC_PLAYER_EQ
+    pcm_eq_reset(&ctl->eq);
+#endif
+    audio_trace_mark(AUDIO_TRACE_READY);
+
+    /* Published last, audio_ctl_switch() returns once it reads NULL */
+
+    atomic_store(&ctl->attach, NULL);
+    pthread_cond_broadcast(&ctl->decode_cond);
+
+    pthread_mutex_unlock(&ctl->lock);
+
+    read_ahead_close(&ctl->retired->ra);
+    audio_source_close(old);
+    audio_source_close(queued);
+}
+
+/**
+ * @brief Absolute CLOCK_MONOTONIC time @p us from now, for decode_cond
+ */
+static void audio_ctl_abstime(FAR struct timespec *ts, uint32_t us)
+{
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_sec += us / 1000000;
+    ts->tv_nsec += (long)(us % 1000000) * 1000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+/**
+ * @brief Idle the decoder thread until there is work
+ *
+ * Ring space is freed by app_dequeue_cb(), which must not take the lock,
+ * so it is still checked every AUDIO_CTL_DECODE_IDLE_US. Requests from the
+ * UI thread signal decode_cond and are picked up at once.
+ */
+static void audio_ctl_decode_idle(FAR audioctl_s *ctl)
+{
+    struct timespec deadline;
+
+    audio_ctl_abstime(&deadline, AUDIO_CTL_DECODE_IDLE_US);
+
+    pthread_mutex_lock(&ctl->lock);
+    if (atomic_load(&ctl->attach) == NULL && !atomic_load(&ctl->seek) &&
+        !ctl->decode_quit &&
+        !(atomic_load(&ctl->decode_eof) && ctl->next != NULL)) {
+        pthread_cond_timedwait(&ctl->decode_cond, &ctl->lock, &deadline);
+    }
+
+    pthread_mutex_unlock(&ctl->lock);
+}
+
+static FAR void *audio_decode_thread(pthread_addr_t arg)
+{
+    FAR audioctl_s *ctl = (FAR audioctl_s *)arg;
+#ifdef CONFIG_LVX_MUSIC_PLAYER_TELEMETRY
+    uint32_t start;
+#endif
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADAPTIVE_BUFFERS
+    uint32_t pass;
+#endif
+    int ret;
+
+    while (!ctl->decode_quit)
+    {
+        if (atomic_load(&ctl->attach) != NULL) {
+            audio_ctl_attach(ctl);
+        }
+
+        if (atomic_load(&ctl->seek)) {
+            FAR audio_source_s *src;
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_CROSSFADE
+            /* The seek is on the incoming track, the outgoing one is done */
+
+            if (ctl->fade_src != NULL) {
+                audio_ctl_fade_end(ctl, false);
+            }
+#endif
+
+            pthread_mutex_lock(&ctl->lock);
+            src = ctl->src;
+
+            audio_source_seek(src, ctl->seek_position, ctl->seek_landed,
+                              ctl->seek_target);
+            atomic_store(&ctl->seek, false);
+            atomic_store(&ctl->decode_eof, false);
+            pcm_ring_flush(&ctl->ring);
+#ifdef CONFIG_LVX_MUSIC_PLAYER_EQ
+            pcm_eq_reset(&ctl->eq);
+#endif
+
+            pthread_mutex_unlock(&ctl->lock);
+        }
+
+        if (atomic_load(&ctl->decode_eof))
+        {
+            if (ctl->next == NULL)
+            {
+                audio_ctl_decode_idle(ctl);
+                continue;
+            }
+
+            audio_ctl_splice(ctl);
+        }
+
+        if (pcm_ring_space(&ctl->ring) < ctl->decode_chunk)
+        {
+            audio_ctl_decode_idle(ctl);
+            continue;
+        }
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_TELEMETRY
+        start = audio_telemetry_now_us();
+#endif
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADAPTIVE_BUFFERS
+        pass = audio_buffering_now_us();
+#endif
+        ret = audio_ctl_decode_chunk(ctl);
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADAPTIVE_BUFFERS
+        audio_buffering_decode(&ctl->buffering, pass);
+#endif
+#ifdef CONFIG_LVX_MUSIC_PLAYER_TELEMETRY
+        if (ret > 0) {
+            audio_telemetry_decode(&ctl->telemetry, start,
+                                   ret / ctl->src->wav.fmt.blockalign);
+        }
+#endif
+
+        if (ret <= 0)
+        {
+            if (ctl->next != NULL)
+            {
+                audio_ctl_splice(ctl);
+            }
+            else
+            {
+                atomic_store(&ctl->decode_eof, true);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static int audio_ctl_start_decoder(FAR audioctl_s *ctl)
+{
+    FAR audio_source_s *src = ctl->src;
+    pthread_attr_t tattr;
+    struct sched_param sparam;
+    uint32_t byterate;
+    uint32_t ring_bytes;
+    uint32_t prime_bytes;
+    int waited;
+    int ret;
+
+    byterate = src->wav.fmt.samplerate * src->wav.fmt.numchannels *
+               src->wav.fmt.bitspersample / 8;
+    ring_bytes = (uint64_t)byterate * CONFIG_LVX_MUSIC_PLAYER_RING_MS / 1000;
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADAPTIVE_BUFFERS
+    prime_bytes = ctl->buffering.bufs * ctl->buffering.bytes;
+#else
+    prime_bytes = ctl->nxaudio.abufnum * ctl->nxaudio.abufs[0]->nmaxbytes;
+#endif
+
+    /* Up to a couple of MP3 frames per pass, resumed mid-frame if cut.
+     * Not tied to the format because a queued track may differ.
+     */
+
+    ctl->decode_chunk = ctl->nxaudio.abufs[0]->nmaxbytes;
+    if (ctl->decode_chunk < PCM_BUFFER_SIZE * sizeof(int16_t)) {
+        ctl->decode_chunk = PCM_BUFFER_SIZE * sizeof(int16_t);
+    }
+
+    if (ring_bytes < 2 * ctl->decode_chunk) {
+        ring_bytes = 2 * ctl->decode_chunk;
+    }
+
+    ret = read_ahead_open(&src->ra, src->fd, src->decode_offset);
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = pcm_ring_init(&ctl->ring, ring_bytes);
+    if (ret < 0) {
+        read_ahead_close(&src->ra);
+        return ret;
+    }
+
+    ctl->decode_quit = false;
+    atomic_store(&ctl->decode_eof, false);
+
+    pthread_attr_init(&tattr);
+    sparam.sched_priority = sched_get_priority_max(SCHED_FIFO) - 10;
+    pthread_attr_setschedparam(&tattr, &sparam);
+    pthread_attr_setstacksize(&tattr, AUDIO_CTL_DECODE_STACKSIZE);
+
+    ret = pthread_create(&ctl->decode_pid, &tattr, audio_decode_thread,
+                         (pthread_addr_t)ctl);
+    pthread_attr_destroy(&tattr);
+    if (ret != 0) {
+        pcm_ring_deinit(&ctl->ring);
+        read_ahead_close(&src->ra);
+        return -ret;
+    }
+
+    pthread_setname_np(ctl->decode_pid, "audioctl_decode");
+    ctl->decode_running = true;
+
+    /* Let the ring fill up so that the initial buffers are all real audio */
+
+    if (prime_bytes > ctl->ring.size) {
+        prime_bytes = ctl->ring.size;
+    }
+
+    for (waited = 0; waited < AUDIO_CTL_PREFILL_TIMEOUT_MS; waited++)
+    {
+        if (atomic_load(&ctl->decode_eof) ||
+            pcm_ring_used(&ctl->ring) >= prime_bytes) {
+            break;
+        }
+
+        usleep(1000);
+    }
+
+    pcm_ring_reset_stats(&ctl->ring);
+    return 0;
+}
+
+static void audio_ctl_stop_decoder(FAR audioctl_s *ctl)
+{
+    if (!ctl->decode_running) {
+        return;
+    }
+
+    pthread_mutex_lock(&ctl->lock);
+    ctl->decode_quit = true;
+    pthread_cond_broadcast(&ctl->decode_cond);
+    pthread_mutex_unlock(&ctl->lock);
+
+    pthread_join(ctl->decode_pid, NULL);
+
+    ctl->decode_running = false;
+    pcm_ring_deinit(&ctl->ring);
+}
+
+static void app_complete_cb(unsigned long arg)
+{
+    /* Do nothing.. */
+
+    printf("Audio loop is Done\n");
+}
+
+static void app_user_cb(unsigned long arg,
+                        FAR struct audio_msg_s *msg, FAR bool *running)
+{
+    /* Do nothing.. */
+}
+
+static FAR void *audio_loop_thread(pthread_addr_t arg)
+{
+    FAR audioctl_s *ctl = (FAR audioctl_s *)arg;
+
+    nxaudio_start(&ctl->nxaudio);
+    audio_trace_mark(AUDIO_TRACE_START);
+    nxaudio_msgloop(&ctl->nxaudio, &cbs,
+                    (unsigned long)(uintptr_t)ctl);
+
+    return NULL;
+}
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADAPTIVE_BUFFERS
+/**
+ * @brief Start the output level of a new session from the lowest one
+ */
+static int audio_ctl_buffering_open(FAR audioctl_s *ctl)
+{
+    FAR fmt_s *fmt = &ctl->src->wav.fmt;
+
+    ctl->out_idle = (FAR struct ap_buffer_s **)
+        malloc(ctl->nxaudio.abufnum * sizeof(FAR struct ap_buffer_s *));
+    if (ctl->out_idle == NULL) {
+        return -ENOMEM;
+    }
+
+    ctl->out_nidle = 0;
+    ctl->out_queued = 0;
+
+    audio_buffering_init(&ctl->buffering, &ctl->out_limits,
+                         fmt->samplerate * fmt->blockalign, fmt->blockalign,
+                         ctl->nxaudio.abufs[0]->nmaxbytes,
+                         ctl->nxaudio.abufnum);
+
+    MP3_LOG("🎚️ 输出缓冲: %u x %u 字节 (驱动 %d x %u)",
+            (unsigned)ctl->buffering.bufs, (unsigned)ctl->buffering.bytes,
+            ctl->nxaudio.abufnum,
+            (unsigned)ctl->nxaudio.abufs[0]->nmaxbytes);
+    return 0;
+}
+#endif
+
+/**
+ * @brief Configure the device for ctl->src and start feeding it
+ *
+ * Opens the device with the PCM layout of the current source, allocates
+ * its buffers, starts the decoder thread (or maps the WAV data) and fills
+ * the buffers of the output level, every buffer without adaptive
+ * buffering. The message loop is started by audio_ctl_start().
+ */
+static int audio_ctl_open_session(FAR audioctl_s *ctl)
+{
+    FAR fmt_s *fmt = &ctl->src->wav.fmt;
+    int ret;
+    int i;
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_EQ
+    pcm_eq_set_rate(&ctl->eq, fmt->samplerate);
+#endif
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_WAV_MMAP
+    /* Mapped data goes to the device untouched, an equalizer needs the
+     * decoder thread.
+     */
+
+    if (ctl->src->audio_format == AUDIO_FORMAT_WAV
+#ifdef CONFIG_LVX_MUSIC_PLAYER_EQ
+        && !pcm_eq_active(&ctl->eq)
+#endif
+        ) {
+        ret = audio_source_map(ctl->src, &ctl->map);
+        MP3_LOG("🗺️ WAV内存映射: %s (%d)", ret == 0 ? "启用" : "回退到解码线程", ret);
+    }
+#endif
+
+    ret = init_nxaudio(&ctl->nxaudio, fmt->samplerate, fmt->bitspersample,
+                       fmt->numchannels);
+    if (ret < 0)
+    {
+        printf("init_nxaudio() return with error!!\n");
+        goto errout;
+    }
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADAPTIVE_BUFFERS
+    ret = audio_ctl_buffering_open(ctl);
+    if (ret < 0)
+    {
+        fin_nxaudio(&ctl->nxaudio);
+        goto errout;
+    }
+#endif
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_WAV_MMAP
+    if (ctl->map.data != NULL)
+    {
+        ret = 0;
+    }
+    else
+#endif
+    ret = audio_ctl_start_decoder(ctl);
+    if (ret < 0)
+    {
+        printf("audio_ctl_start_decoder() failed: %d\n", ret);
+        fin_nxaudio(&ctl->nxaudio);
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADAPTIVE_BUFFERS
+        free(ctl->out_idle);
+        ctl->out_idle = NULL;
+#endif
+        goto errout;
+    }
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_TELEMETRY
+    audio_telemetry_session(&ctl->telemetry);
+#endif
+
+    audio_trace_mark(AUDIO_TRACE_READY);
+
+    for (i = 0; i < ctl->nxaudio.abufnum; i++)
+    {
+        app_dequeue_cb((unsigned long)ctl, ctl->nxaudio.abufs[i]);
+    }
+
+    ctl->session_open = true;
+    ctl->state = AUDIO_CTL_STATE_INIT;
+
+    return 0;
+
+errout:
+#ifdef CONFIG_LVX_MUSIC_PLAYER_WAV_MMAP
+    audio_source_unmap(&ctl->map);
+#endif
+    return ret;
+}
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_EQ
+/**
+ * @brief Apply CONFIG_LVX_MUSIC_PLAYER_EQ_PRESET, a bad preset plays flat
+ */
+static void audio_ctl_eq_preset(FAR audioctl_s *ctl)
+{
+    pcm_eq_band_s bands[PCM_EQ_MAX_BANDS];
+    int nbands;
+    int ret;
+
+    nbands = pcm_eq_parse(CONFIG_LVX_MUSIC_PLAYER_EQ_PRESET, bands,
+                          PCM_EQ_MAX_BANDS);
+    ret = nbands > 0 ? pcm_eq_set(&ctl->eq, bands, nbands) : nbands;
+    if (ret < 0) {
+        MP3_LOG("❌ 均衡器预设无效: \"%s\" (%d)",
+                CONFIG_LVX_MUSIC_PLAYER_EQ_PRESET, ret);
+    } else if (nbands > 0) {
+        MP3_LOG("🎚️ 均衡器: %d段 (%s)", nbands, pcm_eq_name());
+    }
+}
+#endif
+
+/**
+ * @brief Stop the message loop and the decoder thread, release the device
+ */
+static void audio_ctl_close_session(FAR audioctl_s *ctl)
+{
+    if (!ctl->session_open) {
+        return;
+    }
+
+    if (ctl->loop_running) {
+        nxaudio_stop(&ctl->nxaudio);
+        pthread_join(ctl->pid, NULL);
+        ctl->loop_running = false;
+    }
+
+    audio_ctl_stop_decoder(ctl);
+#ifdef CONFIG_LVX_MUSIC_PLAYER_WAV_MMAP
+    audio_source_unmap(&ctl->map);
+#endif
+
+    fin_nxaudio(&ctl->nxaudio);
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADAPTIVE_BUFFERS
+    free(ctl->out_idle);
+    ctl->out_idle = NULL;
+#endif
+    ctl->session_open = false;
+}
+
+/**
+ * @brief Whether b produces exactly the PCM layout the device is set for
+ */
+static bool audio_source_same_format(FAR audio_source_s *a,
+                                     FAR audio_source_s *b)
+{
+    return a->wav.fmt.audioformat == b->wav.fmt.audioformat &&
+           a->wav.fmt.samplerate == b->wav.fmt.samplerate &&
+           a->wav.fmt.numchannels == b->wav.fmt.numchannels &&
+           a->wav.fmt.bitspersample == b->wav.fmt.bitspersample;
+}
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+FAR audioctl_s *audio_ctl_init_nxaudio(FAR const char *arg)
+{
+    FAR audioctl_s *ctl;
+    pthread_condattr_t cattr;
+    int ret;
+
+    audio_trace_mark(AUDIO_TRACE_OPEN);
+
+    ctl = (FAR audioctl_s *)malloc(sizeof(audioctl_s));
+    if(ctl == NULL)
+    {
+        return NULL;
+    }
+
+    memset(ctl, 0, sizeof(audioctl_s));
+    ctl->seek_position = 0;
+    atomic_init(&ctl->seek, false);
+    atomic_init(&ctl->splice_pending, false);
+    atomic_init(&ctl->decode_eof, false);
+    atomic_init(&ctl->attach, NULL);
+#ifdef CONFIG_LVX_MUSIC_PLAYER_TELEMETRY
+    audio_telemetry_init(&ctl->telemetry);
+#endif
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADAPTIVE_BUFFERS
+    audio_buffering_default_limits(&ctl->out_limits);
+#endif
+
+    ret = audio_source_open(arg, &ctl->src);
+    if (ret < 0) {
+        free(ctl);
+        return NULL;
+    }
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_RESAMPLE
+    /* Formats the converter cannot take run the device at their own rate */
+
+    audio_source_set_rate(ctl->src, CONFIG_LVX_MUSIC_PLAYER_OUTPUT_RATE);
+#endif
+
+    pthread_mutex_init(&ctl->lock, NULL);
+    pthread_condattr_init(&cattr);
+    pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&ctl->decode_cond, &cattr);
+    pthread_condattr_destroy(&cattr);
+    ctl->total_frames = ctl->src->total_frames;
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_EQ
+    pcm_eq_init(&ctl->eq);
+    audio_ctl_eq_preset(ctl);
+#endif
+
+    ret = audio_ctl_open_session(ctl);
+    if (ret < 0)
+    {
+        audio_source_close(ctl->src);
+#ifdef CONFIG_LVX_MUSIC_PLAYER_EQ
+        pcm_eq_deinit(&ctl->eq);
+#endif
+        pthread_cond_destroy(&ctl->decode_cond);
+        pthread_mutex_destroy(&ctl->lock);
+        free(ctl);
+        return NULL;
+    }
+
+    return ctl;
+}
+
+int audio_ctl_start(FAR audioctl_s *ctl)
+{
+    if (ctl == NULL)
+        return -EINVAL;
+
+    if (ctl->state != AUDIO_CTL_STATE_INIT && ctl->state != AUDIO_CTL_STATE_PAUSE)
+    {
+        return -1;
+    }
+
+    ctl->state = AUDIO_CTL_STATE_START;
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADAPTIVE_BUFFERS
+    audio_buffering_restart(&ctl->buffering);
+#endif
+
+    pthread_attr_t tattr;
+    struct sched_param sparam;
+
+    pthread_attr_init(&tattr);
+    sparam.sched_priority = sched_get_priority_max(SCHED_FIFO) - 9;
+    pthread_attr_setschedparam(&tattr, &sparam);
+    pthread_attr_setstacksize(&tattr, 4096);
+
+    pthread_create(&ctl->pid, &tattr, audio_loop_thread,
+                                (pthread_addr_t)ctl);
+
+    pthread_attr_destroy(&tattr);
+    pthread_setname_np(ctl->pid, "audioctl_thread");
+    ctl->loop_running = true;
+
+    return 0;
+}
+
+int audio_ctl_pause(FAR audioctl_s *ctl)
+{
+    if (ctl == NULL)
+        return -EINVAL;
+
+    if (ctl->state != AUDIO_CTL_STATE_START)
+    {
+        return -1;
+    }
+
+    ctl->state = AUDIO_CTL_STATE_PAUSE;
+
+    return nxaudio_pause(&ctl->nxaudio);
+}
+
+int audio_ctl_resume(FAR audioctl_s *ctl)
+{
+    int ret;
+
+    if (ctl == NULL)
+        return -EINVAL;
+
+    /* Reconfigured by audio_ctl_switch() while paused: never started */
+
+    if (ctl->state == AUDIO_CTL_STATE_INIT)
+    {
+        return audio_ctl_start(ctl);
+    }
+
+    if (ctl->state != AUDIO_CTL_STATE_PAUSE)
+    {
+        return -1;
+    }
+
+    ctl->state = AUDIO_CTL_STATE_START;
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADAPTIVE_BUFFERS
+    audio_buffering_restart(&ctl->buffering);
+#endif
+    ret = nxaudio_resume(&ctl->nxaudio);
+    audio_trace_mark(AUDIO_TRACE_START);
+
+    return ret;
+}
+
+/**
+ * @brief Seek to a whole second, kept for the UI which works in seconds
+ */
+int audio_ctl_seek(FAR audioctl_s *ctl, unsigned sec)
+{
+    if (ctl == NULL)
+        return -EINVAL;
+
+    return audio_ctl_seek_frame(ctl, (uint64_t)sec * ctl->src->wav.fmt.samplerate);
+}
+
+/**
+ * @brief Seek to a sample frame
+ * @param ctl Audio controller
+ * @param frame Target frame, clamped to the end of the stream
+ * @return 0 on success, -EINVAL on bad arguments
+ *
+ * See audio_source_locate() for how the target is reached exactly.
+ *
+ * Within the last ring length of a track the decoder already reads the
+ * queued one; a seek then applies to that track, which becomes current.
+ */
+int audio_ctl_seek_frame(FAR audioctl_s *ctl, uint64_t frame)
+{
+    FAR audio_source_s *src;
+    uint64_t in_frame;
+    int ret;
+
+    if (ctl == NULL || ctl->src->wav.fmt.blockalign == 0)
+        return -EINVAL;
+
+    pthread_mutex_lock(&ctl->lock);
+
+    if (atomic_exchange(&ctl->splice_pending, false)) {
+        ctl->total_frames = ctl->splice_total;
+        ctl->track_serial++;
+    }
+
+    src = ctl->src;
+
+    if (frame > ctl->total_frames) {
+        frame = ctl->total_frames;
+    }
+
+    /* Position and length are in output frames, the file in decoder ones */
+
+    in_frame = frame;
+#ifdef CONFIG_LVX_MUSIC_PLAYER_RESAMPLE
+    if (src->rs != NULL) {
+        in_frame = frame * src->in_rate / src->wav.fmt.samplerate;
+    }
+#endif
+
+    ret = audio_source_locate(src, in_frame, &ctl->seek_position,
+                              &ctl->seek_landed, &ctl->seek_target);
+    if (ret < 0) {
+        pthread_mutex_unlock(&ctl->lock);
+        return ret;
+    }
+
+    ctl->seek_bytes = frame * src->wav.fmt.blockalign;
+    ctl->played_bytes = ctl->seek_bytes;
+    atomic_store_explicit(&ctl->seek, true, memory_order_release);
+    pthread_cond_broadcast(&ctl->decode_cond);
+
+    pthread_mutex_unlock(&ctl->lock);
+
+    return 0;
+}
+
+int audio_ctl_stop(FAR audioctl_s *ctl)
+{
+    if (ctl == NULL)
+        return -EINVAL;
 
     if (ctl->state != AUDIO_CTL_STATE_PAUSE && ctl->state != AUDIO_CTL_STATE_START)
     {
         return -1;
     }
 
-    ctl->state = AUDIO_CTL_STATE_STOP;
+    ctl->state = AUDIO_CTL_STATE_STOP;
+
+    nxaudio_stop(&ctl->nxaudio);
+
+    if (ctl->loop_running)
+    {
+        pthread_join(ctl->pid, NULL);
+        ctl->loop_running = false;
+    }
+
+    return 0;
+}
+
+int audio_ctl_set_volume(FAR audioctl_s *ctl, uint16_t vol)
+{
+    if (ctl == NULL)
+        return -EINVAL;
+
+    return nxaudio_setvolume(&ctl->nxaudio, vol);
+}
+
+int audio_ctl_get_position(FAR audioctl_s *ctl)
+{
+    if (ctl == NULL)
+        return -EINVAL;
+
+    if (ctl->src->wav.fmt.samplerate == 0)
+        return 0;
+
+    return audio_ctl_get_frame_position(ctl) / ctl->src->wav.fmt.samplerate;
+}
+
+/**
+ * @brief Current playback position in sample frames
+ */
+uint64_t audio_ctl_get_frame_position(FAR audioctl_s *ctl)
+{
+    if (ctl == NULL || ctl->src->wav.fmt.blockalign == 0)
+        return 0;
+
+    return ctl->played_bytes / ctl->src->wav.fmt.blockalign;
+}
+
+/**
+ * @brief Length in sample frames of the track being heard
+ */
+uint64_t audio_ctl_get_total_frames(FAR audioctl_s *ctl)
+{
+    if (ctl == NULL)
+        return 0;
+
+    return ctl->total_frames;
+}
+
+/**
+ * @brief Length in milliseconds of the track being heard
+ *
+ * Takes the controller lock, the source and its rate are replaced by
+ * audio_ctl_switch() and the decoder thread.
+ */
+uint32_t audio_ctl_get_duration_ms(FAR audioctl_s *ctl)
+{
+    uint64_t frames;
+    uint32_t rate;
+
+    if (ctl == NULL)
+        return 0;
+
+    pthread_mutex_lock(&ctl->lock);
+    frames = ctl->total_frames;
+    rate = ctl->src->wav.fmt.samplerate;
+    pthread_mutex_unlock(&ctl->lock);
+
+    return rate > 0 ? frames * 1000 / rate : 0;
+}
+
+/**
+ * @brief Play another track in the same output session
+ * @param ctl Audio controller
+ * @param path Audio file
+ * @return 0 on success, -ETIMEDOUT if the decoder thread did not take the
+ *         track within AUDIO_CTL_ATTACH_TIMEOUT_MS, negated errno on other
+ *         errors (the current track then keeps playing, unless the device
+ *         had to be reconfigured)
+ *
+ * When the new track produces the same PCM layout, the device, its
+ * buffers and the message loop thread stay as they are: the decoder
+ * thread drops what is left in the ring and continues with the new track,
+ * so the switch costs only the buffers already queued in the driver. Only
+ * a different sample rate, width or channel count, or a memory-mapped WAV
+ * session, closes and reopens the device. The play state is kept, except
+ * that a paused session that had to be reconfigured is started again by
+ * audio_ctl_resume().
+ */
+int audio_ctl_switch(FAR audioctl_s *ctl, FAR const char *path)
+{
+    FAR audio_source_s *src;
+    FAR audio_source_s *old[4];
+    struct timespec deadline;
+    int state;
+    int ret;
+    int i;
+
+    if (ctl == NULL || path == NULL)
+        return -EINVAL;
+
+    audio_trace_mark(AUDIO_TRACE_OPEN);
+
+    ret = audio_source_open(path, &src);
+    if (ret < 0) {
+        return ret;
+    }
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_RESAMPLE
+    audio_source_set_rate(src, CONFIG_LVX_MUSIC_PLAYER_OUTPUT_RATE);
+#endif
+
+    if (ctl->session_open && ctl->decode_running &&
+        audio_source_same_format(ctl->src, src)) {
+        ret = read_ahead_open(&src->ra, src->fd, src->decode_offset);
+        if (ret < 0) {
+            audio_source_close(src);
+            return ret;
+        }
+
+        /* Taken at the top of the decoder loop, after the current chunk */
+
+        audio_ctl_abstime(&deadline, AUDIO_CTL_ATTACH_TIMEOUT_MS * 1000);
+        ret = 0;
+
+        pthread_mutex_lock(&ctl->lock);
+        atomic_store(&ctl->attach, src);
+        pthread_cond_broadcast(&ctl->decode_cond);
+
+        while (atomic_load(&ctl->attach) != NULL && ret != ETIMEDOUT) {
+            ret = pthread_cond_timedwait(&ctl->decode_cond, &ctl->lock,
+                                         &deadline);
+        }
+
+        /* A decoder stuck in a read never took it, withdraw the track */
+
+        if (atomic_load(&ctl->attach) != NULL) {
+            atomic_store(&ctl->attach, NULL);
+            pthread_mutex_unlock(&ctl->lock);
+
+            MP3_LOG("❌ 解码线程未响应，切换曲目超时: %s", path);
+            audio_source_close(src);
+            return -ETIMEDOUT;
+        }
+
+        pthread_mutex_unlock(&ctl->lock);
+
+        MP3_LOG("🔁 复用输出会话切换曲目: %s", path);
+        return 0;
+    }
+
+    MP3_LOG("🔧 输出格式变化，重新配置音频设备: %s", path);
+
+    state = ctl->state;
+    audio_ctl_close_session(ctl);
+
+    pthread_mutex_lock(&ctl->lock);
+    old[0] = ctl->src;
+    old[1] = ctl->next;
+    old[2] = ctl->retired;
+#ifdef CONFIG_LVX_MUSIC_PLAYER_CROSSFADE
+    old[3] = ctl->fade_src;
+    ctl->fade_src = NULL;
+#else
+    old[3] = NULL;
+#endif
+    ctl->src = src;
+    ctl->next = NULL;
+    ctl->retired = NULL;
+
+    atomic_store(&ctl->splice_pending, false);
+    ctl->total_frames = src->total_frames;
+    ctl->played_bytes = 0;
+    atomic_store(&ctl->seek, false);
+    pthread_mutex_unlock(&ctl->lock);
+
+    for (i = 0; i < 4; i++)
+    {
+        audio_source_close(old[i]);
+    }
+
+    ret = audio_ctl_open_session(ctl);
+    if (ret < 0) {
+        ctl->state = AUDIO_CTL_STATE_STOP;
+        return ret;
+    }
+
+    if (state == AUDIO_CTL_STATE_START) {
+        ret = audio_ctl_start(ctl);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Open the track to play after the current one
+ * @param ctl Audio controller
+ * @param path Audio file with the same sample rate, width and channels
+ * @return 0 on success, -EBUSY if a track is already queued, -ENOTSUP if it
+ *         cannot follow without reconfiguring the device, negated errno on
+ *         other errors
+ *
+ * Opening, indexing and the first reads happen now, so when the current
+ * track runs out the decoder thread continues with this one in the same
+ * PCM stream and there is no gap. audio_ctl_get_track_serial() changes
+ * once the device actually reaches it.
+ */
+int audio_ctl_queue_next(FAR audioctl_s *ctl, FAR const char *path)
+{
+    FAR audio_source_s *src;
+    int ret;
+
+    if (ctl == NULL || path == NULL)
+        return -EINVAL;
+
+    /* Mapped WAV plays without the decoder thread and its ring */
+
+    if (!ctl->decode_running)
+        return -ENOTSUP;
+
+    if (ctl->next != NULL)
+        return -EBUSY;
+
+    ret = audio_source_open(path, &src);
+    if (ret < 0) {
+        return ret;
+    }
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_RESAMPLE
+    audio_source_set_rate(src, ctl->src->wav.fmt.samplerate);
+#endif
 
-    nxaudio_stop(&ctl->nxaudio);
+    if (!audio_source_same_format(ctl->src, src)) {
+        MP3_LOG("⚠️ 下一首输出格式不同，无法无缝衔接: %s", path);
+        audio_source_close(src);
+        return -ENOTSUP;
+    }
 
-    if (ctl->pid > 0)
-    {
-        pthread_join(ctl->pid, NULL);
+    ret = read_ahead_open(&src->ra, src->fd, src->decode_offset);
+    if (ret < 0) {
+        audio_source_close(src);
+        return ret;
     }
 
+    pthread_mutex_lock(&ctl->lock);
+    ctl->next = src;
+    pthread_cond_broadcast(&ctl->decode_cond);
+    pthread_mutex_unlock(&ctl->lock);
+
+    MP3_LOG("⏭️ 已预加载下一首: %s", path);
     return 0;
 }
 
-int audio_ctl_set_volume(FAR audioctl_s *ctl, uint16_t vol)
+/**
+ * @brief Number of gapless track changes the device has played through
+ */
+uint32_t audio_ctl_get_track_serial(FAR audioctl_s *ctl)
+{
+    if (ctl == NULL)
+        return 0;
+
+    return ctl->track_serial;
+}
+
+/**
+ * @brief Whether everything, including a queued track, has been played
+ */
+bool audio_ctl_is_finished(FAR audioctl_s *ctl)
+{
+    if (ctl == NULL)
+        return true;
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_WAV_MMAP
+    if (ctl->map.data != NULL)
+        return ctl->map.pos >= ctl->map.size;
+#endif
+
+    return atomic_load(&ctl->decode_eof) && ctl->next == NULL &&
+           pcm_ring_used(&ctl->ring) == 0;
+}
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_CROSSFADE
+/**
+ * @brief Overlap the end of each track with the start of the queued one
+ * @param ctl Audio controller
+ * @param ms Crossfade length, 0 switches back to plain gapless changes
+ * @return 0 on success, -ENOTSUP when tracks cannot be queued
+ *
+ * Takes effect from the next track change. The fade is shortened when the
+ * track is queued late or the next track is short.
+ */
+int audio_ctl_set_crossfade(FAR audioctl_s *ctl, uint32_t ms)
 {
     if (ctl == NULL)
         return -EINVAL;
 
-    return nxaudio_setvolume(&ctl->nxaudio, vol);
+    if (!ctl->decode_running)
+        return -ENOTSUP;
+
+    ctl->fade_ms = ms;
+    return 0;
 }
 
-int audio_ctl_get_position(FAR audioctl_s *ctl)
+/**
+ * @brief Snapshot the crossfade counters
+ */
+int audio_ctl_get_fade_stats(FAR audioctl_s *ctl,
+                             FAR audio_fade_stats_s *stats)
+{
+    if (ctl == NULL || stats == NULL)
+        return -EINVAL;
+
+    *stats = ctl->fade_stats;
+    return 0;
+}
+#endif
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_EQ
+/**
+ * @brief Replace the equalizer bands
+ * @param ctl Audio controller
+ * @param bands New bands, applied in order
+ * @param nbands Number of bands, 0 makes the output flat again
+ * @return 0 on success, -ENOTSUP while a mapped WAV bypasses the decoder
+ *         thread, else the error of pcm_eq_set()
+ *
+ * The decoder thread ramps from the old response to the new one over
+ * CONFIG_LVX_MUSIC_PLAYER_EQ_RAMP_MS, PCM already queued plays unchanged.
+ */
+int audio_ctl_set_eq(FAR audioctl_s *ctl, FAR const pcm_eq_band_s *bands,
+                     int nbands)
 {
     if (ctl == NULL)
         return -EINVAL;
 
-    return ctl->file_position / (ctl->wav.fmt.bitspersample * ctl->wav.fmt.numchannels * ctl->wav.fmt.samplerate / 8);
+    if (!ctl->decode_running)
+        return -ENOTSUP;
+
+    return pcm_eq_set(&ctl->eq, bands, nbands);
+}
+
+/**
+ * @brief Copy the equalizer bands
+ * @param bands Room for CONFIG_LVX_MUSIC_PLAYER_EQ_BANDS bands
+ * @return Number of bands
+ */
+int audio_ctl_get_eq(FAR audioctl_s *ctl, FAR pcm_eq_band_s *bands)
+{
+    if (ctl == NULL || bands == NULL)
+        return -EINVAL;
+
+    return pcm_eq_get(&ctl->eq, bands);
 }
+#endif
 
 int audio_ctl_uninit_nxaudio(FAR audioctl_s *ctl)
 {
@@ -436,316 +2903,381 @@ int audio_ctl_uninit_nxaudio(FAR audioctl_s *ctl)
         return 0;
     }
 
-#ifdef CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT
-    /* Cleanup MP3 decoder if used */
-    if (ctl->audio_format == AUDIO_FORMAT_MP3) {
-        mp3_decoder_cleanup(&ctl->mp3);
-    }
+    audio_ctl_close_session(ctl);
+
+    audio_source_close(ctl->next);
+    audio_source_close(ctl->retired);
+    audio_source_close(ctl->src);
+#ifdef CONFIG_LVX_MUSIC_PLAYER_CROSSFADE
+    audio_source_close(ctl->fade_src);
+    free(ctl->fade_buf);
+#endif
+#ifdef CONFIG_LVX_MUSIC_PLAYER_EQ
+    pcm_eq_deinit(&ctl->eq);
 #endif
 
-    if (ctl->fd > 0)
-    {
-        close(ctl->fd);
-        ctl->fd = -1;
-    }
+    pthread_cond_destroy(&ctl->decode_cond);
+    pthread_mutex_destroy(&ctl->lock);
+    free(ctl);
 
-    fin_nxaudio(&ctl->nxaudio);
+    return 0;
+}
 
-    free(ctl);
+/**
+ * @brief Snapshot the PCM ring fill-level counters
+ * @param ctl Audio controller
+ * @param stats Output counters
+ * @return 0 on success, -EINVAL if the decoder is not running
+ */
+int audio_ctl_get_ring_stats(FAR audioctl_s *ctl, FAR pcm_ring_stats_s *stats)
+{
+    if (ctl == NULL || stats == NULL || ctl->ring.buf == NULL)
+        return -EINVAL;
 
+    pcm_ring_get_stats(&ctl->ring, stats);
     return 0;
 }
 
-/**********************
- *   MP3 FUNCTIONS
- **********************/
+/**
+ * @brief Snapshot the read-ahead stage latency and depth counters
+ * @param ctl Audio controller
+ * @param stats Output counters
+ * @return 0 on success, -EINVAL if the decoder is not running
+ */
+int audio_ctl_get_io_stats(FAR audioctl_s *ctl, FAR read_ahead_stats_s *stats)
+{
+    if (ctl == NULL || stats == NULL || !ctl->src->ra.running)
+        return -EINVAL;
+
+    read_ahead_get_stats(&ctl->src->ra, stats);
+    return 0;
+}
 
+#ifdef CONFIG_LVX_MUSIC_PLAYER_TELEMETRY
 /**
- * @brief Detect audio format based on file extension
- * @param filename Audio file path
- * @return AUDIO_FORMAT_WAV, AUDIO_FORMAT_MP3, or AUDIO_FORMAT_UNKNOWN
+ * @brief Snapshot of the dequeue and decode telemetry
+ * @return 0 on success, -EINVAL on bad arguments
+ *
+ * Safe to call from any thread while playing, the writers are not
+ * stopped or locked.
  */
-int audio_ctl_detect_format(FAR const char *filename)
+int audio_ctl_get_telemetry(FAR audioctl_s *ctl,
+                            FAR audio_telemetry_stats_s *stats)
 {
-    if (!filename) {
-        return AUDIO_FORMAT_UNKNOWN;
-    }
-    
-    size_t len = strlen(filename);
-    if (len < 4) {
-        return AUDIO_FORMAT_UNKNOWN;
-    }
-    
-    const char *ext = filename + len - 4;
-    
-    if (strncasecmp(ext, ".wav", 4) == 0) {
-        return AUDIO_FORMAT_WAV;
-    }
-#ifdef CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT
-    else if (strncasecmp(ext, ".mp3", 4) == 0) {
-        return AUDIO_FORMAT_MP3;
-    }
-#endif
-    
-    return AUDIO_FORMAT_UNKNOWN;
+    if (ctl == NULL || stats == NULL)
+        return -EINVAL;
+
+    audio_telemetry_get_stats(&ctl->telemetry, stats);
+    return 0;
 }
 
-#ifdef CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT
+/**
+ * @brief Start the telemetry over, from the next buffer and decode pass
+ */
+int audio_ctl_reset_telemetry(FAR audioctl_s *ctl)
+{
+    if (ctl == NULL)
+        return -EINVAL;
+
+    audio_telemetry_reset(&ctl->telemetry);
+    return 0;
+}
+#endif
 
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADAPTIVE_BUFFERS
 /**
- * @brief Initialize MP3 decoder
- * @param decoder MP3 decoder structure
- * @return 0 on success, -1 on error
+ * @brief Bound the output buffer count and size
+ * @param limits Buffers kept queued and play time of each, min == max pins
+ * @return 0 on success, -EINVAL on bad or inconsistent limits
+ *
+ * Applies from the next buffer of the current session and to every later
+ * one. The driver's buffer count and size cap the limits further.
  */
-int mp3_decoder_init(FAR mp3_decoder_s *decoder)
+int audio_ctl_set_buffering(FAR audioctl_s *ctl,
+                            FAR const audio_buffering_limits_s *limits)
 {
-    if (!decoder) {
-        return -1;
-    }
-    
-    memset(decoder, 0, sizeof(mp3_decoder_s));
-    
-    /* Initialize libmad structures */
-    mad_stream_init(&decoder->stream);
-    mad_frame_init(&decoder->frame);
-    mad_synth_init(&decoder->synth);
-    
-    /* Allocate buffers */
-    decoder->buffer_size = CONFIG_LVX_MUSIC_PLAYER_MP3_BUFFER_SIZE;
-    decoder->input_buffer = malloc(decoder->buffer_size);
-    decoder->output_buffer = malloc(decoder->buffer_size * 4); /* PCM output is larger */
-    
-    if (!decoder->input_buffer || !decoder->output_buffer) {
-        mp3_decoder_cleanup(decoder);
-        return -1;
+    if (ctl == NULL || limits == NULL)
+        return -EINVAL;
+
+    if (limits->min_bufs == 0 || limits->min_bufs > limits->max_bufs ||
+        limits->min_ms == 0 || limits->min_ms > limits->max_ms) {
+        return -EINVAL;
     }
-    
-    decoder->bytes_remaining = 0;
-    decoder->output_size = 0;
-    decoder->sample_rate = 44100; /* Default */
-    decoder->channels = 2;       /* Default stereo */
-    decoder->bits_per_sample = 16; /* Default 16-bit */
-    
+
+    pthread_mutex_lock(&ctl->lock);
+    ctl->out_limits = *limits;
+    audio_buffering_set_limits(&ctl->buffering, limits);
+    pthread_mutex_unlock(&ctl->lock);
+
     return 0;
 }
 
 /**
- * @brief Convert MP3 sample to 16-bit PCM
- * @param sample MAD fixed-point sample
- * @return 16-bit PCM sample
+ * @brief Snapshot of the output level and what moved it
+ * @return 0 on success, -EINVAL if no session is open
  */
-static inline int16_t mp3_sample_to_pcm(mad_fixed_t sample)
+int audio_ctl_get_buffering(FAR audioctl_s *ctl,
+                            FAR audio_buffering_stats_s *stats)
 {
-    /* MAD produces samples in 24.8 fixed point format */
-    /* Round and clip to 16-bit */
-    sample += (1L << (MAD_F_FRACBITS - 16));
-    
-    if (sample >= MAD_F_ONE) {
-        sample = MAD_F_ONE - 1;
-    } else if (sample < -MAD_F_ONE) {
-        sample = -MAD_F_ONE;
-    }
-    
-    return (int16_t)(sample >> (MAD_F_FRACBITS + 1 - 16));
+    if (ctl == NULL || stats == NULL || !ctl->session_open)
+        return -EINVAL;
+
+    audio_buffering_get_stats(&ctl->buffering, stats);
+    return 0;
 }
+#endif
+
+/**********************
+ *   STREAM FUNCTIONS
+ **********************/
 
 /**
- * @brief Decode MP3 data to PCM
- * @param decoder MP3 decoder structure  
- * @param input Input MP3 data
- * @param input_size Size of input data
- * @param output Output PCM buffer
- * @param output_size Size of output data (in/out parameter)
- * @return 0 on success, -1 on error
+ * @brief Open a track for pull-model decoding
+ * @param path Audio file
+ * @param streamp Returns the stream
+ * @return 0 on success, negated errno on error
+ *
+ * Plain PCM WAV is served from a mapping of the data chunk when
+ * CONFIG_LVX_MUSIC_PLAYER_WAV_MMAP is set, everything else is decoded on
+ * the caller's thread from the read-ahead stage.
  */
-int mp3_decoder_decode(FAR mp3_decoder_s *decoder, FAR const unsigned char *input,
-                       size_t input_size, FAR unsigned char *output, FAR size_t *output_size)
+int audio_ctl_stream_open(FAR const char *path, FAR audio_stream_s **streamp)
 {
-    if (!decoder || !input || !output || !output_size) {
-        return -1;
+    FAR audio_stream_s *stream;
+    FAR audio_source_s *src;
+    int ret;
+
+    if (path == NULL || streamp == NULL)
+        return -EINVAL;
+
+    stream = (FAR audio_stream_s *)malloc(sizeof(audio_stream_s));
+    if (stream == NULL) {
+        return -ENOMEM;
     }
-    
-    int16_t *pcm_output = (int16_t *)output;
-    size_t pcm_samples = 0;
-    size_t max_samples = *output_size / sizeof(int16_t);
-    
-    /* Copy input data to decoder buffer */
-    if (input_size > decoder->buffer_size) {
-        input_size = decoder->buffer_size;
+
+    memset(stream, 0, sizeof(audio_stream_s));
+
+    ret = audio_source_open(path, &src);
+    if (ret < 0) {
+        free(stream);
+        return ret;
     }
-    
-    memcpy(decoder->input_buffer, input, input_size);
-    mad_stream_buffer(&decoder->stream, decoder->input_buffer, input_size);
-    
-    while (pcm_samples < max_samples) {
-        /* Decode frame */
-        if (mad_frame_decode(&decoder->frame, &decoder->stream) == -1) {
-            if (MAD_RECOVERABLE(decoder->stream.error)) {
-                continue;
-            } else {
-                break;
-            }
-        }
-        
-        /* Update audio format info from first frame */
-        if (decoder->sample_rate == 44100) { /* First frame */
-            decoder->sample_rate = decoder->frame.header.samplerate;
-            decoder->channels = MAD_NCHANNELS(&decoder->frame.header);
-        }
-        
-        /* Synthesize PCM data */
-        mad_synth_frame(&decoder->synth, &decoder->frame);
-        
-        /* Convert to 16-bit PCM */
-        for (int i = 0; i < decoder->synth.pcm.length; i++) {
-            if (pcm_samples >= max_samples) {
-                break;
-            }
-            
-            /* Left channel */
-            pcm_output[pcm_samples++] = mp3_sample_to_pcm(decoder->synth.pcm.samples[0][i]);
-            
-            /* Right channel (if stereo) */
-            if (decoder->channels == 2 && pcm_samples < max_samples) {
-                pcm_output[pcm_samples++] = mp3_sample_to_pcm(decoder->synth.pcm.samples[1][i]);
-            }
+
+    stream->src = src;
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_WAV_MMAP
+    if (audio_source_map(src, &stream->map) == 0) {
+        MP3_LOG("🗺️ WAV内存映射: 启用");
+    }
+    else
+#endif
+    {
+        ret = read_ahead_open(&src->ra, src->fd, src->decode_offset);
+        if (ret < 0) {
+            audio_source_close(src);
+            free(stream);
+            return ret;
         }
     }
-    
-    *output_size = pcm_samples * sizeof(int16_t);
+
+    pthread_mutex_init(&stream->lock, NULL);
+
+    *streamp = stream;
     return 0;
 }
 
 /**
- * @brief Cleanup MP3 decoder
- * @param decoder MP3 decoder structure
+ * @brief Decode the next PCM of the track into buf
+ * @param stream Stream from audio_ctl_stream_open()
+ * @param buf Output, in the layout audio_ctl_stream_get_fmt() describes
+ * @param len Size of buf, only whole frames are produced
+ * @return Bytes produced, 0 at the end of the track, negated errno on error
+ *
+ * buf is filled completely unless the track ends first.
  */
-void mp3_decoder_cleanup(FAR mp3_decoder_s *decoder)
+ssize_t audio_ctl_stream_read(FAR audio_stream_s *stream, FAR uint8_t *buf,
+                              size_t len)
 {
-    if (!decoder) {
-        return;
+    size_t bpf;
+    ssize_t ret;
+
+    if (stream == NULL || buf == NULL)
+        return -EINVAL;
+
+    pthread_mutex_lock(&stream->lock);
+
+    bpf = stream->src->wav.fmt.blockalign;
+    len -= len % bpf;
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_WAV_MMAP
+    if (stream->map.data != NULL) {
+        FAR audio_map_s *map = &stream->map;
+
+        if (len > map->size - map->pos) {
+            len = map->size - map->pos;
+        }
+
+        memcpy(buf, map->data + map->pos, len);
+        map->pos += len;
+        audio_map_prefetch(map, 4 * len);
+        ret = len;
     }
-    
-    mad_synth_finish(&decoder->synth);
-    mad_frame_finish(&decoder->frame);
-    mad_stream_finish(&decoder->stream);
-    
-    if (decoder->input_buffer) {
-        free(decoder->input_buffer);
-        decoder->input_buffer = NULL;
+    else
+#endif
+    if (stream->eof) {
+        ret = 0;
+    } else {
+        ret = audio_source_fill(stream->src, buf, len);
+        stream->eof = ret == 0;
     }
-    
-    if (decoder->output_buffer) {
-        free(decoder->output_buffer);
-        decoder->output_buffer = NULL;
+
+    if (ret > 0) {
+        stream->position += ret / bpf;
     }
-    
-    memset(decoder, 0, sizeof(mp3_decoder_s));
+
+    pthread_mutex_unlock(&stream->lock);
+
+    return ret;
 }
 
-#if MP3_DECODER_AVAILABLE
 /**
- * @brief 初始化MP3解码器
+ * @brief Continue the stream from a sample frame
+ * @param stream Stream from audio_ctl_stream_open()
+ * @param frame Target frame, clamped to the end of the track
+ * @return 0 on success, negated errno on error
+ *
+ * Exact like audio_ctl_seek_frame(): the next read starts on frame.
  */
-static int mp3_decoder_init(mp3_decoder_t *decoder)
+int audio_ctl_stream_seek(FAR audio_stream_s *stream, uint64_t frame)
 {
-    if (!decoder || decoder->initialized) {
-        return -1;
+    FAR audio_source_s *src;
+    uint32_t position;
+    uint64_t landed;
+    uint64_t target;
+    int ret = 0;
+
+    if (stream == NULL)
+        return -EINVAL;
+
+    pthread_mutex_lock(&stream->lock);
+
+    src = stream->src;
+    if (src->total_frames > 0 && frame > src->total_frames) {
+        frame = src->total_frames;
     }
-    
-    memset(decoder, 0, sizeof(mp3_decoder_t));
-    
-    mad_stream_init(&decoder->stream);
-    mad_frame_init(&decoder->frame);
-    mad_synth_init(&decoder->synth);
-    
-    decoder->initialized = true;
-    MP3_LOG("MP3解码器初始化成功");
-    return 0;
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_WAV_MMAP
+    if (stream->map.data != NULL) {
+        stream->map.pos = frame * src->wav.fmt.blockalign;
+        if (stream->map.pos > stream->map.size) {
+            stream->map.pos = stream->map.size;
+        }
+    }
+    else
+#endif
+    {
+        ret = audio_source_locate(src, frame, &position, &landed, &target);
+        if (ret == 0) {
+            audio_source_seek(src, position, landed, target);
+        }
+    }
+
+    if (ret == 0) {
+        stream->position = frame;
+        stream->eof = false;
+    }
+
+    pthread_mutex_unlock(&stream->lock);
+
+    return ret;
 }
 
 /**
- * @brief 清理MP3解码器
+ * @brief Frame of the track the next read starts at
  */
-static void mp3_decoder_cleanup(mp3_decoder_t *decoder)
+uint64_t audio_ctl_stream_get_position(FAR audio_stream_s *stream)
 {
-    if (!decoder || !decoder->initialized) {
-        return;
-    }
-    
-    mad_synth_finish(&decoder->synth);
-    mad_frame_finish(&decoder->frame);
-    mad_stream_finish(&decoder->stream);
-    
-    decoder->initialized = false;
-    MP3_LOG("MP3解码器清理完成");
+    if (stream == NULL)
+        return 0;
+
+    return stream->position;
 }
 
 /**
- * @brief 缩放MAD采样值到16位PCM
+ * @brief Length of the track in sample frames, 0 if unknown
  */
-static short mp3_scale_sample(mad_fixed_t sample)
+uint64_t audio_ctl_stream_get_total_frames(FAR audio_stream_s *stream)
 {
-    // MAD固定点格式转换为16位PCM
-    if (sample >= MAD_F_ONE) {
-        return 32767;
-    } else if (sample <= -MAD_F_ONE) {
-        return -32768;
-    } else {
-        return (short)(sample >> (MAD_F_FRACBITS - 15));
+    if (stream == NULL)
+        return 0;
+
+    return stream->src->total_frames;
+}
+
+/**
+ * @brief Layout of the PCM audio_ctl_stream_read() produces
+ */
+FAR const fmt_s *audio_ctl_stream_get_fmt(FAR audio_stream_s *stream)
+{
+    if (stream == NULL)
+        return NULL;
+
+    return &stream->src->wav.fmt;
+}
+
+void audio_ctl_stream_close(FAR audio_stream_s *stream)
+{
+    if (stream == NULL) {
+        return;
     }
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_WAV_MMAP
+    audio_source_unmap(&stream->map);
+#endif
+
+    audio_source_close(stream->src);
+    pthread_mutex_destroy(&stream->lock);
+    free(stream);
 }
 
+/**********************
+ *   MP3 FUNCTIONS
+ **********************/
+
 /**
- * @brief 解码MP3帧数据
+ * @brief Guess the audio format from the file extension alone
+ * @param filename Audio file path
+ * @return AUDIO_FORMAT_WAV, AUDIO_FORMAT_MP3, AUDIO_FORMAT_FLAC or
+ *         AUDIO_FORMAT_UNKNOWN
+ *
+ * Only a fallback for files audio_ctl_probe() does not recognise.
  */
-static int mp3_decode_frame(mp3_decoder_t *decoder, const unsigned char *data, int len)
+int audio_ctl_detect_format(FAR const char *filename)
 {
-    if (!decoder || !decoder->initialized || !data || len <= 0) {
-        return -1;
+    if (!filename) {
+        return AUDIO_FORMAT_UNKNOWN;
     }
     
-    // 设置输入数据
-    mad_stream_buffer(&decoder->stream, data, len);
+    size_t len = strlen(filename);
+    if (len < 4) {
+        return AUDIO_FORMAT_UNKNOWN;
+    }
     
-    decoder->output_length = 0;
+    const char *ext = filename + len - 4;
     
-    while (decoder->stream.bufend - decoder->stream.next_frame > 0) {
-        // 解码帧
-        if (mad_frame_decode(&decoder->frame, &decoder->stream) != 0) {
-            if (MAD_RECOVERABLE(decoder->stream.error)) {
-                MP3_LOG("可恢复的MP3解码错误: %s", mad_stream_errorstr(&decoder->stream));
-                continue;
-            } else {
-                MP3_LOG("不可恢复的MP3解码错误: %s", mad_stream_errorstr(&decoder->stream));
-                break;
-            }
-        }
-        
-        // 合成PCM数据
-        mad_synth_frame(&decoder->synth, &decoder->frame);
-        
-        // 转换为16位PCM
-        for (int i = 0; i < decoder->synth.pcm.length && decoder->output_length < PCM_BUFFER_SIZE - 2; i++) {
-            // 左声道
-            decoder->output_buffer[decoder->output_length++] = 
-                mp3_scale_sample(decoder->synth.pcm.samples[0][i]);
-            
-            // 右声道（如果是立体声）
-            if (decoder->synth.pcm.channels == 2) {
-                decoder->output_buffer[decoder->output_length++] = 
-                    mp3_scale_sample(decoder->synth.pcm.samples[1][i]);
-            } else {
-                // 单声道复制到右声道
-                decoder->output_buffer[decoder->output_length++] = 
-                    decoder->output_buffer[decoder->output_length - 1];
-            }
-        }
+    if (strncasecmp(ext, ".wav", 4) == 0) {
+        return AUDIO_FORMAT_WAV;
+    }
+#ifdef CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT
+    else if (strncasecmp(ext, ".mp3", 4) == 0) {
+        return AUDIO_FORMAT_MP3;
+    }
+#endif
+#ifdef CONFIG_LVX_MUSIC_PLAYER_FLAC_SUPPORT
+    else if (len >= 5 && strncasecmp(filename + len - 5, ".flac", 5) == 0) {
+        return AUDIO_FORMAT_FLAC;
     }
+#endif
     
-    MP3_LOG("解码完成，输出PCM样本数: %d", decoder->output_length);
-    return decoder->output_length;
+    return AUDIO_FORMAT_UNKNOWN;
 }
-#endif /* MP3_DECODER_AVAILABLE */
-
-#endif /* CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT */
@@ -10,9 +10,39 @@ extern "C" {
  *********************/
 #include <audioutils/nxaudio.h>
 #include <pthread.h>
+#include <stdbool.h>
+
+#include "mp3_index.h"
+#include "pcm_format.h"
+#include "pcm_ring.h"
+#include "read_ahead.h"
 
 #ifdef CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT
-#include <mad.h>
+#include "mp3_decoder.h"
+#endif
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADPCM_SUPPORT
+#include "adpcm.h"
+#endif
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_FLAC_SUPPORT
+#include "flac_decoder.h"
+#endif
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_RESAMPLE
+#include "pcm_resample.h"
+#endif
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_EQ
+#include "pcm_eq.h"
+#endif
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_TELEMETRY
+#include "audio_telemetry.h"
+#endif
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADAPTIVE_BUFFERS
+#include "audio_buffering.h"
 #endif
 
 enum {
@@ -26,6 +56,8 @@ enum {
 enum {
     AUDIO_FORMAT_WAV,
     AUDIO_FORMAT_MP3,
+    AUDIO_FORMAT_FLAC,
+    AUDIO_FORMAT_OGG,      /* recognised by the probe, not decoded */
     AUDIO_FORMAT_UNKNOWN,
 };
 
@@ -65,59 +97,269 @@ typedef struct wav_fotmat {
    riff_s riff;
    fmt_s fmt;
    data_s data;
+   /* Located by walking the RIFF chunks, not part of the file layout */
+   uint32_t data_offset;   /* file offset of the first sample */
+   uint32_t data_size;     /* bytes of sample data, clipped to the file */
+   uint16_t samples_per_block; /* fmt extension of ADPCM, 0 if absent */
+   uint32_t fact_frames;   /* "fact" chunk sample length, 0 if absent */
 } wav_s;
 
-#ifdef CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT
-typedef struct mp3_decoder {
-    struct mad_stream stream;
-    struct mad_frame frame;
-    struct mad_synth synth;
-    unsigned char *input_buffer;
-    unsigned char *output_buffer;
-    size_t buffer_size;
-    size_t bytes_remaining;
-    size_t output_size;
+#define WAVE_FORMAT_PCM        0x0001
+#define WAVE_FORMAT_ADPCM      0x0002
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#define WAVE_FORMAT_IMA_ADPCM  0x0011
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+/* What the start of a file says it is. Fields the header does not carry
+ * are left 0, wav is only filled for AUDIO_FORMAT_WAV.
+ */
+
+typedef struct audio_probe {
+    int format;             /* AUDIO_FORMAT_*, _UNKNOWN if nothing matched */
     uint32_t sample_rate;
     uint16_t channels;
     uint16_t bits_per_sample;
-} mp3_decoder_s;
+    uint32_t data_offset;   /* first sample, MPEG frame or FLAC frame */
+    wav_s wav;
+} audio_probe_s;
+
+/* One open track. The decoder thread moves from the current source to a
+ * preloaded one at end of stream without touching the output side, which
+ * is what makes track changes gapless.
+ */
+
+typedef struct audio_source {
+    int fd;
+    int audio_format;  /* AUDIO_FORMAT_WAV, _MP3 or _FLAC */
+    uint32_t file_size;
+    wav_s wav;         /* PCM layout produced and location of the data */
+#ifdef CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT
+    mp3_decoder_s mp3;
+    mp3_index_s mp3_index;
+#endif
+#ifdef CONFIG_LVX_MUSIC_PLAYER_FLAC_SUPPORT
+    flac_decoder_s flac;
+    flac_info_s flac_info;
+#endif
+    read_ahead_s ra;
+    uint32_t decode_offset; /* file offset of the next read */
+
+    /* WAV samples not already 16-bit stereo are converted on the way in,
+     * wav.fmt then describes the converted PCM.
+     */
+    uint16_t file_bpf;       /* bytes per frame in the data chunk */
+    pcm_format_fn convert;   /* NULL when the file is read as is */
+    FAR uint8_t *cv_buf;     /* raw frames waiting for conversion */
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADPCM_SUPPORT
+    /* ADPCM is read a block at a time into cv_buf and expanded into
+     * blk_pcm, convert then takes it from there to 16-bit stereo.
+     */
+    adpcm_s adpcm;           /* block_frames is 0 for PCM data */
+    FAR int16_t *blk_pcm;
+    uint32_t blk_len;        /* frames expanded from the current block */
+    uint32_t blk_pos;        /* frames already handed out */
+#endif
+
+    /* Decoder timeline in frames from the first decoded sample. Only
+     * [out_from, end_frame) reaches the ring, which drops encoder delay and
+     * padding and lets a seek start on the exact target sample.
+     */
+    uint64_t start_frame;   /* first frame of the track itself */
+    uint64_t end_frame;     /* one past the last frame, 0 if unknown */
+    uint64_t decode_frame;  /* frame number of the next decoded sample */
+    uint64_t out_from;      /* earlier frames are dropped */
+    uint64_t total_frames;  /* playable length, 0 if unknown */
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_RESAMPLE
+    /* Conversion to the session rate. wav.fmt and total_frames describe
+     * the converted output, the frame counts above stay in decoder frames.
+     */
+    FAR pcm_resample_s *rs;  /* NULL when the decoder rate is used as is */
+    uint32_t in_rate;        /* decoder sample rate */
+    FAR uint8_t *rs_buf;     /* decoded PCM waiting to be converted */
+    size_t rs_len;
+    size_t rs_pos;
+    bool rs_eof;
+#endif
+} audio_source_s;
+
+/* Crossfade counters. Load is the time spent decoding both tracks and
+ * mixing, relative to the play time of the PCM produced.
+ */
+
+typedef struct audio_fade_stats {
+    uint32_t fades;          /* crossfades played to the end */
+    uint32_t shortened;      /* of those, hurried as the overlap was slow */
+    uint32_t aborted;        /* cut short by a seek or a switch */
+    uint32_t last_load_pct;  /* load of the most recent crossfade */
+    uint32_t peak_load_pct;  /* highest load of any crossfade */
+} audio_fade_stats_s;
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_WAV_MMAP
+/* Read-only mapping of a WAV data chunk, data is NULL when not mapped */
+
+typedef struct audio_map {
+    FAR uint8_t *base;        /* page aligned start of the mapping */
+    off_t offset;             /* file offset of base */
+    size_t len;
+    FAR const uint8_t *data;  /* first sample */
+    size_t size;              /* bytes of sample data */
+    size_t pos;               /* next byte handed out */
+} audio_map_s;
 #endif
 
 typedef struct audioctl {
     struct nxaudio_s nxaudio;
-    wav_s wav;
-    int fd;
+    FAR audio_source_s *src;     /* source the decoder thread reads */
+    FAR audio_source_s *next;    /* queued by audio_ctl_queue_next() */
+    FAR audio_source_s *retired; /* previous source, freed one switch later */
+    _Atomic(FAR audio_source_s *) attach; /* posted by audio_ctl_switch() */
+    pthread_mutex_t lock;        /* seek against source switch */
+    pthread_cond_t decode_cond;  /* under lock: wakes the decoder thread for
+                                  * a switch, seek or queued track, and the
+                                  * switch once its track is taken */
     int state;
     pthread_t pid;
-    int seek;
+    bool loop_running;           /* message loop thread exists */
+    bool session_open;           /* device configured, buffers allocated */
+    atomic_bool seek;         /* set last, after the fields below */
     uint32_t seek_position;
-    uint32_t file_position;
-    int audio_format;  /* AUDIO_FORMAT_WAV or AUDIO_FORMAT_MP3 */
-#ifdef CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT
-    mp3_decoder_s mp3;
+    uint64_t seek_landed;     /* decoder frame at seek_position */
+    uint64_t seek_target;     /* decoder frame playback resumes from */
+    uint64_t seek_bytes;      /* played_bytes once the seek is applied */
+    uint64_t played_bytes;    /* PCM of the current track handed to the device */
+    uint64_t total_frames;    /* length of the track being heard */
+
+    /* Track switch posted by the decoder thread, taken by app_dequeue_cb
+     * once the device reaches it.
+     */
+    uint32_t splice_pos;      /* ring byte count where the next track starts */
+    uint64_t splice_total;
+    atomic_bool splice_pending;
+    volatile uint32_t track_serial;
+
+    /* Decoder thread feeding app_dequeue_cb through a lock-free ring */
+    pcm_ring_s ring;
+    pthread_t decode_pid;
+    size_t decode_chunk;    /* ring space needed before decoding more */
+    bool decode_running;
+    volatile bool decode_quit;
+    atomic_bool decode_eof;
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_CROSSFADE
+    /* Outgoing track while the decoder thread mixes it into the start of
+     * ctl->src, see audio_ctl_fade_chunk().
+     */
+    FAR audio_source_s *fade_src;
+    FAR uint8_t *fade_buf;    /* incoming and outgoing chunk, side by side */
+    uint32_t fade_ms;         /* requested overlap, 0 disables */
+    uint32_t fade_pos;        /* position on the fade curve */
+    uint32_t fade_len;        /* frames in this crossfade */
+    uint32_t fade_mixed;      /* frames mixed so far */
+    uint32_t fade_chunks;
+    uint64_t fade_busy_us;    /* decode + mix time spent in this crossfade */
+    audio_fade_stats_s fade_stats;
+#endif
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_EQ
+    /* Applied by the decoder thread to everything it queues */
+    pcm_eq_s eq;
+#endif
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_WAV_MMAP
+    /* Mapped WAV data chunk, replaces the decoder thread when set */
+    audio_map_s map;
+#endif
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_TELEMETRY
+    /* Dequeue callback and decoder thread timing, underrun gaps */
+    audio_telemetry_s telemetry;
+#endif
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADAPTIVE_BUFFERS
+    /* Output queue level, driver buffers above it wait in out_idle. Only
+     * the dequeue callback touches the queue, limits outlive sessions.
+     */
+    audio_buffering_limits_s out_limits;
+    audio_buffering_s buffering;
+    FAR struct ap_buffer_s **out_idle;
+    uint32_t out_nidle;
+    uint32_t out_queued;      /* buffers the driver holds */
 #endif
 } audioctl_s;
 
+/* Pull-model decoding of one track for callers that drive their own
+ * output (the new architecture adapters). Same sources, read-ahead and
+ * mapped WAV path as the device session, but no device, ring or decoder
+ * thread: PCM is produced straight into the caller's buffer.
+ */
+
+typedef struct audio_stream {
+    FAR audio_source_s *src;
+    pthread_mutex_t lock;     /* read against seek */
+    uint64_t position;        /* frames handed out since the last seek */
+    bool eof;
+#ifdef CONFIG_LVX_MUSIC_PLAYER_WAV_MMAP
+    audio_map_s map;          /* data is NULL when decoding */
+#endif
+} audio_stream_s;
+
 FAR audioctl_s *audio_ctl_init_nxaudio(FAR const char *arg);
 int audio_ctl_start(FAR audioctl_s *ctl);
 int audio_ctl_pause(FAR audioctl_s *ctl);
 int audio_ctl_resume(FAR audioctl_s *ctl);
-int audio_ctl_seek(FAR audioctl_s *ctl, unsigned ms);
+int audio_ctl_seek(FAR audioctl_s *ctl, unsigned sec);
+int audio_ctl_seek_frame(FAR audioctl_s *ctl, uint64_t frame);
 int audio_ctl_stop(FAR audioctl_s *ctl);
 int audio_ctl_set_volume(FAR audioctl_s *ctl, uint16_t vol);
 int audio_ctl_get_position(FAR audioctl_s *ctl);
+uint64_t audio_ctl_get_frame_position(FAR audioctl_s *ctl);
+uint64_t audio_ctl_get_total_frames(FAR audioctl_s *ctl);
+uint32_t audio_ctl_get_duration_ms(FAR audioctl_s *ctl);
+int audio_ctl_switch(FAR audioctl_s *ctl, FAR const char *path);
+int audio_ctl_queue_next(FAR audioctl_s *ctl, FAR const char *path);
+uint32_t audio_ctl_get_track_serial(FAR audioctl_s *ctl);
+bool audio_ctl_is_finished(FAR audioctl_s *ctl);
+#ifdef CONFIG_LVX_MUSIC_PLAYER_CROSSFADE
+int audio_ctl_set_crossfade(FAR audioctl_s *ctl, uint32_t ms);
+int audio_ctl_get_fade_stats(FAR audioctl_s *ctl,
+                             FAR audio_fade_stats_s *stats);
+#endif
+#ifdef CONFIG_LVX_MUSIC_PLAYER_EQ
+int audio_ctl_set_eq(FAR audioctl_s *ctl, FAR const pcm_eq_band_s *bands,
+                     int nbands);
+int audio_ctl_get_eq(FAR audioctl_s *ctl, FAR pcm_eq_band_s *bands);
+#endif
 int audio_ctl_uninit_nxaudio(FAR audioctl_s *ctl);
+int audio_ctl_get_ring_stats(FAR audioctl_s *ctl, FAR pcm_ring_stats_s *stats);
+int audio_ctl_get_io_stats(FAR audioctl_s *ctl, FAR read_ahead_stats_s *stats);
+#ifdef CONFIG_LVX_MUSIC_PLAYER_TELEMETRY
+int audio_ctl_get_telemetry(FAR audioctl_s *ctl,
+                            FAR audio_telemetry_stats_s *stats);
+int audio_ctl_reset_telemetry(FAR audioctl_s *ctl);
+#endif
+#ifdef CONFIG_LVX_MUSIC_PLAYER_ADAPTIVE_BUFFERS
+int audio_ctl_set_buffering(FAR audioctl_s *ctl,
+                            FAR const audio_buffering_limits_s *limits);
+int audio_ctl_get_buffering(FAR audioctl_s *ctl,
+                            FAR audio_buffering_stats_s *stats);
+#endif
+
+/* Pull-model decoding */
+int audio_ctl_stream_open(FAR const char *path, FAR audio_stream_s **streamp);
+ssize_t audio_ctl_stream_read(FAR audio_stream_s *stream, FAR uint8_t *buf,
+                              size_t len);
+int audio_ctl_stream_seek(FAR audio_stream_s *stream, uint64_t frame);
+uint64_t audio_ctl_stream_get_position(FAR audio_stream_s *stream);
+uint64_t audio_ctl_stream_get_total_frames(FAR audio_stream_s *stream);
+FAR const fmt_s *audio_ctl_stream_get_fmt(FAR audio_stream_s *stream);
+void audio_ctl_stream_close(FAR audio_stream_s *stream);
 
 /* Audio format detection */
 int audio_ctl_detect_format(FAR const char *filename);
-
-#ifdef CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT
-/* MP3 specific functions */
-int mp3_decoder_init(FAR mp3_decoder_s *decoder);
-int mp3_decoder_decode(FAR mp3_decoder_s *decoder, FAR const unsigned char *input, 
-                       size_t input_size, FAR unsigned char *output, FAR size_t *output_size);
-void mp3_decoder_cleanup(FAR mp3_decoder_s *decoder);
-#endif
+int audio_ctl_parse_wav(int fd, FAR wav_s *wav);
+int audio_ctl_probe(FAR const char *path, int fd, FAR audio_probe_s *probe);
 
 #ifdef __cplusplus
 } /*extern "C"*/
@@ -0,0 +1,570 @@
+/**
+ * @file audio_probe.c
+ * Content based format detection with cached results
+ *
+ * The start of a file is read once into a window and matched against the
+ * container magics: RIFF/WAVE, fLaC, OggS, an ID3v2 tag or a bare MPEG
+ * frame sync. The header of the format found is parsed from the same
+ * window, only a tag or chunk reaching past it costs another read. The
+ * result, with the full RIFF layout for WAV, is kept in a small table keyed
+ * by path, size and mtime, so reopening a track (repeat, previous, gapless
+ * preload) does no header I/O at all.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "audio_ctl.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define AUDIO_PROBE_WINDOW 4096
+
+/* How far past a tag a sync word is looked for, and how many frames in a
+ * row must follow before a bare stream counts as MPEG audio.
+ */
+
+#define AUDIO_PROBE_SYNC_RANGE  4096
+#define AUDIO_PROBE_SYNC_FRAMES 3
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_PROBE_CACHE
+#define CONFIG_LVX_MUSIC_PLAYER_PROBE_CACHE 16
+#endif
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* File bytes [base, base + len), moved by audio_probe_peek() */
+
+typedef struct audio_probe_window {
+    int fd;
+    off_t size;
+    off_t base;
+    size_t len;
+    uint8_t buf[AUDIO_PROBE_WINDOW];
+} audio_probe_window_s;
+
+#if CONFIG_LVX_MUSIC_PLAYER_PROBE_CACHE > 0
+typedef struct audio_probe_entry {
+    uint64_t key;          /* FNV-1a of the path */
+    uint64_t file_size;
+    int64_t file_mtime;
+    uint32_t stamp;        /* last use, 0 for a free slot */
+    audio_probe_s probe;
+} audio_probe_entry_s;
+#endif
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static FAR const uint8_t *audio_probe_peek(FAR audio_probe_window_s *w,
+                                           off_t offset, size_t len);
+static int audio_probe_riff(FAR audio_probe_window_s *w, FAR wav_s *wav);
+static off_t audio_probe_id3(FAR audio_probe_window_s *w, off_t offset);
+static bool audio_probe_flac(FAR audio_probe_window_s *w, off_t offset,
+                             FAR audio_probe_s *probe);
+static bool audio_probe_ogg(FAR audio_probe_window_s *w,
+                            FAR audio_probe_s *probe);
+static bool audio_probe_mpeg(FAR audio_probe_window_s *w, off_t offset,
+                             off_t range, FAR audio_probe_s *probe);
+static int audio_probe_scan(int fd, FAR audio_probe_s *probe);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+#if CONFIG_LVX_MUSIC_PLAYER_PROBE_CACHE > 0
+static audio_probe_entry_s
+g_audio_probe_cache[CONFIG_LVX_MUSIC_PLAYER_PROBE_CACHE];
+static uint32_t g_audio_probe_clock;
+static pthread_mutex_t g_audio_probe_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static uint16_t wav_le16(FAR const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t wav_le32(FAR const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * @brief Bytes [offset, offset + len) of the file
+ * @return Pointer into the window, NULL past the end of the file
+ *
+ * The window is refilled from offset when the range is not inside it.
+ */
+static FAR const uint8_t *audio_probe_peek(FAR audio_probe_window_s *w,
+                                           off_t offset, size_t len)
+{
+    ssize_t n;
+
+    if (len > sizeof(w->buf) || offset < 0 ||
+        offset + (off_t)len > w->size) {
+        return NULL;
+    }
+
+    if (offset < w->base ||
+        offset + (off_t)len > w->base + (off_t)w->len) {
+        n = pread(w->fd, w->buf, sizeof(w->buf), offset);
+        if (n < (ssize_t)len) {
+            w->len = 0;
+            return NULL;
+        }
+
+        w->base = offset;
+        w->len = n;
+    }
+
+    return w->buf + (offset - w->base);
+}
+
+/**
+ * @brief Walk the RIFF chunks up to the sample data
+ * @return 0 with wav filled, -EINVAL if the file is not a usable WAV
+ *
+ * Unknown chunks (LIST, bext, ...) are skipped. For
+ * WAVE_FORMAT_EXTENSIBLE the sub-format GUID tag replaces audioformat so
+ * callers only ever see the real coding.
+ */
+static int audio_probe_riff(FAR audio_probe_window_s *w, FAR wav_s *wav)
+{
+    FAR const uint8_t *p;
+    off_t offset;
+    bool have_fmt = false;
+
+    memset(wav, 0, sizeof(wav_s));
+
+    p = audio_probe_peek(w, 0, 12);
+    if (p == NULL || memcmp(p, "RIFF", 4) != 0 ||
+        memcmp(p + 8, "WAVE", 4) != 0) {
+        return -EINVAL;
+    }
+
+    memcpy(wav->riff.chunkID, p, 4);
+    wav->riff.chunksize = wav_le32(p + 4);
+    memcpy(wav->riff.format, p + 8, 4);
+    offset = 12;
+
+    while (offset + 8 <= w->size)
+    {
+        uint32_t size;
+
+        p = audio_probe_peek(w, offset, 8);
+        if (p == NULL) {
+            return -EINVAL;
+        }
+
+        size = wav_le32(p + 4);
+        offset += 8;
+
+        if (memcmp(p, "fmt ", 4) == 0) {
+            /* Up to the end of the WAVE_FORMAT_EXTENSIBLE fields */
+
+            uint32_t len = size < 40 ? size : 40;
+
+            p = len < 16 ? NULL : audio_probe_peek(w, offset, len);
+            if (p == NULL) {
+                return -EINVAL;
+            }
+
+            memcpy(wav->fmt.subchunk1ID, "fmt ", 4);
+            wav->fmt.subchunk1size = size;
+            wav->fmt.audioformat = wav_le16(p);
+            wav->fmt.numchannels = wav_le16(p + 2);
+            wav->fmt.samplerate = wav_le32(p + 4);
+            wav->fmt.byterate = wav_le32(p + 8);
+            wav->fmt.blockalign = wav_le16(p + 12);
+            wav->fmt.bitspersample = wav_le16(p + 14);
+
+            if (wav->fmt.audioformat == WAVE_FORMAT_EXTENSIBLE && len >= 40) {
+                /* First two bytes of the SubFormat GUID are the format tag */
+
+                wav->fmt.audioformat = wav_le16(p + 24);
+            }
+
+            if ((wav->fmt.audioformat == WAVE_FORMAT_ADPCM ||
+                 wav->fmt.audioformat == WAVE_FORMAT_IMA_ADPCM) &&
+                len >= 20) {
+                /* cbSize, then wSamplesPerBlock */
+
+                wav->samples_per_block = wav_le16(p + 18);
+            }
+
+            have_fmt = true;
+        } else if (memcmp(p, "fact", 4) == 0 && size >= 4) {
+            /* Length in frames of compressed data, drops the block padding */
+
+            p = audio_probe_peek(w, offset, 4);
+            if (p == NULL) {
+                return -EINVAL;
+            }
+
+            wav->fact_frames = wav_le32(p);
+        } else if (memcmp(p, "data", 4) == 0) {
+            if (!have_fmt || wav->fmt.blockalign == 0 ||
+                wav->fmt.samplerate == 0) {
+                return -EINVAL;
+            }
+
+            memcpy(wav->data.subchunk2ID, "data", 4);
+            wav->data.subchunk2size = size;
+            wav->data_offset = offset;
+
+            /* Streamed writers leave 0 or ~0 here, trust the file size */
+
+            wav->data_size = size;
+            if (size == 0 || size > w->size - offset) {
+                wav->data_size = w->size - offset;
+            }
+
+            /* The last ADPCM block may be short, PCM ends on a frame */
+
+            if (wav->fmt.audioformat != WAVE_FORMAT_ADPCM &&
+                wav->fmt.audioformat != WAVE_FORMAT_IMA_ADPCM) {
+                wav->data_size -= wav->data_size % wav->fmt.blockalign;
+            }
+
+            return 0;
+        }
+
+        /* Chunks are word aligned */
+
+        offset += size + (size & 1);
+    }
+
+    return -EINVAL;
+}
+
+/* End of an ID3v2 tag at offset (syncsafe size, optional footer), offset
+ * itself when there is none.
+ */
+
+static off_t audio_probe_id3(FAR audio_probe_window_s *w, off_t offset)
+{
+    FAR const uint8_t *p = audio_probe_peek(w, offset, 10);
+
+    if (p == NULL || memcmp(p, "ID3", 3) != 0) {
+        return offset;
+    }
+
+    offset += 10 + ((p[6] & 0x7f) << 21) + ((p[7] & 0x7f) << 14) +
+              ((p[8] & 0x7f) << 7) + (p[9] & 0x7f);
+    if (p[5] & 0x10) {
+        offset += 10;
+    }
+
+    return offset;
+}
+
+/* "fLaC", the STREAMINFO block and the metadata blocks up to the frames */
+
+static bool audio_probe_flac(FAR audio_probe_window_s *w, off_t offset,
+                             FAR audio_probe_s *probe)
+{
+    FAR const uint8_t *p = audio_probe_peek(w, offset, 4 + 4 + 34);
+    FAR const uint8_t *si;
+
+    if (p == NULL || memcmp(p, "fLaC", 4) != 0 || (p[4] & 0x7f) != 0) {
+        return false;
+    }
+
+    si = p + 8;
+    probe->format = AUDIO_FORMAT_FLAC;
+    probe->sample_rate = (si[10] << 12) | (si[11] << 4) | (si[12] >> 4);
+    probe->channels = ((si[12] >> 1) & 7) + 1;
+    probe->bits_per_sample = (((si[12] & 1) << 4) | (si[13] >> 4)) + 1;
+
+    for (offset += 4; ; ) {
+        p = audio_probe_peek(w, offset, 4);
+        if (p == NULL) {
+            break;
+        }
+
+        offset += 4 + ((p[1] << 16) | (p[2] << 8) | p[3]);
+        if (p[0] & 0x80) {
+            probe->data_offset = offset;
+            break;
+        }
+    }
+
+    return true;
+}
+
+/* Ogg page carrying a Vorbis or Opus identification header. Anything else
+ * in an Ogg container is still reported as Ogg, without stream details.
+ */
+
+static bool audio_probe_ogg(FAR audio_probe_window_s *w,
+                            FAR audio_probe_s *probe)
+{
+    FAR const uint8_t *p = audio_probe_peek(w, 0, 27);
+    FAR const uint8_t *pkt;
+    off_t start;
+
+    if (p == NULL || memcmp(p, "OggS", 4) != 0) {
+        return false;
+    }
+
+    probe->format = AUDIO_FORMAT_OGG;
+
+    start = 27 + p[26];
+    pkt = audio_probe_peek(w, start, 19);
+    if (pkt == NULL) {
+        return true;
+    }
+
+    if (memcmp(pkt, "\x01vorbis", 7) == 0) {
+        probe->channels = pkt[11];
+        probe->sample_rate = wav_le32(pkt + 12);
+    } else if (memcmp(pkt, "OpusHead", 8) == 0) {
+        /* Opus always decodes at 48 kHz whatever the source rate was */
+
+        probe->channels = pkt[9];
+        probe->sample_rate = 48000;
+    }
+
+    return true;
+}
+
+/* A run of AUDIO_PROBE_SYNC_FRAMES MPEG frame headers, each at the end of
+ * the previous frame, starting in [offset, offset + range]. A run cut by
+ * the end of the file counts as well.
+ */
+
+static bool audio_probe_mpeg(FAR audio_probe_window_s *w, off_t offset,
+                             off_t range, FAR audio_probe_s *probe)
+{
+    mp3_frame_info_s first;
+    mp3_frame_info_s info;
+    FAR const uint8_t *p;
+    off_t end = offset + range;
+    off_t pos;
+    int n;
+
+    for (; offset <= end; offset++) {
+        p = audio_probe_peek(w, offset, 4);
+        if (p == NULL) {
+            return false;
+        }
+
+        if (p[0] != 0xff || !mp3_index_parse_header(p, &first) ||
+            first.length < 4) {
+            continue;
+        }
+
+        pos = offset + first.length;
+        for (n = 1; n < AUDIO_PROBE_SYNC_FRAMES; n++) {
+            p = audio_probe_peek(w, pos, 4);
+            if (p == NULL) {
+                n = pos >= w->size ? AUDIO_PROBE_SYNC_FRAMES : n;
+                break;
+            }
+
+            if (!mp3_index_parse_header(p, &info) || info.length < 4 ||
+                info.sample_rate != first.sample_rate ||
+                info.layer != first.layer) {
+                break;
+            }
+
+            pos += info.length;
+        }
+
+        if (n >= AUDIO_PROBE_SYNC_FRAMES) {
+            probe->format = AUDIO_FORMAT_MP3;
+            probe->sample_rate = first.sample_rate;
+            probe->channels = first.channels;
+            probe->bits_per_sample = 16;
+            probe->data_offset = offset;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Identify the open file from its content */
+
+static int audio_probe_scan(int fd, FAR audio_probe_s *probe)
+{
+    FAR audio_probe_window_s *w;
+    struct stat st;
+    off_t tag;
+
+    if (fstat(fd, &st) < 0) {
+        return -errno;
+    }
+
+    w = (FAR audio_probe_window_s *)malloc(sizeof(audio_probe_window_s));
+    if (w == NULL) {
+        return -ENOMEM;
+    }
+
+    w->fd = fd;
+    w->size = st.st_size;
+    w->base = 0;
+    w->len = 0;
+
+    memset(probe, 0, sizeof(audio_probe_s));
+    probe->format = AUDIO_FORMAT_UNKNOWN;
+
+    if (audio_probe_riff(w, &probe->wav) == 0) {
+        probe->format = AUDIO_FORMAT_WAV;
+        probe->sample_rate = probe->wav.fmt.samplerate;
+        probe->channels = probe->wav.fmt.numchannels;
+        probe->bits_per_sample = probe->wav.fmt.bitspersample;
+        probe->data_offset = probe->wav.data_offset;
+    } else if (!audio_probe_ogg(w, probe)) {
+        memset(&probe->wav, 0, sizeof(wav_s));
+
+        /* Both MP3 and FLAC files may start with an ID3v2 tag. A bare
+         * MPEG stream must sync right at the start.
+         */
+
+        tag = audio_probe_id3(w, 0);
+        if (!audio_probe_flac(w, tag, probe)) {
+            audio_probe_mpeg(w, tag, tag > 0 ? AUDIO_PROBE_SYNC_RANGE : 0,
+                             probe);
+        }
+    }
+
+    free(w);
+    return 0;
+}
+
+#if CONFIG_LVX_MUSIC_PLAYER_PROBE_CACHE > 0
+static uint64_t audio_probe_key(FAR const char *path)
+{
+    uint64_t hash = 14695981039346656037ull;
+
+    while (*path != '\0') {
+        hash = (hash ^ (uint8_t)*path++) * 1099511628211ull;
+    }
+
+    return hash;
+}
+#endif
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+/**
+ * @brief Identify an audio file from its content
+ * @param path Track path, the cache key together with size and mtime
+ * @param fd The track, open; only read with pread()
+ * @param probe Receives the format and, when the header has them, rate,
+ *        channels and where the audio data starts
+ * @return 0 on success, also when the format is AUDIO_FORMAT_UNKNOWN,
+ *         negated errno on I/O errors
+ */
+int audio_ctl_probe(FAR const char *path, int fd, FAR audio_probe_s *probe)
+{
+#if CONFIG_LVX_MUSIC_PLAYER_PROBE_CACHE > 0
+    FAR audio_probe_entry_s *slot;
+    struct stat st;
+    uint64_t key;
+    int ret;
+    int i;
+
+    if (fstat(fd, &st) < 0) {
+        return -errno;
+    }
+
+    key = audio_probe_key(path);
+
+    pthread_mutex_lock(&g_audio_probe_lock);
+
+    slot = &g_audio_probe_cache[0];
+    for (i = 0; i < CONFIG_LVX_MUSIC_PLAYER_PROBE_CACHE; i++) {
+        FAR audio_probe_entry_s *e = &g_audio_probe_cache[i];
+
+        if (e->stamp != 0 && e->key == key &&
+            e->file_size == (uint64_t)st.st_size &&
+            e->file_mtime == (int64_t)st.st_mtime) {
+            e->stamp = ++g_audio_probe_clock;
+            *probe = e->probe;
+            pthread_mutex_unlock(&g_audio_probe_lock);
+            return 0;
+        }
+
+        if (e->stamp < slot->stamp) {
+            slot = e;
+        }
+    }
+
+    pthread_mutex_unlock(&g_audio_probe_lock);
+
+    /* Probe unlocked, another open may fill the same slot meanwhile */
+
+    ret = audio_probe_scan(fd, probe);
+    if (ret < 0) {
+        return ret;
+    }
+
+    pthread_mutex_lock(&g_audio_probe_lock);
+    slot->key = key;
+    slot->file_size = st.st_size;
+    slot->file_mtime = st.st_mtime;
+    slot->stamp = ++g_audio_probe_clock;
+    slot->probe = *probe;
+    pthread_mutex_unlock(&g_audio_probe_lock);
+
+    return 0;
+#else
+    return audio_probe_scan(fd, probe);
+#endif
+}
+
+/**
+ * @brief Walk the RIFF chunks of a WAV file
+ * @param fd File positioned at offset 0
+ * @param wav Filled with the fmt chunk and the location of the data chunk
+ * @return 0 with fd positioned at the first sample, negated errno on error
+ */
+int audio_ctl_parse_wav(int fd, FAR wav_s *wav)
+{
+    FAR audio_probe_window_s *w;
+    struct stat st;
+    int ret;
+
+    if (fstat(fd, &st) < 0) {
+        return -errno;
+    }
+
+    w = (FAR audio_probe_window_s *)malloc(sizeof(audio_probe_window_s));
+    if (w == NULL) {
+        return -ENOMEM;
+    }
+
+    w->fd = fd;
+    w->size = st.st_size;
+    w->base = 0;
+    w->len = 0;
+
+    ret = audio_probe_riff(w, wav);
+    free(w);
+
+    if (ret == 0 && lseek(fd, wav->data_offset, SEEK_SET) < 0) {
+        ret = -errno;
+    }
+
+    return ret;
+}
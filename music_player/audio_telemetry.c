@@ -0,0 +1,368 @@
+/**
+ * @file audio_telemetry.c
+ * Lock-free latency histograms and underrun counters for the audio path
+ *
+ * Every counter has a single writer, so recording is a relaxed load and
+ * store per field with no read-modify-write and no lock; the dequeue
+ * callback never waits on a reader. Readers summarize the histograms while
+ * playback goes on. Resets are requests the writer applies on its next
+ * record, a reader never stores into a writer's counters.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "audio_telemetry.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <time.h>
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static uint32_t audio_hist_index(uint32_t value);
+static uint32_t audio_hist_upper(uint32_t index);
+static void audio_counter_add(FAR atomic_uint *counter, uint32_t value);
+static void audio_telemetry_apply_output_reset(FAR audio_telemetry_s *tm);
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static uint32_t audio_hist_index(uint32_t value)
+{
+    uint32_t exp;
+
+    if (value >= (1u << AUDIO_HIST_MAX_BITS)) {
+        return AUDIO_HIST_BUCKETS - 1;
+    }
+
+    if (value < AUDIO_HIST_SUB) {
+        return value;
+    }
+
+    exp = 31 - __builtin_clz(value);
+    return (exp - AUDIO_HIST_SUB_BITS + 1) * AUDIO_HIST_SUB +
+           ((value >> (exp - AUDIO_HIST_SUB_BITS)) & (AUDIO_HIST_SUB - 1));
+}
+
+/* Highest value that lands in bucket index */
+
+static uint32_t audio_hist_upper(uint32_t index)
+{
+    uint32_t exp;
+    uint32_t sub;
+
+    if (index < AUDIO_HIST_SUB) {
+        return index;
+    }
+
+    exp = index / AUDIO_HIST_SUB + AUDIO_HIST_SUB_BITS - 1;
+    sub = index % AUDIO_HIST_SUB;
+
+    return ((AUDIO_HIST_SUB + sub + 1) << (exp - AUDIO_HIST_SUB_BITS)) - 1;
+}
+
+/* Single writer increment, readers see either the old or the new value */
+
+static void audio_counter_add(FAR atomic_uint *counter, uint32_t value)
+{
+    atomic_store_explicit(counter,
+        atomic_load_explicit(counter, memory_order_relaxed) + value,
+        memory_order_relaxed);
+}
+
+static void audio_telemetry_apply_output_reset(FAR audio_telemetry_s *tm)
+{
+    if (!atomic_exchange_explicit(&tm->output_reset, false,
+                                  memory_order_acquire)) {
+        return;
+    }
+
+    audio_hist_reset(&tm->dequeue_us);
+    audio_hist_reset(&tm->headroom_us);
+    audio_hist_reset(&tm->depth);
+    audio_hist_reset(&tm->gap_us);
+    atomic_store_explicit(&tm->underruns, 0, memory_order_relaxed);
+    atomic_store_explicit(&tm->gaps, 0, memory_order_relaxed);
+    atomic_store_explicit(&tm->gap_open_us, 0, memory_order_relaxed);
+}
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+/**
+ * @brief Monotonic time in microseconds, wraps after about 71 minutes
+ *
+ * Only differences are used, unsigned subtraction handles the wrap.
+ */
+uint32_t audio_telemetry_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+/**
+ * @brief Clear a histogram, writer side only
+ */
+void audio_hist_reset(FAR audio_hist_s *hist)
+{
+    int i;
+
+    for (i = 0; i < AUDIO_HIST_BUCKETS; i++)
+    {
+        atomic_store_explicit(&hist->counts[i], 0, memory_order_relaxed);
+    }
+
+    atomic_store_explicit(&hist->total, 0, memory_order_relaxed);
+    atomic_store_explicit(&hist->min, UINT32_MAX, memory_order_relaxed);
+    atomic_store_explicit(&hist->max, 0, memory_order_relaxed);
+}
+
+/**
+ * @brief Count one value, writer side only
+ */
+void audio_hist_record(FAR audio_hist_s *hist, uint32_t value)
+{
+    audio_counter_add(&hist->counts[audio_hist_index(value)], 1);
+    audio_counter_add(&hist->total, 1);
+
+    if (value < atomic_load_explicit(&hist->min, memory_order_relaxed)) {
+        atomic_store_explicit(&hist->min, value, memory_order_relaxed);
+    }
+
+    if (value > atomic_load_explicit(&hist->max, memory_order_relaxed)) {
+        atomic_store_explicit(&hist->max, value, memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Value below which permille/1000 of the recorded values lie
+ * @return Upper end of the bucket holding that rank, at most max; 0 for an
+ *         empty histogram
+ */
+uint32_t audio_hist_percentile(FAR audio_hist_s *hist, uint32_t permille)
+{
+    uint32_t total = atomic_load_explicit(&hist->total, memory_order_relaxed);
+    uint32_t max = atomic_load_explicit(&hist->max, memory_order_relaxed);
+    uint64_t rank;
+    uint64_t seen = 0;
+    uint32_t value;
+    int i;
+
+    if (total == 0) {
+        return 0;
+    }
+
+    rank = ((uint64_t)total * permille + 999) / 1000;
+    if (rank == 0) {
+        rank = 1;
+    }
+
+    for (i = 0; i < AUDIO_HIST_BUCKETS; i++)
+    {
+        seen += atomic_load_explicit(&hist->counts[i], memory_order_relaxed);
+        if (seen >= rank) {
+            value = audio_hist_upper(i);
+            return value < max ? value : max;
+        }
+    }
+
+    return max;
+}
+
+void audio_hist_summarize(FAR audio_hist_s *hist,
+                          FAR audio_hist_summary_s *summary)
+{
+    summary->count = atomic_load_explicit(&hist->total, memory_order_relaxed);
+    summary->min = summary->count == 0 ? 0 :
+                   atomic_load_explicit(&hist->min, memory_order_relaxed);
+    summary->p50 = audio_hist_percentile(hist, 500);
+    summary->p90 = audio_hist_percentile(hist, 900);
+    summary->p99 = audio_hist_percentile(hist, 990);
+    summary->p999 = audio_hist_percentile(hist, 999);
+    summary->max = atomic_load_explicit(&hist->max, memory_order_relaxed);
+}
+
+/**
+ * @brief Start from empty counters, before any writer runs
+ */
+void audio_telemetry_init(FAR audio_telemetry_s *tm)
+{
+    audio_hist_reset(&tm->dequeue_us);
+    audio_hist_reset(&tm->headroom_us);
+    audio_hist_reset(&tm->depth);
+    audio_hist_reset(&tm->gap_us);
+    audio_hist_reset(&tm->decode_us);
+    audio_hist_reset(&tm->decode_ns);
+    atomic_store(&tm->underruns, 0);
+    atomic_store(&tm->gaps, 0);
+    atomic_store(&tm->output_reset, false);
+    atomic_store(&tm->decode_reset, false);
+
+    audio_telemetry_session(tm);
+}
+
+/**
+ * @brief Ask both writers to clear their counters, any thread
+ *
+ * Takes effect on the next dequeue and the next decode pass.
+ */
+void audio_telemetry_reset(FAR audio_telemetry_s *tm)
+{
+    atomic_store_explicit(&tm->output_reset, true, memory_order_release);
+    atomic_store_explicit(&tm->decode_reset, true, memory_order_release);
+}
+
+/**
+ * @brief A new output session starts with no buffers in the driver
+ *
+ * Called while the dequeue callback cannot run.
+ */
+void audio_telemetry_session(FAR audio_telemetry_s *tm)
+{
+    atomic_store(&tm->enqueued, 0);
+    atomic_store(&tm->dequeued, 0);
+    atomic_store(&tm->gap_open_us, 0);
+}
+
+/**
+ * @brief Entry of the dequeue callback
+ * @param from_driver Whether the driver returned the buffer, false while
+ *        the session primes its buffers
+ * @param headroom_us PCM ready to be copied out, AUDIO_TELEMETRY_NONE when
+ *        the buffer is not served from the ring
+ */
+void audio_telemetry_output_begin(FAR audio_telemetry_s *tm,
+                                  bool from_driver, uint32_t headroom_us)
+{
+    audio_telemetry_apply_output_reset(tm);
+
+    if (from_driver) {
+        audio_counter_add(&tm->dequeued, 1);
+    }
+
+    if (headroom_us != AUDIO_TELEMETRY_NONE) {
+        audio_hist_record(&tm->headroom_us, headroom_us);
+    }
+}
+
+/**
+ * @brief Exit of the dequeue callback
+ * @param start audio_telemetry_now_us() at the entry
+ * @param enqueued Whether the buffer went back to the driver
+ * @param silence_us Padding that had to replace missing PCM, 0 if none
+ *
+ * Consecutive padded buffers form one gap, its length is recorded when
+ * real audio comes back.
+ */
+void audio_telemetry_output_end(FAR audio_telemetry_s *tm, uint32_t start,
+                                bool enqueued, uint32_t silence_us)
+{
+    uint32_t gap = atomic_load_explicit(&tm->gap_open_us,
+                                        memory_order_relaxed);
+
+    if (enqueued) {
+        audio_counter_add(&tm->enqueued, 1);
+        audio_hist_record(&tm->depth,
+            atomic_load_explicit(&tm->enqueued, memory_order_relaxed) -
+            atomic_load_explicit(&tm->dequeued, memory_order_relaxed));
+    }
+
+    if (silence_us > 0) {
+        audio_counter_add(&tm->underruns, 1);
+        if (gap == 0) {
+            audio_counter_add(&tm->gaps, 1);
+        }
+
+        atomic_store_explicit(&tm->gap_open_us, gap + silence_us,
+                              memory_order_relaxed);
+    } else if (gap > 0) {
+        audio_hist_record(&tm->gap_us, gap);
+        atomic_store_explicit(&tm->gap_open_us, 0, memory_order_relaxed);
+    }
+
+    audio_hist_record(&tm->dequeue_us, audio_telemetry_now_us() - start);
+}
+
+/**
+ * @brief One decode pass of the decoder thread
+ * @param start audio_telemetry_now_us() before the pass
+ * @param frames PCM frames the pass produced
+ */
+void audio_telemetry_decode(FAR audio_telemetry_s *tm, uint32_t start,
+                            uint32_t frames)
+{
+    uint32_t elapsed = audio_telemetry_now_us() - start;
+
+    if (atomic_exchange_explicit(&tm->decode_reset, false,
+                                 memory_order_acquire)) {
+        audio_hist_reset(&tm->decode_us);
+        audio_hist_reset(&tm->decode_ns);
+    }
+
+    audio_hist_record(&tm->decode_us, elapsed);
+    if (frames > 0) {
+        audio_hist_record(&tm->decode_ns,
+                          (uint64_t)elapsed * 1000 / frames);
+    }
+}
+
+/**
+ * @brief Summarize all counters, any thread, playback keeps running
+ */
+void audio_telemetry_get_stats(FAR audio_telemetry_s *tm,
+                               FAR audio_telemetry_stats_s *stats)
+{
+    audio_hist_summarize(&tm->dequeue_us, &stats->dequeue_us);
+    audio_hist_summarize(&tm->headroom_us, &stats->headroom_us);
+    audio_hist_summarize(&tm->depth, &stats->depth);
+    audio_hist_summarize(&tm->gap_us, &stats->gap_us);
+    audio_hist_summarize(&tm->decode_us, &stats->decode_us);
+    audio_hist_summarize(&tm->decode_ns, &stats->decode_ns);
+    stats->underruns = atomic_load_explicit(&tm->underruns,
+                                            memory_order_relaxed);
+    stats->gaps = atomic_load_explicit(&tm->gaps, memory_order_relaxed);
+    stats->gap_open_us = atomic_load_explicit(&tm->gap_open_us,
+                                              memory_order_relaxed);
+}
+
+void audio_telemetry_print(FAR const audio_telemetry_stats_s *stats)
+{
+    static const struct {
+        FAR const char *name;
+        size_t offset;
+    } rows[] = {
+        { "dequeue us",  offsetof(audio_telemetry_stats_s, dequeue_us) },
+        { "headroom us", offsetof(audio_telemetry_stats_s, headroom_us) },
+        { "depth",       offsetof(audio_telemetry_stats_s, depth) },
+        { "gap us",      offsetof(audio_telemetry_stats_s, gap_us) },
+        { "decode us",   offsetof(audio_telemetry_stats_s, decode_us) },
+        { "decode ns/f", offsetof(audio_telemetry_stats_s, decode_ns) },
+    };
+
+    size_t i;
+
+    printf("%-12s %8s %8s %8s %8s %8s %8s %8s\n", "", "count", "min",
+           "p50", "p90", "p99", "p99.9", "max");
+
+    for (i = 0; i < sizeof(rows) / sizeof(rows[0]); i++)
+    {
+        FAR const audio_hist_summary_s *h = (FAR const audio_hist_summary_s *)
+            ((FAR const uint8_t *)stats + rows[i].offset);
+
+        printf("%-12s %8u %8u %8u %8u %8u %8u %8u\n", rows[i].name,
+               (unsigned)h->count, (unsigned)h->min, (unsigned)h->p50,
+               (unsigned)h->p90, (unsigned)h->p99, (unsigned)h->p999,
+               (unsigned)h->max);
+    }
+
+    printf("underruns %u in %u gaps, %u us of silence in progress\n",
+           (unsigned)stats->underruns, (unsigned)stats->gaps,
+           (unsigned)stats->gap_open_us);
+}
@@ -0,0 +1,137 @@
+/**
+ * @file audio_telemetry.h
+ * Lock-free latency histograms and underrun counters for the audio path
+ */
+
+#ifndef AUDIO_TELEMETRY_H
+#define AUDIO_TELEMETRY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <nuttx/config.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Log-linear buckets as in HdrHistogram: values below 2 * SUB are exact,
+ * every power of two above is split into SUB buckets, so a recorded value
+ * is known to within 1/SUB (12.5%). Values from 2^MAX_BITS on land in the
+ * last bucket, max still holds them exactly.
+ */
+
+#define AUDIO_HIST_SUB_BITS 3
+#define AUDIO_HIST_SUB      (1 << AUDIO_HIST_SUB_BITS)
+#define AUDIO_HIST_MAX_BITS 24
+#define AUDIO_HIST_BUCKETS  \
+    ((AUDIO_HIST_MAX_BITS - AUDIO_HIST_SUB_BITS + 1) * AUDIO_HIST_SUB)
+
+/* Headroom of a dequeue that does not read from the ring */
+
+#define AUDIO_TELEMETRY_NONE UINT32_MAX
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* Written by one thread only, read by any thread at any time. A reader
+ * may see a record half done (bucket counted, total not yet), which only
+ * shifts a percentile by one sample.
+ */
+
+typedef struct audio_hist {
+    atomic_uint counts[AUDIO_HIST_BUCKETS];
+    atomic_uint total;
+    atomic_uint min;
+    atomic_uint max;
+} audio_hist_s;
+
+typedef struct audio_hist_summary {
+    uint32_t count;
+    uint32_t min;
+    uint32_t p50;
+    uint32_t p90;
+    uint32_t p99;
+    uint32_t p999;
+    uint32_t max;
+} audio_hist_summary_s;
+
+/* Hot-path telemetry of one output session. The first group is written
+ * only by the nxaudio dequeue callback, the second only by the decoder
+ * thread; a reset is posted to each writer and applied by it.
+ */
+
+typedef struct audio_telemetry {
+    /* nxaudio dequeue callback */
+    audio_hist_s dequeue_us;    /* time spent in the callback */
+    audio_hist_s headroom_us;   /* PCM ready in the ring at each dequeue */
+    audio_hist_s depth;         /* buffers in the driver after an enqueue */
+    audio_hist_s gap_us;        /* silence of each underrun gap */
+    atomic_uint underruns;      /* buffers padded with silence */
+    atomic_uint gaps;           /* runs of padded buffers */
+    atomic_uint gap_open_us;    /* silence of the gap in progress */
+    atomic_uint enqueued;       /* buffers given to the driver */
+    atomic_uint dequeued;       /* buffers the driver gave back */
+    atomic_bool output_reset;
+
+    /* Decoder thread */
+    audio_hist_s decode_us;     /* time of each decode pass */
+    audio_hist_s decode_ns;     /* decode time per PCM frame produced */
+    atomic_bool decode_reset;
+} audio_telemetry_s;
+
+typedef struct audio_telemetry_stats {
+    audio_hist_summary_s dequeue_us;
+    audio_hist_summary_s headroom_us;
+    audio_hist_summary_s depth;
+    audio_hist_summary_s gap_us;
+    audio_hist_summary_s decode_us;
+    audio_hist_summary_s decode_ns;
+    uint32_t underruns;
+    uint32_t gaps;
+    uint32_t gap_open_us;
+} audio_telemetry_stats_s;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+uint32_t audio_telemetry_now_us(void);
+
+void audio_hist_reset(FAR audio_hist_s *hist);
+void audio_hist_record(FAR audio_hist_s *hist, uint32_t value);
+uint32_t audio_hist_percentile(FAR audio_hist_s *hist, uint32_t permille);
+void audio_hist_summarize(FAR audio_hist_s *hist,
+                          FAR audio_hist_summary_s *summary);
+
+void audio_telemetry_init(FAR audio_telemetry_s *tm);
+void audio_telemetry_reset(FAR audio_telemetry_s *tm);
+void audio_telemetry_session(FAR audio_telemetry_s *tm);
+
+/* Dequeue callback side */
+void audio_telemetry_output_begin(FAR audio_telemetry_s *tm,
+                                  bool from_driver, uint32_t headroom_us);
+void audio_telemetry_output_end(FAR audio_telemetry_s *tm, uint32_t start,
+                                bool enqueued, uint32_t silence_us);
+
+/* Decoder thread side */
+void audio_telemetry_decode(FAR audio_telemetry_s *tm, uint32_t start,
+                            uint32_t frames);
+
+void audio_telemetry_get_stats(FAR audio_telemetry_s *tm,
+                               FAR audio_telemetry_stats_s *stats);
+void audio_telemetry_print(FAR const audio_telemetry_stats_s *stats);
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /* AUDIO_TELEMETRY_H */
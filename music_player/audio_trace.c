@@ -0,0 +1,251 @@
+/**
+ * @file audio_trace.c
+ * Timestamped trace points from a UI interaction to the first audio
+ *
+ * One interaction is traced at a time. The UI thread begins it at the
+ * LVGL event; the UI, decoder and dequeue callback threads then mark the
+ * stages they reach. Each stage is taken once by clearing its bit in the
+ * armed mask, so a mark that is not wanted costs one atomic load. The
+ * interaction is folded into per-stage histograms by the UI thread when
+ * the next one begins, or on audio_trace_flush().
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "audio_trace.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define AUDIO_TRACE_BIT(stage)   (1u << (stage))
+#define AUDIO_TRACE_ALL          (AUDIO_TRACE_BIT(AUDIO_TRACE_STAGES) - 1)
+#define AUDIO_TRACE_AFTER_READY  (AUDIO_TRACE_BIT(AUDIO_TRACE_DEQUEUE) | \
+                                  AUDIO_TRACE_BIT(AUDIO_TRACE_ENQUEUE))
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct audio_trace {
+    /* Interaction in progress */
+    atomic_uint armed;                   /* stages still to record */
+    atomic_uint at[AUDIO_TRACE_STAGES];  /* us after the event + 1, 0 if not
+                                          * reached */
+    bool active;
+    int kind;
+    uint32_t t0;
+
+    /* Folded by the UI thread */
+    uint32_t interactions[AUDIO_TRACE_KINDS];
+    audio_hist_s stage[AUDIO_TRACE_KINDS][AUDIO_TRACE_STAGES];
+    audio_hist_s audio[AUDIO_TRACE_KINDS];
+} audio_trace_s;
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+static audio_trace_s g_trace;
+
+static FAR const char *const g_stage_names[AUDIO_TRACE_STAGES] = {
+    "event",
+    "play status",
+    "ctl open",
+    "track ready",
+    "dev start",
+    "1st dequeue",
+    "1st enqueue",
+};
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+/**
+ * @brief A UI interaction that should end in audio, UI thread only
+ * @param kind AUDIO_TRACE_PLAY or AUDIO_TRACE_SWITCH
+ */
+void audio_trace_begin(int kind)
+{
+    int i;
+
+    if (kind < 0 || kind >= AUDIO_TRACE_KINDS) {
+        return;
+    }
+
+    audio_trace_flush();
+
+    for (i = 0; i < AUDIO_TRACE_STAGES; i++)
+    {
+        atomic_store_explicit(&g_trace.at[i], 0, memory_order_relaxed);
+    }
+
+    g_trace.kind = kind;
+    g_trace.t0 = audio_telemetry_now_us();
+    g_trace.active = true;
+
+    atomic_store_explicit(&g_trace.armed,
+                          AUDIO_TRACE_ALL & ~AUDIO_TRACE_AFTER_READY,
+                          memory_order_release);
+
+    audio_trace_mark(AUDIO_TRACE_EVENT);
+}
+
+/**
+ * @brief Stage reached, any thread
+ *
+ * Only the first mark of a stage after audio_trace_begin() counts.
+ */
+void audio_trace_mark(int stage)
+{
+    uint32_t bit = AUDIO_TRACE_BIT(stage);
+
+    if ((atomic_load_explicit(&g_trace.armed, memory_order_relaxed) &
+         bit) == 0) {
+        return;
+    }
+
+    if ((atomic_fetch_and_explicit(&g_trace.armed, ~bit,
+                                   memory_order_acquire) & bit) == 0) {
+        return;
+    }
+
+    atomic_store_explicit(&g_trace.at[stage],
+                          audio_telemetry_now_us() - g_trace.t0 + 1,
+                          memory_order_relaxed);
+
+    /* From here on the device gets the new track */
+
+    if (stage == AUDIO_TRACE_READY) {
+        atomic_fetch_or_explicit(&g_trace.armed, AUDIO_TRACE_AFTER_READY,
+                                 memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Stop the interaction in progress and record it, UI thread only
+ */
+void audio_trace_flush(void)
+{
+    uint32_t audio = 0;
+    uint32_t at;
+    int i;
+
+    atomic_store_explicit(&g_trace.armed, 0, memory_order_relaxed);
+    if (!g_trace.active) {
+        return;
+    }
+
+    g_trace.active = false;
+    g_trace.interactions[g_trace.kind]++;
+
+    for (i = 0; i < AUDIO_TRACE_STAGES; i++)
+    {
+        at = atomic_load_explicit(&g_trace.at[i], memory_order_relaxed);
+        if (at == 0) {
+            continue;
+        }
+
+        audio_hist_record(&g_trace.stage[g_trace.kind][i], at - 1);
+
+        if ((i == AUDIO_TRACE_START || i == AUDIO_TRACE_ENQUEUE) &&
+            at > audio) {
+            audio = at;
+        }
+    }
+
+    if (audio > 0) {
+        audio_hist_record(&g_trace.audio[g_trace.kind], audio - 1);
+    }
+}
+
+/**
+ * @brief Drop the interaction in progress and all recorded ones
+ */
+void audio_trace_reset(void)
+{
+    int k;
+    int i;
+
+    atomic_store_explicit(&g_trace.armed, 0, memory_order_relaxed);
+    g_trace.active = false;
+
+    for (k = 0; k < AUDIO_TRACE_KINDS; k++)
+    {
+        g_trace.interactions[k] = 0;
+        audio_hist_reset(&g_trace.audio[k]);
+        for (i = 0; i < AUDIO_TRACE_STAGES; i++)
+        {
+            audio_hist_reset(&g_trace.stage[k][i]);
+        }
+    }
+}
+
+void audio_trace_get_stats(int kind, FAR audio_trace_stats_s *stats)
+{
+    int i;
+
+    if (kind < 0 || kind >= AUDIO_TRACE_KINDS) {
+        return;
+    }
+
+    stats->interactions = g_trace.interactions[kind];
+    for (i = 0; i < AUDIO_TRACE_STAGES; i++)
+    {
+        audio_hist_summarize(&g_trace.stage[kind][i], &stats->stage[i]);
+    }
+
+    audio_hist_summarize(&g_trace.audio[kind], &stats->audio);
+}
+
+FAR const char *audio_trace_stage_name(int stage)
+{
+    if (stage < 0 || stage >= AUDIO_TRACE_STAGES) {
+        return "?";
+    }
+
+    return g_stage_names[stage];
+}
+
+void audio_trace_print(void)
+{
+    static FAR const char *const kinds[AUDIO_TRACE_KINDS] = {
+        "play", "switch"
+    };
+
+    audio_trace_stats_s stats;
+    FAR const audio_hist_summary_s *h;
+    int k;
+    int i;
+
+    for (k = 0; k < AUDIO_TRACE_KINDS; k++)
+    {
+        audio_trace_get_stats(k, &stats);
+        if (stats.interactions == 0) {
+            continue;
+        }
+
+        printf("%s: %u interactions, us after the event\n", kinds[k],
+               (unsigned)stats.interactions);
+        printf("  %-12s %8s %8s %8s %8s\n", "", "count", "p50", "p99",
+               "max");
+
+        for (i = 0; i <= AUDIO_TRACE_STAGES; i++)
+        {
+            h = i < AUDIO_TRACE_STAGES ? &stats.stage[i] : &stats.audio;
+            if (h->count == 0) {
+                continue;
+            }
+
+            printf("  %-12s %8u %8u %8u %8u\n",
+                   i < AUDIO_TRACE_STAGES ? g_stage_names[i] : "first audio",
+                   (unsigned)h->count, (unsigned)h->p50, (unsigned)h->p99,
+                   (unsigned)h->max);
+        }
+    }
+}
@@ -0,0 +1,84 @@
+/**
+ * @file audio_trace.h
+ * Timestamped trace points from a UI interaction to the first audio
+ */
+
+#ifndef AUDIO_TRACE_H
+#define AUDIO_TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <nuttx/config.h>
+#include <stdint.h>
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_PLAY_TRACE
+#include "audio_telemetry.h"
+#endif
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Interactions, each traced on its own */
+
+#define AUDIO_TRACE_PLAY        0  /* tap on play_btn */
+#define AUDIO_TRACE_SWITCH      1  /* previous / next album */
+#define AUDIO_TRACE_KINDS       2
+
+/* Stages, in the order a cold start passes them. Each is recorded the
+ * first time it is reached after the event; DEQUEUE and ENQUEUE only count
+ * once READY has put the new track in place.
+ */
+
+#define AUDIO_TRACE_EVENT       0  /* LVGL event handler */
+#define AUDIO_TRACE_PLAY_STATUS 1  /* app_set_play_status(PLAY) */
+#define AUDIO_TRACE_OPEN        2  /* audio_ctl_init_nxaudio(), _switch() */
+#define AUDIO_TRACE_READY       3  /* new track opened, ring holds its PCM */
+#define AUDIO_TRACE_START       4  /* device started or resumed */
+#define AUDIO_TRACE_DEQUEUE     5  /* first app_dequeue_cb() */
+#define AUDIO_TRACE_ENQUEUE     6  /* first nxaudio_enqbuffer() of its PCM */
+#define AUDIO_TRACE_STAGES      7
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_PLAY_TRACE
+/* Microseconds from the event to each stage, and to the first audio:
+ * the later of START and ENQUEUE, or whichever of them happened.
+ */
+
+typedef struct audio_trace_stats {
+    uint32_t interactions;
+    audio_hist_summary_s stage[AUDIO_TRACE_STAGES];
+    audio_hist_summary_s audio;
+} audio_trace_stats_s;
+#endif
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_PLAY_TRACE
+void audio_trace_begin(int kind);
+void audio_trace_mark(int stage);
+void audio_trace_flush(void);
+void audio_trace_reset(void);
+void audio_trace_get_stats(int kind, FAR audio_trace_stats_s *stats);
+void audio_trace_print(void);
+FAR const char *audio_trace_stage_name(int stage);
+#else
+#define audio_trace_begin(kind)
+#define audio_trace_mark(stage)
+#endif
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /* AUDIO_TRACE_H */
@@ -0,0 +1,130 @@
+#!/bin/bash
+# 主机编译音频管线与基准测试（无需音频硬件）
+#
+# 用 host/nxaudio_host.c 模拟的输出设备替代 NuttX 的 nxaudio，
+# 在 Linux 上编译 audio_ctl 整条解码管线和基准测试程序。
+# 模拟设备由 NXAUDIO_HOST_* 环境变量配置，见 host/nxaudio_host.c。
+#
+# 用法: ./build_host.sh [test | bench [文件...]]
+#   test   编译后生成测试音频，以 4 倍速并注入抖动、欠载和停顿运行延迟测试
+#   bench  运行解码器基准测试，启用 MP3 时按 MP3_BUFFER_SIZES 中的每个
+#          缓冲区大小各编译一次，结果合并到 $OUT/decoder_bench.json
+set -e
+
+echo "🖥️ 主机编译Vela音乐播放器音频管线"
+echo "================================="
+
+cd "$(dirname "$0")"
+
+# 设置编译参数
+CC=${CC:-gcc}
+OUT=${OUT:-build/host}
+CFLAGS="-Wall -O2 -g -std=gnu11 -D_GNU_SOURCE ${EXTRA_CFLAGS}"
+INCLUDES="-Ihost/include -Ihost -I."
+LIBS="-lpthread -lm"
+
+# 定义源文件
+SOURCES="audio_ctl.c audio_probe.c audio_telemetry.c audio_buffering.c audio_trace.c adpcm.c flac_decoder.c mp3_index.c mp3_index_cache.c pcm_convert.c pcm_format.c pcm_mix.c pcm_resample.c pcm_eq.c pcm_ring.c read_ahead.c host/nxaudio_host.c"
+PROGRAMS="play_latency_bench pcm_convert_bench pcm_resample_bench pcm_eq_bench decoder_bench"
+
+# 检测到 libmad 时启用 MP3
+if echo '#include <mad.h>' | $CC -E - >/dev/null 2>&1; then
+    CFLAGS="$CFLAGS -DCONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT=1"
+    SOURCES="$SOURCES mp3_decoder.c"
+    LIBS="-lmad $LIBS"
+    echo "🎶 MP3: 已启用 (libmad)"
+else
+    echo "⚠️ MP3: 未找到 libmad，已禁用"
+fi
+
+echo "🔧 编译器: $CC"
+echo "📁 输出目录: $OUT"
+
+mkdir -p "$OUT/obj"
+
+# 编译公共源文件
+OBJECTS=""
+for src in $SOURCES; do
+    obj="$OUT/obj/$(basename "${src%.c}").o"
+    $CC $CFLAGS $INCLUDES -c "$src" -o "$obj"
+    OBJECTS="$OBJECTS $obj"
+done
+
+# 链接各个程序
+for prog in $PROGRAMS; do
+    $CC $CFLAGS $INCLUDES -o "$OUT/$prog" "$prog.c" $OBJECTS $LIBS
+    echo "✅ $OUT/$prog"
+done
+
+# 解码器基准测试: MP3 缓冲区大小是编译期配置，每个大小单独编译
+if [ "$1" = "bench" ]; then
+    shift
+    SIZES=${MP3_BUFFER_SIZES:-2048 4096 8192 16384}
+    case "$CFLAGS" in
+        *MP3_SUPPORT*) ;;
+        *) SIZES="default" ;;
+    esac
+
+    REPORTS=""
+    for size in $SIZES; do
+        dir="$OUT"
+        if [ "$size" != "default" ]; then
+            dir="$OUT/mp3_$size"
+            echo "📦 MP3_BUFFER_SIZE=$size"
+            OUT="$dir" EXTRA_CFLAGS="${EXTRA_CFLAGS} -DCONFIG_LVX_MUSIC_PLAYER_MP3_BUFFER_SIZE=$size" \
+                "./$(basename "$0")" >/dev/null
+        fi
+        "$dir/decoder_bench" -d "$OUT/corpus" -o "$dir/decoder_bench_$size.json" "$@"
+        REPORTS="$REPORTS $dir/decoder_bench_$size.json"
+    done
+
+    {
+        echo "["
+        sep=""
+        for report in $REPORTS; do
+            printf "%s" "$sep"
+            cat "$report"
+            sep=","
+        done
+        echo "]"
+    } > "$OUT/decoder_bench.json"
+    echo "📊 $OUT/decoder_bench.json"
+    exit 0
+fi
+
+if [ "$1" != "test" ]; then
+    echo ""
+    echo "🎉 编译完成！"
+    echo "🚀 运行方式: NXAUDIO_HOST_SPEED=4 $OUT/play_latency_bench track.wav ..."
+    exit 0
+fi
+
+# 生成两段 2 秒的测试音频
+TRACKS=""
+for hz in 440 660; do
+    wav="$OUT/tone_$hz.wav"
+    python3 - "$wav" "$hz" <<'EOF'
+import math, struct, sys, wave
+path, hz = sys.argv[1], int(sys.argv[2])
+with wave.open(path, "wb") as w:
+    w.setnchannels(2)
+    w.setsampwidth(2)
+    w.setframerate(44100)
+    frames = bytearray()
+    for i in range(2 * 44100):
+        s = int(8000 * math.sin(2 * math.pi * hz * i / 44100))
+        frames += struct.pack("<hh", s, s)
+    w.writeframes(bytes(frames))
+EOF
+    TRACKS="$TRACKS $wav"
+done
+
+echo "🧪 延迟测试: 4 倍速，抖动 2 ms，每 500 ms 欠载 30 ms，每 700 ms 停顿 10 ms"
+NXAUDIO_HOST_SPEED=${NXAUDIO_HOST_SPEED:-4} \
+NXAUDIO_HOST_JITTER_US=${NXAUDIO_HOST_JITTER_US:-2000} \
+NXAUDIO_HOST_UNDERRUN_MS=${NXAUDIO_HOST_UNDERRUN_MS:-30} \
+NXAUDIO_HOST_UNDERRUN_EVERY_MS=${NXAUDIO_HOST_UNDERRUN_EVERY_MS:-500} \
+NXAUDIO_HOST_STALL_MS=${NXAUDIO_HOST_STALL_MS:-10} \
+NXAUDIO_HOST_STALL_EVERY_MS=${NXAUDIO_HOST_STALL_EVERY_MS:-700} \
+NXAUDIO_HOST_VERBOSE=${NXAUDIO_HOST_VERBOSE:-1} \
+    "$OUT/play_latency_bench" -r 3 $TRACKS
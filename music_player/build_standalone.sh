@@ -12,7 +12,7 @@ INCLUDES="-I. -I/usr/include/lvgl -I/usr/local/include"
 LIBS="-llvgl -lmad -lpthread -lm"
 
 # 定义源文件
-SOURCES="music_player.c audio_ctl.c playlist_manager_optimized.c font_config.c splash_screen.c wifi.c"
+SOURCES="music_player.c audio_ctl.c audio_probe.c audio_telemetry.c audio_buffering.c adpcm.c mp3_decoder.c flac_decoder.c mp3_index.c mp3_index_cache.c pcm_convert.c pcm_format.c pcm_mix.c pcm_resample.c pcm_ring.c read_ahead.c playlist_manager_optimized.c font_config.c splash_screen.c wifi.c"
 MAIN_SOURCE="music_player_main.c"
 OUTPUT="music_player"
 
@@ -0,0 +1,1619 @@
+/**
+ * @file decoder_bench.c
+ * Decoder throughput and per-frame latency over a generated test corpus
+ *
+ * Usage: decoder_bench [-d dir] [-t seconds] [-r sizes] [-o json] [-n]
+ *                      [file...]
+ *
+ * Writes a fixed corpus into dir: a tone, a logarithmic sweep and white
+ * noise, each as 16-bit, 24-bit, float and 6-channel WAV, IMA ADPCM WAV
+ * and 16 and 24-bit FLAC, plus a 16-bit FLAC with one bit flipped in its
+ * second frame. Files given on the command line, MP3 for instance, are
+ * decoded as well; -n leaves the corpus out. Every file is decoded with
+ * audio_ctl_stream_read(), the audio_source_fill() path of the playback
+ * decoder thread that the adapters of adapters/audio_adapter.c wrap,
+ * reading one codec frame at a time and then each size of -r.
+ *
+ * The output of a corpus file is compared with its source regenerated
+ * sample by sample: exact for 16-bit PCM, FLAC and the IMA ADPCM
+ * encoder's own reconstruction, within one LSB where 24-bit or float is
+ * rounded and two where 5.1 is downmixed. The damaged frame has to be
+ * dropped whole, its CRC-16 failing, and the rest played unharmed.
+ *
+ * Every run reports input and output MB/s (10^6 bytes), the real-time
+ * factor, the time per read call and per PCM frame, the cost of the
+ * conversion kernel the path uses timed on its own over the same number
+ * of frames, and the peak heap of the stream. The compile-time buffer
+ * sizes are part of the JSON report; build_host.sh bench makes one build
+ * per MP3_BUFFER_SIZE.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <nuttx/config.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "audio_ctl.h"
+#include "audio_telemetry.h"
+#include "pcm_convert.h"
+#include "pcm_format.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define BENCH_DEFAULT_DIR     "/tmp/decoder_bench"
+#define BENCH_DEFAULT_JSON    "decoder_bench.json"
+#define BENCH_DEFAULT_SECONDS 5
+#define BENCH_DEFAULT_SIZES   "1024,4096,16384"
+
+#define BENCH_MAX_SIZES       8
+#define BENCH_MAX_FILES       32
+#define BENCH_PATH_MAX        128
+
+/* Frames audio_ctl converts per kernel call, and the block the corpus
+ * generator works in
+ */
+
+#define BENCH_BLOCK           1024
+
+#define BENCH_MP3_FRAME       1152
+#define BENCH_IMA_BLOCK       1024  /* bytes per channel */
+#define BENCH_FLAC_BLOCK      4096
+#define BENCH_FLAC_ORDER      8
+#define BENCH_FLAC_PRECISION  12
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+enum {
+    BENCH_SINE,
+    BENCH_SWEEP,
+    BENCH_NOISE,
+    BENCH_SIGNALS
+};
+
+enum {
+    BENCH_WAV,
+    BENCH_IMA,
+    BENCH_FLAC
+};
+
+typedef struct bench_coding {
+    FAR const char *name;
+    int container;               /* BENCH_WAV, _IMA or _FLAC */
+    uint32_t rate;
+    uint8_t channels;
+    uint8_t bits;
+    bool is_float;
+    bool corrupt;                /* FLAC frame 1 damaged, to be dropped */
+    uint8_t tolerance;           /* LSB of the 16-bit output */
+} bench_coding_s;
+
+/* Deterministic signal source, one block after the other */
+
+typedef struct bench_gen {
+    int signal;
+    uint32_t rate;
+    uint32_t frames;
+    int channels;
+    uint32_t pos;
+    uint32_t seed;
+} bench_gen_s;
+
+typedef struct bench_bits {
+    FAR uint8_t *buf;
+    size_t cap;
+    size_t len;
+    uint64_t acc;
+    int n;
+    bool overflow;
+} bench_bits_s;
+
+typedef struct bench_file {
+    char path[BENCH_PATH_MAX];
+    FAR const char *signal;
+    FAR const char *coding;
+    uint64_t frames;             /* expected, 0 when unknown */
+    FAR const bench_coding_s *source;  /* NULL for files given */
+    bench_gen_s gen;             /* the generator the file was written by */
+} bench_file_s;
+
+/* Regenerates the source of a corpus file as the 16-bit stereo the
+ * decoder has to produce, one block at a time
+ */
+
+typedef struct bench_ref {
+    bench_gen_s gen;
+    FAR const bench_coding_s *c;
+    FAR float *pcm;
+    FAR int16_t *out;
+    FAR int16_t *recon;          /* IMA ADPCM, the encoder's reconstruction */
+    FAR uint8_t *ima;
+    int index[8];
+    uint32_t block;
+    uint32_t len;
+    uint32_t pos;
+} bench_ref_s;
+
+/* What audio_ctl does to the decoder output of a file */
+
+typedef struct bench_kernel {
+    char name[32];
+    pcm_format_fn format;        /* WAV layouts, ADPCM, FLAC downmix */
+    bool q28;                    /* MP3, pcm_convert_q28_s16() */
+    bool is_float;
+    int container;
+    int channels;
+} bench_kernel_s;
+
+typedef struct bench_result {
+    FAR const char *adapter;
+    uint32_t codec_frame;        /* frames per codec frame */
+    size_t read_bytes;
+    bool per_codec_frame;
+    uint64_t input_bytes;
+    uint64_t output_bytes;
+    uint64_t frames;
+    uint32_t rate;
+    uint32_t calls;
+    int max_error;               /* against the source, -1 if unchecked */
+    uint64_t open_ns;
+    uint64_t decode_ns;
+    uint64_t kernel_ns;
+    size_t heap_open;
+    size_t heap_peak;
+    bench_kernel_s kernel;
+    audio_hist_s call_us;
+    audio_hist_s frame_ns;
+} bench_result_s;
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+static FAR const char *const g_signals[BENCH_SIGNALS] = {
+    "sine", "sweep", "noise"
+};
+
+static const bench_coding_s g_codings[] = {
+    { "wav_s16",      BENCH_WAV,  44100, 2, 16, false, false, 0 },
+    { "wav_s24",      BENCH_WAV,  48000, 2, 24, false, false, 1 },
+    { "wav_f32",      BENCH_WAV,  44100, 2, 32, true,  false, 1 },
+    { "wav_s16_6ch",  BENCH_WAV,  48000, 6, 16, false, false, 2 },
+    { "ima_adpcm",    BENCH_IMA,  44100, 2, 16, false, false, 0 },
+    { "flac_16",      BENCH_FLAC, 44100, 2, 16, false, false, 0 },
+    { "flac_24",      BENCH_FLAC, 48000, 2, 24, false, false, 1 },
+    { "flac_16_crc",  BENCH_FLAC, 44100, 2, 16, false, true,  0 },
+};
+
+static const int16_t g_ima_steps[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37,
+    41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173,
+    190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658,
+    724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484,
+    7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818,
+    18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int8_t g_ima_index[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static size_t bench_heap_used(void)
+{
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+    struct mallinfo2 info = mallinfo2();
+
+    return info.uordblks + info.hblkhd;
+#elif defined(__GLIBC__)
+    struct mallinfo info = mallinfo();
+
+    return info.uordblks + info.hblkhd;
+#else
+    struct mallinfo info = mallinfo();
+
+    return info.uordblks;
+#endif
+}
+
+static void bench_put_le(FAR uint8_t *p, uint32_t v, int bytes)
+{
+    while (bytes-- > 0)
+    {
+        *p++ = v;
+        v >>= 8;
+    }
+}
+
+/* Signals */
+
+static void bench_gen_block(FAR bench_gen_s *g, FAR float *out, uint32_t n)
+{
+    double k = log(20000.0 / 20.0);
+    double span = (double)g->frames / g->rate;
+    double t;
+    uint32_t i;
+    int ch;
+
+    for (i = 0; i < n; i++, g->pos++)
+    {
+        t = (double)g->pos / g->rate;
+
+        for (ch = 0; ch < g->channels; ch++)
+        {
+            FAR float *s = &out[i * g->channels + ch];
+
+            if (g->pos >= g->frames) {
+                *s = 0;
+                continue;
+            }
+
+            switch (g->signal) {
+            case BENCH_SINE:
+                *s = 0.5 * sin(2 * M_PI * 997.0 * (1 + 0.5 * ch) * t);
+                break;
+            case BENCH_SWEEP:
+                *s = 0.7 * sin(2 * M_PI * 20.0 * span / k *
+                               (exp(t / span * k) - 1) + ch * M_PI / 3);
+                break;
+            default:
+                g->seed = g->seed * 1664525u + 1013904223u;
+                *s = (int32_t)g->seed / 4294967296.0;
+                break;
+            }
+        }
+    }
+}
+
+static int32_t bench_quantize(float s, int bits)
+{
+    double max = (double)(1u << (bits - 1)) - 1;
+
+    return (int32_t)lrint(s * max);
+}
+
+/* WAV, plain PCM and float */
+
+static void bench_wav_header(FAR uint8_t *hdr, FAR size_t *len,
+                             FAR const bench_coding_s *c, uint32_t frames,
+                             uint32_t data)
+{
+    int bytes = c->bits / 8;
+    int block = c->channels * bytes;
+    int spb = 0;
+    uint8_t *p = hdr;
+
+    if (c->container == BENCH_IMA) {
+        block = BENCH_IMA_BLOCK * c->channels;
+        spb = (block - 4 * c->channels) * 2 / c->channels + 1;
+    }
+
+    memcpy(p, "RIFF", 4);
+    memcpy(p + 8, "WAVEfmt ", 8);
+    bench_put_le(p + 16, spb ? 20 : 16, 4);
+    bench_put_le(p + 20, spb ? WAVE_FORMAT_IMA_ADPCM :
+                 c->is_float ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM, 2);
+    bench_put_le(p + 22, c->channels, 2);
+    bench_put_le(p + 24, c->rate, 4);
+    bench_put_le(p + 28, spb ? (uint64_t)c->rate * block / spb :
+                 c->rate * block, 4);
+    bench_put_le(p + 32, block, 2);
+    bench_put_le(p + 34, spb ? 4 : c->bits, 2);
+    p += 36;
+
+    if (spb) {
+        /* cbSize, wSamplesPerBlock, then the exact length */
+
+        bench_put_le(p, 2, 2);
+        bench_put_le(p + 2, spb, 2);
+        memcpy(p + 4, "fact", 4);
+        bench_put_le(p + 8, 4, 4);
+        bench_put_le(p + 12, frames, 4);
+        p += 16;
+    }
+
+    memcpy(p, "data", 4);
+    bench_put_le(p + 4, data, 4);
+    p += 8;
+
+    *len = p - hdr;
+    bench_put_le(hdr + 4, *len - 8 + data, 4);
+}
+
+static int bench_write_wav(FAR FILE *fp, FAR bench_gen_s *g,
+                           FAR const bench_coding_s *c)
+{
+    uint8_t hdr[64];
+    FAR uint8_t *raw;
+    FAR float *pcm;
+    size_t len;
+    uint32_t n;
+    uint32_t i;
+    int bytes = c->bits / 8;
+
+    pcm = malloc(BENCH_BLOCK * c->channels * sizeof(float));
+    raw = malloc(BENCH_BLOCK * c->channels * bytes);
+    if (pcm == NULL || raw == NULL) {
+        free(pcm);
+        free(raw);
+        return -ENOMEM;
+    }
+
+    bench_wav_header(hdr, &len, c, g->frames, g->frames * c->channels *
+                     bytes);
+    fwrite(hdr, 1, len, fp);
+
+    while (g->pos < g->frames)
+    {
+        n = g->frames - g->pos < BENCH_BLOCK ? g->frames - g->pos :
+            BENCH_BLOCK;
+        bench_gen_block(g, pcm, n);
+
+        for (i = 0; i < n * c->channels; i++)
+        {
+            if (c->is_float) {
+                memcpy(&raw[i * 4], &pcm[i], 4);
+            } else {
+                bench_put_le(&raw[i * bytes],
+                             bench_quantize(pcm[i], c->bits), bytes);
+            }
+        }
+
+        fwrite(raw, 1, n * c->channels * bytes, fp);
+    }
+
+    free(pcm);
+    free(raw);
+    return 0;
+}
+
+/* IMA ADPCM */
+
+static uint8_t bench_ima_nibble(FAR int32_t *pred, FAR int *index,
+                                int32_t sample)
+{
+    int32_t diff = sample - *pred;
+    int32_t step = g_ima_steps[*index];
+    int32_t delta = step >> 3;
+    uint8_t code = 0;
+
+    if (diff < 0) {
+        code = 8;
+        diff = -diff;
+    }
+
+    if (diff >= step) {
+        code |= 4;
+        diff -= step;
+        delta += step;
+    }
+
+    step >>= 1;
+    if (diff >= step) {
+        code |= 2;
+        diff -= step;
+        delta += step;
+    }
+
+    step >>= 1;
+    if (diff >= step) {
+        code |= 1;
+        delta += step;
+    }
+
+    *pred += code & 8 ? -delta : delta;
+    *pred = *pred > 32767 ? 32767 : *pred < -32768 ? -32768 : *pred;
+
+    *index += g_ima_index[code & 7];
+    *index = *index < 0 ? 0 : *index > 88 ? 88 : *index;
+
+    return code;
+}
+
+/**
+ * @brief Encode one block of spb frames
+ * @param recon If not NULL, receives what a decoder makes of the block
+ */
+static void bench_ima_block(FAR const float *pcm, int spb, int ch,
+                            FAR int *index, FAR uint8_t *out,
+                            FAR int16_t *recon)
+{
+    int32_t pred[8];
+    FAR uint8_t *p;
+    int i;
+    int j;
+    int k;
+
+    /* Header: the first sample and the step index of each channel */
+
+    for (k = 0; k < ch; k++)
+    {
+        pred[k] = bench_quantize(pcm[k], 16);
+        bench_put_le(&out[4 * k], pred[k], 2);
+        out[4 * k + 2] = index[k];
+        out[4 * k + 3] = 0;
+
+        if (recon != NULL) {
+            recon[k] = pred[k];
+        }
+    }
+
+    /* Then 8 samples per channel in 4 bytes, low nibble first */
+
+    p = out + 4 * ch;
+    for (i = 1; i < spb; i += 8)
+    {
+        for (k = 0; k < ch; k++)
+        {
+            for (j = 0; j < 8; j++)
+            {
+                uint8_t code = bench_ima_nibble(&pred[k], &index[k],
+                    bench_quantize(pcm[(i + j) * ch + k], 16));
+
+                if (j & 1) {
+                    p[j / 2] |= code << 4;
+                } else {
+                    p[j / 2] = code;
+                }
+
+                if (recon != NULL) {
+                    recon[(i + j) * ch + k] = pred[k];
+                }
+            }
+
+            p += 4;
+        }
+    }
+}
+
+static int bench_write_ima(FAR FILE *fp, FAR bench_gen_s *g,
+                           FAR const bench_coding_s *c)
+{
+    int ch = c->channels;
+    int block = BENCH_IMA_BLOCK * ch;
+    int spb = (block - 4 * ch) * 2 / ch + 1;
+    uint32_t blocks = (g->frames + spb - 1) / spb;
+    int index[8] = { 0 };
+    uint8_t hdr[64];
+    FAR uint8_t *out;
+    FAR float *pcm;
+    size_t len;
+    uint32_t b;
+
+    pcm = malloc((size_t)spb * ch * sizeof(float));
+    out = malloc(block);
+    if (pcm == NULL || out == NULL) {
+        free(pcm);
+        free(out);
+        return -ENOMEM;
+    }
+
+    bench_wav_header(hdr, &len, c, g->frames, blocks * block);
+    fwrite(hdr, 1, len, fp);
+
+    for (b = 0; b < blocks; b++)
+    {
+        bench_gen_block(g, pcm, spb);
+        bench_ima_block(pcm, spb, ch, index, out, NULL);
+        fwrite(out, 1, block, fp);
+    }
+
+    free(pcm);
+    free(out);
+    return 0;
+}
+
+/* FLAC: LPC subframes, mid/side stereo, partitioned Rice residual */
+
+static void bench_bits_put(FAR bench_bits_s *bw, uint32_t v, int bits)
+{
+    if (bits == 0) {
+        return;
+    }
+
+    if (bits < 32) {
+        v &= (1u << bits) - 1;
+    }
+
+    bw->acc = (bw->acc << bits) | v;
+    bw->n += bits;
+
+    while (bw->n >= 8)
+    {
+        bw->n -= 8;
+        if (bw->len < bw->cap) {
+            bw->buf[bw->len++] = bw->acc >> bw->n;
+        } else {
+            bw->overflow = true;
+        }
+    }
+}
+
+static void bench_bits_unary(FAR bench_bits_s *bw, uint32_t q)
+{
+    while (q >= 31 && !bw->overflow)
+    {
+        bench_bits_put(bw, 0, 31);
+        q -= 31;
+    }
+
+    bench_bits_put(bw, 1, q + 1);
+}
+
+static void bench_bits_align(FAR bench_bits_s *bw)
+{
+    if (bw->n > 0) {
+        bench_bits_put(bw, 0, 8 - bw->n);
+    }
+}
+
+static uint64_t bench_bits_used(FAR const bench_bits_s *bw)
+{
+    return (uint64_t)bw->len * 8 + bw->n;
+}
+
+static uint8_t bench_crc8(FAR const uint8_t *p, size_t len)
+{
+    uint8_t crc = 0;
+    int i;
+
+    while (len-- > 0)
+    {
+        crc ^= *p++;
+        for (i = 0; i < 8; i++)
+        {
+            crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+    }
+
+    return crc;
+}
+
+static uint16_t bench_crc16(FAR const uint8_t *p, size_t len)
+{
+    uint16_t crc = 0;
+    int i;
+
+    while (len-- > 0)
+    {
+        crc ^= *p++ << 8;
+        for (i = 0; i < 8; i++)
+        {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x8005 : crc << 1;
+        }
+    }
+
+    return crc;
+}
+
+/**
+ * @brief Quantized LPC coefficients by Levinson-Durbin
+ * @return 0 on success, -1 when the block has no usable predictor
+ */
+static int bench_lpc(FAR const int32_t *x, uint32_t n, FAR int32_t *q,
+                     FAR int *shift)
+{
+    double r[BENCH_FLAC_ORDER + 1];
+    double a[BENCH_FLAC_ORDER + 1];
+    double prev[BENCH_FLAC_ORDER + 1];
+    double err;
+    double acc;
+    double max = 0;
+    int32_t limit = (1 << (BENCH_FLAC_PRECISION - 1)) - 1;
+    uint32_t i;
+    int lag;
+    int j;
+    int e;
+
+    if (n <= BENCH_FLAC_ORDER) {
+        return -1;
+    }
+
+    for (lag = 0; lag <= BENCH_FLAC_ORDER; lag++)
+    {
+        r[lag] = 0;
+        for (i = lag; i < n; i++)
+        {
+            r[lag] += (double)x[i] * x[i - lag];
+        }
+    }
+
+    if (r[0] == 0) {
+        return -1;
+    }
+
+    memset(a, 0, sizeof(a));
+    err = r[0];
+
+    for (lag = 1; lag <= BENCH_FLAC_ORDER; lag++)
+    {
+        acc = r[lag];
+        for (j = 1; j < lag; j++)
+        {
+            acc -= a[j] * r[lag - j];
+        }
+
+        memcpy(prev, a, sizeof(a));
+        a[lag] = acc / err;
+        for (j = 1; j < lag; j++)
+        {
+            a[j] = prev[j] - a[lag] * prev[lag - j];
+        }
+
+        err *= 1 - a[lag] * a[lag];
+        if (err <= 0) {
+            return -1;
+        }
+    }
+
+    for (j = 1; j <= BENCH_FLAC_ORDER; j++)
+    {
+        max = fabs(a[j]) > max ? fabs(a[j]) : max;
+    }
+
+    /* max < 2^e, so the largest coefficient fits the precision */
+
+    frexp(max, &e);
+    *shift = BENCH_FLAC_PRECISION - 1 - e;
+    if (*shift > 15) {
+        *shift = 15;
+    } else if (*shift < 0) {
+        return -1;
+    }
+
+    for (j = 0; j < BENCH_FLAC_ORDER; j++)
+    {
+        long v = lrint(ldexp(a[j + 1], *shift));
+
+        q[j] = v > limit ? limit : v < -limit - 1 ? -limit - 1 : v;
+    }
+
+    return 0;
+}
+
+static void bench_flac_residual(FAR bench_bits_s *bw, FAR const int32_t *res,
+                                uint32_t n, int order)
+{
+    uint32_t count;
+    uint32_t u;
+    uint64_t sum;
+    int porder;
+    int method = 0;
+    int part;
+    int k[16];
+
+    for (porder = 4; porder > 0; porder--)
+    {
+        if (n % (1u << porder) == 0 && (n >> porder) > (uint32_t)order) {
+            break;
+        }
+    }
+
+    /* Rice parameter near log2 of the mean folded residual */
+
+    for (part = 0, u = 0; part < (1 << porder); part++)
+    {
+        count = (n >> porder) - (part == 0 ? order : 0);
+        for (sum = 0; count-- > 0; u++)
+        {
+            sum += ((uint32_t)res[u] << 1) ^ (uint32_t)(res[u] >> 31);
+        }
+
+        count = (n >> porder) - (part == 0 ? order : 0);
+        for (k[part] = 0; k[part] < 30 &&
+             ((uint64_t)count << (k[part] + 1)) < sum; k[part]++)
+        {
+        }
+
+        if (k[part] > 14) {
+            method = 1;
+        }
+    }
+
+    bench_bits_put(bw, method, 2);
+    bench_bits_put(bw, porder, 4);
+
+    for (part = 0, u = 0; part < (1 << porder); part++)
+    {
+        count = (n >> porder) - (part == 0 ? order : 0);
+        bench_bits_put(bw, k[part], method ? 5 : 4);
+
+        for (; count-- > 0 && !bw->overflow; u++)
+        {
+            uint32_t z = ((uint32_t)res[u] << 1) ^ (uint32_t)(res[u] >> 31);
+
+            bench_bits_unary(bw, z >> k[part]);
+            bench_bits_put(bw, z, k[part]);
+        }
+    }
+}
+
+static void bench_flac_subframe(FAR bench_bits_s *bw, FAR const int32_t *x,
+                                uint32_t n, int bps, FAR int32_t *res)
+{
+    bench_bits_s saved = *bw;
+    int32_t q[BENCH_FLAC_ORDER];
+    int64_t pred;
+    uint32_t i;
+    int shift;
+    int j;
+
+    for (i = 1; i < n && x[i] == x[0]; i++)
+    {
+    }
+
+    if (i == n) {
+        bench_bits_put(bw, 0, 8);            /* CONSTANT, no wasted bits */
+        bench_bits_put(bw, x[0], bps);
+        return;
+    }
+
+    if (bench_lpc(x, n, q, &shift) == 0) {
+        for (i = BENCH_FLAC_ORDER; i < n; i++)
+        {
+            for (pred = 0, j = 0; j < BENCH_FLAC_ORDER; j++)
+            {
+                pred += (int64_t)q[j] * x[i - 1 - j];
+            }
+
+            pred = x[i] - (pred >> shift);
+            if (pred > (1 << 29) || pred < -(1 << 29)) {
+                break;
+            }
+
+            res[i - BENCH_FLAC_ORDER] = pred;
+        }
+
+        if (i == n) {
+            bench_bits_put(bw, (32 + BENCH_FLAC_ORDER - 1) << 1, 8);
+            for (i = 0; i < BENCH_FLAC_ORDER; i++)
+            {
+                bench_bits_put(bw, x[i], bps);
+            }
+
+            bench_bits_put(bw, BENCH_FLAC_PRECISION - 1, 4);
+            bench_bits_put(bw, shift, 5);
+            for (j = 0; j < BENCH_FLAC_ORDER; j++)
+            {
+                bench_bits_put(bw, q[j], BENCH_FLAC_PRECISION);
+            }
+
+            bench_flac_residual(bw, res, n, BENCH_FLAC_ORDER);
+
+            if (!bw->overflow &&
+                bench_bits_used(bw) - bench_bits_used(&saved) <=
+                8 + (uint64_t)n * bps) {
+                return;
+            }
+        }
+    }
+
+    /* Noise does not predict, VERBATIM is smaller */
+
+    *bw = saved;
+    bench_bits_put(bw, 1 << 1, 8);
+    for (i = 0; i < n; i++)
+    {
+        bench_bits_put(bw, x[i], bps);
+    }
+}
+
+static void bench_flac_frame(FAR bench_bits_s *bw, FAR const float *pcm,
+                             uint32_t n, uint32_t number,
+                             FAR const bench_coding_s *c,
+                             FAR int32_t **chan, FAR int32_t *res)
+{
+    int bs_code = n == BENCH_FLAC_BLOCK ? 12 : 7;
+    int rate_code = c->rate == 44100 ? 9 : c->rate == 48000 ? 10 : 0;
+    int ss_code = c->bits == 16 ? 4 : c->bits == 24 ? 6 : 0;
+    bool stereo = c->channels == 2;
+    uint32_t i;
+    int ch;
+
+    bw->len = 0;
+    bw->n = 0;
+    bw->overflow = false;
+
+    bench_bits_put(bw, 0xfff8, 16);
+    bench_bits_put(bw, (bs_code << 4) | rate_code, 8);
+    bench_bits_put(bw, ((stereo ? 10 : c->channels - 1) << 4) |
+                   (ss_code << 1), 8);
+
+    /* UTF-8 coded frame number */
+
+    if (number < 0x80) {
+        bench_bits_put(bw, number, 8);
+    } else if (number < 0x800) {
+        bench_bits_put(bw, 0xc0 | (number >> 6), 8);
+        bench_bits_put(bw, 0x80 | (number & 0x3f), 8);
+    } else {
+        bench_bits_put(bw, 0xe0 | (number >> 12), 8);
+        bench_bits_put(bw, 0x80 | ((number >> 6) & 0x3f), 8);
+        bench_bits_put(bw, 0x80 | (number & 0x3f), 8);
+    }
+
+    if (bs_code == 7) {
+        bench_bits_put(bw, n - 1, 16);
+    }
+
+    bench_bits_put(bw, bench_crc8(bw->buf, bw->len), 8);
+
+    for (i = 0; i < n; i++)
+    {
+        for (ch = 0; ch < c->channels; ch++)
+        {
+            chan[ch][i] = bench_quantize(pcm[i * c->channels + ch], c->bits);
+        }
+    }
+
+    if (stereo) {
+        /* Mid and side, side has one bit more */
+
+        for (i = 0; i < n; i++)
+        {
+            int32_t l = chan[0][i];
+            int32_t r = chan[1][i];
+
+            chan[0][i] = (l + r) >> 1;
+            chan[1][i] = l - r;
+        }
+    }
+
+    for (ch = 0; ch < c->channels; ch++)
+    {
+        bench_flac_subframe(bw, chan[ch], n,
+                            c->bits + (stereo && ch == 1), res);
+    }
+
+    bench_bits_align(bw);
+    bench_bits_put(bw, bench_crc16(bw->buf, bw->len), 16);
+}
+
+static int bench_write_flac(FAR FILE *fp, FAR bench_gen_s *g,
+                            FAR const bench_coding_s *c)
+{
+    FAR int32_t *chan[8];
+    FAR int32_t *block;
+    FAR int32_t *res;
+    FAR float *pcm;
+    bench_bits_s bw;
+    uint8_t hdr[42];
+    uint32_t number;
+    uint32_t n;
+    int ch;
+
+    memset(&bw, 0, sizeof(bw));
+    bw.cap = (size_t)BENCH_FLAC_BLOCK * c->channels * 8 + 256;
+    bw.buf = malloc(bw.cap);
+    pcm = malloc(BENCH_FLAC_BLOCK * c->channels * sizeof(float));
+    block = malloc(BENCH_FLAC_BLOCK * c->channels * sizeof(int32_t));
+    res = malloc(BENCH_FLAC_BLOCK * sizeof(int32_t));
+    if (bw.buf == NULL || pcm == NULL || block == NULL || res == NULL) {
+        free(bw.buf);
+        free(pcm);
+        free(block);
+        free(res);
+        return -ENOMEM;
+    }
+
+    for (ch = 0; ch < c->channels; ch++)
+    {
+        chan[ch] = block + ch * BENCH_FLAC_BLOCK;
+    }
+
+    /* "fLaC", then STREAMINFO as the last metadata block, no MD5 */
+
+    memset(hdr, 0, sizeof(hdr));
+    memcpy(hdr, "fLaC", 4);
+    hdr[4] = 0x80;
+    hdr[7] = 34;
+    hdr[8] = BENCH_FLAC_BLOCK >> 8;
+    hdr[10] = BENCH_FLAC_BLOCK >> 8;
+    hdr[18] = c->rate >> 12;
+    hdr[19] = c->rate >> 4;
+    hdr[20] = ((c->rate & 0xf) << 4) | ((c->channels - 1) << 1) |
+              ((c->bits - 1) >> 4);
+    hdr[21] = ((c->bits - 1) & 0xf) << 4;
+    hdr[22] = g->frames >> 24;
+    hdr[23] = g->frames >> 16;
+    hdr[24] = g->frames >> 8;
+    hdr[25] = g->frames;
+    fwrite(hdr, 1, sizeof(hdr), fp);
+
+    for (number = 0; g->pos < g->frames; number++)
+    {
+        n = g->frames - g->pos < BENCH_FLAC_BLOCK ? g->frames - g->pos :
+            BENCH_FLAC_BLOCK;
+        bench_gen_block(g, pcm, n);
+        bench_flac_frame(&bw, pcm, n, number, c, chan, res);
+
+        /* One bit flipped in the middle of the subframes */
+
+        if (c->corrupt && number == 1) {
+            bw.buf[bw.len / 2] ^= 0x10;
+        }
+
+        fwrite(bw.buf, 1, bw.len, fp);
+    }
+
+    free(bw.buf);
+    free(pcm);
+    free(block);
+    free(res);
+    return 0;
+}
+
+static int bench_write_corpus(FAR const char *dir, uint32_t seconds,
+                              FAR bench_file_s *files, FAR int *count)
+{
+    FAR const bench_coding_s *c;
+    bench_gen_s gen;
+    FAR FILE *fp;
+    size_t i;
+    int signal;
+    int ret;
+
+    if (mkdir(dir, 0777) < 0 && errno != EEXIST) {
+        printf("Cannot create %s: %d\n", dir, errno);
+        return -errno;
+    }
+
+    for (signal = 0; signal < BENCH_SIGNALS; signal++)
+    {
+        for (i = 0; i < sizeof(g_codings) / sizeof(g_codings[0]); i++)
+        {
+            FAR bench_file_s *f = &files[(*count)++];
+
+            c = &g_codings[i];
+            snprintf(f->path, sizeof(f->path), "%s/%s_%s.%s", dir,
+                     g_signals[signal], c->name,
+                     c->container == BENCH_FLAC ? "flac" : "wav");
+            f->signal = g_signals[signal];
+            f->coding = c->name;
+
+            memset(&gen, 0, sizeof(gen));
+            gen.signal = signal;
+            gen.rate = c->rate;
+            gen.frames = c->rate * seconds;
+            gen.channels = c->channels;
+            gen.seed = 0x12345678u + signal;
+            f->frames = gen.frames - (c->corrupt ? BENCH_FLAC_BLOCK : 0);
+            f->source = c;
+            f->gen = gen;
+
+            fp = fopen(f->path, "wb");
+            if (fp == NULL) {
+                printf("Cannot write %s: %d\n", f->path, errno);
+                return -errno;
+            }
+
+            ret = c->container == BENCH_FLAC ? bench_write_flac(fp, &gen, c) :
+                  c->container == BENCH_IMA ? bench_write_ima(fp, &gen, c) :
+                  bench_write_wav(fp, &gen, c);
+            fclose(fp);
+            if (ret < 0) {
+                return ret;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* Reference output of the corpus */
+
+static int bench_ref_init(FAR bench_ref_s *ref, FAR const bench_file_s *f)
+{
+    FAR const bench_coding_s *c = f->source;
+
+    memset(ref, 0, sizeof(*ref));
+    ref->gen = f->gen;
+    ref->c = c;
+    ref->block = BENCH_BLOCK;
+
+    if (c->container == BENCH_IMA) {
+        ref->block = (BENCH_IMA_BLOCK - 4) * 2 + 1;
+        ref->ima = malloc(BENCH_IMA_BLOCK * c->channels);
+        ref->recon = malloc(ref->block * c->channels * sizeof(int16_t));
+    }
+
+    ref->pcm = malloc(ref->block * c->channels * sizeof(float));
+    ref->out = malloc(ref->block * 2 * sizeof(int16_t));
+
+    if (ref->pcm == NULL || ref->out == NULL ||
+        (c->container == BENCH_IMA &&
+         (ref->ima == NULL || ref->recon == NULL))) {
+        free(ref->pcm);
+        free(ref->out);
+        free(ref->ima);
+        free(ref->recon);
+        return -ENOMEM;
+    }
+
+    return 0;
+}
+
+static void bench_ref_free(FAR bench_ref_s *ref)
+{
+    free(ref->pcm);
+    free(ref->out);
+    free(ref->ima);
+    free(ref->recon);
+}
+
+static void bench_ref_fill(FAR bench_ref_s *ref)
+{
+    FAR const bench_coding_s *c = ref->c;
+    double side = sqrt(0.5);
+    uint32_t i;
+    int ch;
+
+    /* The damaged frame never reaches the output */
+
+    if (c->corrupt && ref->gen.pos == BENCH_FLAC_BLOCK) {
+        for (i = 0; i < BENCH_FLAC_BLOCK; i += ref->block)
+        {
+            bench_gen_block(&ref->gen, ref->pcm, ref->block);
+        }
+    }
+
+    bench_gen_block(&ref->gen, ref->pcm, ref->block);
+
+    if (c->container == BENCH_IMA) {
+        bench_ima_block(ref->pcm, ref->block, c->channels, ref->index,
+                        ref->ima, ref->recon);
+    }
+
+    for (i = 0; i < ref->block; i++)
+    {
+        FAR const float *s = &ref->pcm[i * c->channels];
+        int32_t v[8];
+
+        for (ch = 0; ch < c->channels; ch++)
+        {
+            v[ch] = ref->recon != NULL ? ref->recon[i * c->channels + ch] :
+                    bench_quantize(s[ch], 16);
+        }
+
+        if (c->channels == 6) {
+            /* 5.1: centre and surrounds at -3 dB, no LFE, unity sum */
+
+            ref->out[2 * i] = lrint((v[0] + side * (v[2] + v[4])) /
+                                    (1 + 2 * side));
+            ref->out[2 * i + 1] = lrint((v[1] + side * (v[2] + v[5])) /
+                                        (1 + 2 * side));
+        } else {
+            ref->out[2 * i] = v[0];
+            ref->out[2 * i + 1] = v[c->channels > 1];
+        }
+    }
+
+    ref->len = ref->block;
+    ref->pos = 0;
+}
+
+/**
+ * @brief Compare decoder output with the reference
+ * @return Largest difference in LSB
+ */
+static int bench_ref_check(FAR bench_ref_s *ref, FAR const int16_t *pcm,
+                           size_t frames)
+{
+    int max = 0;
+    int d;
+
+    while (frames-- > 0)
+    {
+        if (ref->pos == ref->len) {
+            bench_ref_fill(ref);
+        }
+
+        d = abs(pcm[0] - ref->out[2 * ref->pos]);
+        max = d > max ? d : max;
+        d = abs(pcm[1] - ref->out[2 * ref->pos + 1]);
+        max = d > max ? d : max;
+
+        pcm += 2;
+        ref->pos++;
+    }
+
+    return max;
+}
+
+/**
+ * @brief The conversion audio_ctl applies to a file, and its codec frame
+ */
+static void bench_kernel_select(FAR const char *path,
+                                FAR bench_result_s *r)
+{
+    FAR bench_kernel_s *k = &r->kernel;
+    FAR const fmt_s *fmt;
+    audio_probe_s probe;
+    uint8_t si[12];
+    int fd;
+
+    memset(k, 0, sizeof(*k));
+    strcpy(k->name, "none");
+    r->adapter = "WAV Decoder";
+    r->codec_frame = BENCH_BLOCK;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+
+    if (audio_ctl_probe(path, fd, &probe) < 0) {
+        close(fd);
+        return;
+    }
+
+    if (probe.format == AUDIO_FORMAT_MP3) {
+        r->adapter = "MP3 Decoder (libmad)";
+        r->codec_frame = BENCH_MP3_FRAME;
+        k->q28 = true;
+        k->channels = 2;
+        snprintf(k->name, sizeof(k->name), "q28_s16_%s",
+                 pcm_convert_name());
+    } else if (probe.format == AUDIO_FORMAT_FLAC) {
+        r->adapter = "FLAC Decoder";
+
+        /* STREAMINFO maximum block size */
+
+        if (pread(fd, si, sizeof(si), 0) == sizeof(si)) {
+            r->codec_frame = (si[10] << 8) | si[11];
+        }
+
+        /* Up to stereo the decoder interleaves on its own */
+
+        if (probe.channels > 2) {
+            k->format = pcm_format_select(false, 32, 4, probe.channels);
+            k->container = 4;
+            k->channels = probe.channels;
+        }
+    } else if (probe.format == AUDIO_FORMAT_WAV) {
+        fmt = &probe.wav.fmt;
+
+        if (fmt->audioformat == WAVE_FORMAT_ADPCM ||
+            fmt->audioformat == WAVE_FORMAT_IMA_ADPCM) {
+            r->codec_frame = probe.wav.samples_per_block;
+            k->container = 2;
+        } else if (fmt->numchannels > 0 &&
+                   !(fmt->audioformat == WAVE_FORMAT_PCM &&
+                     fmt->bitspersample == 16 && fmt->numchannels == 2)) {
+            k->is_float = fmt->audioformat == WAVE_FORMAT_IEEE_FLOAT;
+            k->container = fmt->blockalign / fmt->numchannels;
+        }
+
+        if (k->container > 0) {
+            k->channels = fmt->numchannels;
+            k->format = pcm_format_select(k->is_float, probe.wav.
+                                          samples_per_block ? 16 :
+                                          fmt->bitspersample,
+                                          k->container, k->channels);
+        }
+    }
+
+    if (k->format != NULL) {
+        snprintf(k->name, sizeof(k->name), "%s%d_%dch_s16",
+                 k->is_float ? "f" : "s", k->container * 8, k->channels);
+    }
+
+    close(fd);
+}
+
+/**
+ * @brief Time the kernel alone over frames, BENCH_BLOCK frames per call
+ */
+static uint64_t bench_kernel_time(FAR const bench_kernel_s *k,
+                                  uint64_t frames)
+{
+    size_t in_bytes = BENCH_BLOCK * k->channels * (k->q28 ? 4 : k->container);
+    FAR uint8_t *in;
+    FAR int16_t *out;
+    uint32_t seed = 1;
+    uint64_t start;
+    uint64_t done;
+    size_t i;
+    float f;
+
+    if (k->format == NULL && !k->q28) {
+        return 0;
+    }
+
+    in = malloc(in_bytes);
+    out = malloc(BENCH_BLOCK * 2 * sizeof(int16_t));
+    if (in == NULL || out == NULL) {
+        free(in);
+        free(out);
+        return 0;
+    }
+
+    for (i = 0; i + 4 <= in_bytes; i += 4)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        if (k->is_float) {
+            f = (int32_t)seed / 2147483648.0f;
+            memcpy(&in[i], &f, 4);
+        } else if (k->q28) {
+            bench_put_le(&in[i], (uint32_t)((int32_t)seed >> 3), 4);
+        } else {
+            bench_put_le(&in[i], seed, 4);
+        }
+    }
+
+    start = bench_now_ns();
+
+    for (done = 0; done < frames; done += BENCH_BLOCK)
+    {
+        size_t n = frames - done < BENCH_BLOCK ? frames - done : BENCH_BLOCK;
+
+        if (k->q28) {
+            pcm_convert_q28_s16(out, (FAR const int32_t *)in,
+                                (FAR const int32_t *)in + BENCH_BLOCK, n);
+        } else {
+            k->format(out, in, n);
+        }
+    }
+
+    start = bench_now_ns() - start;
+
+    free(in);
+    free(out);
+    return start;
+}
+
+static int bench_run(FAR const bench_file_s *f, size_t read_bytes,
+                     FAR bench_result_s *r)
+{
+    FAR audio_stream_s *stream;
+    FAR const fmt_s *fmt;
+    FAR uint8_t *buf;
+    bench_ref_s ref;
+    struct stat st;
+    size_t base;
+    size_t heap;
+    uint64_t start;
+    uint64_t ns;
+    ssize_t n;
+    int ret;
+
+    buf = malloc(read_bytes);
+    if (buf == NULL) {
+        return -ENOMEM;
+    }
+
+    r->max_error = -1;
+    if (f->source != NULL) {
+        if (bench_ref_init(&ref, f) < 0) {
+            free(buf);
+            return -ENOMEM;
+        }
+
+        r->max_error = 0;
+    }
+
+    r->read_bytes = read_bytes;
+    r->input_bytes = stat(f->path, &st) == 0 ? st.st_size : 0;
+    audio_hist_reset(&r->call_us);
+    audio_hist_reset(&r->frame_ns);
+
+    base = bench_heap_used();
+    start = bench_now_ns();
+
+    ret = audio_ctl_stream_open(f->path, &stream);
+    if (ret < 0) {
+        if (f->source != NULL) {
+            bench_ref_free(&ref);
+        }
+
+        free(buf);
+        return ret;
+    }
+
+    r->open_ns = bench_now_ns() - start;
+    heap = bench_heap_used();
+    r->heap_open = heap > base ? heap - base : 0;
+    r->heap_peak = r->heap_open;
+
+    fmt = audio_ctl_stream_get_fmt(stream);
+    r->rate = fmt->samplerate;
+
+    for (; ; )
+    {
+        start = bench_now_ns();
+        n = audio_ctl_stream_read(stream, buf, read_bytes);
+        ns = bench_now_ns() - start;
+
+        if (n <= 0) {
+            ret = n;
+            break;
+        }
+
+        r->decode_ns += ns;
+        r->output_bytes += n;
+        r->frames += n / fmt->blockalign;
+        r->calls++;
+        audio_hist_record(&r->call_us, ns / 1000);
+        audio_hist_record(&r->frame_ns, ns / (n / fmt->blockalign));
+
+        heap = bench_heap_used();
+        if (heap > base && heap - base > r->heap_peak) {
+            r->heap_peak = heap - base;
+        }
+
+        /* Off the clock: the output against the source */
+
+        if (f->source != NULL && fmt->blockalign == 4) {
+            int err = bench_ref_check(&ref, (FAR const int16_t *)buf,
+                                      n / 4);
+
+            r->max_error = err > r->max_error ? err : r->max_error;
+        }
+    }
+
+    audio_ctl_stream_close(stream);
+    free(buf);
+
+    if (f->source != NULL) {
+        bench_ref_free(&ref);
+    }
+
+    r->kernel_ns = bench_kernel_time(&r->kernel, r->frames);
+    return ret;
+}
+
+static void bench_json_string(FAR FILE *fp, FAR const char *s)
+{
+    fputc('"', fp);
+    for (; *s != '\0'; s++)
+    {
+        if (*s == '"' || *s == '\\') {
+            fputc('\\', fp);
+        }
+
+        fputc(*s, fp);
+    }
+
+    fputc('"', fp);
+}
+
+static void bench_json_hist(FAR FILE *fp, FAR const char *name,
+                            FAR audio_hist_s *hist, double mean)
+{
+    audio_hist_summary_s s;
+
+    audio_hist_summarize(hist, &s);
+    fprintf(fp, "\"%s\": {\"count\": %u, \"mean\": %.2f, \"min\": %u, "
+            "\"p50\": %u, \"p90\": %u, \"p99\": %u, \"max\": %u}", name,
+            (unsigned)s.count, mean, (unsigned)s.min, (unsigned)s.p50,
+            (unsigned)s.p90, (unsigned)s.p99, (unsigned)s.max);
+}
+
+static void bench_json_result(FAR FILE *fp, FAR const bench_file_s *f,
+                              FAR bench_result_s *r, bool first)
+{
+    double decode_s = r->decode_ns / 1e9;
+    double audio_s = r->rate ? (double)r->frames / r->rate : 0;
+    double calls = r->calls ? r->calls : 1;
+    double frames = r->frames ? r->frames : 1;
+    FAR const char *slash = strrchr(f->path, '/');
+
+    fprintf(fp, "%s\n    {", first ? "" : ",");
+    fprintf(fp, "\"file\": ");
+    bench_json_string(fp, slash ? slash + 1 : f->path);
+    fprintf(fp, ", \"signal\": ");
+    bench_json_string(fp, f->signal);
+    fprintf(fp, ", \"coding\": ");
+    bench_json_string(fp, f->coding);
+    fprintf(fp, ", \"adapter\": ");
+    bench_json_string(fp, r->adapter);
+    fprintf(fp, ",\n     \"read_bytes\": %zu, \"per_codec_frame\": %s, "
+            "\"codec_frame\": %u,\n", r->read_bytes,
+            r->per_codec_frame ? "true" : "false",
+            (unsigned)r->codec_frame);
+    fprintf(fp, "     \"input_bytes\": %llu, \"output_bytes\": %llu, "
+            "\"frames\": %llu, \"expected_frames\": %llu, \"rate\": %u,\n",
+            (unsigned long long)r->input_bytes,
+            (unsigned long long)r->output_bytes,
+            (unsigned long long)r->frames, (unsigned long long)f->frames,
+            (unsigned)r->rate);
+    fprintf(fp, "     \"open_us\": %.1f, \"decode_us\": %.1f, "
+            "\"in_mb_per_s\": %.3f, \"out_mb_per_s\": %.3f, "
+            "\"realtime\": %.2f,\n", r->open_ns / 1e3, r->decode_ns / 1e3,
+            decode_s > 0 ? r->input_bytes / decode_s / 1e6 : 0,
+            decode_s > 0 ? r->output_bytes / decode_s / 1e6 : 0,
+            decode_s > 0 ? audio_s / decode_s : 0);
+    fprintf(fp, "     ");
+    bench_json_hist(fp, "call_us", &r->call_us, r->decode_ns / 1e3 / calls);
+    fprintf(fp, ",\n     ");
+    bench_json_hist(fp, "frame_ns", &r->frame_ns, r->decode_ns / frames);
+    fprintf(fp, ",\n     \"kernel\": ");
+    bench_json_string(fp, r->kernel.name);
+    fprintf(fp, ", \"kernel_ns_per_frame\": %.3f, \"kernel_share\": %.4f,\n",
+            r->kernel_ns / frames,
+            r->decode_ns ? (double)r->kernel_ns / r->decode_ns : 0);
+    fprintf(fp, "     \"heap_open_bytes\": %zu, \"heap_peak_bytes\": %zu, "
+            "\"max_error\": %d}", r->heap_open, r->heap_peak, r->max_error);
+}
+
+static int bench_parse_sizes(FAR const char *arg, FAR size_t *sizes)
+{
+    FAR char *end;
+    int count = 0;
+
+    while (*arg != '\0' && count < BENCH_MAX_SIZES)
+    {
+        sizes[count] = strtoul(arg, &end, 0);
+        if (end == arg || sizes[count] < 4) {
+            return -1;
+        }
+
+        count++;
+        arg = *end == ',' ? end + 1 : end;
+    }
+
+    return count;
+}
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int main(int argc, FAR char *argv[])
+{
+    static bench_file_s files[BENCH_MAX_FILES];
+    FAR const char *dir = BENCH_DEFAULT_DIR;
+    FAR const char *json = BENCH_DEFAULT_JSON;
+    size_t sizes[BENCH_MAX_SIZES];
+    uint32_t seconds = BENCH_DEFAULT_SECONDS;
+    bool corpus = true;
+    bench_result_s r;
+    int nsizes;
+    int count = 0;
+    int fails = 0;
+    bool first = true;
+    FAR FILE *fp;
+    int opt;
+    int i;
+    int s;
+
+    nsizes = bench_parse_sizes(BENCH_DEFAULT_SIZES, sizes);
+
+    while ((opt = getopt(argc, argv, "d:t:r:o:n")) != -1)
+    {
+        switch (opt) {
+        case 'd':
+            dir = optarg;
+            break;
+        case 't':
+            seconds = strtoul(optarg, NULL, 0);
+            break;
+        case 'r':
+            nsizes = bench_parse_sizes(optarg, sizes);
+            break;
+        case 'o':
+            json = optarg;
+            break;
+        case 'n':
+            corpus = false;
+            break;
+        default:
+            nsizes = -1;
+            break;
+        }
+    }
+
+    if (nsizes < 0 || seconds == 0 || (!corpus && optind == argc)) {
+        printf("Usage: %s [-d dir] [-t seconds] [-r sizes] [-o json] [-n] "
+               "[file...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (corpus && bench_write_corpus(dir, seconds, files, &count) < 0) {
+        return EXIT_FAILURE;
+    }
+
+    for (i = optind; i < argc && count < BENCH_MAX_FILES; i++)
+    {
+        snprintf(files[count].path, BENCH_PATH_MAX, "%s", argv[i]);
+        files[count].signal = "file";
+        files[count].coding = "file";
+        files[count].frames = 0;
+        files[count].source = NULL;
+        count++;
+    }
+
+    fp = fopen(json, "w");
+    if (fp == NULL) {
+        printf("Cannot write %s\n", json);
+        return EXIT_FAILURE;
+    }
+
+    fprintf(fp, "{\n  \"bench\": \"decoder_bench\",\n  \"config\": {"
+            "\"mp3_support\": %s, \"mp3_buffer_size\": %d, "
+            "\"readahead_block\": %d, \"readahead_depth\": %d, "
+            "\"seconds\": %u},\n  \"results\": [",
+#ifdef CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT
+            "true", CONFIG_LVX_MUSIC_PLAYER_MP3_BUFFER_SIZE,
+#else
+            "false", 0,
+#endif
+            CONFIG_LVX_MUSIC_PLAYER_READAHEAD_BLOCK,
+            CONFIG_LVX_MUSIC_PLAYER_READAHEAD_DEPTH, (unsigned)seconds);
+
+    printf("%-28s %7s %9s %9s %9s %9s %9s\n", "file", "read", "MB/s",
+           "realtime", "call p99", "kernel", "heap KB");
+
+    for (i = 0; i < count; i++)
+    {
+        for (s = -1; s < nsizes; s++)
+        {
+            memset(&r, 0, sizeof(r));
+            bench_kernel_select(files[i].path, &r);
+
+            /* One codec frame of 16-bit stereo output first */
+
+            r.per_codec_frame = s < 0;
+            if (bench_run(&files[i], s < 0 ? r.codec_frame * 4 : sizes[s],
+                          &r) < 0 ||
+                (files[i].frames != 0 && r.frames != files[i].frames) ||
+                (files[i].source != NULL &&
+                 r.max_error > files[i].source->tolerance)) {
+                printf("FAIL %s: %llu of %llu frames, off by up to %d\n",
+                       files[i].path, (unsigned long long)r.frames,
+                       (unsigned long long)files[i].frames, r.max_error);
+                fails++;
+                break;
+            }
+
+            bench_json_result(fp, &files[i], &r, first);
+            first = false;
+
+            printf("%-28s %6zu%c %9.2f %9.1f %9u %9.2f %9zu\n",
+                   strrchr(files[i].path, '/') ?
+                   strrchr(files[i].path, '/') + 1 : files[i].path,
+                   r.read_bytes, r.per_codec_frame ? '*' : ' ',
+                   r.input_bytes / (r.decode_ns / 1e3),
+                   r.rate && r.decode_ns ?
+                   (double)r.frames / r.rate / (r.decode_ns / 1e9) : 0,
+                   audio_hist_percentile(&r.call_us, 990),
+                   r.frames ? (double)r.kernel_ns / r.frames : 0,
+                   r.heap_peak / 1024);
+        }
+    }
+
+    fprintf(fp, "\n  ]\n}\n");
+    fclose(fp);
+
+    printf("%d files, * one codec frame per read, report in %s\n", count,
+           json);
+    return fails ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,1333 @@
+/**
+ * @file flac_decoder.c
+ * Streaming FLAC decoder with seektable and bisection seeking
+ *
+ * Frames are decoded from a bounded input buffer filled the same way as
+ * the MP3 decoder's: flac_decoder_input_space() carries the unconsumed
+ * tail to the front and flac_decoder_input_commit() appends what was
+ * read. A frame is only attempted once the buffer holds STREAMINFO's
+ * maximum frame size (or a worst-case estimate), so a frame is never
+ * decoded twice. The decoded block stays in one int32 buffer per channel,
+ * which linear prediction needs anyway, and is converted to 16-bit stereo
+ * straight into the caller's buffer, stopping and resuming anywhere.
+ *
+ * Seeking starts from the closest SEEKTABLE point and otherwise bisects
+ * the file on frame headers (sync code plus CRC-8 and STREAMINFO checks,
+ * then a CRC-16 up to the next header), then steps frame by frame to the
+ * one containing the target sample. A frame whose CRC-16 does not match
+ * is dropped and decoding resyncs on the next one.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "flac_decoder.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define FLAC_INPUT_CHUNK     4096
+#define FLAC_SCAN_BUFSIZE    4096
+#define FLAC_MAX_HEADER      16      /* sync ... CRC-8 */
+#define FLAC_MIX_FRAMES      64
+#define FLAC_SEEKPOINT_BYTES 18
+
+#define FLAC_CH_LEFT_SIDE    8
+#define FLAC_CH_SIDE_RIGHT   9
+#define FLAC_CH_MID_SIDE     10
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* MSB-first bit reader. Bits past the end read as zero and set overrun,
+ * the caller then waits for more input or drops the frame.
+ */
+
+typedef struct flac_bits {
+    FAR const uint8_t *p;
+    FAR const uint8_t *end;
+    uint64_t cache;        /* next bits at the top, zero below avail */
+    int avail;
+    bool overrun;
+} flac_bits_s;
+
+typedef struct flac_frame {
+    uint64_t sample;       /* first sample of the frame */
+    uint32_t blocksize;
+    uint16_t channels;
+    uint16_t bits_per_sample;
+    uint8_t assignment;    /* 0-7 independent, 8-10 stereo decorrelation */
+} flac_frame_s;
+
+/* Small pread() window for header walks while seeking */
+
+typedef struct flac_scan {
+    int fd;
+    uint32_t end;
+    uint32_t base;
+    uint32_t len;
+    uint8_t buf[FLAC_SCAN_BUFSIZE];
+} flac_scan_s;
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+static const uint32_t g_flac_rates[12] =
+{
+    0, 88200, 176400, 192000, 8000, 16000, 22050, 24000, 32000, 44100,
+    48000, 96000,
+};
+
+static const uint8_t g_flac_sample_sizes[8] =
+{
+    0, 8, 12, 0, 16, 20, 24, 0,
+};
+
+/* CRC-16 of the frame footer, polynomial 0x8005, MSB first */
+
+static const uint16_t g_flac_crc16[256] =
+{
+    0x0000, 0x8005, 0x800f, 0x000a, 0x801b, 0x001e, 0x0014, 0x8011,
+    0x8033, 0x0036, 0x003c, 0x8039, 0x0028, 0x802d, 0x8027, 0x0022,
+    0x8063, 0x0066, 0x006c, 0x8069, 0x0078, 0x807d, 0x8077, 0x0072,
+    0x0050, 0x8055, 0x805f, 0x005a, 0x804b, 0x004e, 0x0044, 0x8041,
+    0x80c3, 0x00c6, 0x00cc, 0x80c9, 0x00d8, 0x80dd, 0x80d7, 0x00d2,
+    0x00f0, 0x80f5, 0x80ff, 0x00fa, 0x80eb, 0x00ee, 0x00e4, 0x80e1,
+    0x00a0, 0x80a5, 0x80af, 0x00aa, 0x80bb, 0x00be, 0x00b4, 0x80b1,
+    0x8093, 0x0096, 0x009c, 0x8099, 0x0088, 0x808d, 0x8087, 0x0082,
+    0x8183, 0x0186, 0x018c, 0x8189, 0x0198, 0x819d, 0x8197, 0x0192,
+    0x01b0, 0x81b5, 0x81bf, 0x01ba, 0x81ab, 0x01ae, 0x01a4, 0x81a1,
+    0x01e0, 0x81e5, 0x81ef, 0x01ea, 0x81fb, 0x01fe, 0x01f4, 0x81f1,
+    0x81d3, 0x01d6, 0x01dc, 0x81d9, 0x01c8, 0x81cd, 0x81c7, 0x01c2,
+    0x0140, 0x8145, 0x814f, 0x014a, 0x815b, 0x015e, 0x0154, 0x8151,
+    0x8173, 0x0176, 0x017c, 0x8179, 0x0168, 0x816d, 0x8167, 0x0162,
+    0x8123, 0x0126, 0x012c, 0x8129, 0x0138, 0x813d, 0x8137, 0x0132,
+    0x0110, 0x8115, 0x811f, 0x011a, 0x810b, 0x010e, 0x0104, 0x8101,
+    0x8303, 0x0306, 0x030c, 0x8309, 0x0318, 0x831d, 0x8317, 0x0312,
+    0x0330, 0x8335, 0x833f, 0x033a, 0x832b, 0x032e, 0x0324, 0x8321,
+    0x0360, 0x8365, 0x836f, 0x036a, 0x837b, 0x037e, 0x0374, 0x8371,
+    0x8353, 0x0356, 0x035c, 0x8359, 0x0348, 0x834d, 0x8347, 0x0342,
+    0x03c0, 0x83c5, 0x83cf, 0x03ca, 0x83db, 0x03de, 0x03d4, 0x83d1,
+    0x83f3, 0x03f6, 0x03fc, 0x83f9, 0x03e8, 0x83ed, 0x83e7, 0x03e2,
+    0x83a3, 0x03a6, 0x03ac, 0x83a9, 0x03b8, 0x83bd, 0x83b7, 0x03b2,
+    0x0390, 0x8395, 0x839f, 0x039a, 0x838b, 0x038e, 0x0384, 0x8381,
+    0x0280, 0x8285, 0x828f, 0x028a, 0x829b, 0x029e, 0x0294, 0x8291,
+    0x82b3, 0x02b6, 0x02bc, 0x82b9, 0x02a8, 0x82ad, 0x82a7, 0x02a2,
+    0x82e3, 0x02e6, 0x02ec, 0x82e9, 0x02f8, 0x82fd, 0x82f7, 0x02f2,
+    0x02d0, 0x82d5, 0x82df, 0x02da, 0x82cb, 0x02ce, 0x02c4, 0x82c1,
+    0x8243, 0x0246, 0x024c, 0x8249, 0x0258, 0x825d, 0x8257, 0x0252,
+    0x0270, 0x8275, 0x827f, 0x027a, 0x826b, 0x026e, 0x0264, 0x8261,
+    0x0220, 0x8225, 0x822f, 0x022a, 0x823b, 0x023e, 0x0234, 0x8231,
+    0x8213, 0x0216, 0x021c, 0x8219, 0x0208, 0x820d, 0x8207, 0x0202,
+};
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static uint32_t flac_be24(FAR const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 16) | (p[1] << 8) | p[2];
+}
+
+static uint64_t flac_be64(FAR const uint8_t *p)
+{
+    return ((uint64_t)flac_be24(p) << 40) | ((uint64_t)flac_be24(p + 3) << 16) |
+           (p[6] << 8) | p[7];
+}
+
+static uint8_t flac_crc8(FAR const uint8_t *p, size_t len)
+{
+    uint8_t crc = 0;
+    int i;
+
+    while (len-- > 0) {
+        crc ^= *p++;
+        for (i = 0; i < 8; i++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : crc << 1;
+        }
+    }
+
+    return crc;
+}
+
+/* Over a whole frame, CRC-16 included, the result is 0 */
+
+static uint16_t flac_crc16(uint16_t crc, FAR const uint8_t *p, size_t len)
+{
+    while (len-- > 0) {
+        crc = (crc << 8) ^ g_flac_crc16[(crc >> 8) ^ *p++];
+    }
+
+    return crc;
+}
+
+static inline void flac_bits_init(FAR flac_bits_s *br,
+                                  FAR const uint8_t *p, size_t len)
+{
+    br->p = p;
+    br->end = p + len;
+    br->cache = 0;
+    br->avail = 0;
+    br->overrun = false;
+}
+
+static inline void flac_bits_refill(FAR flac_bits_s *br)
+{
+    while (br->avail <= 56 && br->p < br->end) {
+        br->cache |= (uint64_t)*br->p++ << (56 - br->avail);
+        br->avail += 8;
+    }
+}
+
+/* 1 to 32 bits */
+
+static inline uint32_t flac_bits_read(FAR flac_bits_s *br, int n)
+{
+    uint32_t v;
+
+    if (br->avail < n) {
+        flac_bits_refill(br);
+        if (br->avail < n) {
+            br->overrun = true;
+            br->avail = n;
+        }
+    }
+
+    v = (uint32_t)(br->cache >> (64 - n));
+    br->cache <<= n;
+    br->avail -= n;
+    return v;
+}
+
+static inline int32_t flac_bits_read_signed(FAR flac_bits_s *br, int n)
+{
+    uint32_t v = flac_bits_read(br, n);
+
+    return (int32_t)(v << (32 - n)) >> (32 - n);
+}
+
+/* Count zero bits up to and including the next one bit */
+
+static inline uint32_t flac_bits_unary(FAR flac_bits_s *br)
+{
+    uint32_t zeros = 0;
+    int n;
+
+    while (br->cache == 0) {
+        zeros += br->avail;
+        br->avail = 0;
+        flac_bits_refill(br);
+        if (br->avail == 0) {
+            br->overrun = true;
+            return zeros;
+        }
+    }
+
+    n = __builtin_clzll(br->cache);
+    br->cache <<= n;
+    br->cache <<= 1;
+    br->avail -= n + 1;
+    return zeros + n;
+}
+
+static inline void flac_bits_align(FAR flac_bits_s *br)
+{
+    br->cache <<= br->avail & 7;
+    br->avail &= ~7;
+}
+
+/* Bytes consumed, only valid on a byte boundary */
+
+static inline size_t flac_bits_used(FAR const flac_bits_s *br,
+                                    FAR const uint8_t *start)
+{
+    return (br->p - start) - br->avail / 8;
+}
+
+/**
+ * @brief Parse a frame header
+ * @return Header length including the CRC-8, 0 if len is too short to
+ *         tell, -EINVAL if this is not a header of this stream
+ */
+static int flac_parse_frame_header(FAR const uint8_t *p, size_t len,
+                                   FAR const flac_info_s *info,
+                                   FAR flac_frame_s *frame)
+{
+    uint32_t bs_code;
+    uint32_t sr_code;
+    uint32_t rate;
+    uint64_t number;
+    size_t i = 4;
+    int extra;
+
+    if (len < 4) {
+        return 0;
+    }
+
+    if (p[0] != 0xff || (p[1] & 0xfe) != 0xf8 || (p[3] & 1) != 0) {
+        return -EINVAL;
+    }
+
+    bs_code = p[2] >> 4;
+    sr_code = p[2] & 0x0f;
+    frame->assignment = p[3] >> 4;
+    frame->bits_per_sample = g_flac_sample_sizes[(p[3] >> 1) & 7];
+
+    if (bs_code == 0 || sr_code == 15 || frame->assignment > 10 ||
+        ((p[3] >> 1) & 7) == 3 || ((p[3] >> 1) & 7) == 7) {
+        return -EINVAL;
+    }
+
+    /* UTF-8 style coded frame or sample number */
+
+    if (len < i + 1) {
+        return 0;
+    }
+
+    number = p[i];
+    if (number < 0x80) {
+        extra = 0;
+    } else if ((number & 0xe0) == 0xc0) {
+        number &= 0x1f;
+        extra = 1;
+    } else if ((number & 0xf0) == 0xe0) {
+        number &= 0x0f;
+        extra = 2;
+    } else if ((number & 0xf8) == 0xf0) {
+        number &= 0x07;
+        extra = 3;
+    } else if ((number & 0xfc) == 0xf8) {
+        number &= 0x03;
+        extra = 4;
+    } else if ((number & 0xfe) == 0xfc) {
+        number &= 0x01;
+        extra = 5;
+    } else if (number == 0xfe) {
+        number = 0;
+        extra = 6;
+    } else {
+        return -EINVAL;
+    }
+
+    if (len < i + 1 + extra) {
+        return 0;
+    }
+
+    for (i++; extra > 0; extra--, i++) {
+        if ((p[i] & 0xc0) != 0x80) {
+            return -EINVAL;
+        }
+
+        number = (number << 6) | (p[i] & 0x3f);
+    }
+
+    /* Optional blocksize and rate bytes, then the CRC-8 */
+
+    if (len < i + (bs_code == 6) + 2 * (bs_code == 7) + (sr_code == 12) +
+              2 * (sr_code > 12) + 1) {
+        return 0;
+    }
+
+    if (bs_code == 1) {
+        frame->blocksize = 192;
+    } else if (bs_code <= 5) {
+        frame->blocksize = 576 << (bs_code - 2);
+    } else if (bs_code == 6) {
+        frame->blocksize = p[i++] + 1;
+    } else if (bs_code == 7) {
+        frame->blocksize = ((p[i] << 8) | p[i + 1]) + 1;
+        i += 2;
+    } else {
+        frame->blocksize = 256 << (bs_code - 8);
+    }
+
+    if (sr_code == 0) {
+        rate = info->sample_rate;
+    } else if (sr_code < 12) {
+        rate = g_flac_rates[sr_code];
+    } else if (sr_code == 12) {
+        rate = p[i++] * 1000;
+    } else {
+        rate = (p[i] << 8) | p[i + 1];
+        rate *= sr_code == 14 ? 10 : 1;
+        i += 2;
+    }
+
+    if (flac_crc8(p, i) != p[i]) {
+        return -EINVAL;
+    }
+
+    /* Frames must match STREAMINFO, buffers are sized from it */
+
+    if (frame->bits_per_sample == 0) {
+        frame->bits_per_sample = info->bits_per_sample;
+    }
+
+    frame->channels = frame->assignment < 8 ? frame->assignment + 1 : 2;
+
+    if (rate != info->sample_rate || frame->channels != info->channels ||
+        frame->bits_per_sample != info->bits_per_sample ||
+        frame->blocksize > info->max_blocksize) {
+        return -EINVAL;
+    }
+
+    /* Blocking strategy bit: sample number, otherwise frame number */
+
+    frame->sample = (p[1] & 1) ? number : number * info->max_blocksize;
+    if (info->total_samples != 0 && frame->sample >= info->total_samples) {
+        return -EINVAL;
+    }
+
+    return i + 1;
+}
+
+static int flac_decode_residual(FAR flac_bits_s *br, FAR int32_t *out,
+                                uint32_t blocksize, int order)
+{
+    uint32_t method = flac_bits_read(br, 2);
+    uint32_t porder;
+    uint32_t parts;
+    uint32_t p;
+    int pbits;
+    int escape;
+
+    if (method > 1) {
+        return -EINVAL;
+    }
+
+    pbits = method ? 5 : 4;
+    escape = method ? 31 : 15;
+    porder = flac_bits_read(br, 4);
+    parts = 1u << porder;
+
+    if ((blocksize & (parts - 1)) != 0 || (blocksize >> porder) < (uint32_t)order) {
+        return -EINVAL;
+    }
+
+    for (p = 0; p < parts && !br->overrun; p++) {
+        uint32_t n = (blocksize >> porder) - (p == 0 ? order : 0);
+        int k = flac_bits_read(br, pbits);
+        uint32_t i;
+
+        if (k == escape) {
+            int bits = flac_bits_read(br, 5);
+
+            for (i = 0; i < n; i++) {
+                *out++ = bits ? flac_bits_read_signed(br, bits) : 0;
+            }
+        } else if (k == 0) {
+            for (i = 0; i < n; i++) {
+                uint32_t v = flac_bits_unary(br);
+
+                *out++ = (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+            }
+        } else {
+            for (i = 0; i < n; i++) {
+                uint32_t v = flac_bits_unary(br) << k;
+
+                v |= flac_bits_read(br, k);
+                *out++ = (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+            }
+        }
+    }
+
+    return 0;
+}
+
+static void flac_restore_fixed(FAR int32_t *x, uint32_t n, int order)
+{
+    uint32_t i;
+
+    switch (order) {
+    case 1:
+        for (i = 1; i < n; i++) {
+            x[i] += x[i - 1];
+        }
+        break;
+    case 2:
+        for (i = 2; i < n; i++) {
+            x[i] += 2 * x[i - 1] - x[i - 2];
+        }
+        break;
+    case 3:
+        for (i = 3; i < n; i++) {
+            x[i] += 3 * (x[i - 1] - x[i - 2]) + x[i - 3];
+        }
+        break;
+    case 4:
+        for (i = 4; i < n; i++) {
+            x[i] += 4 * (x[i - 1] + x[i - 3]) - 6 * x[i - 2] - x[i - 4];
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void flac_restore_lpc(FAR int32_t *x, uint32_t n,
+                             FAR const int32_t *coef, int order, int shift,
+                             bool wide)
+{
+    uint32_t i;
+    int j;
+
+    if (wide) {
+        for (i = order; i < n; i++) {
+            int64_t sum = 0;
+
+            for (j = 0; j < order; j++) {
+                sum += (int64_t)coef[j] * x[i - 1 - j];
+            }
+
+            x[i] += (int32_t)(sum >> shift);
+        }
+    } else {
+        for (i = order; i < n; i++) {
+            int32_t sum = 0;
+
+            for (j = 0; j < order; j++) {
+                sum += coef[j] * x[i - 1 - j];
+            }
+
+            x[i] += sum >> shift;
+        }
+    }
+}
+
+static int flac_decode_subframe(FAR flac_bits_s *br, FAR int32_t *out,
+                                uint32_t blocksize, int bps)
+{
+    uint32_t hdr = flac_bits_read(br, 8);
+    uint32_t type = (hdr >> 1) & 0x3f;
+    uint32_t wasted = 0;
+    uint32_t i;
+    int ret = 0;
+
+    if (hdr & 0x80) {
+        return -EINVAL;
+    }
+
+    if (hdr & 1) {
+        wasted = flac_bits_unary(br) + 1;
+        if (wasted >= (uint32_t)bps) {
+            return -EINVAL;
+        }
+
+        bps -= wasted;
+    }
+
+    if (type == 0) {
+        int32_t v = flac_bits_read_signed(br, bps);
+
+        for (i = 0; i < blocksize; i++) {
+            out[i] = v;
+        }
+    } else if (type == 1) {
+        for (i = 0; i < blocksize; i++) {
+            out[i] = flac_bits_read_signed(br, bps);
+        }
+    } else if (type >= 8 && type <= 12) {
+        int order = type - 8;
+
+        if ((uint32_t)order > blocksize) {
+            return -EINVAL;
+        }
+
+        for (i = 0; i < (uint32_t)order; i++) {
+            out[i] = flac_bits_read_signed(br, bps);
+        }
+
+        ret = flac_decode_residual(br, out + order, blocksize, order);
+        if (ret == 0 && !br->overrun) {
+            flac_restore_fixed(out, blocksize, order);
+        }
+    } else if (type >= 32) {
+        int32_t coef[32];
+        int order = type - 31;
+        int precision;
+        int shift;
+        int log2_order = 0;
+
+        if ((uint32_t)order > blocksize) {
+            return -EINVAL;
+        }
+
+        for (i = 0; i < (uint32_t)order; i++) {
+            out[i] = flac_bits_read_signed(br, bps);
+        }
+
+        precision = flac_bits_read(br, 4) + 1;
+        shift = flac_bits_read_signed(br, 5);
+        if (precision == 16 || shift < 0) {
+            return -EINVAL;
+        }
+
+        for (i = 0; i < (uint32_t)order; i++) {
+            coef[i] = flac_bits_read_signed(br, precision);
+        }
+
+        ret = flac_decode_residual(br, out + order, blocksize, order);
+        if (ret == 0 && !br->overrun) {
+            while ((1 << log2_order) < order) {
+                log2_order++;
+            }
+
+            /* 32-bit sums are exact while the worst case fits */
+
+            flac_restore_lpc(out, blocksize, coef, order, shift,
+                             bps + precision + log2_order > 32);
+        }
+    } else {
+        return -EINVAL;
+    }
+
+    if (wasted != 0 && ret == 0) {
+        for (i = 0; i < blocksize; i++) {
+            out[i] = (int32_t)((uint32_t)out[i] << wasted);
+        }
+    }
+
+    return ret;
+}
+
+static void flac_decorrelate(FAR flac_decoder_s *decoder,
+                             FAR const flac_frame_s *frame)
+{
+    FAR int32_t *l = decoder->block[0];
+    FAR int32_t *r = decoder->block[1];
+    uint32_t i;
+
+    switch (frame->assignment) {
+    case FLAC_CH_LEFT_SIDE:
+        for (i = 0; i < frame->blocksize; i++) {
+            r[i] = l[i] - r[i];
+        }
+        break;
+    case FLAC_CH_SIDE_RIGHT:
+        for (i = 0; i < frame->blocksize; i++) {
+            l[i] += r[i];
+        }
+        break;
+    case FLAC_CH_MID_SIDE:
+        for (i = 0; i < frame->blocksize; i++) {
+            int32_t side = r[i];
+            int32_t mid = (int32_t)((uint32_t)l[i] << 1) | (side & 1);
+
+            l[i] = (mid + side) >> 1;
+            r[i] = (mid - side) >> 1;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Decode the next frame of the input buffer into the block
+ * @return 1 when a block was decoded, 0 when more input is needed or the
+ *         stream has ended
+ *
+ * Bytes that do not form a valid frame, a frame failing its CRC-16
+ * included, are skipped and counted as errors.
+ */
+static int flac_decode_frame(FAR flac_decoder_s *decoder)
+{
+    flac_info_s info;
+    flac_frame_s frame;
+    flac_bits_s br;
+
+    memset(&info, 0, sizeof(info));
+    info.sample_rate = decoder->sample_rate;
+    info.channels = decoder->channels;
+    info.bits_per_sample = decoder->bits_per_sample;
+    info.max_blocksize = decoder->max_blocksize;
+
+    for (;;) {
+        FAR const uint8_t *p = decoder->input_buffer + decoder->input_pos;
+        size_t avail = decoder->input_length - decoder->input_pos;
+        size_t skip = 0;
+        int hlen;
+        int ch;
+        int ret = 0;
+
+        if (!decoder->input_eof && avail < decoder->frame_bound) {
+            return 0;
+        }
+
+        /* Frame sync, 0xfff8 or 0xfff9 */
+
+        while (skip + 1 < avail &&
+               (p[skip] != 0xff || (p[skip + 1] & 0xfe) != 0xf8)) {
+            skip++;
+        }
+
+        if (skip + 1 >= avail) {
+            decoder->input_pos += decoder->input_eof ? avail : skip;
+            return 0;
+        }
+
+        if (skip > 0) {
+            decoder->errors++;
+            decoder->input_pos += skip;
+            continue;
+        }
+
+        hlen = flac_parse_frame_header(p, avail, &info, &frame);
+        if (hlen == 0) {
+            /* Header cut by the end of the file */
+
+            if (decoder->input_eof) {
+                decoder->input_pos = decoder->input_length;
+            }
+
+            return 0;
+        }
+
+        if (hlen < 0) {
+            decoder->errors++;
+            decoder->input_pos++;
+            continue;
+        }
+
+        flac_bits_init(&br, p + hlen, avail - hlen);
+
+        for (ch = 0; ch < frame.channels && ret == 0 && !br.overrun; ch++) {
+            int bps = frame.bits_per_sample;
+
+            /* The side channel needs one more bit */
+
+            if ((frame.assignment == FLAC_CH_LEFT_SIDE && ch == 1) ||
+                (frame.assignment == FLAC_CH_SIDE_RIGHT && ch == 0) ||
+                (frame.assignment == FLAC_CH_MID_SIDE && ch == 1)) {
+                bps++;
+            }
+
+            ret = flac_decode_subframe(&br, decoder->block[ch],
+                                       frame.blocksize, bps);
+        }
+
+        if (ret == 0 && !br.overrun) {
+            flac_bits_align(&br);
+            flac_bits_read(&br, 16);    /* CRC-16 of the frame */
+        }
+
+        if (br.overrun && ret == 0) {
+            /* The frame is longer than the bound: fetch more input while
+             * there is room, at the end of the file it was truncated.
+             */
+
+            if (!decoder->input_eof && avail < decoder->buffer_size) {
+                decoder->frame_bound = avail + 1;
+                return 0;
+            }
+
+            ret = -EINVAL;
+        }
+
+        /* A false sync or a damaged frame decodes into noise, only a
+         * matching CRC-16 makes it to the output
+         */
+
+        if (ret == 0 &&
+            flac_crc16(0, p, hlen + flac_bits_used(&br, p + hlen)) != 0) {
+            ret = -EBADMSG;
+        }
+
+        if (ret < 0) {
+            decoder->errors++;
+            decoder->input_pos++;
+            continue;
+        }
+
+        flac_decorrelate(decoder, &frame);
+
+        decoder->input_pos += hlen + flac_bits_used(&br, p + hlen);
+        decoder->block_len = frame.blocksize;
+        decoder->block_pos = 0;
+        return 1;
+    }
+}
+
+static inline int16_t flac_sat16(int32_t v)
+{
+    return v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v;
+}
+
+/* Write count frames of the block from block_pos as 16-bit stereo */
+
+static void flac_decoder_output(FAR flac_decoder_s *decoder,
+                                FAR int16_t *out, uint32_t count)
+{
+    FAR const int32_t *l = decoder->block[0] + decoder->block_pos;
+    FAR const int32_t *r = decoder->channels > 1 ?
+                           decoder->block[1] + decoder->block_pos : l;
+    int bps = decoder->bits_per_sample;
+    uint32_t i;
+
+    if (decoder->downmix != NULL) {
+        int channels = decoder->channels;
+
+        while (count > 0) {
+            uint32_t n = count < FLAC_MIX_FRAMES ? count : FLAC_MIX_FRAMES;
+            FAR uint8_t *mix = decoder->mix_buf;
+            int ch;
+
+            /* Left-justified 32-bit little endian, as in a WAV file */
+
+            for (i = 0; i < n; i++) {
+                for (ch = 0; ch < channels; ch++) {
+                    uint32_t v = (uint32_t)decoder->block[ch][decoder->block_pos + i]
+                                 << (32 - bps);
+
+                    *mix++ = v;
+                    *mix++ = v >> 8;
+                    *mix++ = v >> 16;
+                    *mix++ = v >> 24;
+                }
+            }
+
+            decoder->downmix(out, decoder->mix_buf, n);
+            decoder->block_pos += n;
+            out += 2 * n;
+            count -= n;
+        }
+
+        return;
+    }
+
+    if (bps == 16) {
+        for (i = 0; i < count; i++) {
+            out[2 * i] = l[i];
+            out[2 * i + 1] = r[i];
+        }
+    } else if (bps > 16) {
+        int shift = bps - 16;
+        int32_t round = 1 << (shift - 1);
+
+        for (i = 0; i < count; i++) {
+            out[2 * i] = flac_sat16((l[i] + round) >> shift);
+            out[2 * i + 1] = flac_sat16((r[i] + round) >> shift);
+        }
+    } else {
+        int shift = 16 - bps;
+
+        for (i = 0; i < count; i++) {
+            out[2 * i] = (int16_t)((uint32_t)l[i] << shift);
+            out[2 * i + 1] = (int16_t)((uint32_t)r[i] << shift);
+        }
+    }
+
+    decoder->block_pos += count;
+}
+
+static FAR const uint8_t *flac_scan_peek(FAR flac_scan_s *scan,
+                                         uint32_t offset, uint32_t need)
+{
+    ssize_t n;
+
+    if (offset + need > scan->end) {
+        need = offset < scan->end ? scan->end - offset : 0;
+        if (need == 0) {
+            return NULL;
+        }
+    }
+
+    if (offset >= scan->base && offset + need <= scan->base + scan->len) {
+        return scan->buf + (offset - scan->base);
+    }
+
+    n = pread(scan->fd, scan->buf, sizeof(scan->buf), offset);
+    scan->base = offset;
+    scan->len = n > 0 ? n : 0;
+
+    return need <= scan->len ? scan->buf : NULL;
+}
+
+/* Worst case is a verbatim frame with a side channel */
+
+static size_t flac_frame_bound(FAR const flac_info_s *info)
+{
+    if (info->max_framesize != 0) {
+        return info->max_framesize;
+    }
+
+    return (size_t)info->max_blocksize * info->channels *
+           (info->bits_per_sample + 1) / 8 + 64;
+}
+
+/**
+ * @brief Check that a header found by the scan starts a whole frame
+ *
+ * The frame ends where its CRC-16 comes out right and the next frame, or
+ * the end of the stream, follows on. A sync pattern in the middle of a
+ * frame that happens to pass the CRC-8 fails this.
+ */
+static bool flac_scan_verify(FAR flac_scan_s *scan,
+                             FAR const flac_info_s *info, uint32_t pos,
+                             FAR const flac_frame_s *frame)
+{
+    uint32_t limit = pos + flac_frame_bound(info);
+    uint16_t crc = 0;
+    flac_frame_s next;
+    uint32_t q;
+
+    for (q = pos; q <= limit; q++) {
+        FAR const uint8_t *p;
+
+        if (q > pos && crc == 0) {
+            if (q >= scan->end) {
+                return true;
+            }
+
+            p = flac_scan_peek(scan, q, FLAC_MAX_HEADER);
+            if (p != NULL && p[0] == 0xff &&
+                flac_parse_frame_header(p, scan->end - q < FLAC_MAX_HEADER ?
+                                        scan->end - q : FLAC_MAX_HEADER,
+                                        info, &next) > 0 &&
+                next.sample == frame->sample + frame->blocksize) {
+                return true;
+            }
+        }
+
+        p = flac_scan_peek(scan, q, 1);
+        if (p == NULL) {
+            break;
+        }
+
+        crc = flac_crc16(crc, p, 1);
+    }
+
+    return false;
+}
+
+/* First frame header in [from, limit) that passes flac_scan_verify() */
+
+static int flac_scan_frame(FAR flac_scan_s *scan,
+                           FAR const flac_info_s *info, uint32_t from,
+                           uint32_t limit, FAR uint32_t *offset,
+                           FAR uint64_t *sample)
+{
+    flac_frame_s frame;
+    uint32_t pos;
+
+    for (pos = from; pos < limit; pos++) {
+        FAR const uint8_t *p = flac_scan_peek(scan, pos, FLAC_MAX_HEADER);
+
+        if (p == NULL) {
+            break;
+        }
+
+        if (p[0] != 0xff) {
+            continue;
+        }
+
+        if (flac_parse_frame_header(p, scan->end - pos < FLAC_MAX_HEADER ?
+                                    scan->end - pos : FLAC_MAX_HEADER,
+                                    info, &frame) > 0 &&
+            flac_scan_verify(scan, info, pos, &frame)) {
+            *offset = pos;
+            *sample = frame.sample;
+            return 0;
+        }
+    }
+
+    return -ENOENT;
+}
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+/**
+ * @brief Read STREAMINFO and SEEKTABLE and find the first frame
+ * @param info Filled in, released with flac_info_free()
+ * @param fd Open file, only accessed through pread()
+ * @return 0 on success, -EINVAL if this is not a FLAC stream, -ENOTSUP
+ *         for streams the decoder cannot play
+ */
+int flac_info_read(FAR flac_info_s *info, int fd)
+{
+    uint8_t buf[FLAC_SEEKPOINT_BYTES * 16];
+    struct stat st;
+    uint32_t offset = 0;
+    bool have_streaminfo = false;
+    bool last = false;
+    uint32_t i;
+
+    memset(info, 0, sizeof(flac_info_s));
+
+    if (fstat(fd, &st) < 0) {
+        return -errno;
+    }
+
+    /* Some taggers put an ID3v2 tag in front of the stream marker */
+
+    if (pread(fd, buf, 10, 0) != 10) {
+        return -EINVAL;
+    }
+
+    if (memcmp(buf, "ID3", 3) == 0) {
+        offset = 10 + ((buf[6] & 0x7f) << 21) + ((buf[7] & 0x7f) << 14) +
+                 ((buf[8] & 0x7f) << 7) + (buf[9] & 0x7f);
+        if (buf[5] & 0x10) {
+            offset += 10;
+        }
+    }
+
+    if (pread(fd, buf, 4, offset) != 4 || memcmp(buf, "fLaC", 4) != 0) {
+        return -EINVAL;
+    }
+
+    offset += 4;
+
+    while (!last) {
+        uint32_t type;
+        uint32_t len;
+
+        if (pread(fd, buf, 4, offset) != 4) {
+            goto errout;
+        }
+
+        last = (buf[0] & 0x80) != 0;
+        type = buf[0] & 0x7f;
+        len = flac_be24(buf + 1);
+        offset += 4;
+
+        if (type == 0) {
+            if (len < 34 || pread(fd, buf, 34, offset) != 34) {
+                goto errout;
+            }
+
+            info->min_blocksize = (buf[0] << 8) | buf[1];
+            info->max_blocksize = (buf[2] << 8) | buf[3];
+            info->max_framesize = flac_be24(buf + 7);
+            info->sample_rate = ((uint32_t)buf[10] << 12) | (buf[11] << 4) |
+                                (buf[12] >> 4);
+            info->channels = ((buf[12] >> 1) & 7) + 1;
+            info->bits_per_sample = (((buf[12] & 1) << 4) | (buf[13] >> 4)) + 1;
+            info->total_samples = ((uint64_t)(buf[13] & 0x0f) << 32) |
+                                  ((uint32_t)buf[14] << 24) | (buf[15] << 16) |
+                                  (buf[16] << 8) | buf[17];
+            have_streaminfo = true;
+        } else if (type == 3 && info->points == NULL &&
+                   len >= FLAC_SEEKPOINT_BYTES) {
+            uint32_t n = len / FLAC_SEEKPOINT_BYTES;
+
+            info->points = malloc(n * sizeof(flac_seekpoint_s));
+            if (info->points == NULL) {
+                flac_info_free(info);
+                return -ENOMEM;
+            }
+
+            /* Offsets are relative to the first frame, fixed up below */
+
+            for (i = 0; i < n; i++) {
+                uint32_t k = i % 16;
+                uint64_t sample;
+                uint64_t rel;
+
+                if (k == 0) {
+                    uint32_t chunk = n - i < 16 ? n - i : 16;
+
+                    if (pread(fd, buf, chunk * FLAC_SEEKPOINT_BYTES,
+                              offset + i * FLAC_SEEKPOINT_BYTES) !=
+                        (ssize_t)(chunk * FLAC_SEEKPOINT_BYTES)) {
+                        goto errout;
+                    }
+                }
+
+                sample = flac_be64(buf + k * FLAC_SEEKPOINT_BYTES);
+                rel = flac_be64(buf + k * FLAC_SEEKPOINT_BYTES + 8);
+
+                /* Placeholders, and points out of order or out of the file */
+
+                if (sample == UINT64_MAX || rel >= (uint64_t)st.st_size ||
+                    (info->count > 0 &&
+                     sample <= info->points[info->count - 1].sample)) {
+                    continue;
+                }
+
+                info->points[info->count].sample = sample;
+                info->points[info->count].offset = rel;
+                info->count++;
+            }
+        }
+
+        offset += len;
+    }
+
+    if (!have_streaminfo || info->sample_rate == 0) {
+        goto errout;
+    }
+
+    info->audio_start = offset;
+    info->audio_end = st.st_size;
+
+    for (i = 0; i < info->count; i++) {
+        info->points[i].offset += offset;
+    }
+
+    while (info->count > 0 &&
+           info->points[info->count - 1].offset >= info->audio_end) {
+        info->count--;
+    }
+
+    if (info->bits_per_sample < 4 || info->bits_per_sample > 24 ||
+        info->max_blocksize < 16 ||
+        info->max_blocksize > CONFIG_LVX_MUSIC_PLAYER_FLAC_MAX_BLOCKSIZE) {
+        flac_info_free(info);
+        return -ENOTSUP;
+    }
+
+    return 0;
+
+errout:
+    flac_info_free(info);
+    return -EINVAL;
+}
+
+/**
+ * @brief Find the frame containing a sample
+ * @param info Stream information from flac_info_read()
+ * @param fd File the information was read from
+ * @param sample Target sample
+ * @param offset Returns the file offset of the frame header
+ * @param landed Returns the first sample of that frame
+ * @return 0 on success, negated errno on failure
+ *
+ * The frame found is the last one starting at or before sample, the
+ * decoder drops the samples in front of the target.
+ */
+int flac_info_seek(FAR const flac_info_s *info, int fd, uint64_t sample,
+                   FAR uint32_t *offset, FAR uint64_t *landed)
+{
+    FAR flac_scan_s *scan;
+    uint32_t lo = info->audio_start;
+    uint32_t hi = info->audio_end;
+    uint64_t lo_sample = 0;
+    uint32_t bound;
+    uint32_t found;
+    uint64_t s;
+    uint32_t i;
+
+    for (i = 0; i < info->count; i++) {
+        if (info->points[i].sample > sample) {
+            hi = info->points[i].offset;
+            break;
+        }
+
+        lo = info->points[i].offset;
+        lo_sample = info->points[i].sample;
+    }
+
+    scan = malloc(sizeof(flac_scan_s));
+    if (scan == NULL) {
+        return -ENOMEM;
+    }
+
+    scan->fd = fd;
+    scan->end = info->audio_end;
+    scan->base = 0;
+    scan->len = 0;
+
+    /* Bisect on frame headers down to about one frame... */
+
+    bound = info->max_framesize ? info->max_framesize : FLAC_SCAN_BUFSIZE;
+
+    while (hi - lo > bound) {
+        uint32_t mid = lo + (hi - lo) / 2;
+
+        if (flac_scan_frame(scan, info, mid, hi, &found, &s) < 0 ||
+            s > sample) {
+            hi = mid;
+        } else {
+            lo = found;
+            lo_sample = s;
+        }
+    }
+
+    /* ...then step to the last frame starting at or before the target */
+
+    while (flac_scan_frame(scan, info, lo + 1, info->audio_end, &found,
+                           &s) == 0 && s <= sample && s > lo_sample) {
+        lo = found;
+        lo_sample = s;
+    }
+
+    free(scan);
+
+    *offset = lo;
+    *landed = lo_sample;
+    return 0;
+}
+
+void flac_info_free(FAR flac_info_s *info)
+{
+    free(info->points);
+    info->points = NULL;
+    info->count = 0;
+}
+
+/**
+ * @brief Initialize a decoder for a stream
+ * @param decoder FLAC decoder structure
+ * @param info Stream information from flac_info_read()
+ * @return 0 on success, negated errno on error
+ */
+int flac_decoder_init(FAR flac_decoder_s *decoder,
+                      FAR const flac_info_s *info)
+{
+    FAR int32_t *block;
+    int ch;
+
+    if (!decoder || !info || info->channels == 0 ||
+        info->channels > FLAC_MAX_CHANNELS) {
+        return -EINVAL;
+    }
+
+    memset(decoder, 0, sizeof(flac_decoder_s));
+
+    decoder->channels = info->channels;
+    decoder->bits_per_sample = info->bits_per_sample;
+    decoder->max_blocksize = info->max_blocksize;
+    decoder->sample_rate = info->sample_rate;
+
+    decoder->frame_bound = flac_frame_bound(info);
+    decoder->buffer_size = decoder->frame_bound + FLAC_INPUT_CHUNK;
+    decoder->input_buffer = malloc(decoder->buffer_size);
+
+    block = malloc((size_t)info->max_blocksize * info->channels *
+                   sizeof(int32_t));
+    if (decoder->input_buffer == NULL || block == NULL) {
+        free(block);
+        flac_decoder_cleanup(decoder);
+        return -ENOMEM;
+    }
+
+    for (ch = 0; ch < info->channels; ch++) {
+        decoder->block[ch] = block + (size_t)ch * info->max_blocksize;
+    }
+
+    if (info->channels > 2) {
+        decoder->downmix = pcm_format_select(false, 32, 4, info->channels);
+        decoder->mix_buf = malloc(FLAC_MIX_FRAMES * info->channels * 4);
+        if (decoder->downmix == NULL || decoder->mix_buf == NULL) {
+            flac_decoder_cleanup(decoder);
+            return -ENOMEM;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Forget buffered input and the rest of the current block
+ *
+ * Used after a seek, the next input must start on a frame header.
+ */
+void flac_decoder_reset(FAR flac_decoder_s *decoder)
+{
+    decoder->input_length = 0;
+    decoder->input_pos = 0;
+    decoder->input_eof = false;
+    decoder->block_len = 0;
+    decoder->block_pos = 0;
+}
+
+/**
+ * @brief Carry unconsumed bytes to the front and return the free tail
+ * @param decoder FLAC decoder structure
+ * @param dst Returns where new compressed data should be written
+ * @return Number of bytes that can be written, 0 once input has ended
+ */
+size_t flac_decoder_input_space(FAR flac_decoder_s *decoder,
+                                FAR unsigned char **dst)
+{
+    size_t remaining = decoder->input_length - decoder->input_pos;
+
+    if (decoder->input_eof) {
+        return 0;
+    }
+
+    memmove(decoder->input_buffer,
+            decoder->input_buffer + decoder->input_pos, remaining);
+    decoder->input_length = remaining;
+    decoder->input_pos = 0;
+    *dst = decoder->input_buffer + remaining;
+
+    return decoder->buffer_size - remaining;
+}
+
+/**
+ * @brief Append len freshly written bytes, 0 marks end of input
+ */
+void flac_decoder_input_commit(FAR flac_decoder_s *decoder, size_t len)
+{
+    if (len == 0) {
+        decoder->input_eof = true;
+    }
+
+    decoder->input_length += len;
+}
+
+/**
+ * @brief Decode into out until it is full or input runs short
+ * @param decoder FLAC decoder structure
+ * @param out Interleaved stereo 16-bit output
+ * @param max_samples Capacity of out in samples (both channels)
+ * @return Samples written, 0 when more input is needed or the stream
+ *         has ended
+ */
+int flac_decoder_decode(FAR flac_decoder_s *decoder, FAR int16_t *out,
+                        size_t max_samples)
+{
+    size_t n = 0;
+
+    while (n + 2 <= max_samples) {
+        uint32_t count;
+
+        if (decoder->block_pos >= decoder->block_len) {
+            if (flac_decode_frame(decoder) <= 0) {
+                break;
+            }
+
+            continue;
+        }
+
+        count = decoder->block_len - decoder->block_pos;
+        if (count > (max_samples - n) / 2) {
+            count = (max_samples - n) / 2;
+        }
+
+        flac_decoder_output(decoder, out + n, count);
+        n += 2 * count;
+    }
+
+    return n;
+}
+
+/**
+ * @brief Cleanup FLAC decoder
+ * @param decoder FLAC decoder structure
+ */
+void flac_decoder_cleanup(FAR flac_decoder_s *decoder)
+{
+    if (!decoder) {
+        return;
+    }
+
+    free(decoder->input_buffer);
+    free(decoder->block[0]);
+    free(decoder->mix_buf);
+    memset(decoder, 0, sizeof(flac_decoder_s));
+}
@@ -0,0 +1,114 @@
+/**
+ * @file flac_decoder.h
+ * Streaming FLAC decoder with seektable and bisection seeking
+ */
+
+#ifndef FLAC_DECODER_H
+#define FLAC_DECODER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <nuttx/config.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pcm_format.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Larger blocks are legal but not in the streamable subset, refusing them
+ * bounds the per-channel sample buffers.
+ */
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_FLAC_MAX_BLOCKSIZE
+#define CONFIG_LVX_MUSIC_PLAYER_FLAC_MAX_BLOCKSIZE 16384
+#endif
+
+#define FLAC_MAX_CHANNELS 8
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct flac_seekpoint {
+    uint64_t sample;       /* first sample of the target frame */
+    uint32_t offset;       /* file offset of its frame header */
+} flac_seekpoint_s;
+
+/* STREAMINFO, the location of the frames and the SEEKTABLE */
+
+typedef struct flac_info {
+    uint32_t audio_start;  /* first frame header */
+    uint32_t audio_end;    /* end of the file */
+    uint32_t sample_rate;
+    uint16_t channels;
+    uint16_t bits_per_sample;
+    uint16_t min_blocksize;
+    uint16_t max_blocksize;
+    uint32_t max_framesize;  /* 0 if the encoder did not know */
+    uint64_t total_samples;  /* 0 if unknown */
+
+    FAR flac_seekpoint_s *points;
+    uint32_t count;
+} flac_info_s;
+
+/* Compressed data is pushed in like for mp3_decoder. One decoded block is
+ * held per channel and handed out as 16-bit stereo, a call can stop in
+ * the middle of a block.
+ */
+
+typedef struct flac_decoder {
+    FAR uint8_t *input_buffer;
+    size_t buffer_size;
+    size_t input_length;
+    size_t input_pos;       /* next byte to decode */
+    size_t frame_bound;     /* bytes that surely hold one whole frame */
+    bool input_eof;
+
+    uint16_t channels;
+    uint16_t bits_per_sample;
+    uint16_t max_blocksize;
+    uint32_t sample_rate;
+
+    FAR int32_t *block[FLAC_MAX_CHANNELS];
+    uint32_t block_len;     /* samples per channel in block */
+    uint32_t block_pos;     /* next sample to convert */
+    uint32_t errors;        /* frames skipped for bad headers or data */
+
+    /* More than two channels go through a pcm_format downmix kernel */
+    pcm_format_fn downmix;
+    FAR uint8_t *mix_buf;
+} flac_decoder_s;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+int flac_info_read(FAR flac_info_s *info, int fd);
+int flac_info_seek(FAR const flac_info_s *info, int fd, uint64_t sample,
+                   FAR uint32_t *offset, FAR uint64_t *landed);
+void flac_info_free(FAR flac_info_s *info);
+
+int flac_decoder_init(FAR flac_decoder_s *decoder,
+                      FAR const flac_info_s *info);
+void flac_decoder_reset(FAR flac_decoder_s *decoder);
+size_t flac_decoder_input_space(FAR flac_decoder_s *decoder,
+                                FAR unsigned char **dst);
+void flac_decoder_input_commit(FAR flac_decoder_s *decoder, size_t len);
+int flac_decoder_decode(FAR flac_decoder_s *decoder, FAR int16_t *out,
+                        size_t max_samples);
+void flac_decoder_cleanup(FAR flac_decoder_s *decoder);
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /* FLAC_DECODER_H */
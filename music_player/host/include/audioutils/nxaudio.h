@@ -0,0 +1,102 @@
+/**
+ * @file nxaudio.h
+ * Host build copy of the NuttX audioutils/nxaudio.h API
+ *
+ * Same structures and functions as apps/include/audioutils/nxaudio.h,
+ * with struct ap_buffer_s cut down to the fields the player touches. The
+ * implementation is host/nxaudio_host.c, a simulated output device.
+ */
+
+#ifndef __APPS_INCLUDE_AUDIOUTILS_NXAUDIO_H
+#define __APPS_INCLUDE_AUDIOUTILS_NXAUDIO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <nuttx/config.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* ap_buffer_s flags, as in nuttx/audio/audio.h */
+
+#define AUDIO_APB_OUTPUT_ENQUEUED (1 << 0)
+#define AUDIO_APB_OUTPUT_PROCESS  (1 << 1)
+#define AUDIO_APB_DEQUEUED        (1 << 2)
+#define AUDIO_APB_FINAL           (1 << 3)
+
+/* Messages from the driver to nxaudio_msgloop() */
+
+#define AUDIO_MSG_DEQUEUE         5
+#define AUDIO_MSG_COMPLETE        8
+#define AUDIO_MSG_USER            64
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef FAR void *pthread_addr_t;
+typedef uint32_t apb_samp_t;
+
+struct ap_buffer_s {
+    apb_samp_t nmaxbytes;  /* size of samp */
+    apb_samp_t nbytes;     /* bytes to play */
+    apb_samp_t curbyte;
+    uint16_t nsamples;
+    uint16_t flags;        /* AUDIO_APB_* */
+    FAR uint8_t *samp;
+};
+
+struct audio_msg_s {
+    uint16_t msg_id;
+    uint16_t reserved;
+    union {
+        FAR void *ptr;
+        uint32_t data;
+    } u;
+};
+
+struct nxaudio_s {
+    int fd;
+    int abufnum;
+    FAR struct ap_buffer_s **abufs;
+    int chnum;
+};
+
+struct nxaudio_callbacks_s {
+    void (*dequeue)(unsigned long arg, FAR struct ap_buffer_s *apb);
+    void (*complete)(unsigned long arg);
+    void (*user)(unsigned long arg, FAR struct audio_msg_s *msg,
+                 FAR bool *running);
+};
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+int init_nxaudio(FAR struct nxaudio_s *nxaudio, int fs, int bps, int chnum);
+void fin_nxaudio(FAR struct nxaudio_s *nxaudio);
+int nxaudio_enqbuffer(FAR struct nxaudio_s *nxaudio,
+                      FAR struct ap_buffer_s *apb);
+int nxaudio_setvolume(FAR struct nxaudio_s *nxaudio, uint16_t vol);
+int nxaudio_start(FAR struct nxaudio_s *nxaudio);
+int nxaudio_pause(FAR struct nxaudio_s *nxaudio);
+int nxaudio_resume(FAR struct nxaudio_s *nxaudio);
+int nxaudio_stop(FAR struct nxaudio_s *nxaudio);
+int nxaudio_msgloop(FAR struct nxaudio_s *nxaudio,
+                    FAR struct nxaudio_callbacks_s *cbs,
+                    unsigned long arg);
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /* __APPS_INCLUDE_AUDIOUTILS_NXAUDIO_H */
@@ -0,0 +1,134 @@
+/**
+ * @file config.h
+ * Host build configuration, stands in for the NuttX generated config.h
+ *
+ * The Kconfig defaults of the music player, plus the benchmarks and the
+ * play latency trace. Numeric options can be overridden with -D on the
+ * compiler command line, MP3 support is added by build_host.sh when
+ * libmad is installed.
+ */
+
+#ifndef __INCLUDE_NUTTX_CONFIG_H
+#define __INCLUDE_NUTTX_CONFIG_H
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* NuttX toolchain qualifiers */
+
+#ifndef FAR
+#define FAR
+#endif
+
+#define CONFIG_LVX_USE_DEMO_MUSIC_PLAYER 1
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_DATA_ROOT
+#define CONFIG_LVX_MUSIC_PLAYER_DATA_ROOT "."
+#endif
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_RING_MS
+#define CONFIG_LVX_MUSIC_PLAYER_RING_MS 300
+#endif
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_READAHEAD_BLOCK
+#define CONFIG_LVX_MUSIC_PLAYER_READAHEAD_BLOCK 8192
+#endif
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_READAHEAD_DEPTH
+#define CONFIG_LVX_MUSIC_PLAYER_READAHEAD_DEPTH 4
+#endif
+
+/* Adaptive output buffering */
+
+#define CONFIG_LVX_MUSIC_PLAYER_ADAPTIVE_BUFFERS 1
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_OUTPUT_MIN_BUFS
+#define CONFIG_LVX_MUSIC_PLAYER_OUTPUT_MIN_BUFS 2
+#endif
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_OUTPUT_MAX_BUFS
+#define CONFIG_LVX_MUSIC_PLAYER_OUTPUT_MAX_BUFS 8
+#endif
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_OUTPUT_MIN_MS
+#define CONFIG_LVX_MUSIC_PLAYER_OUTPUT_MIN_MS 5
+#endif
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_OUTPUT_MAX_MS
+#define CONFIG_LVX_MUSIC_PLAYER_OUTPUT_MAX_MS 40
+#endif
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_OUTPUT_STABLE_MS
+#define CONFIG_LVX_MUSIC_PLAYER_OUTPUT_STABLE_MS 3000
+#endif
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_PROBE_CACHE
+#define CONFIG_LVX_MUSIC_PLAYER_PROBE_CACHE 16
+#endif
+
+/* Telemetry and the play latency trace */
+
+#define CONFIG_LVX_MUSIC_PLAYER_TELEMETRY 1
+#define CONFIG_LVX_MUSIC_PLAYER_PLAY_TRACE 1
+#define CONFIG_LVX_MUSIC_PLAYER_BENCHMARKS 1
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_PLAY_LATENCY_BUDGET_MS
+#define CONFIG_LVX_MUSIC_PLAYER_PLAY_LATENCY_BUDGET_MS 200
+#endif
+
+/* Gapless playback */
+
+#define CONFIG_LVX_MUSIC_PLAYER_GAPLESS 1
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_GAPLESS_PRELOAD_MS
+#define CONFIG_LVX_MUSIC_PLAYER_GAPLESS_PRELOAD_MS 5000
+#endif
+
+/* Parametric equalizer, flat unless a preset is given */
+
+#define CONFIG_LVX_MUSIC_PLAYER_EQ 1
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_EQ_BANDS
+#define CONFIG_LVX_MUSIC_PLAYER_EQ_BANDS 5
+#endif
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_EQ_PRESET
+#define CONFIG_LVX_MUSIC_PLAYER_EQ_PRESET ""
+#endif
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_EQ_RAMP_MS
+#define CONFIG_LVX_MUSIC_PLAYER_EQ_RAMP_MS 20
+#endif
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_EQ_CYCLE_BUDGET
+#define CONFIG_LVX_MUSIC_PLAYER_EQ_CYCLE_BUDGET 120
+#endif
+
+/* Formats */
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_MP3_SUPPORT
+#ifndef CONFIG_LVX_MUSIC_PLAYER_MP3_BUFFER_SIZE
+#define CONFIG_LVX_MUSIC_PLAYER_MP3_BUFFER_SIZE 8192
+#endif
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_MP3_INDEX_MS
+#define CONFIG_LVX_MUSIC_PLAYER_MP3_INDEX_MS 500
+#endif
+
+#define CONFIG_LVX_MUSIC_PLAYER_MP3_INDEX_CACHE 1
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_MP3_INDEX_CACHE_KB
+#define CONFIG_LVX_MUSIC_PLAYER_MP3_INDEX_CACHE_KB 256
+#endif
+#endif
+
+#define CONFIG_LVX_MUSIC_PLAYER_FLAC_SUPPORT 1
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_FLAC_MAX_BLOCKSIZE
+#define CONFIG_LVX_MUSIC_PLAYER_FLAC_MAX_BLOCKSIZE 16384
+#endif
+
+#define CONFIG_LVX_MUSIC_PLAYER_ADPCM_SUPPORT 1
+
+#endif /* __INCLUDE_NUTTX_CONFIG_H */
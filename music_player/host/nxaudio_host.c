@@ -0,0 +1,794 @@
+/**
+ * @file nxaudio_host.c
+ * Simulated nxaudio output device for host builds
+ *
+ * Implements audioutils/nxaudio.h on Linux so audio_ctl and the benchmarks
+ * run without audio hardware. The device plays the buffers queued by
+ * nxaudio_enqbuffer() one after the other on a simulated clock, writes
+ * them to a WAV file or drops them, and hands each back through the
+ * dequeue callback of nxaudio_msgloop(), which runs the whole device on
+ * the caller's thread.
+ *
+ * Device time starts at 0 in init_nxaudio(), stands still until
+ * nxaudio_start() and while paused, and otherwise runs speed_pct / 100
+ * times as fast as the wall clock. At speed 0 it jumps straight to the
+ * next event and the callbacks run back to back; the player then pads
+ * whatever its decoder has not produced yet with silence, so only a finite
+ * speed gives a WAV file worth comparing.
+ *
+ * Faults are injected on the device clock:
+ *   jitter      each dequeue is delivered up to jitter_us after its
+ *               buffer finished playing
+ *   underrun    for underrun_ms out of every underrun_every_ms no dequeue
+ *               is delivered while the device keeps playing, so the
+ *               player gets its buffers back too late
+ *   stall       every stall_every_ms the device stops for stall_ms
+ *               before its next buffer
+ * A buffer that reaches the device after the previous one has finished
+ * counts as an underrun; the gap, and every stall, is written to the WAV
+ * file as silence, so the file is what a listener would have heard.
+ *
+ * Without nxaudio_host_configure() the device is set up from the
+ * environment: NXAUDIO_HOST_SPEED (factor, default 1), NXAUDIO_HOST_WAV,
+ * NXAUDIO_HOST_BUFFERS, NXAUDIO_HOST_BUFFER_BYTES, NXAUDIO_HOST_JITTER_US,
+ * NXAUDIO_HOST_UNDERRUN_MS, NXAUDIO_HOST_UNDERRUN_EVERY_MS,
+ * NXAUDIO_HOST_STALL_MS, NXAUDIO_HOST_STALL_EVERY_MS, NXAUDIO_HOST_SEED
+ * and NXAUDIO_HOST_VERBOSE.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "nxaudio_host.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* A NuttX audio driver without board overrides */
+
+#define HOST_DEFAULT_BUFFERS      2
+#define HOST_DEFAULT_BUFFER_BYTES 8192
+
+#define HOST_MAX_BUFFERS          64
+#define HOST_WAV_HEADER           44
+#define HOST_PATH_MAX             256
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct host_queued {
+    FAR struct ap_buffer_s *apb;
+    uint64_t at;                  /* device time it was queued or played */
+} host_queued_s;
+
+typedef struct nxaudio_host {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+
+    nxaudio_host_config_s config;
+    bool configured;
+    nxaudio_host_stats_s stats;
+
+    /* Session, from init_nxaudio() to fin_nxaudio() */
+    bool open;
+    uint32_t byterate;
+    uint32_t blockalign;
+    int bps;
+    FAR struct ap_buffer_s *bufs;
+    FAR struct ap_buffer_s **abufs;
+    FAR uint8_t *mem;
+    FAR FILE *wav;
+    uint64_t wav_bytes;
+    uint32_t rand;
+    nxaudio_host_stats_s session;
+
+    /* Buffers waiting for the device, and played ones for the player */
+    host_queued_s queue[HOST_MAX_BUFFERS];
+    int queue_head;
+    int queue_count;
+    host_queued_s done[HOST_MAX_BUFFERS];
+    int done_head;
+    int done_count;
+
+    /* Device clock, us of device time */
+    bool started;
+    bool paused;
+    bool stopping;
+    uint64_t clock_base;          /* device time at wall_base */
+    uint64_t wall_base;
+    uint64_t dev_us;              /* end of everything played so far */
+    uint64_t dur_rem;             /* sub-us remainder of dev_us */
+    FAR struct ap_buffer_s *playing;
+    uint64_t playing_end;
+    uint64_t next_stall;
+    uint64_t last_delivery;
+    uint64_t held_window;
+    bool drained;                 /* a final buffer ended the stream */
+    bool complete;                /* complete callback due */
+} nxaudio_host_s;
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+static nxaudio_host_s g_host = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static uint64_t host_wall_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint32_t host_env(FAR const char *name, uint32_t def)
+{
+    FAR const char *value = getenv(name);
+
+    return value != NULL && *value != '\0' ? strtoul(value, NULL, 0) : def;
+}
+
+static uint32_t host_random(FAR nxaudio_host_s *h)
+{
+    /* xorshift32 */
+
+    h->rand ^= h->rand << 13;
+    h->rand ^= h->rand >> 17;
+    h->rand ^= h->rand << 5;
+    return h->rand;
+}
+
+/**
+ * @brief Current device time, with the lock held
+ */
+static uint64_t host_now(FAR nxaudio_host_s *h)
+{
+    if (!h->started || h->paused || h->config.speed_pct == 0) {
+        return h->clock_base;
+    }
+
+    return h->clock_base +
+           (host_wall_us() - h->wall_base) * h->config.speed_pct / 100;
+}
+
+static void host_run_clock(FAR nxaudio_host_s *h)
+{
+    h->wall_base = host_wall_us();
+}
+
+static void host_stop_clock(FAR nxaudio_host_s *h)
+{
+    h->clock_base = host_now(h);
+}
+
+static void host_wav_header(FAR nxaudio_host_s *h, int fs, int chnum)
+{
+    uint8_t hdr[HOST_WAV_HEADER];
+    uint32_t data = h->wav_bytes > UINT32_MAX - HOST_WAV_HEADER ?
+                    UINT32_MAX - HOST_WAV_HEADER : (uint32_t)h->wav_bytes;
+    uint32_t fields[] = {
+        36 + data, 16, 1 | (chnum << 16), fs, h->byterate,
+        h->blockalign | (h->bps << 16), data
+    };
+    FAR uint8_t *p;
+    int i;
+
+    memcpy(hdr, "RIFF", 4);
+    memcpy(hdr + 8, "WAVEfmt ", 8);
+    memcpy(hdr + 36, "data", 4);
+
+    /* Little endian, whatever the host */
+
+    for (i = 0; i < 7; i++)
+    {
+        p = hdr + (i == 0 ? 4 : i == 6 ? 40 : 12 + 4 * i);
+        p[0] = fields[i];
+        p[1] = fields[i] >> 8;
+        p[2] = fields[i] >> 16;
+        p[3] = fields[i] >> 24;
+    }
+
+    fseek(h->wav, 0, SEEK_SET);
+    fwrite(hdr, 1, sizeof(hdr), h->wav);
+    fseek(h->wav, 0, SEEK_END);
+}
+
+static void host_wav_open(FAR nxaudio_host_s *h, int fs, int chnum)
+{
+    char path[HOST_PATH_MAX];
+
+    if (h->config.wav_path == NULL || h->config.wav_path[0] == '\0') {
+        return;
+    }
+
+    snprintf(path, sizeof(path), h->config.wav_path, h->stats.sessions);
+    h->wav = fopen(path, "wb");
+    if (h->wav == NULL) {
+        printf("nxaudio_host: cannot write %s\n", path);
+        return;
+    }
+
+    h->wav_bytes = 0;
+    host_wav_header(h, fs, chnum);
+}
+
+/**
+ * @brief Silence for a stall or an underrun, in whole frames
+ */
+static void host_wav_silence(FAR nxaudio_host_s *h, uint64_t us)
+{
+    static uint8_t zero[4096];
+    static uint8_t zero8[4096];
+    uint64_t n;
+    size_t len;
+
+    if (h->wav == NULL) {
+        return;
+    }
+
+    n = us * h->byterate / 1000000;
+    n -= n % h->blockalign;
+    h->wav_bytes += n;
+
+    if (zero8[0] == 0) {
+        memset(zero8, 0x80, sizeof(zero8));
+    }
+
+    while (n > 0)
+    {
+        len = n > sizeof(zero) ? sizeof(zero) : n;
+        fwrite(h->bps == 8 ? zero8 : zero, 1, len, h->wav);
+        n -= len;
+    }
+}
+
+/**
+ * @brief Move the next queued buffer onto the device
+ */
+static void host_play_next(FAR nxaudio_host_s *h)
+{
+    FAR host_queued_s *q = &h->queue[h->queue_head];
+    uint64_t start = h->dev_us;
+    uint64_t us;
+
+    h->queue_head = (h->queue_head + 1) % HOST_MAX_BUFFERS;
+    h->queue_count--;
+
+    /* Queued after the device ran out. The first buffers of the session
+     * and of a stream after its final buffer wait for nothing.
+     */
+
+    if (q->at > start) {
+        if (h->session.buffers > 0 && !h->drained) {
+            h->session.underruns++;
+            h->session.starved_us += q->at - start;
+            host_wav_silence(h, q->at - start);
+        }
+
+        start = q->at;
+    }
+
+    h->drained = false;
+
+    if (h->config.stall_ms > 0 && h->config.stall_every_ms > 0 &&
+        start >= h->next_stall) {
+        us = (uint64_t)h->config.stall_ms * 1000;
+        h->session.stalls++;
+        host_wav_silence(h, us);
+        start += us;
+
+        while (h->next_stall <= start)
+        {
+            h->next_stall += (uint64_t)h->config.stall_every_ms * 1000;
+        }
+    }
+
+    /* Play time in us, carrying the remainder so long runs do not drift */
+
+    us = (uint64_t)q->apb->nbytes * 1000000 + h->dur_rem;
+    h->dur_rem = us % h->byterate;
+
+    h->playing = q->apb;
+    h->playing_end = start + us / h->byterate;
+    h->dev_us = start;
+}
+
+/**
+ * @brief The buffer on the device has been played, schedule its dequeue
+ */
+static void host_played(FAR nxaudio_host_s *h)
+{
+    FAR struct ap_buffer_s *apb = h->playing;
+    FAR host_queued_s *d;
+    uint64_t every = (uint64_t)h->config.underrun_every_ms * 1000;
+    uint64_t hold = (uint64_t)h->config.underrun_ms * 1000;
+    uint64_t at;
+    uint64_t w;
+
+    h->playing = NULL;
+    h->dev_us = h->playing_end;
+
+    if (h->wav != NULL) {
+        fwrite(apb->samp, 1, apb->nbytes, h->wav);
+        h->wav_bytes += apb->nbytes;
+    }
+
+    h->session.buffers++;
+    h->session.bytes += apb->nbytes;
+
+    at = h->dev_us;
+    if (h->config.jitter_us > 0) {
+        at += host_random(h) % (h->config.jitter_us + 1);
+    }
+
+    /* Held back until the end of the underrun window, the first window
+     * opens one period into the session.
+     */
+
+    if (every > 0 && hold > 0) {
+        w = at / every;
+        if (w > 0 && at % every < hold) {
+            at = w * every + hold;
+            if (w != h->held_window) {
+                h->held_window = w;
+                h->session.held++;
+            }
+        }
+    }
+
+    /* The driver's message queue keeps its order */
+
+    if (at < h->last_delivery) {
+        at = h->last_delivery;
+    }
+
+    h->last_delivery = at;
+
+    if (at - h->dev_us > h->session.max_late_us) {
+        h->session.max_late_us = at - h->dev_us;
+    }
+
+    d = &h->done[(h->done_head + h->done_count) % HOST_MAX_BUFFERS];
+    d->apb = apb;
+    d->at = at;
+    h->done_count++;
+
+    if (apb->flags & AUDIO_APB_FINAL) {
+        h->drained = true;
+        h->complete = true;
+    }
+}
+
+static void host_fold_stats(FAR nxaudio_host_stats_s *total,
+                            FAR const nxaudio_host_stats_s *s)
+{
+    total->buffers += s->buffers;
+    total->bytes += s->bytes;
+    total->underruns += s->underruns;
+    total->starved_us += s->starved_us;
+    total->stalls += s->stalls;
+    total->held += s->held;
+    if (s->max_late_us > total->max_late_us) {
+        total->max_late_us = s->max_late_us;
+    }
+}
+
+static void host_print(FAR const char *what,
+                       FAR const nxaudio_host_stats_s *s)
+{
+    printf("nxaudio_host: %s %u buffers, %llu bytes, %u underruns "
+           "(%llu us starved), %u stalls, %u held windows, "
+           "dequeue up to %u us late\n",
+           what, (unsigned)s->buffers, (unsigned long long)s->bytes,
+           (unsigned)s->underruns, (unsigned long long)s->starved_us,
+           (unsigned)s->stalls, (unsigned)s->held,
+           (unsigned)s->max_late_us);
+}
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+/**
+ * @brief The device model described by the NXAUDIO_HOST_* variables
+ */
+void nxaudio_host_default_config(FAR nxaudio_host_config_s *config)
+{
+    FAR const char *speed = getenv("NXAUDIO_HOST_SPEED");
+
+    memset(config, 0, sizeof(*config));
+
+    config->speed_pct = speed != NULL && *speed != '\0' ?
+                        (uint32_t)(strtod(speed, NULL) * 100 + 0.5) : 100;
+    config->wav_path = getenv("NXAUDIO_HOST_WAV");
+    config->buffers = host_env("NXAUDIO_HOST_BUFFERS",
+                               HOST_DEFAULT_BUFFERS);
+    config->buffer_bytes = host_env("NXAUDIO_HOST_BUFFER_BYTES",
+                                    HOST_DEFAULT_BUFFER_BYTES);
+    config->jitter_us = host_env("NXAUDIO_HOST_JITTER_US", 0);
+    config->underrun_ms = host_env("NXAUDIO_HOST_UNDERRUN_MS", 0);
+    config->underrun_every_ms = host_env("NXAUDIO_HOST_UNDERRUN_EVERY_MS",
+                                         0);
+    config->stall_ms = host_env("NXAUDIO_HOST_STALL_MS", 0);
+    config->stall_every_ms = host_env("NXAUDIO_HOST_STALL_EVERY_MS", 0);
+    config->seed = host_env("NXAUDIO_HOST_SEED", 1);
+    config->verbose = host_env("NXAUDIO_HOST_VERBOSE", 0) != 0;
+}
+
+/**
+ * @brief Device model for the next init_nxaudio()
+ * @param config copied, wav_path must stay valid
+ */
+void nxaudio_host_configure(FAR const nxaudio_host_config_s *config)
+{
+    pthread_mutex_lock(&g_host.lock);
+    g_host.config = *config;
+    g_host.configured = true;
+    pthread_mutex_unlock(&g_host.lock);
+}
+
+/**
+ * @brief Totals of the closed sessions and the open one
+ */
+void nxaudio_host_get_stats(FAR nxaudio_host_stats_s *stats)
+{
+    pthread_mutex_lock(&g_host.lock);
+    *stats = g_host.stats;
+    if (g_host.open) {
+        host_fold_stats(stats, &g_host.session);
+    }
+
+    pthread_mutex_unlock(&g_host.lock);
+}
+
+void nxaudio_host_reset_stats(void)
+{
+    pthread_mutex_lock(&g_host.lock);
+    memset(&g_host.stats, 0, sizeof(g_host.stats));
+    memset(&g_host.session, 0, sizeof(g_host.session));
+    pthread_mutex_unlock(&g_host.lock);
+}
+
+void nxaudio_host_print_stats(void)
+{
+    nxaudio_host_stats_s stats;
+    char what[32];
+
+    nxaudio_host_get_stats(&stats);
+    snprintf(what, sizeof(what), "%u sessions,", (unsigned)stats.sessions);
+    host_print(what, &stats);
+}
+
+int init_nxaudio(FAR struct nxaudio_s *nxaudio, int fs, int bps, int chnum)
+{
+    FAR nxaudio_host_s *h = &g_host;
+    uint32_t nbufs;
+    uint32_t size;
+    uint32_t i;
+
+    if (fs <= 0 || chnum < 1 || chnum > 8 ||
+        (bps != 8 && bps != 16 && bps != 24 && bps != 32)) {
+        return -EINVAL;
+    }
+
+    pthread_mutex_lock(&h->lock);
+
+    if (h->open) {
+        pthread_mutex_unlock(&h->lock);
+        return -EBUSY;
+    }
+
+    if (!h->configured) {
+        nxaudio_host_default_config(&h->config);
+        h->configured = true;
+    }
+
+    nbufs = h->config.buffers;
+    if (nbufs < 1) {
+        nbufs = 1;
+    } else if (nbufs > HOST_MAX_BUFFERS) {
+        nbufs = HOST_MAX_BUFFERS;
+    }
+
+    h->blockalign = chnum * (bps / 8);
+    h->byterate = fs * h->blockalign;
+    h->bps = bps;
+
+    size = h->config.buffer_bytes - h->config.buffer_bytes % h->blockalign;
+    if (size == 0) {
+        size = h->blockalign;
+    }
+
+    h->bufs = calloc(nbufs, sizeof(struct ap_buffer_s));
+    h->abufs = calloc(nbufs, sizeof(FAR struct ap_buffer_s *));
+    h->mem = malloc((size_t)nbufs * size);
+    if (h->bufs == NULL || h->abufs == NULL || h->mem == NULL) {
+        free(h->bufs);
+        free(h->abufs);
+        free(h->mem);
+        pthread_mutex_unlock(&h->lock);
+        return -ENOMEM;
+    }
+
+    for (i = 0; i < nbufs; i++)
+    {
+        h->bufs[i].nmaxbytes = size;
+        h->bufs[i].samp = h->mem + (size_t)i * size;
+        h->abufs[i] = &h->bufs[i];
+    }
+
+    memset(&h->session, 0, sizeof(h->session));
+    h->queue_head = 0;
+    h->queue_count = 0;
+    h->done_head = 0;
+    h->done_count = 0;
+    h->started = false;
+    h->paused = false;
+    h->stopping = false;
+    h->clock_base = 0;
+    h->dev_us = 0;
+    h->dur_rem = 0;
+    h->playing = NULL;
+    h->next_stall = (uint64_t)h->config.stall_every_ms * 1000;
+    h->last_delivery = 0;
+    h->held_window = 0;
+    h->drained = false;
+    h->complete = false;
+    h->rand = h->config.seed != 0 ? h->config.seed : 1;
+    h->open = true;
+
+    host_wav_open(h, fs, chnum);
+
+    pthread_mutex_unlock(&h->lock);
+
+    nxaudio->fd = -1;
+    nxaudio->abufnum = nbufs;
+    nxaudio->abufs = h->abufs;
+    nxaudio->chnum = chnum;
+
+    return 0;
+}
+
+void fin_nxaudio(FAR struct nxaudio_s *nxaudio)
+{
+    FAR nxaudio_host_s *h = &g_host;
+
+    pthread_mutex_lock(&h->lock);
+
+    if (!h->open) {
+        pthread_mutex_unlock(&h->lock);
+        return;
+    }
+
+    if (h->wav != NULL) {
+        host_wav_header(h, h->byterate / h->blockalign, nxaudio->chnum);
+        fclose(h->wav);
+        h->wav = NULL;
+    }
+
+    if (h->config.verbose) {
+        host_print("session", &h->session);
+    }
+
+    h->stats.sessions++;
+    host_fold_stats(&h->stats, &h->session);
+    memset(&h->session, 0, sizeof(h->session));
+
+    free(h->bufs);
+    free(h->abufs);
+    free(h->mem);
+    h->bufs = NULL;
+    h->abufs = NULL;
+    h->mem = NULL;
+    h->open = false;
+
+    pthread_mutex_unlock(&h->lock);
+
+    nxaudio->abufs = NULL;
+    nxaudio->abufnum = 0;
+}
+
+int nxaudio_enqbuffer(FAR struct nxaudio_s *nxaudio,
+                      FAR struct ap_buffer_s *apb)
+{
+    FAR nxaudio_host_s *h = &g_host;
+    FAR host_queued_s *q;
+
+    pthread_mutex_lock(&h->lock);
+
+    if (!h->open || h->queue_count == HOST_MAX_BUFFERS) {
+        pthread_mutex_unlock(&h->lock);
+        return -EINVAL;
+    }
+
+    q = &h->queue[(h->queue_head + h->queue_count) % HOST_MAX_BUFFERS];
+    q->apb = apb;
+    q->at = host_now(h);
+    h->queue_count++;
+
+    pthread_cond_broadcast(&h->cond);
+    pthread_mutex_unlock(&h->lock);
+
+    return 0;
+}
+
+int nxaudio_setvolume(FAR struct nxaudio_s *nxaudio, uint16_t vol)
+{
+    /* Written to the file as it was played, like a digital tap */
+
+    return 0;
+}
+
+int nxaudio_start(FAR struct nxaudio_s *nxaudio)
+{
+    FAR nxaudio_host_s *h = &g_host;
+
+    pthread_mutex_lock(&h->lock);
+    if (!h->started) {
+        h->started = true;
+        h->paused = false;
+        host_run_clock(h);
+    }
+
+    pthread_cond_broadcast(&h->cond);
+    pthread_mutex_unlock(&h->lock);
+
+    return 0;
+}
+
+int nxaudio_pause(FAR struct nxaudio_s *nxaudio)
+{
+    FAR nxaudio_host_s *h = &g_host;
+
+    pthread_mutex_lock(&h->lock);
+    if (h->started && !h->paused) {
+        host_stop_clock(h);
+        h->paused = true;
+    }
+
+    pthread_cond_broadcast(&h->cond);
+    pthread_mutex_unlock(&h->lock);
+
+    return 0;
+}
+
+int nxaudio_resume(FAR struct nxaudio_s *nxaudio)
+{
+    FAR nxaudio_host_s *h = &g_host;
+
+    pthread_mutex_lock(&h->lock);
+    if (h->paused) {
+        h->paused = false;
+        host_run_clock(h);
+    }
+
+    pthread_cond_broadcast(&h->cond);
+    pthread_mutex_unlock(&h->lock);
+
+    return 0;
+}
+
+int nxaudio_stop(FAR struct nxaudio_s *nxaudio)
+{
+    FAR nxaudio_host_s *h = &g_host;
+
+    pthread_mutex_lock(&h->lock);
+    h->stopping = true;
+    pthread_cond_broadcast(&h->cond);
+    pthread_mutex_unlock(&h->lock);
+
+    return 0;
+}
+
+/**
+ * @brief Run the device until nxaudio_stop(), callbacks on this thread
+ */
+int nxaudio_msgloop(FAR struct nxaudio_s *nxaudio,
+                    FAR struct nxaudio_callbacks_s *cbs,
+                    unsigned long arg)
+{
+    FAR nxaudio_host_s *h = &g_host;
+    FAR struct ap_buffer_s *apb;
+    struct timespec ts;
+    uint64_t next;
+    uint64_t wall;
+    uint64_t now;
+
+    pthread_mutex_lock(&h->lock);
+
+    while (!h->stopping)
+    {
+        now = host_now(h);
+
+        if (h->playing != NULL && h->playing_end <= now) {
+            host_played(h);
+            continue;
+        }
+
+        if (h->done_count > 0 && h->done[h->done_head].at <= now) {
+            apb = h->done[h->done_head].apb;
+            h->done_head = (h->done_head + 1) % HOST_MAX_BUFFERS;
+            h->done_count--;
+
+            pthread_mutex_unlock(&h->lock);
+            if (cbs->dequeue != NULL) {
+                cbs->dequeue(arg, apb);
+            }
+
+            pthread_mutex_lock(&h->lock);
+            continue;
+        }
+
+        if (h->complete && h->done_count == 0) {
+            h->complete = false;
+
+            pthread_mutex_unlock(&h->lock);
+            if (cbs->complete != NULL) {
+                cbs->complete(arg);
+            }
+
+            pthread_mutex_lock(&h->lock);
+            continue;
+        }
+
+        if (h->playing == NULL && h->queue_count > 0 && h->started &&
+            !h->paused) {
+            host_play_next(h);
+            continue;
+        }
+
+        /* Sleep until the next event, or until the player does something */
+
+        next = UINT64_MAX;
+        if (h->playing != NULL) {
+            next = h->playing_end;
+        }
+
+        if (h->done_count > 0 && h->done[h->done_head].at < next) {
+            next = h->done[h->done_head].at;
+        }
+
+        if (!h->started || h->paused || next == UINT64_MAX) {
+            pthread_cond_wait(&h->cond, &h->lock);
+            continue;
+        }
+
+        if (h->config.speed_pct == 0) {
+            h->clock_base = next;
+            continue;
+        }
+
+        wall = h->wall_base + ((next - h->clock_base) * 100 +
+                               h->config.speed_pct - 1) / h->config.speed_pct;
+
+        /* pthread_cond_timedwait() takes CLOCK_REALTIME */
+
+        clock_gettime(CLOCK_REALTIME, &ts);
+        wall = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000 +
+               (int64_t)(wall - host_wall_us());
+        ts.tv_sec = wall / 1000000;
+        ts.tv_nsec = (wall % 1000000) * 1000;
+
+        pthread_cond_timedwait(&h->cond, &h->lock, &ts);
+    }
+
+    pthread_mutex_unlock(&h->lock);
+
+    return 0;
+}
@@ -0,0 +1,66 @@
+/**
+ * @file nxaudio_host.h
+ * Simulated nxaudio output device for host builds
+ */
+
+#ifndef NXAUDIO_HOST_H
+#define NXAUDIO_HOST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <audioutils/nxaudio.h>
+#include <stdint.h>
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* Device model, read by init_nxaudio(). Times are device time, which runs
+ * speed_pct / 100 times as fast as the wall clock.
+ */
+
+typedef struct nxaudio_host_config {
+    uint32_t speed_pct;          /* 100 real time, 0 never waits */
+    FAR const char *wav_path;    /* NULL null sink, "%d" session number */
+    uint32_t buffers;            /* driver buffers handed to the player */
+    uint32_t buffer_bytes;
+    uint32_t jitter_us;          /* dequeue delivered up to this late */
+    uint32_t stall_ms;           /* device stops playing ... */
+    uint32_t stall_every_ms;     /* ... this often */
+    uint32_t underrun_ms;        /* dequeues held back ... */
+    uint32_t underrun_every_ms;  /* ... this often, the queue runs dry */
+    uint32_t seed;
+    bool verbose;                /* one line per session on stdout */
+} nxaudio_host_config_s;
+
+typedef struct nxaudio_host_stats {
+    uint32_t sessions;
+    uint32_t buffers;            /* played */
+    uint64_t bytes;
+    uint32_t underruns;          /* the device found its queue empty */
+    uint64_t starved_us;         /* device time spent waiting for data */
+    uint32_t stalls;             /* injected */
+    uint32_t held;               /* injected underrun windows */
+    uint32_t max_late_us;        /* worst dequeue delivery delay */
+} nxaudio_host_stats_s;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+void nxaudio_host_default_config(FAR nxaudio_host_config_s *config);
+void nxaudio_host_configure(FAR const nxaudio_host_config_s *config);
+void nxaudio_host_get_stats(FAR nxaudio_host_stats_s *stats);
+void nxaudio_host_reset_stats(void);
+void nxaudio_host_print_stats(void);
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /* NXAUDIO_HOST_H */
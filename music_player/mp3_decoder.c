@@ -0,0 +1,208 @@
+/**
+ * @file mp3_decoder.c
+ * Re-entrant streaming MP3 decoder on top of libmad
+ *
+ * Compressed data is pushed in with mp3_decoder_input_space() and
+ * mp3_decoder_input_commit(); bytes libmad has not consumed yet are carried
+ * to the front of the buffer before every refill. mp3_decoder_decode()
+ * converts synthesized frames to interleaved 16-bit stereo with the
+ * pcm_convert kernels and can stop in the middle of a frame, the next call
+ * resumes where it left off.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "mp3_decoder.h"
+#include "pcm_convert.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+/**
+ * @brief Initialize MP3 decoder
+ * @param decoder MP3 decoder structure
+ * @return 0 on success, negated errno on error
+ */
+int mp3_decoder_init(FAR mp3_decoder_s *decoder)
+{
+    if (!decoder) {
+        return -EINVAL;
+    }
+
+    memset(decoder, 0, sizeof(mp3_decoder_s));
+
+    /* Initialize libmad structures */
+    mad_stream_init(&decoder->stream);
+    mad_frame_init(&decoder->frame);
+    mad_synth_init(&decoder->synth);
+
+    /* Room for the guard bytes libmad needs to decode the last frame */
+    decoder->buffer_size = CONFIG_LVX_MUSIC_PLAYER_MP3_BUFFER_SIZE;
+    decoder->input_buffer = malloc(decoder->buffer_size + MAD_BUFFER_GUARD);
+    if (!decoder->input_buffer) {
+        mp3_decoder_cleanup(decoder);
+        return -ENOMEM;
+    }
+
+    decoder->sample_rate = 44100; /* Default */
+    decoder->channels = 2;        /* Output is always stereo */
+    decoder->bits_per_sample = 16;
+
+    return 0;
+}
+
+/**
+ * @brief Forget buffered input and the overlap of the previous frame
+ *
+ * Used after a seek, the next input must start on a frame header.
+ */
+void mp3_decoder_reset(FAR mp3_decoder_s *decoder)
+{
+    decoder->input_length = 0;
+    decoder->input_eof = false;
+
+    mad_stream_buffer(&decoder->stream, decoder->input_buffer, 0);
+    mad_frame_mute(&decoder->frame);
+    mad_synth_mute(&decoder->synth);
+    decoder->synth.pcm.length = 0;
+    decoder->synth_pos = 0;
+    decoder->lost_samples = 0;
+}
+
+/**
+ * @brief Carry unconsumed bytes to the front and return the free tail
+ * @param decoder MP3 decoder structure
+ * @param dst Returns where new compressed data should be written
+ * @return Number of bytes that can be written, 0 once input has ended
+ */
+size_t mp3_decoder_input_space(FAR mp3_decoder_s *decoder,
+                               FAR unsigned char **dst)
+{
+    size_t remaining = 0;
+
+    if (decoder->input_eof) {
+        return 0;
+    }
+
+    if (decoder->stream.next_frame != NULL) {
+        remaining = decoder->stream.bufend - decoder->stream.next_frame;
+        memmove(decoder->input_buffer, decoder->stream.next_frame, remaining);
+    }
+
+    decoder->input_length = remaining;
+    *dst = decoder->input_buffer + remaining;
+
+    return decoder->buffer_size - remaining;
+}
+
+/**
+ * @brief Hand len freshly written bytes to libmad, 0 marks end of input
+ */
+void mp3_decoder_input_commit(FAR mp3_decoder_s *decoder, size_t len)
+{
+    if (len == 0) {
+        memset(decoder->input_buffer + decoder->input_length, 0,
+               MAD_BUFFER_GUARD);
+        decoder->input_eof = true;
+        len = MAD_BUFFER_GUARD;
+    }
+
+    decoder->input_length += len;
+    mad_stream_buffer(&decoder->stream, decoder->input_buffer,
+                      decoder->input_length);
+}
+
+/**
+ * @brief Decode into out until it is full or input runs short
+ * @param decoder MP3 decoder structure
+ * @param out Interleaved stereo 16-bit output
+ * @param max_samples Capacity of out in samples (both channels)
+ * @return Samples written, 0 when more input is needed, negated errno on
+ *         an unrecoverable stream error
+ */
+int mp3_decoder_decode(FAR mp3_decoder_s *decoder, FAR int16_t *out,
+                       size_t max_samples)
+{
+    FAR struct mad_pcm *pcm = &decoder->synth.pcm;
+    size_t count;
+    size_t n = 0;
+
+    while (n + 2 <= max_samples) {
+        if (decoder->synth_pos >= pcm->length) {
+            if (decoder->stream.buffer == NULL) {
+                break;
+            }
+
+            if (mad_frame_decode(&decoder->frame, &decoder->stream) != 0) {
+                if (MAD_RECOVERABLE(decoder->stream.error)) {
+                    /* Right after a seek the first frame usually refers to
+                     * main data before the jump. Count its samples so the
+                     * caller's sample position stays exact.
+                     */
+
+                    if (decoder->stream.error == MAD_ERROR_BADDATAPTR) {
+                        decoder->lost_samples +=
+                            32 * MAD_NSBSAMPLES(&decoder->frame.header);
+                    }
+
+                    continue;
+                }
+
+                if (decoder->stream.error != MAD_ERROR_BUFLEN && n == 0) {
+                    return -EIO;
+                }
+
+                break;
+            }
+
+            decoder->sample_rate = decoder->frame.header.samplerate;
+
+            mad_synth_frame(&decoder->synth, &decoder->frame);
+            decoder->synth_pos = 0;
+            continue;
+        }
+
+        /* One kernel pass rounds, clips and interleaves as much of the
+         * frame as fits. Mono is duplicated to both channels.
+         */
+
+        count = pcm->length - decoder->synth_pos;
+        if (count > (max_samples - n) / 2) {
+            count = (max_samples - n) / 2;
+        }
+
+        pcm_convert_q28_s16(out + n,
+            (FAR const int32_t *)&pcm->samples[0][decoder->synth_pos],
+            (FAR const int32_t *)&pcm->samples[pcm->channels == 2][decoder->synth_pos],
+            count);
+
+        n += 2 * count;
+        decoder->synth_pos += count;
+    }
+
+    return n;
+}
+
+/**
+ * @brief Cleanup MP3 decoder
+ * @param decoder MP3 decoder structure
+ */
+void mp3_decoder_cleanup(FAR mp3_decoder_s *decoder)
+{
+    if (!decoder) {
+        return;
+    }
+
+    mad_synth_finish(&decoder->synth);
+    mad_frame_finish(&decoder->frame);
+    mad_stream_finish(&decoder->stream);
+
+    free(decoder->input_buffer);
+    memset(decoder, 0, sizeof(mp3_decoder_s));
+}
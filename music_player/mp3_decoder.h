@@ -0,0 +1,76 @@
+/**
+ * @file mp3_decoder.h
+ * Re-entrant streaming MP3 decoder on top of libmad
+ */
+
+#ifndef MP3_DECODER_H
+#define MP3_DECODER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <nuttx/config.h>
+#include <mad.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_MP3_BUFFER_SIZE
+#define CONFIG_LVX_MUSIC_PLAYER_MP3_BUFFER_SIZE 8192
+#endif
+
+/* Samples libmad's synthesis filterbank lags behind the encoder input,
+ * added to the LAME encoder delay when trimming for gapless playback.
+ */
+
+#define MP3_DECODER_DELAY 529
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* All state lives in the instance, so any number of streams can decode at
+ * the same time (current track, preloaded next track, previews).
+ */
+
+typedef struct mp3_decoder {
+    struct mad_stream stream;
+    struct mad_frame frame;
+    struct mad_synth synth;
+    FAR unsigned char *input_buffer;
+    size_t buffer_size;
+    size_t input_length;
+    unsigned int synth_pos;   /* next sample of synth.pcm to convert */
+    bool input_eof;           /* MAD_BUFFER_GUARD already appended */
+    uint32_t lost_samples;    /* frames dropped for a missing bit reservoir */
+    uint32_t sample_rate;
+    uint16_t channels;
+    uint16_t bits_per_sample;
+} mp3_decoder_s;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+int mp3_decoder_init(FAR mp3_decoder_s *decoder);
+void mp3_decoder_reset(FAR mp3_decoder_s *decoder);
+size_t mp3_decoder_input_space(FAR mp3_decoder_s *decoder,
+                               FAR unsigned char **dst);
+void mp3_decoder_input_commit(FAR mp3_decoder_s *decoder, size_t len);
+int mp3_decoder_decode(FAR mp3_decoder_s *decoder, FAR int16_t *out,
+                       size_t max_samples);
+void mp3_decoder_cleanup(FAR mp3_decoder_s *decoder);
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /* MP3_DECODER_H */
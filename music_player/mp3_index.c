@@ -0,0 +1,633 @@
+/**
+ * @file mp3_index.c
+ * Frame-accurate MP3 seek index
+ *
+ * Seeking a VBR stream by a linear time/size ratio lands seconds away from
+ * the target and in the middle of a frame. The index below maps PCM sample
+ * positions to MPEG frame headers instead. The frame headers are walked
+ * once when the index is built (without decoding), keeping one entry
+ * every CONFIG_LVX_MUSIC_PLAYER_MP3_INDEX_MS milliseconds; a Xing/Info or
+ * VBRI tag still supplies the length and the encoder delay and padding.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "mp3_index.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define MP3_SCAN_BUFSIZE   4096
+#define MP3_SYNC_WINDOW    (64 * 1024)
+#define MP3_INDEX_GROW     64
+
+#define MP3_XING_FRAMES    0x0001
+#define MP3_XING_BYTES     0x0002
+#define MP3_XING_TOC       0x0004
+#define MP3_XING_QUALITY   0x0008
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* Small pread() window so header walks do not issue one syscall per frame */
+
+typedef struct mp3_scan {
+    int fd;
+    uint32_t end;
+    uint32_t base;
+    uint32_t len;
+    uint8_t buf[MP3_SCAN_BUFSIZE];
+} mp3_scan_s;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static uint32_t mp3_be32(FAR const uint8_t *p);
+static FAR const uint8_t *mp3_scan_peek(FAR mp3_scan_s *scan,
+                                        uint32_t offset, uint32_t need);
+static int64_t mp3_scan_sync(FAR mp3_scan_s *scan, uint32_t offset,
+                             uint32_t limit, FAR mp3_frame_info_s *info);
+static int mp3_index_add(FAR mp3_index_s *idx, uint32_t sample,
+                         uint32_t offset);
+static bool mp3_index_parse_xing(FAR mp3_index_s *idx,
+                                 FAR const uint8_t *frame, uint32_t first,
+                                 FAR const mp3_frame_info_s *info);
+static bool mp3_index_parse_vbri(FAR mp3_index_s *idx,
+                                 FAR const uint8_t *frame, uint32_t first,
+                                 FAR const mp3_frame_info_s *info);
+static int mp3_index_scan(FAR mp3_index_s *idx, FAR mp3_scan_s *scan);
+static int mp3_index_rescan(FAR mp3_index_s *idx, FAR mp3_scan_s *scan);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+/* kbps, [lsf][layer - 1][index] */
+
+static const uint16_t g_mp3_bitrates[2][3][15] =
+{
+    {
+        {0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448},
+        {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384},
+        {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320},
+    },
+    {
+        {0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256},
+        {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+        {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+    },
+};
+
+static const uint32_t g_mp3_samplerates[3] = { 44100, 48000, 32000 };
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static uint32_t mp3_be32(FAR const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static FAR const uint8_t *mp3_scan_peek(FAR mp3_scan_s *scan,
+                                        uint32_t offset, uint32_t need)
+{
+    ssize_t n;
+
+    if (offset + need > scan->end) {
+        return NULL;
+    }
+
+    if (offset >= scan->base && offset + need <= scan->base + scan->len) {
+        return scan->buf + (offset - scan->base);
+    }
+
+    n = pread(scan->fd, scan->buf, sizeof(scan->buf), offset);
+    scan->base = offset;
+    scan->len = n > 0 ? n : 0;
+
+    return need <= scan->len ? scan->buf : NULL;
+}
+
+/* A header only counts when the next one agrees with it, random 0xFFE
+ * patterns inside audio data are common enough to fool a single check.
+ */
+
+static int64_t mp3_scan_sync(FAR mp3_scan_s *scan, uint32_t offset,
+                             uint32_t limit, FAR mp3_frame_info_s *info)
+{
+    FAR const uint8_t *p;
+    mp3_frame_info_s next;
+
+    if (limit > scan->end) {
+        limit = scan->end;
+    }
+
+    for (; offset + 4 <= limit; offset++)
+    {
+        p = mp3_scan_peek(scan, offset, 4);
+        if (p == NULL) {
+            break;
+        }
+
+        if (p[0] != 0xff || !mp3_index_parse_header(p, info)) {
+            continue;
+        }
+
+        p = mp3_scan_peek(scan, offset + info->length, 4);
+        if (p == NULL) {
+            /* Last frame of the stream */
+
+            return offset + info->length <= scan->end ? (int64_t)offset : -1;
+        }
+
+        if (mp3_index_parse_header(p, &next) &&
+            next.version == info->version && next.layer == info->layer &&
+            next.sample_rate == info->sample_rate) {
+            return offset;
+        }
+    }
+
+    return -1;
+}
+
+static int mp3_index_add(FAR mp3_index_s *idx, uint32_t sample,
+                         uint32_t offset)
+{
+    if ((idx->count % MP3_INDEX_GROW) == 0) {
+        FAR mp3_index_point_s *points;
+
+        points = realloc(idx->points, (idx->count + MP3_INDEX_GROW) *
+                                      sizeof(mp3_index_point_s));
+        if (points == NULL) {
+            return -ENOMEM;
+        }
+
+        idx->points = points;
+    }
+
+    idx->points[idx->count].sample = sample;
+    idx->points[idx->count].offset = offset;
+    idx->count++;
+
+    return 0;
+}
+
+static bool mp3_index_parse_xing(FAR mp3_index_s *idx,
+                                 FAR const uint8_t *frame, uint32_t first,
+                                 FAR const mp3_frame_info_s *info)
+{
+    FAR const uint8_t *p;
+    FAR const uint8_t *end = frame + info->length;
+    FAR const uint8_t *toc = NULL;
+    uint32_t flags;
+    uint32_t frames = 0;
+    uint32_t bytes = 0;
+    int side;
+    int i;
+
+    if (info->version == 3) {
+        side = info->channels == 1 ? 17 : 32;
+    } else {
+        side = info->channels == 1 ? 9 : 17;
+    }
+
+    p = frame + 4 + side;
+    if (p + 8 > end ||
+        (memcmp(p, "Xing", 4) != 0 && memcmp(p, "Info", 4) != 0)) {
+        return false;
+    }
+
+    flags = mp3_be32(p + 4);
+    p += 8;
+
+    if ((flags & MP3_XING_FRAMES) && p + 4 <= end) {
+        frames = mp3_be32(p);
+        p += 4;
+    }
+
+    if ((flags & MP3_XING_BYTES) && p + 4 <= end) {
+        bytes = mp3_be32(p);
+        p += 4;
+    }
+
+    if ((flags & MP3_XING_TOC) && p + 100 <= end) {
+        toc = p;
+        p += 100;
+    }
+
+    if (flags & MP3_XING_QUALITY) {
+        p += 4;
+    }
+
+    /* LAME extension: 12-bit encoder delay and padding at offset 21 */
+
+    if (p + 24 <= end && memcmp(p, "LAME", 4) == 0) {
+        idx->enc_delay = (p[21] << 4) | (p[22] >> 4);
+        idx->enc_padding = ((p[22] & 0x0f) << 8) | p[23];
+    }
+
+    idx->audio_start = first + info->length;
+    if (frames == 0) {
+        return false;
+    }
+
+    idx->total_samples = (uint64_t)frames * info->samples;
+
+    if (toc == NULL || bytes == 0) {
+        return false;
+    }
+
+    if (bytes > idx->audio_end - first) {
+        bytes = idx->audio_end - first;
+    }
+
+    for (i = 0; i < 100; i++)
+    {
+        if (mp3_index_add(idx, idx->total_samples * i / 100,
+                          first + (uint64_t)toc[i] * bytes / 256) < 0) {
+            return false;
+        }
+    }
+
+    idx->points[0].offset = idx->audio_start;
+    idx->source = MP3_INDEX_XING;
+    return true;
+}
+
+static bool mp3_index_parse_vbri(FAR mp3_index_s *idx,
+                                 FAR const uint8_t *frame, uint32_t first,
+                                 FAR const mp3_frame_info_s *info)
+{
+    FAR const uint8_t *p = frame + 4 + 32;
+    FAR const uint8_t *end = frame + info->length;
+    uint32_t frames;
+    uint32_t entries;
+    uint32_t scale;
+    uint32_t size;
+    uint32_t per_entry;
+    uint64_t offset;
+    uint32_t i;
+    uint32_t j;
+
+    if (p + 26 > end || memcmp(p, "VBRI", 4) != 0) {
+        return false;
+    }
+
+    frames = mp3_be32(p + 14);
+    entries = (p[18] << 8) | p[19];
+    scale = (p[20] << 8) | p[21];
+    size = (p[22] << 8) | p[23];
+    per_entry = (p[24] << 8) | p[25];
+
+    idx->audio_start = first + info->length;
+    if (frames == 0) {
+        return false;
+    }
+
+    idx->total_samples = (uint64_t)frames * info->samples;
+
+    p += 26;
+    if (size < 1 || size > 4 || p + entries * size > end) {
+        return false;
+    }
+
+    offset = first;
+    if (mp3_index_add(idx, 0, idx->audio_start) < 0) {
+        return false;
+    }
+
+    for (i = 1; i < entries; i++)
+    {
+        uint32_t delta = 0;
+
+        for (j = 0; j < size; j++) {
+            delta = (delta << 8) | *p++;
+        }
+
+        offset += (uint64_t)delta * scale;
+        if (offset >= idx->audio_end) {
+            break;
+        }
+
+        if (mp3_index_add(idx, (uint64_t)i * per_entry * info->samples,
+                          offset) < 0) {
+            return false;
+        }
+    }
+
+    idx->source = MP3_INDEX_VBRI;
+    return true;
+}
+
+static int mp3_index_scan(FAR mp3_index_s *idx, FAR mp3_scan_s *scan)
+{
+    uint32_t step = (uint64_t)idx->sample_rate *
+                    CONFIG_LVX_MUSIC_PLAYER_MP3_INDEX_MS / 1000;
+    uint32_t offset = idx->audio_start;
+    uint64_t sample = 0;
+    uint64_t next = 0;
+    mp3_frame_info_s info;
+    int ret;
+
+    while (offset + 4 <= idx->audio_end)
+    {
+        FAR const uint8_t *p = mp3_scan_peek(scan, offset, 4);
+
+        if (p == NULL || !mp3_index_parse_header(p, &info) ||
+            info.sample_rate != idx->sample_rate) {
+            int64_t found = mp3_scan_sync(scan, offset + 1,
+                                          offset + MP3_SYNC_WINDOW, &info);
+
+            if (found < 0) {
+                break;
+            }
+
+            offset = found;
+        }
+
+        if (sample >= next) {
+            ret = mp3_index_add(idx, sample, offset);
+            if (ret < 0) {
+                return ret;
+            }
+
+            next = sample + step;
+        }
+
+        sample += info.samples;
+        offset += info.length;
+    }
+
+    idx->total_samples = sample;
+    idx->source = MP3_INDEX_SCAN;
+    return 0;
+}
+
+/**
+ * @brief Replace a table of contents with scanned frame positions
+ *
+ * A TOC maps time to bytes only roughly, the first PCM frame of the MPEG
+ * frame found near an interpolated offset is unknown. Runs once, when the
+ * index is built, so a seek never has to walk the file. The length and
+ * the LAME trim of the tag are kept as the encoder wrote them.
+ */
+static int mp3_index_rescan(FAR mp3_index_s *idx, FAR mp3_scan_s *scan)
+{
+    mp3_index_s tmp = *idx;
+    int ret;
+
+    tmp.points = NULL;
+    tmp.count = 0;
+
+    ret = mp3_index_scan(&tmp, scan);
+    if (ret < 0 || tmp.count == 0) {
+        free(tmp.points);
+        return ret < 0 ? ret : -EINVAL;
+    }
+
+    free(idx->points);
+    idx->points = tmp.points;
+    idx->count = tmp.count;
+    idx->source = MP3_INDEX_SCAN;
+    return 0;
+}
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+/**
+ * @brief Decode a 4-byte MPEG audio frame header
+ * @return true when the header is valid
+ */
+bool mp3_index_parse_header(FAR const uint8_t *hdr,
+                            FAR mp3_frame_info_s *info)
+{
+    uint32_t bitrate;
+    int version;
+    int layer;
+    int index;
+    int lsf;
+
+    if (hdr[0] != 0xff || (hdr[1] & 0xe0) != 0xe0) {
+        return false;
+    }
+
+    version = (hdr[1] >> 3) & 3;
+    layer = 4 - ((hdr[1] >> 1) & 3);
+    index = hdr[2] >> 4;
+    if (version == 1 || layer == 4 || index == 0 || index == 15 ||
+        ((hdr[2] >> 2) & 3) == 3) {
+        return false;
+    }
+
+    lsf = version != 3;
+    bitrate = g_mp3_bitrates[lsf][layer - 1][index] * 1000;
+
+    info->version = version;
+    info->layer = layer;
+    info->sample_rate = g_mp3_samplerates[(hdr[2] >> 2) & 3] >>
+                        (version == 3 ? 0 : version == 2 ? 1 : 2);
+    info->channels = (hdr[3] >> 6) == 3 ? 1 : 2;
+
+    if (layer == 1) {
+        info->samples = 384;
+        info->length = (12 * bitrate / info->sample_rate +
+                        ((hdr[2] >> 1) & 1)) * 4;
+    } else {
+        info->samples = (layer == 3 && lsf) ? 576 : 1152;
+        info->length = info->samples / 8 * bitrate / info->sample_rate +
+                       ((hdr[2] >> 1) & 1);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Build the seek index for an MP3 file
+ * @param idx Index to fill, released with mp3_index_free()
+ * @param fd Open file, only accessed through pread()
+ * @return 0 on success, negated errno on failure
+ */
+int mp3_index_build(FAR mp3_index_s *idx, int fd)
+{
+    FAR mp3_scan_s *scan;
+    FAR const uint8_t *p;
+    mp3_frame_info_s info;
+    struct stat st;
+    int64_t first;
+    int ret = 0;
+
+    memset(idx, 0, sizeof(mp3_index_s));
+
+    if (fstat(fd, &st) < 0) {
+        return -errno;
+    }
+
+    scan = malloc(sizeof(mp3_scan_s));
+    if (scan == NULL) {
+        return -ENOMEM;
+    }
+
+    scan->fd = fd;
+    scan->end = st.st_size;
+    scan->base = 0;
+    scan->len = 0;
+
+    /* Skip a leading ID3v2 tag (syncsafe size, optional footer) */
+
+    p = mp3_scan_peek(scan, 0, 10);
+    if (p != NULL && memcmp(p, "ID3", 3) == 0) {
+        idx->audio_start = 10 + ((p[6] & 0x7f) << 21) + ((p[7] & 0x7f) << 14) +
+                           ((p[8] & 0x7f) << 7) + (p[9] & 0x7f);
+        if (p[5] & 0x10) {
+            idx->audio_start += 10;
+        }
+    }
+
+    idx->audio_end = st.st_size;
+    if (st.st_size >= 128) {
+        p = mp3_scan_peek(scan, st.st_size - 128, 3);
+        if (p != NULL && memcmp(p, "TAG", 3) == 0) {
+            idx->audio_end -= 128;
+        }
+    }
+
+    scan->end = idx->audio_end;
+
+    first = mp3_scan_sync(scan, idx->audio_start,
+                          idx->audio_start + MP3_SYNC_WINDOW, &info);
+    if (first < 0) {
+        free(scan);
+        return -EINVAL;
+    }
+
+    idx->audio_start = first;
+    idx->sample_rate = info.sample_rate;
+    idx->channels = info.channels;
+    idx->frame_samples = info.samples;
+
+    p = mp3_scan_peek(scan, first, info.length);
+    if (p == NULL ||
+        (!mp3_index_parse_xing(idx, p, first, &info) &&
+         !mp3_index_parse_vbri(idx, p, first, &info))) {
+        /* No usable table of contents, walk the frame headers instead.
+         * An Info/VBRI frame without one still moved audio_start past it.
+         */
+
+        idx->count = 0;
+        ret = mp3_index_scan(idx, scan);
+    } else {
+        ret = mp3_index_rescan(idx, scan);
+    }
+
+    free(scan);
+
+    if (ret < 0 || idx->count == 0) {
+        mp3_index_free(idx);
+        return ret < 0 ? ret : -EINVAL;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Find the MPEG frame containing a PCM sample
+ * @param idx Built index
+ * @param fd File the index was built from
+ * @param sample Target PCM frame
+ * @param offset Returns the file offset of the frame header
+ * @param landed Returns the first PCM frame of that MPEG frame
+ * @return 0 on success, negated errno on failure
+ *
+ * Frame headers are walked from the last scanned point before the
+ * target, at most CONFIG_LVX_MUSIC_PLAYER_MP3_INDEX_MS of them, so the
+ * returned frame and its first sample are exact.
+ */
+int mp3_index_seek(FAR mp3_index_s *idx, int fd, uint64_t sample,
+                   FAR uint32_t *offset, FAR uint64_t *landed)
+{
+    FAR mp3_scan_s *scan;
+    FAR mp3_index_point_s *pt;
+    mp3_frame_info_s info;
+    uint32_t lo = 0;
+    uint32_t hi;
+    uint32_t off;
+    uint64_t pos;
+
+    if (idx == NULL || idx->count == 0) {
+        return -EINVAL;
+    }
+
+    if (sample > idx->total_samples) {
+        sample = idx->total_samples;
+    }
+
+    scan = malloc(sizeof(mp3_scan_s));
+    if (scan == NULL) {
+        return -ENOMEM;
+    }
+
+    scan->fd = fd;
+    scan->end = idx->audio_end;
+    scan->base = 0;
+    scan->len = 0;
+
+    /* Last point at or before the target */
+
+    hi = idx->count - 1;
+    while (lo < hi)
+    {
+        uint32_t mid = (lo + hi + 1) / 2;
+
+        if (idx->points[mid].sample <= sample) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    pt = &idx->points[lo];
+    off = pt->offset;
+    pos = pt->sample;
+
+    while (pos + idx->frame_samples <= sample)
+    {
+        FAR const uint8_t *p = mp3_scan_peek(scan, off, 4);
+
+        if (p == NULL || !mp3_index_parse_header(p, &info)) {
+            break;
+        }
+
+        off += info.length;
+        pos += info.samples;
+    }
+
+    free(scan);
+
+    *offset = off;
+    *landed = pos;
+    return 0;
+}
+
+void mp3_index_free(FAR mp3_index_s *idx)
+{
+    if (idx == NULL) {
+        return;
+    }
+
+    free(idx->points);
+    idx->points = NULL;
+    idx->count = 0;
+}
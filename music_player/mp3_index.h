@@ -0,0 +1,97 @@
+/**
+ * @file mp3_index.h
+ * Frame-accurate MP3 seek index
+ */
+
+#ifndef MP3_INDEX_H
+#define MP3_INDEX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <nuttx/config.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_MP3_INDEX_MS
+#define CONFIG_LVX_MUSIC_PLAYER_MP3_INDEX_MS 500
+#endif
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_MP3_INDEX_CACHE_KB
+#define CONFIG_LVX_MUSIC_PLAYER_MP3_INDEX_CACHE_KB 256
+#endif
+
+#define MP3_INDEX_CACHE_DIR CONFIG_LVX_MUSIC_PLAYER_DATA_ROOT "/.mp3index"
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef enum {
+    MP3_INDEX_NONE = 0,
+    MP3_INDEX_XING,     /* Xing/Info TOC, 100 points by percent of duration */
+    MP3_INDEX_VBRI,     /* Fraunhofer VBRI TOC */
+    MP3_INDEX_SCAN,     /* Frame headers scanned, offsets are exact */
+} mp3_index_source_e;
+
+typedef struct mp3_frame_info {
+    uint32_t sample_rate;
+    uint16_t channels;
+    uint16_t samples;      /* PCM frames per MPEG frame */
+    uint32_t length;       /* bytes including header and padding */
+    uint8_t version;       /* 0 = MPEG2.5, 2 = MPEG2, 3 = MPEG1 */
+    uint8_t layer;         /* 1, 2 or 3 */
+} mp3_frame_info_s;
+
+typedef struct mp3_index_point {
+    uint32_t sample;       /* first PCM frame of the MPEG frame */
+    uint32_t offset;       /* file offset of the MPEG frame header */
+} mp3_index_point_s;
+
+typedef struct mp3_index {
+    mp3_index_source_e source;
+    uint32_t audio_start;  /* first audio frame, after ID3v2 and Xing/VBRI */
+    uint32_t audio_end;    /* end of audio, before a trailing ID3v1 tag */
+    uint32_t sample_rate;
+    uint16_t channels;
+    uint16_t frame_samples;
+    uint64_t total_samples;
+
+    /* LAME tag, samples to drop at the start and end for gapless output */
+    uint16_t enc_delay;
+    uint16_t enc_padding;
+
+    FAR mp3_index_point_s *points;
+    uint32_t count;
+} mp3_index_s;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+bool mp3_index_parse_header(FAR const uint8_t *hdr,
+                            FAR mp3_frame_info_s *info);
+int mp3_index_build(FAR mp3_index_s *idx, int fd);
+int mp3_index_seek(FAR mp3_index_s *idx, int fd, uint64_t sample,
+                   FAR uint32_t *offset, FAR uint64_t *landed);
+void mp3_index_free(FAR mp3_index_s *idx);
+
+/* Sidecar cache keyed by path, size and mtime */
+int mp3_index_cache_load(FAR mp3_index_s *idx, FAR const char *path, int fd);
+int mp3_index_cache_store(FAR const mp3_index_s *idx, FAR const char *path,
+                          int fd);
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /* MP3_INDEX_H */
@@ -0,0 +1,329 @@
+/**
+ * @file mp3_index_cache.c
+ * Sidecar cache for MP3 seek indexes
+ *
+ * Every built index is stored as one small binary file under
+ * MP3_INDEX_CACHE_DIR, named after a hash of the track path. The record
+ * repeats the path, size and mtime of the track so a renamed, replaced or
+ * re-tagged file is never matched against a stale index. The directory is
+ * kept under CONFIG_LVX_MUSIC_PLAYER_MP3_INDEX_CACHE_KB by dropping the
+ * least recently used records whenever a new one is written, a hit stamps
+ * its record with the current time.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "mp3_index.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define MP3_INDEX_CACHE_MAGIC   0x5844494d  /* "MIDX" */
+#define MP3_INDEX_CACHE_VERSION 2  /* 1 could hold a coarse Xing/VBRI TOC */
+#define MP3_INDEX_CACHE_SUFFIX  ".idx"
+#define MP3_INDEX_CACHE_TMP     MP3_INDEX_CACHE_SUFFIX ".tmp"
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct mp3_index_cache_hdr {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t path_len;
+    uint64_t file_size;
+    int64_t file_mtime;
+    uint64_t total_samples;
+    uint32_t audio_start;
+    uint32_t audio_end;
+    uint32_t sample_rate;
+    uint32_t count;
+    uint16_t channels;
+    uint16_t frame_samples;
+    uint16_t enc_delay;
+    uint16_t enc_padding;
+    uint8_t source;
+    uint8_t reserved[7];
+} mp3_index_cache_hdr_s;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static void mp3_index_cache_name(FAR const char *path, FAR char *name,
+                                 size_t size);
+static void mp3_index_cache_evict(FAR const char *keep);
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/* FNV-1a of the track path, collisions are caught by the stored path */
+
+static void mp3_index_cache_name(FAR const char *path, FAR char *name,
+                                 size_t size)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*path != '\0') {
+        hash = (hash ^ (uint8_t)*path++) * 16777619u;
+    }
+
+    snprintf(name, size, "%s/%08lx" MP3_INDEX_CACHE_SUFFIX,
+             MP3_INDEX_CACHE_DIR, (unsigned long)hash);
+}
+
+/* Drop the least recently used records until the directory fits the
+ * budget again, the mtime of a record is its last hit or write. A
+ * temporary file left by a write cut short is removed on the way.
+ */
+
+static void mp3_index_cache_evict(FAR const char *keep)
+{
+    char path[PATH_MAX];
+    char oldest[PATH_MAX];
+    FAR struct dirent *entry;
+    FAR DIR *dir;
+    struct stat st;
+    uint64_t total;
+    time_t oldest_time;
+
+    for (; ; )
+    {
+        dir = opendir(MP3_INDEX_CACHE_DIR);
+        if (dir == NULL) {
+            return;
+        }
+
+        total = 0;
+        oldest[0] = '\0';
+        oldest_time = 0;
+
+        while ((entry = readdir(dir)) != NULL)
+        {
+            size_t len = strlen(entry->d_name);
+            bool tmp = len >= sizeof(MP3_INDEX_CACHE_TMP) &&
+                       strcmp(entry->d_name + len -
+                              sizeof(MP3_INDEX_CACHE_TMP) + 1,
+                              MP3_INDEX_CACHE_TMP) == 0;
+
+            if (!tmp && (len < sizeof(MP3_INDEX_CACHE_SUFFIX) ||
+                         strcmp(entry->d_name + len -
+                                sizeof(MP3_INDEX_CACHE_SUFFIX) + 1,
+                                MP3_INDEX_CACHE_SUFFIX) != 0)) {
+                continue;
+            }
+
+            snprintf(path, sizeof(path), "%s/%s", MP3_INDEX_CACHE_DIR,
+                     entry->d_name);
+            if (stat(path, &st) < 0) {
+                continue;
+            }
+
+            /* The record of keep is already renamed into place, any
+             * temporary file is from a power cut or a failed write
+             */
+
+            if (tmp && unlink(path) == 0) {
+                continue;
+            }
+
+            total += st.st_size;
+            if (!tmp && strcmp(path, keep) != 0 &&
+                (oldest[0] == '\0' || st.st_mtime < oldest_time)) {
+                snprintf(oldest, sizeof(oldest), "%s", path);
+                oldest_time = st.st_mtime;
+            }
+        }
+
+        closedir(dir);
+
+        if (total <= CONFIG_LVX_MUSIC_PLAYER_MP3_INDEX_CACHE_KB * 1024ull ||
+            oldest[0] == '\0' || unlink(oldest) < 0) {
+            return;
+        }
+    }
+}
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+/**
+ * @brief Load a cached index for the track open on fd
+ * @param idx Index to fill, released with mp3_index_free()
+ * @param path Track path, part of the cache key
+ * @param fd Open track, its size and mtime are the rest of the key
+ * @return 0 on a hit, -ENOENT on a miss, negated errno on failure
+ */
+int mp3_index_cache_load(FAR mp3_index_s *idx, FAR const char *path, int fd)
+{
+    mp3_index_cache_hdr_s hdr;
+    char name[PATH_MAX];
+    char stored[PATH_MAX];
+    struct stat track;
+    struct stat st;
+    size_t points;
+    int cfd;
+    int ret = -ENOENT;
+
+    memset(idx, 0, sizeof(mp3_index_s));
+
+    if (fstat(fd, &track) < 0) {
+        return -errno;
+    }
+
+    mp3_index_cache_name(path, name, sizeof(name));
+    cfd = open(name, O_RDONLY);
+    if (cfd < 0) {
+        return -ENOENT;
+    }
+
+    if (fstat(cfd, &st) < 0 ||
+        read(cfd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+        hdr.magic != MP3_INDEX_CACHE_MAGIC ||
+        hdr.version != MP3_INDEX_CACHE_VERSION ||
+        hdr.file_size != (uint64_t)track.st_size ||
+        hdr.file_mtime != (int64_t)track.st_mtime ||
+        hdr.path_len >= sizeof(stored) || hdr.count == 0 ||
+        hdr.source != MP3_INDEX_SCAN) {
+        goto out;
+    }
+
+    points = hdr.count * sizeof(mp3_index_point_s);
+    if ((size_t)st.st_size != sizeof(hdr) + hdr.path_len + points ||
+        read(cfd, stored, hdr.path_len) != hdr.path_len) {
+        goto out;
+    }
+
+    stored[hdr.path_len] = '\0';
+    if (strcmp(stored, path) != 0) {
+        goto out;
+    }
+
+    idx->points = malloc(points);
+    if (idx->points == NULL) {
+        ret = -ENOMEM;
+        goto out;
+    }
+
+    if (read(cfd, idx->points, points) != (ssize_t)points) {
+        mp3_index_free(idx);
+        goto out;
+    }
+
+    idx->source = hdr.source;
+    idx->audio_start = hdr.audio_start;
+    idx->audio_end = hdr.audio_end;
+    idx->sample_rate = hdr.sample_rate;
+    idx->channels = hdr.channels;
+    idx->frame_samples = hdr.frame_samples;
+    idx->total_samples = hdr.total_samples;
+    idx->enc_delay = hdr.enc_delay;
+    idx->enc_padding = hdr.enc_padding;
+    idx->count = hdr.count;
+    ret = 0;
+
+    /* Mark the record used so eviction keeps it */
+
+    futimens(cfd, NULL);
+
+out:
+    close(cfd);
+    return ret;
+}
+
+/**
+ * @brief Save an index so the next open of the same track skips the scan
+ * @return 0 on success, negated errno on failure
+ *
+ * The record is written to a temporary file and renamed into place, so a
+ * power cut never leaves a truncated record behind.
+ */
+int mp3_index_cache_store(FAR const mp3_index_s *idx, FAR const char *path,
+                          int fd)
+{
+    mp3_index_cache_hdr_s hdr;
+    char name[PATH_MAX];
+    char tmp[PATH_MAX + sizeof(".tmp")];
+    struct stat track;
+    size_t points;
+    int cfd;
+    int ret = 0;
+
+    if (idx == NULL || idx->count == 0 || fstat(fd, &track) < 0) {
+        return -EINVAL;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = MP3_INDEX_CACHE_MAGIC;
+    hdr.version = MP3_INDEX_CACHE_VERSION;
+    hdr.path_len = strlen(path);
+    hdr.file_size = track.st_size;
+    hdr.file_mtime = track.st_mtime;
+    hdr.total_samples = idx->total_samples;
+    hdr.audio_start = idx->audio_start;
+    hdr.audio_end = idx->audio_end;
+    hdr.sample_rate = idx->sample_rate;
+    hdr.count = idx->count;
+    hdr.channels = idx->channels;
+    hdr.frame_samples = idx->frame_samples;
+    hdr.enc_delay = idx->enc_delay;
+    hdr.enc_padding = idx->enc_padding;
+    hdr.source = idx->source;
+
+    points = idx->count * sizeof(mp3_index_point_s);
+    if (sizeof(hdr) + hdr.path_len + points >
+        CONFIG_LVX_MUSIC_PLAYER_MP3_INDEX_CACHE_KB * 1024ull) {
+        return -EFBIG;
+    }
+
+    if (mkdir(MP3_INDEX_CACHE_DIR, 0777) < 0 && errno != EEXIST) {
+        return -errno;
+    }
+
+    mp3_index_cache_name(path, name, sizeof(name));
+    snprintf(tmp, sizeof(tmp), "%s.tmp", name);
+
+    cfd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (cfd < 0) {
+        return -errno;
+    }
+
+    if (write(cfd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+        write(cfd, path, hdr.path_len) != hdr.path_len ||
+        write(cfd, idx->points, points) != (ssize_t)points) {
+        ret = -EIO;
+    }
+
+    if (close(cfd) < 0 && ret == 0) {
+        ret = -errno;
+    }
+
+    /* Not every file system replaces an existing target on rename */
+
+    if (ret == 0 && rename(tmp, name) < 0 &&
+        (unlink(name) < 0 || rename(tmp, name) < 0)) {
+        ret = -errno;
+    }
+
+    if (ret < 0) {
+        unlink(tmp);
+        return ret;
+    }
+
+    mp3_index_cache_evict(name);
+    return 0;
+}
@@ -44,7 +44,9 @@
 #include "music_player.h"
 #include "playlist_manager.h"
 #include "font_config.h"
+#include "audio_trace.h"
 #include <stdlib.h>
+#include <string.h>
 #include <netutils/cJSON.h>
 #include <time.h>
 
@@ -63,6 +65,19 @@
 #define MODERN_TEXT_SECONDARY       lv_color_hex(0xBBBBBB)
 #define MODERN_ACCENT_COLOR         lv_color_hex(0x4ECDC4)
 
+#ifndef CONFIG_LVX_MUSIC_PLAYER_GAPLESS_PRELOAD_MS
+#define CONFIG_LVX_MUSIC_PLAYER_GAPLESS_PRELOAD_MS 5000
+#endif
+
+/* The next track has to be open before its crossfade begins */
+
+#if defined(CONFIG_LVX_MUSIC_PLAYER_CROSSFADE) && \
+    CONFIG_LVX_MUSIC_PLAYER_CROSSFADE_MS + 1000 > CONFIG_LVX_MUSIC_PLAYER_GAPLESS_PRELOAD_MS
+#define APP_PRELOAD_MS (CONFIG_LVX_MUSIC_PLAYER_CROSSFADE_MS + 1000)
+#else
+#define APP_PRELOAD_MS CONFIG_LVX_MUSIC_PLAYER_GAPLESS_PRELOAD_MS
+#endif
+
 #define COVER_SIZE                  200
 #define COVER_ROTATION_DURATION     8000  // 8秒转一圈，更接近真实唱片转速 (33 RPM ≈ 1.8秒/圈，45 RPM ≈ 1.3秒/圈，8秒为慢速视觉效果)
 
@@ -92,6 +107,14 @@ static void app_cover_rotation_anim_cb(void* obj, int32_t value);
 
 /* Album operations */
 static int32_t app_get_album_index(album_info_t* album);
+static int32_t app_get_next_album_index(void);
+static void app_shuffle_albums(void);
+static void app_play_next_album(void);
+static void app_open_current_album(void);
+static void app_update_album_total_time(void);
+#ifdef CONFIG_LVX_MUSIC_PLAYER_GAPLESS
+static void app_update_gapless(void);
+#endif
 
 /* Album operations */
 void app_set_play_status(play_status_t status);
@@ -199,6 +222,156 @@ static int32_t app_get_album_index(album_info_t* album)
     return -1;
 }
 
+static void app_shuffle_albums(void)
+{
+    static bool seeded;
+
+    if (!seeded) {
+        srand(time(NULL));
+        seeded = true;
+    }
+
+    lv_free(C.shuffle_order);
+    C.shuffle_order = lv_malloc(R.album_count);
+    if (C.shuffle_order == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < R.album_count; i++) {
+        C.shuffle_order[i] = i;
+    }
+
+    // Fisher-Yates 洗牌
+    for (int i = R.album_count - 1; i > 0; i--) {
+        int j = rand() % (i + 1);
+        uint8_t tmp = C.shuffle_order[i];
+        C.shuffle_order[i] = C.shuffle_order[j];
+        C.shuffle_order[j] = tmp;
+    }
+}
+
+/**
+ * @brief 按播放模式决定当前曲目之后播放哪一首
+ * @return 专辑索引，-1 表示播放到列表末尾后停止
+ */
+static int32_t app_get_next_album_index(void)
+{
+    int32_t index = app_get_album_index(C.current_album);
+
+    if (index < 0) {
+        return -1;
+    }
+
+    switch (C.play_mode) {
+    case PLAY_MODE_REPEAT_ONE:
+        return index;
+    case PLAY_MODE_REPEAT_ALL:
+        return (index + 1) % R.album_count;
+    case PLAY_MODE_SHUFFLE:
+        if (C.shuffle_order == NULL) {
+            app_shuffle_albums();
+        }
+
+        for (int i = 0; C.shuffle_order && i < R.album_count; i++) {
+            if (C.shuffle_order[i] == index) {
+                return C.shuffle_order[(i + 1) % R.album_count];
+            }
+        }
+        return -1;
+    default:
+        return index + 1 < R.album_count ? index + 1 : -1;
+    }
+}
+
+/**
+ * @brief 曲目自然播放结束（未能无缝衔接）时切到下一首
+ */
+static void app_play_next_album(void)
+{
+    int32_t index = app_get_next_album_index();
+
+    if (index < 0) {
+        app_set_play_status(PLAY_STATUS_STOP);
+        app_set_playback_time(0);
+        return;
+    }
+
+    if (&R.albums[index] == C.current_album) {
+        // 单曲循环：在同一个输出会话里从头播放当前曲目
+        app_open_current_album();
+        C.current_time = 0;
+        app_refresh_playback_progress();
+        return;
+    }
+
+    app_switch_to_album(index);
+}
+
+static void app_update_album_total_time(void)
+{
+    uint32_t total_time;
+
+    if (C.audioctl == NULL) {
+        return;
+    }
+
+    // 用解析出的真实时长替换manifest.json中的手填值
+    total_time = audio_ctl_get_duration_ms(C.audioctl);
+    if (total_time > 0) {
+        C.current_album->total_time = total_time;
+    }
+}
+
+#ifdef CONFIG_LVX_MUSIC_PLAYER_GAPLESS
+/**
+ * @brief 无缝播放：临近结尾时预加载下一首，设备播放到新曲目后刷新界面
+ */
+static void app_update_gapless(void)
+{
+    uint32_t serial;
+    int32_t index;
+    int ret;
+
+    if (C.audioctl == NULL) {
+        return;
+    }
+
+    serial = audio_ctl_get_track_serial(C.audioctl);
+    if (serial != C.track_serial) {
+        C.track_serial = serial;
+        if (C.next_album != NULL) {
+            C.current_album = C.next_album;
+            C.next_album = NULL;
+            C.next_album_tried = false;
+            app_update_album_total_time();
+            app_refresh_album_info();
+            app_refresh_playlist();
+        }
+    }
+
+    if (C.next_album != NULL || C.next_album_tried ||
+        C.current_time + APP_PRELOAD_MS <
+        C.current_album->total_time) {
+        return;
+    }
+
+    C.next_album_tried = true;
+
+    index = app_get_next_album_index();
+    if (index < 0) {
+        return;
+    }
+
+    ret = audio_ctl_queue_next(C.audioctl, R.albums[index].path);
+    if (ret < 0) {
+        LV_LOG_WARN("Gapless preload of %s failed: %d", R.albums[index].path, ret);
+        return;
+    }
+
+    C.next_album = &R.albums[index];
+}
+#endif
+
 static void app_set_volume(uint16_t volume)
 {
     C.volume = volume;
@@ -207,6 +380,10 @@ static void app_set_volume(uint16_t volume)
 
 void app_set_play_status(play_status_t status)
 {
+    if (status == PLAY_STATUS_PLAY) {
+        audio_trace_mark(AUDIO_TRACE_PLAY_STATUS);
+    }
+
     C.play_status_prev = C.play_status;
     C.play_status = status;
     app_refresh_play_status();
@@ -220,14 +397,62 @@ void app_switch_to_album(int index)
     C.current_album = &R.albums[index];
     app_refresh_album_info();
     app_refresh_playlist();
-    app_set_playback_time(0);
 
     if (C.play_status == PLAY_STATUS_STOP) {
+        app_set_playback_time(0);
         return;
     }
 
-    app_set_play_status(PLAY_STATUS_STOP);
-    app_set_play_status(PLAY_STATUS_PLAY);
+    app_open_current_album();
+    C.current_time = 0;
+    app_refresh_playback_progress();
+
+    if (C.play_status == PLAY_STATUS_PAUSE) {
+        app_set_play_status(PLAY_STATUS_PLAY);
+    }
+}
+
+/**
+ * @brief 在已打开的输出会话上换成当前曲目，第一次播放时才创建会话
+ *
+ * 格式相同的曲目只替换音源，设备、缓冲区和消息循环线程都保留；
+ * 采样格式不同时由 audio_ctl_switch() 自行重新配置设备。
+ */
+static void app_open_current_album(void)
+{
+    int ret;
+
+    C.next_album = NULL;
+    C.next_album_tried = false;
+
+    if (C.audioctl != NULL) {
+        ret = audio_ctl_switch(C.audioctl, C.current_album->path);
+        if (ret == 0) {
+            app_update_album_total_time();
+            return;
+        }
+
+        LV_LOG_WARN("Switch to %s failed: %d", C.current_album->path, ret);
+        audio_ctl_stop(C.audioctl);
+        audio_ctl_uninit_nxaudio(C.audioctl);
+        C.audioctl = NULL;
+    }
+
+    C.audioctl = audio_ctl_init_nxaudio(C.current_album->path);
+    if (C.audioctl == NULL) {
+        return;
+    }
+
+    C.track_serial = audio_ctl_get_track_serial(C.audioctl);
+#ifdef CONFIG_LVX_MUSIC_PLAYER_CROSSFADE
+    audio_ctl_set_crossfade(C.audioctl, CONFIG_LVX_MUSIC_PLAYER_CROSSFADE_MS);
+#endif
+    app_update_album_total_time();
+
+    // 新会话处于INIT状态：界面仍在播放时直接启动，否则切歌后会静音
+    if (C.play_status == PLAY_STATUS_PLAY) {
+        audio_ctl_resume(C.audioctl);
+    }
 }
 
 static void app_set_playback_time(uint32_t current_time)
@@ -342,11 +567,12 @@ static void app_refresh_play_status(void)
         lv_image_set_src(R.ui.play_btn, R.images.play);
         lv_timer_pause(C.timers.playback_progress_update);
         app_stop_cover_rotation_animation();  // 停止封面旋转
+        // 输出会话保持打开，只暂停设备，下次播放时直接换音源
         if (C.audioctl) {
-            audio_ctl_stop(C.audioctl);
-            audio_ctl_uninit_nxaudio(C.audioctl);
-            C.audioctl = NULL;
+            audio_ctl_pause(C.audioctl);
         }
+        C.next_album = NULL;
+        C.next_album_tried = false;
         break;
     case PLAY_STATUS_PLAY:
         lv_image_set_src(R.ui.play_btn, R.images.pause);
@@ -355,8 +581,9 @@ static void app_refresh_play_status(void)
         if (C.play_status_prev == PLAY_STATUS_PAUSE)
             audio_ctl_resume(C.audioctl);
         else if (C.play_status_prev == PLAY_STATUS_STOP) {
-            C.audioctl = audio_ctl_init_nxaudio(C.current_album->path);
-            audio_ctl_start(C.audioctl);
+            // 换音源后会话仍是暂停的；新建的会话已由app_open_current_album()启动
+            app_open_current_album();
+            audio_ctl_resume(C.audioctl);
         }
         break;
     case PLAY_STATUS_PAUSE:
@@ -419,6 +646,15 @@ static void app_playback_progress_update_timer_cb(lv_timer_t* timer)
 {
     LV_UNUSED(timer);
 
+#ifdef CONFIG_LVX_MUSIC_PLAYER_GAPLESS
+    app_update_gapless();
+#endif
+
+    if (C.audioctl && audio_ctl_is_finished(C.audioctl)) {
+        app_play_next_album();
+        return;
+    }
+
     C.current_time = audio_ctl_get_position(C.audioctl) * 1000;
     app_refresh_playback_progress();
 }
@@ -508,6 +744,8 @@ static void app_switch_album_event_handler(lv_event_t* e)
 {
     switch_album_mode_t direction = (switch_album_mode_t)(lv_uintptr_t)lv_event_get_user_data(e);
 
+    audio_trace_begin(AUDIO_TRACE_SWITCH);
+
     int32_t album_index = app_get_album_index(C.current_album);
     if (album_index < 0) {
         return;
@@ -535,12 +773,14 @@ static void app_play_status_event_handler(lv_event_t* e)
 
     switch (C.play_status) {
     case PLAY_STATUS_STOP:
+        audio_trace_begin(AUDIO_TRACE_PLAY);
         app_set_play_status(PLAY_STATUS_PLAY);
         break;
     case PLAY_STATUS_PLAY:
         app_set_play_status(PLAY_STATUS_PAUSE);
         break;
     case PLAY_STATUS_PAUSE:
+        audio_trace_begin(AUDIO_TRACE_PLAY);
         app_set_play_status(PLAY_STATUS_PLAY);
         break;
     default:
@@ -1152,6 +1392,18 @@ static void read_configs(void)
         return;
     }
 
+    const char* play_mode = cJSON_GetStringValue(cJSON_GetObjectItem(json, "play_mode"));
+    if (play_mode != NULL) {
+        if (strcmp(play_mode, "shuffle") == 0)
+            C.play_mode = PLAY_MODE_SHUFFLE;
+        else if (strcmp(play_mode, "repeat_one") == 0)
+            C.play_mode = PLAY_MODE_REPEAT_ONE;
+        else if (strcmp(play_mode, "repeat_all") == 0)
+            C.play_mode = PLAY_MODE_REPEAT_ALL;
+        else
+            C.play_mode = PLAY_MODE_SEQUENTIAL;
+    }
+
 #if WIFI_ENABLED
     cJSON* wifi_object = cJSON_GetObjectItem(json, "wifi");
 
@@ -1182,6 +1434,9 @@ static void reload_music_config(void)
     lv_free(R.albums);
     R.album_count = 0;
 
+    lv_free(C.shuffle_order);
+    C.shuffle_order = NULL;
+
     /* Load music config */
     uint32_t file_size;
     lv_fs_file_t file;
@@ -9,6 +9,7 @@
 
 #include "audio_ctl.h"
 #include "lvgl.h"
+#include "playlist_types.h"
 #include "wifi.h"
 
 #define RES_ROOT CONFIG_LVX_MUSIC_PLAYER_DATA_ROOT "/res"
@@ -133,6 +134,12 @@ struct ctx_s {
     play_status_t play_status;
     uint64_t current_time;
 
+    play_mode_t play_mode;
+    uint8_t* shuffle_order;                  // 随机播放顺序
+    album_info_t* next_album;                // 已预加载的下一首（无缝播放）
+    bool next_album_tried;                   // 本曲目已尝试过预加载
+    uint32_t track_serial;                   // 已播放到的无缝切换次数
+
     struct {
         lv_timer_t* volume_bar_countdown;
         lv_timer_t* playback_progress_update;
@@ -0,0 +1,274 @@
+/**
+ * @file pcm_convert.c
+ * Fixed-point to 16-bit PCM conversion and interleave kernels
+ *
+ * Every variant computes exactly the same result as the scalar reference:
+ * add half an output LSB, clip to [-1.0, 1.0), shift down to 16 bits and
+ * interleave left/right. The instruction set is chosen at build time from
+ * the compiler target (NEON, SSE2); on x86 hosts AVX2 is additionally
+ * picked at run time when the CPU supports it.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "pcm_convert.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PCM_CONVERT_HAVE_NEON 1
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define PCM_CONVERT_HAVE_SSE2 1
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define PCM_CONVERT_HAVE_AVX2 1
+#endif
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define PCM_CONVERT_SHIFT (PCM_CONVERT_FRACBITS + 1 - 16)
+#define PCM_CONVERT_ROUND (1 << (PCM_CONVERT_SHIFT - 1))
+#define PCM_CONVERT_ONE   (1 << PCM_CONVERT_FRACBITS)
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static void pcm_convert_scalar(FAR int16_t *out, FAR const int32_t *left,
+                               FAR const int32_t *right, size_t n);
+#ifdef PCM_CONVERT_HAVE_NEON
+static void pcm_convert_neon(FAR int16_t *out, FAR const int32_t *left,
+                             FAR const int32_t *right, size_t n);
+#endif
+#ifdef PCM_CONVERT_HAVE_SSE2
+static void pcm_convert_sse2(FAR int16_t *out, FAR const int32_t *left,
+                             FAR const int32_t *right, size_t n);
+#endif
+#ifdef PCM_CONVERT_HAVE_AVX2
+static void pcm_convert_avx2(FAR int16_t *out, FAR const int32_t *left,
+                             FAR const int32_t *right, size_t n);
+#endif
+static void pcm_convert_select(void);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+static pcm_convert_variant_s g_pcm_convert_variants[4];
+static int g_pcm_convert_count;
+static pcm_convert_fn g_pcm_convert;
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static inline int16_t pcm_convert_one(int32_t sample)
+{
+    sample += PCM_CONVERT_ROUND;
+
+    /* Written as selects so the compiler can use SSAT / cmov */
+
+    sample = sample >= PCM_CONVERT_ONE ? PCM_CONVERT_ONE - 1 : sample;
+    sample = sample < -PCM_CONVERT_ONE ? -PCM_CONVERT_ONE : sample;
+
+    return (int16_t)(sample >> PCM_CONVERT_SHIFT);
+}
+
+static void pcm_convert_scalar(FAR int16_t *out, FAR const int32_t *left,
+                               FAR const int32_t *right, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++)
+    {
+        out[2 * i] = pcm_convert_one(left[i]);
+        out[2 * i + 1] = pcm_convert_one(right[i]);
+    }
+}
+
+#ifdef PCM_CONVERT_HAVE_NEON
+/* vqrshrn rounds, shifts and saturates in one go, vst2 interleaves */
+
+static void pcm_convert_neon(FAR int16_t *out, FAR const int32_t *left,
+                             FAR const int32_t *right, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        int16x8x2_t lr;
+
+        lr.val[0] = vcombine_s16(
+            vqrshrn_n_s32(vld1q_s32(left + i), PCM_CONVERT_SHIFT),
+            vqrshrn_n_s32(vld1q_s32(left + i + 4), PCM_CONVERT_SHIFT));
+        lr.val[1] = vcombine_s16(
+            vqrshrn_n_s32(vld1q_s32(right + i), PCM_CONVERT_SHIFT),
+            vqrshrn_n_s32(vld1q_s32(right + i + 4), PCM_CONVERT_SHIFT));
+
+        vst2q_s16(out + 2 * i, lr);
+    }
+
+    pcm_convert_scalar(out + 2 * i, left + i, right + i, n - i);
+}
+#endif
+
+#ifdef PCM_CONVERT_HAVE_SSE2
+/* Shifting before packs_epi32 saturates to the same range as the clip */
+
+static void pcm_convert_sse2(FAR int16_t *out, FAR const int32_t *left,
+                             FAR const int32_t *right, size_t n)
+{
+    const __m128i round = _mm_set1_epi32(PCM_CONVERT_ROUND);
+    size_t i;
+
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        __m128i l0 = _mm_loadu_si128((FAR const __m128i *)(left + i));
+        __m128i l1 = _mm_loadu_si128((FAR const __m128i *)(left + i + 4));
+        __m128i r0 = _mm_loadu_si128((FAR const __m128i *)(right + i));
+        __m128i r1 = _mm_loadu_si128((FAR const __m128i *)(right + i + 4));
+        __m128i l;
+        __m128i r;
+
+        l0 = _mm_srai_epi32(_mm_add_epi32(l0, round), PCM_CONVERT_SHIFT);
+        l1 = _mm_srai_epi32(_mm_add_epi32(l1, round), PCM_CONVERT_SHIFT);
+        r0 = _mm_srai_epi32(_mm_add_epi32(r0, round), PCM_CONVERT_SHIFT);
+        r1 = _mm_srai_epi32(_mm_add_epi32(r1, round), PCM_CONVERT_SHIFT);
+
+        l = _mm_packs_epi32(l0, l1);
+        r = _mm_packs_epi32(r0, r1);
+
+        _mm_storeu_si128((FAR __m128i *)(out + 2 * i),
+                         _mm_unpacklo_epi16(l, r));
+        _mm_storeu_si128((FAR __m128i *)(out + 2 * i + 8),
+                         _mm_unpackhi_epi16(l, r));
+    }
+
+    pcm_convert_scalar(out + 2 * i, left + i, right + i, n - i);
+}
+#endif
+
+#ifdef PCM_CONVERT_HAVE_AVX2
+/* packs and unpack work per 128-bit lane, which here happens to leave
+ * frames 0-7 in the low result and frames 8-15 in the high one.
+ */
+
+__attribute__((target("avx2")))
+static void pcm_convert_avx2(FAR int16_t *out, FAR const int32_t *left,
+                             FAR const int32_t *right, size_t n)
+{
+    const __m256i round = _mm256_set1_epi32(PCM_CONVERT_ROUND);
+    size_t i;
+
+    for (i = 0; i + 16 <= n; i += 16)
+    {
+        __m256i l0 = _mm256_loadu_si256((FAR const __m256i *)(left + i));
+        __m256i l1 = _mm256_loadu_si256((FAR const __m256i *)(left + i + 8));
+        __m256i r0 = _mm256_loadu_si256((FAR const __m256i *)(right + i));
+        __m256i r1 = _mm256_loadu_si256((FAR const __m256i *)(right + i + 8));
+        __m256i l;
+        __m256i r;
+
+        l0 = _mm256_srai_epi32(_mm256_add_epi32(l0, round), PCM_CONVERT_SHIFT);
+        l1 = _mm256_srai_epi32(_mm256_add_epi32(l1, round), PCM_CONVERT_SHIFT);
+        r0 = _mm256_srai_epi32(_mm256_add_epi32(r0, round), PCM_CONVERT_SHIFT);
+        r1 = _mm256_srai_epi32(_mm256_add_epi32(r1, round), PCM_CONVERT_SHIFT);
+
+        l = _mm256_packs_epi32(l0, l1);
+        r = _mm256_packs_epi32(r0, r1);
+
+        _mm256_storeu_si256((FAR __m256i *)(out + 2 * i),
+                            _mm256_unpacklo_epi16(l, r));
+        _mm256_storeu_si256((FAR __m256i *)(out + 2 * i + 16),
+                            _mm256_unpackhi_epi16(l, r));
+    }
+
+    pcm_convert_scalar(out + 2 * i, left + i, right + i, n - i);
+}
+#endif
+
+/* Every candidate writes the same value, so racing first calls are benign */
+
+static void pcm_convert_select(void)
+{
+    int count = 0;
+
+    g_pcm_convert_variants[count].name = "scalar";
+    g_pcm_convert_variants[count++].fn = pcm_convert_scalar;
+
+#ifdef PCM_CONVERT_HAVE_NEON
+    g_pcm_convert_variants[count].name = "neon";
+    g_pcm_convert_variants[count++].fn = pcm_convert_neon;
+#endif
+
+#ifdef PCM_CONVERT_HAVE_SSE2
+    g_pcm_convert_variants[count].name = "sse2";
+    g_pcm_convert_variants[count++].fn = pcm_convert_sse2;
+#endif
+
+#ifdef PCM_CONVERT_HAVE_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        g_pcm_convert_variants[count].name = "avx2";
+        g_pcm_convert_variants[count++].fn = pcm_convert_avx2;
+    }
+#endif
+
+    /* The last registered variant is the fastest one available */
+
+    g_pcm_convert_count = count;
+    g_pcm_convert = g_pcm_convert_variants[count - 1].fn;
+}
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+/**
+ * @brief Convert Q3.28 samples to interleaved 16-bit stereo
+ * @param out 2 * n output samples
+ * @param left Left channel
+ * @param right Right channel, or left again for mono
+ * @param n Samples per channel
+ */
+void pcm_convert_q28_s16(FAR int16_t *out, FAR const int32_t *left,
+                         FAR const int32_t *right, size_t n)
+{
+    if (g_pcm_convert == NULL) {
+        pcm_convert_select();
+    }
+
+    g_pcm_convert(out, left, right, n);
+}
+
+/**
+ * @brief Name of the kernel pcm_convert_q28_s16() dispatches to
+ */
+FAR const char *pcm_convert_name(void)
+{
+    if (g_pcm_convert == NULL) {
+        pcm_convert_select();
+    }
+
+    return g_pcm_convert_variants[g_pcm_convert_count - 1].name;
+}
+
+/**
+ * @brief List every kernel usable on this CPU, scalar reference first
+ * @return Number of entries in *variants
+ */
+int pcm_convert_variants(FAR const pcm_convert_variant_s **variants)
+{
+    if (g_pcm_convert == NULL) {
+        pcm_convert_select();
+    }
+
+    *variants = g_pcm_convert_variants;
+    return g_pcm_convert_count;
+}
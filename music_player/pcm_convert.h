@@ -0,0 +1,58 @@
+/**
+ * @file pcm_convert.h
+ * Fixed-point to 16-bit PCM conversion and interleave kernels
+ */
+
+#ifndef PCM_CONVERT_H
+#define PCM_CONVERT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <nuttx/config.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* libmad synth output is Q3.28 (MAD_F_FRACBITS) */
+
+#define PCM_CONVERT_FRACBITS 28
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* Round, clip and narrow n samples per channel to interleaved stereo.
+ * Passing right == left duplicates a mono channel.
+ */
+
+typedef void (*pcm_convert_fn)(FAR int16_t *out, FAR const int32_t *left,
+                               FAR const int32_t *right, size_t n);
+
+typedef struct pcm_convert_variant {
+    FAR const char *name;
+    pcm_convert_fn fn;
+} pcm_convert_variant_s;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+void pcm_convert_q28_s16(FAR int16_t *out, FAR const int32_t *left,
+                         FAR const int32_t *right, size_t n);
+
+FAR const char *pcm_convert_name(void);
+int pcm_convert_variants(FAR const pcm_convert_variant_s **variants);
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /* PCM_CONVERT_H */
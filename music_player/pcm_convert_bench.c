@@ -0,0 +1,144 @@
+/**
+ * @file pcm_convert_bench.c
+ * Microbenchmark for the PCM conversion kernels
+ *
+ * Usage: pcm_convert_bench [frames] [iterations]
+ *
+ * Every kernel is first checked bit for bit against the scalar reference,
+ * then timed on the same Q3.28 input (including out of range samples so the
+ * clipping path is exercised). Throughput is reported in samples per second
+ * counting both channels.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <nuttx/config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pcm_convert.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define BENCH_DEFAULT_FRAMES     1152
+#define BENCH_DEFAULT_ITERATIONS 20000
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void bench_fill(FAR int32_t *buf, size_t n, uint32_t seed)
+{
+    size_t i;
+
+    /* Roughly +/-1.25 full scale so about a fifth of the samples clip */
+
+    for (i = 0; i < n; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        buf[i] = (int32_t)seed / 6;
+    }
+}
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int main(int argc, FAR char *argv[])
+{
+    FAR const pcm_convert_variant_s *variants;
+    FAR int32_t *left;
+    FAR int32_t *right;
+    FAR int16_t *ref;
+    FAR int16_t *out;
+    size_t frames = BENCH_DEFAULT_FRAMES;
+    int iterations = BENCH_DEFAULT_ITERATIONS;
+    int count;
+    int ret = 0;
+    int i;
+
+    if (argc > 1) {
+        frames = strtoul(argv[1], NULL, 0);
+    }
+
+    if (argc > 2) {
+        iterations = atoi(argv[2]);
+    }
+
+    if (frames == 0 || iterations <= 0) {
+        printf("Usage: %s [frames] [iterations]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    left = malloc(frames * sizeof(int32_t));
+    right = malloc(frames * sizeof(int32_t));
+    ref = malloc(2 * frames * sizeof(int16_t));
+    out = malloc(2 * frames * sizeof(int16_t));
+    if (!left || !right || !ref || !out) {
+        printf("Out of memory\n");
+        ret = EXIT_FAILURE;
+        goto out;
+    }
+
+    bench_fill(left, frames, 1);
+    bench_fill(right, frames, 2);
+
+    count = pcm_convert_variants(&variants);
+    variants[0].fn(ref, left, right, frames);
+
+    printf("pcm_convert: %zu frames x %d iterations, dispatch = %s\n",
+           frames, iterations, pcm_convert_name());
+
+    for (i = 0; i < count; i++)
+    {
+        uint64_t start;
+        uint64_t elapsed;
+        int j;
+
+        memset(out, 0, 2 * frames * sizeof(int16_t));
+        variants[i].fn(out, left, right, frames);
+        if (memcmp(out, ref, 2 * frames * sizeof(int16_t)) != 0) {
+            printf("  %-8s MISMATCH against scalar reference\n",
+                   variants[i].name);
+            ret = EXIT_FAILURE;
+            continue;
+        }
+
+        start = bench_now_ns();
+        for (j = 0; j < iterations; j++)
+        {
+            variants[i].fn(out, left, right, frames);
+        }
+
+        elapsed = bench_now_ns() - start;
+        if (elapsed == 0) {
+            elapsed = 1;
+        }
+
+        printf("  %-8s %10.1f Msamples/s  %6.2f ns/frame\n",
+               variants[i].name,
+               2.0 * frames * iterations * 1000.0 / elapsed,
+               (double)elapsed / ((double)frames * iterations));
+    }
+
+out:
+    free(left);
+    free(right);
+    free(ref);
+    free(out);
+    return ret;
+}
@@ -0,0 +1,799 @@
+/**
+ * @file pcm_eq.c
+ * Fixed-point parametric equalizer for 16-bit stereo PCM
+ *
+ * A cascade of up to PCM_EQ_MAX_BANDS biquads (peaking, shelving, low and
+ * high-pass, RBJ cookbook designs) in direct form I. Samples are Q31 with
+ * 12 dB of headroom above 16-bit full scale, coefficients Q3.28, products
+ * are summed in 64 bits and every stage output is rounded and saturated
+ * to 32 bits, so the cost per sample is fixed: five multiply-accumulates
+ * per band and channel, no data dependent branches.
+ *
+ * Coefficients are designed in pcm_eq_set() on the caller's thread, only
+ * when the settings change, and taken over by the audio thread without
+ * blocking. They are then ramped linearly from the old to the new set
+ * over EQ_RAMP_MS, one step per PCM_EQ_CHUNK frames. The set of stable
+ * biquads is convex in (a1, a2) and the coefficient bound below holds for
+ * every mix of two sets, so each intermediate filter is stable and cannot
+ * overflow. Bands are added and removed by ramping from and to a
+ * pass-through stage.
+ *
+ * Both channels of a stage run side by side, dispatched like pcm_resample
+ * to a NEON kernel on ARM and an SSE4.2 one on x86 hosts that have it.
+ * Every variant matches the scalar reference bit for bit.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "pcm_eq.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PCM_EQ_HAVE_NEON 1
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define PCM_EQ_HAVE_SSE42 1
+#endif
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define PCM_EQ_PI    3.14159265358979323846
+#define PCM_EQ_ONE   (1 << PCM_EQ_COEF_BITS)
+#define PCM_EQ_ROUND (1ll << (PCM_EQ_COEF_BITS - 1))
+
+/* Sum of |coefficient| the 64-bit accumulator takes from Q31 samples and
+ * Q3.28 coefficients: 16 * 2^31 * 2^28 = 2^63, less a margin for rounding.
+ */
+
+#define PCM_EQ_COEF_SUM_MAX 15.9
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static void pcm_eq_stage_scalar(FAR int32_t *buf, size_t frames,
+                                FAR const pcm_eq_coef_s *coef,
+                                FAR pcm_eq_state_s *state);
+#ifdef PCM_EQ_HAVE_NEON
+static void pcm_eq_stage_neon(FAR int32_t *buf, size_t frames,
+                              FAR const pcm_eq_coef_s *coef,
+                              FAR pcm_eq_state_s *state);
+#endif
+#ifdef PCM_EQ_HAVE_SSE42
+static void pcm_eq_stage_sse42(FAR int32_t *buf, size_t frames,
+                               FAR const pcm_eq_coef_s *coef,
+                               FAR pcm_eq_state_s *state);
+#endif
+static void pcm_eq_select(void);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+static const pcm_eq_coef_s g_pcm_eq_identity = { PCM_EQ_ONE, 0, 0, 0, 0 };
+
+static FAR const char *const g_pcm_eq_types[] =
+{
+    [PCM_EQ_PEAK]       = "peak",
+    [PCM_EQ_LOW_SHELF]  = "lowshelf",
+    [PCM_EQ_HIGH_SHELF] = "highshelf",
+    [PCM_EQ_LOW_PASS]   = "lowpass",
+    [PCM_EQ_HIGH_PASS]  = "highpass",
+};
+
+static pcm_eq_variant_s g_pcm_eq_variants[3];
+static int g_pcm_eq_count;
+static pcm_eq_stage_fn g_pcm_eq_stage;
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static inline int32_t pcm_eq_sat32(int64_t acc)
+{
+    acc = (acc + PCM_EQ_ROUND) >> PCM_EQ_COEF_BITS;
+    acc = acc > INT32_MAX ? INT32_MAX : acc;
+    acc = acc < INT32_MIN ? INT32_MIN : acc;
+
+    return (int32_t)acc;
+}
+
+/* Round to nearest without forming x + half, which could overflow */
+
+static inline int16_t pcm_eq_sat16(int32_t x)
+{
+    x = (x >> PCM_EQ_IN_SHIFT) + ((x >> (PCM_EQ_IN_SHIFT - 1)) & 1);
+    x = x > INT16_MAX ? INT16_MAX : x;
+    x = x < INT16_MIN ? INT16_MIN : x;
+
+    return (int16_t)x;
+}
+
+static void pcm_eq_stage_scalar(FAR int32_t *buf, size_t frames,
+                                FAR const pcm_eq_coef_s *coef,
+                                FAR pcm_eq_state_s *state)
+{
+    size_t i;
+    int ch;
+
+    for (ch = 0; ch < PCM_EQ_CHANNELS; ch++)
+    {
+        int32_t x1 = state->x1[ch];
+        int32_t x2 = state->x2[ch];
+        int32_t y1 = state->y1[ch];
+        int32_t y2 = state->y2[ch];
+
+        for (i = 0; i < frames; i++)
+        {
+            int32_t x = buf[i * PCM_EQ_CHANNELS + ch];
+            int64_t acc;
+
+            acc = (int64_t)coef->b0 * x + (int64_t)coef->b1 * x1 +
+                  (int64_t)coef->b2 * x2 + (int64_t)coef->a1 * y1 +
+                  (int64_t)coef->a2 * y2;
+
+            x2 = x1;
+            x1 = x;
+            y2 = y1;
+            y1 = pcm_eq_sat32(acc);
+            buf[i * PCM_EQ_CHANNELS + ch] = y1;
+        }
+
+        state->x1[ch] = x1;
+        state->x2[ch] = x2;
+        state->y1[ch] = y1;
+        state->y2[ch] = y2;
+    }
+}
+
+#ifdef PCM_EQ_HAVE_NEON
+/* vqrshrn rounds and saturates exactly like pcm_eq_sat32() */
+
+static void pcm_eq_stage_neon(FAR int32_t *buf, size_t frames,
+                              FAR const pcm_eq_coef_s *coef,
+                              FAR pcm_eq_state_s *state)
+{
+    int32x2_t x1 = vld1_s32(state->x1);
+    int32x2_t x2 = vld1_s32(state->x2);
+    int32x2_t y1 = vld1_s32(state->y1);
+    int32x2_t y2 = vld1_s32(state->y2);
+    size_t i;
+
+    for (i = 0; i < frames; i++)
+    {
+        int32x2_t x = vld1_s32(buf + i * PCM_EQ_CHANNELS);
+        int64x2_t acc;
+
+        acc = vmull_n_s32(x, coef->b0);
+        acc = vmlal_n_s32(acc, x1, coef->b1);
+        acc = vmlal_n_s32(acc, x2, coef->b2);
+        acc = vmlal_n_s32(acc, y1, coef->a1);
+        acc = vmlal_n_s32(acc, y2, coef->a2);
+
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = vqrshrn_n_s64(acc, PCM_EQ_COEF_BITS);
+        vst1_s32(buf + i * PCM_EQ_CHANNELS, y1);
+    }
+
+    vst1_s32(state->x1, x1);
+    vst1_s32(state->x2, x2);
+    vst1_s32(state->y1, y1);
+    vst1_s32(state->y2, y2);
+}
+#endif
+
+#ifdef PCM_EQ_HAVE_SSE42
+/* pmuldq multiplies dwords 0 and 2, so left and right live there. There
+ * is no 64-bit arithmetic shift: the sum is clamped to the range that
+ * shifts into 32 bits, then shifted up to put the result in the high
+ * dword.
+ */
+
+#define PCM_EQ_SSE_LOAD(p) \
+    _mm_shuffle_epi32(_mm_loadl_epi64((FAR const __m128i *)(p)), \
+                      _MM_SHUFFLE(1, 1, 0, 0))
+#define PCM_EQ_SSE_STORE(p, v) \
+    _mm_storel_epi64((FAR __m128i *)(p), \
+                     _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 0, 2, 0)))
+
+__attribute__((target("sse4.2")))
+static void pcm_eq_stage_sse42(FAR int32_t *buf, size_t frames,
+                               FAR const pcm_eq_coef_s *coef,
+                               FAR pcm_eq_state_s *state)
+{
+    const __m128i b0 = _mm_set1_epi32(coef->b0);
+    const __m128i b1 = _mm_set1_epi32(coef->b1);
+    const __m128i b2 = _mm_set1_epi32(coef->b2);
+    const __m128i a1 = _mm_set1_epi32(coef->a1);
+    const __m128i a2 = _mm_set1_epi32(coef->a2);
+    const __m128i round = _mm_set1_epi64x(PCM_EQ_ROUND);
+    const __m128i hi = _mm_set1_epi64x((1ll << (31 + PCM_EQ_COEF_BITS)) - 1);
+    const __m128i lo = _mm_set1_epi64x(-(1ll << (31 + PCM_EQ_COEF_BITS)));
+    __m128i x1 = PCM_EQ_SSE_LOAD(state->x1);
+    __m128i x2 = PCM_EQ_SSE_LOAD(state->x2);
+    __m128i y1 = PCM_EQ_SSE_LOAD(state->y1);
+    __m128i y2 = PCM_EQ_SSE_LOAD(state->y2);
+    size_t i;
+
+    for (i = 0; i < frames; i++)
+    {
+        __m128i x = PCM_EQ_SSE_LOAD(buf + i * PCM_EQ_CHANNELS);
+        __m128i acc;
+
+        acc = _mm_mul_epi32(x, b0);
+        acc = _mm_add_epi64(acc, _mm_mul_epi32(x1, b1));
+        acc = _mm_add_epi64(acc, _mm_mul_epi32(x2, b2));
+        acc = _mm_add_epi64(acc, _mm_mul_epi32(y1, a1));
+        acc = _mm_add_epi64(acc, _mm_mul_epi32(y2, a2));
+        acc = _mm_add_epi64(acc, round);
+        acc = _mm_blendv_epi8(acc, hi, _mm_cmpgt_epi64(acc, hi));
+        acc = _mm_blendv_epi8(acc, lo, _mm_cmpgt_epi64(lo, acc));
+
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = _mm_shuffle_epi32(_mm_slli_epi64(acc, 32 - PCM_EQ_COEF_BITS),
+                               _MM_SHUFFLE(3, 3, 1, 1));
+        PCM_EQ_SSE_STORE(buf + i * PCM_EQ_CHANNELS, y1);
+    }
+
+    PCM_EQ_SSE_STORE(state->x1, x1);
+    PCM_EQ_SSE_STORE(state->x2, x2);
+    PCM_EQ_SSE_STORE(state->y1, y1);
+    PCM_EQ_SSE_STORE(state->y2, y2);
+}
+#endif
+
+/* Every candidate writes the same value, so racing first calls are benign */
+
+static void pcm_eq_select(void)
+{
+    int count = 0;
+
+    g_pcm_eq_variants[count].name = "scalar";
+    g_pcm_eq_variants[count++].fn = pcm_eq_stage_scalar;
+
+#ifdef PCM_EQ_HAVE_NEON
+    g_pcm_eq_variants[count].name = "neon";
+    g_pcm_eq_variants[count++].fn = pcm_eq_stage_neon;
+#endif
+
+#ifdef PCM_EQ_HAVE_SSE42
+    if (__builtin_cpu_supports("sse4.2")) {
+        g_pcm_eq_variants[count].name = "sse4.2";
+        g_pcm_eq_variants[count++].fn = pcm_eq_stage_sse42;
+    }
+#endif
+
+    /* The last registered variant is the fastest one available */
+
+    g_pcm_eq_count = count;
+    g_pcm_eq_stage = g_pcm_eq_variants[count - 1].fn;
+}
+
+static int pcm_eq_check(FAR const pcm_eq_band_s *band)
+{
+    if (band->type > PCM_EQ_HIGH_PASS || band->freq == 0 ||
+        band->q < PCM_EQ_Q_MIN || band->q > PCM_EQ_Q_MAX ||
+        band->gain > PCM_EQ_GAIN_MAX || band->gain < -PCM_EQ_GAIN_MAX) {
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Make an added stage pass its input through from the start
+ *
+ * The history of a pass-through stage is its input twice over: the last
+ * input frames for the first stage, the previous stage's output otherwise.
+ */
+static void pcm_eq_insert(FAR pcm_eq_s *eq, int s)
+{
+    FAR pcm_eq_state_s *st = &eq->state[s];
+
+    if (s == 0) {
+        memcpy(st->x1, eq->in1, sizeof(st->x1));
+        memcpy(st->x2, eq->in2, sizeof(st->x2));
+    } else {
+        memcpy(st->x1, eq->state[s - 1].y1, sizeof(st->x1));
+        memcpy(st->x2, eq->state[s - 1].y2, sizeof(st->x2));
+    }
+
+    memcpy(st->y1, st->x1, sizeof(st->y1));
+    memcpy(st->y2, st->x2, sizeof(st->y2));
+    eq->coef[s] = g_pcm_eq_identity;
+}
+
+/**
+ * @brief Start ramping to the settings posted by pcm_eq_set()
+ *
+ * Audio thread. If the poster holds the lock the update waits for the
+ * next block rather than block the audio thread.
+ */
+static void pcm_eq_take(FAR pcm_eq_s *eq)
+{
+    int stages;
+    int s;
+
+    if (pthread_mutex_trylock(&eq->lock) != 0) {
+        return;
+    }
+
+    stages = eq->npending > eq->stages ? eq->npending : eq->stages;
+
+    for (s = eq->stages; s < stages; s++)
+    {
+        pcm_eq_insert(eq, s);
+    }
+
+    for (s = 0; s < stages; s++)
+    {
+        eq->from[s] = eq->coef[s];
+        eq->to[s] = s < eq->npending ? eq->pending_coef[s] :
+                    g_pcm_eq_identity;
+    }
+
+    eq->nbands = eq->npending;
+    eq->stages = stages;
+    eq->ramp_pos = 0;
+    eq->ramp_len = eq->rate * CONFIG_LVX_MUSIC_PLAYER_EQ_RAMP_MS / 1000;
+    if (eq->ramp_len == 0) {
+        eq->ramp_len = 1;
+    }
+
+    atomic_store(&eq->update, false);
+    pthread_mutex_unlock(&eq->lock);
+}
+
+/**
+ * @brief Move the coefficients one step along the ramp
+ */
+static void pcm_eq_ramp(FAR pcm_eq_s *eq, size_t frames)
+{
+    FAR const int32_t *from;
+    FAR const int32_t *to;
+    FAR int32_t *cur;
+    int64_t frac;
+    int s;
+    int k;
+
+    eq->ramp_pos += frames;
+
+    if (eq->ramp_pos >= eq->ramp_len) {
+        memcpy(eq->coef, eq->to, eq->stages * sizeof(pcm_eq_coef_s));
+
+        /* Stages past the band list are pass-through now */
+
+        eq->stages = eq->nbands;
+        eq->ramp_len = 0;
+        return;
+    }
+
+    frac = ((int64_t)eq->ramp_pos << 16) / eq->ramp_len;
+
+    for (s = 0; s < eq->stages; s++)
+    {
+        from = (FAR const int32_t *)&eq->from[s];
+        to = (FAR const int32_t *)&eq->to[s];
+        cur = (FAR int32_t *)&eq->coef[s];
+
+        for (k = 0; k < 5; k++)
+        {
+            cur[k] = from[k] + (((int64_t)to[k] - from[k]) * frac >> 16);
+        }
+    }
+}
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+/**
+ * @brief Set up a flat equalizer, the stream rate follows with
+ *        pcm_eq_set_rate()
+ */
+void pcm_eq_init(FAR pcm_eq_s *eq)
+{
+    if (g_pcm_eq_stage == NULL) {
+        pcm_eq_select();
+    }
+
+    memset(eq, 0, sizeof(pcm_eq_s));
+    pthread_mutex_init(&eq->lock, NULL);
+    atomic_init(&eq->update, false);
+    eq->stage = g_pcm_eq_stage;
+}
+
+void pcm_eq_deinit(FAR pcm_eq_s *eq)
+{
+    if (eq == NULL) {
+        return;
+    }
+
+    pthread_mutex_destroy(&eq->lock);
+}
+
+/**
+ * @brief Replace the band list
+ * @param eq Equalizer
+ * @param bands New bands, applied in order
+ * @param nbands Number of bands, 0 makes the equalizer flat
+ * @return 0 on success, -EINVAL for a band out of range, -ERANGE for a
+ *         band whose coefficients Q3.28 cannot hold at this rate
+ *
+ * Any thread. The audio thread ramps to the new response from its next
+ * block on, bands are matched by position.
+ */
+int pcm_eq_set(FAR pcm_eq_s *eq, FAR const pcm_eq_band_s *bands, int nbands)
+{
+    pcm_eq_coef_s coef[PCM_EQ_MAX_BANDS];
+    int ret;
+    int i;
+
+    if (eq == NULL || nbands < 0 || nbands > PCM_EQ_MAX_BANDS ||
+        (bands == NULL && nbands > 0)) {
+        return -EINVAL;
+    }
+
+    for (i = 0; i < nbands; i++)
+    {
+        ret = pcm_eq_check(&bands[i]);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
+    pthread_mutex_lock(&eq->lock);
+
+    for (i = 0; eq->rate != 0 && i < nbands; i++)
+    {
+        ret = pcm_eq_design(&bands[i], eq->rate, &coef[i]);
+        if (ret < 0) {
+            pthread_mutex_unlock(&eq->lock);
+            return ret;
+        }
+    }
+
+    memcpy(eq->pending, bands, nbands * sizeof(pcm_eq_band_s));
+    eq->npending = nbands;
+
+    if (eq->rate != 0) {
+        memcpy(eq->pending_coef, coef, nbands * sizeof(pcm_eq_coef_s));
+        atomic_store(&eq->update, true);
+    }
+
+    pthread_mutex_unlock(&eq->lock);
+    return 0;
+}
+
+/**
+ * @brief Copy the current band list
+ * @return Number of bands
+ */
+int pcm_eq_get(FAR pcm_eq_s *eq, FAR pcm_eq_band_s *bands)
+{
+    int n;
+
+    pthread_mutex_lock(&eq->lock);
+    n = eq->npending;
+    memcpy(bands, eq->pending, n * sizeof(pcm_eq_band_s));
+    pthread_mutex_unlock(&eq->lock);
+
+    return n;
+}
+
+/**
+ * @brief Redesign every band for a new stream rate
+ *
+ * Call while the audio thread is not processing, e.g. before a session
+ * starts. The new response applies at once and the history is cleared.
+ * A band the rate cannot represent (at or above Nyquist) passes through.
+ */
+void pcm_eq_set_rate(FAR pcm_eq_s *eq, uint32_t rate)
+{
+    int i;
+
+    pthread_mutex_lock(&eq->lock);
+
+    eq->rate = rate;
+    for (i = 0; i < eq->npending; i++)
+    {
+        if (pcm_eq_design(&eq->pending[i], rate, &eq->pending_coef[i]) < 0) {
+            eq->pending_coef[i] = g_pcm_eq_identity;
+        }
+    }
+
+    eq->nbands = eq->npending;
+    eq->stages = eq->npending;
+    memcpy(eq->coef, eq->pending_coef, eq->stages * sizeof(pcm_eq_coef_s));
+    eq->ramp_len = 0;
+    atomic_store(&eq->update, false);
+
+    pthread_mutex_unlock(&eq->lock);
+
+    pcm_eq_reset(eq);
+}
+
+/**
+ * @brief Forget the filter history, the next block starts a new stream
+ */
+void pcm_eq_reset(FAR pcm_eq_s *eq)
+{
+    memset(eq->state, 0, sizeof(eq->state));
+    memset(eq->in1, 0, sizeof(eq->in1));
+    memset(eq->in2, 0, sizeof(eq->in2));
+}
+
+/**
+ * @brief Whether any band is set or still ramping out
+ */
+bool pcm_eq_active(FAR pcm_eq_s *eq)
+{
+    return eq->npending > 0 || eq->stages > 0;
+}
+
+/**
+ * @brief Equalize interleaved 16-bit stereo in place
+ * @param eq Equalizer
+ * @param pcm Samples
+ * @param frames Stereo frames
+ *
+ * Audio thread. Costs nothing while the equalizer is flat.
+ */
+void pcm_eq_process(FAR pcm_eq_s *eq, FAR int16_t *pcm, size_t frames)
+{
+    int32_t buf[PCM_EQ_CHUNK * PCM_EQ_CHANNELS];
+    size_t n;
+    size_t i;
+    int s;
+
+    if (atomic_load(&eq->update)) {
+        pcm_eq_take(eq);
+    }
+
+    while (frames > 0 && eq->stages > 0)
+    {
+        n = frames < PCM_EQ_CHUNK ? frames : PCM_EQ_CHUNK;
+
+        if (eq->ramp_len != 0) {
+            pcm_eq_ramp(eq, n);
+        }
+
+        for (i = 0; i < n * PCM_EQ_CHANNELS; i++)
+        {
+            buf[i] = (int32_t)pcm[i] * (1 << PCM_EQ_IN_SHIFT);
+        }
+
+        memcpy(eq->in2, n > 1 ? &buf[(n - 2) * PCM_EQ_CHANNELS] : eq->in1,
+               sizeof(eq->in2));
+        memcpy(eq->in1, &buf[(n - 1) * PCM_EQ_CHANNELS], sizeof(eq->in1));
+
+        for (s = 0; s < eq->stages; s++)
+        {
+            eq->stage(buf, n, &eq->coef[s], &eq->state[s]);
+        }
+
+        for (i = 0; i < n * PCM_EQ_CHANNELS; i++)
+        {
+            pcm[i] = pcm_eq_sat16(buf[i]);
+        }
+
+        pcm += n * PCM_EQ_CHANNELS;
+        frames -= n;
+    }
+}
+
+/**
+ * @brief Biquad coefficients of one band
+ * @param band Band settings
+ * @param rate Sample rate
+ * @param coef Returns the Q3.28 coefficients
+ * @return 0 on success, -EINVAL for settings out of range or a frequency
+ *         at or above Nyquist, -ERANGE when the coefficients exceed what
+ *         the accumulator takes (very high boosts at low Q)
+ */
+int pcm_eq_design(FAR const pcm_eq_band_s *band, uint32_t rate,
+                  FAR pcm_eq_coef_s *coef)
+{
+    double w0;
+    double cw;
+    double amp;
+    double alpha;
+    double sa;
+    double b[3];
+    double a[3];
+    double sum;
+    int i;
+
+    if (band == NULL || coef == NULL || pcm_eq_check(band) < 0 ||
+        rate == 0 || band->freq * 2 >= rate) {
+        return -EINVAL;
+    }
+
+    w0 = 2 * PCM_EQ_PI * band->freq / rate;
+    cw = cos(w0);
+    alpha = sin(w0) / (2 * band->q / 100.0);
+    amp = pow(10, band->gain / 400.0);
+    sa = 2 * sqrt(amp) * alpha;
+
+    switch (band->type) {
+    case PCM_EQ_PEAK:
+        b[0] = 1 + alpha * amp;
+        b[1] = -2 * cw;
+        b[2] = 1 - alpha * amp;
+        a[0] = 1 + alpha / amp;
+        a[1] = -2 * cw;
+        a[2] = 1 - alpha / amp;
+        break;
+    case PCM_EQ_LOW_SHELF:
+        b[0] = amp * ((amp + 1) - (amp - 1) * cw + sa);
+        b[1] = 2 * amp * ((amp - 1) - (amp + 1) * cw);
+        b[2] = amp * ((amp + 1) - (amp - 1) * cw - sa);
+        a[0] = (amp + 1) + (amp - 1) * cw + sa;
+        a[1] = -2 * ((amp - 1) + (amp + 1) * cw);
+        a[2] = (amp + 1) + (amp - 1) * cw - sa;
+        break;
+    case PCM_EQ_HIGH_SHELF:
+        b[0] = amp * ((amp + 1) + (amp - 1) * cw + sa);
+        b[1] = -2 * amp * ((amp - 1) + (amp + 1) * cw);
+        b[2] = amp * ((amp + 1) + (amp - 1) * cw - sa);
+        a[0] = (amp + 1) - (amp - 1) * cw + sa;
+        a[1] = 2 * ((amp - 1) - (amp + 1) * cw);
+        a[2] = (amp + 1) - (amp - 1) * cw - sa;
+        break;
+    case PCM_EQ_LOW_PASS:
+        b[0] = (1 - cw) / 2;
+        b[1] = 1 - cw;
+        b[2] = b[0];
+        a[0] = 1 + alpha;
+        a[1] = -2 * cw;
+        a[2] = 1 - alpha;
+        break;
+    default:
+        b[0] = (1 + cw) / 2;
+        b[1] = -(1 + cw);
+        b[2] = b[0];
+        a[0] = 1 + alpha;
+        a[1] = -2 * cw;
+        a[2] = 1 - alpha;
+        break;
+    }
+
+    for (sum = 0, i = 2; i >= 0; i--)
+    {
+        b[i] /= a[0];
+        a[i] /= a[0];
+        sum += fabs(b[i]) + (i > 0 ? fabs(a[i]) : 0);
+    }
+
+    if (sum > PCM_EQ_COEF_SUM_MAX) {
+        return -ERANGE;
+    }
+
+    coef->b0 = lrint(b[0] * PCM_EQ_ONE);
+    coef->b1 = lrint(b[1] * PCM_EQ_ONE);
+    coef->b2 = lrint(b[2] * PCM_EQ_ONE);
+    coef->a1 = lrint(-a[1] * PCM_EQ_ONE);
+    coef->a2 = lrint(-a[2] * PCM_EQ_ONE);
+
+    return 0;
+}
+
+/**
+ * @brief Parse a band list such as "highpass:120:0:0.71,peak:3000:-4:2"
+ * @param spec Comma separated TYPE:FREQ:GAIN_DB:Q, TYPE one of peak,
+ *             lowshelf, highshelf, lowpass, highpass
+ * @param bands Returns the bands
+ * @param max Capacity of bands
+ * @return Number of bands, -EINVAL on a syntax or range error
+ */
+int pcm_eq_parse(FAR const char *spec, FAR pcm_eq_band_s *bands, int max)
+{
+    FAR const char *p = spec;
+    FAR char *end;
+    double gain;
+    double q;
+    size_t len;
+    int count = 0;
+    int t;
+
+    if (spec == NULL || bands == NULL) {
+        return -EINVAL;
+    }
+
+    while (*p == ' ')
+    {
+        p++;
+    }
+
+    while (*p != '\0')
+    {
+        if (count == max) {
+            return -EINVAL;
+        }
+
+        for (t = 0; t <= PCM_EQ_HIGH_PASS; t++)
+        {
+            len = strlen(g_pcm_eq_types[t]);
+            if (strncmp(p, g_pcm_eq_types[t], len) == 0 && p[len] == ':') {
+                break;
+            }
+        }
+
+        if (t > PCM_EQ_HIGH_PASS) {
+            return -EINVAL;
+        }
+
+        p += len + 1;
+        bands[count].type = t;
+        bands[count].freq = strtoul(p, &end, 10);
+        if (*end != ':') {
+            return -EINVAL;
+        }
+
+        gain = strtod(end + 1, &end);
+        if (*end != ':') {
+            return -EINVAL;
+        }
+
+        q = strtod(end + 1, &end);
+        if (*end != ',' && *end != '\0') {
+            return -EINVAL;
+        }
+
+        if (fabs(gain) * 10 > PCM_EQ_GAIN_MAX ||
+            !(q * 100 >= PCM_EQ_Q_MIN && q * 100 <= PCM_EQ_Q_MAX)) {
+            return -EINVAL;
+        }
+
+        bands[count].gain = lrint(gain * 10);
+        bands[count].q = lrint(q * 100);
+        if (pcm_eq_check(&bands[count]) < 0) {
+            return -EINVAL;
+        }
+
+        count++;
+        p = *end == ',' ? end + 1 : end;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Name of the stage kernel new equalizers use
+ */
+FAR const char *pcm_eq_name(void)
+{
+    if (g_pcm_eq_stage == NULL) {
+        pcm_eq_select();
+    }
+
+    return g_pcm_eq_variants[g_pcm_eq_count - 1].name;
+}
+
+/**
+ * @brief List every stage kernel usable here, scalar reference first
+ * @return Number of entries in *variants
+ */
+int pcm_eq_variants(FAR const pcm_eq_variant_s **variants)
+{
+    if (g_pcm_eq_stage == NULL) {
+        pcm_eq_select();
+    }
+
+    *variants = g_pcm_eq_variants;
+    return g_pcm_eq_count;
+}
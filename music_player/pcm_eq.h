@@ -0,0 +1,157 @@
+/**
+ * @file pcm_eq.h
+ * Fixed-point parametric equalizer for 16-bit stereo PCM
+ */
+
+#ifndef PCM_EQ_H
+#define PCM_EQ_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <nuttx/config.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_EQ_BANDS
+#define CONFIG_LVX_MUSIC_PLAYER_EQ_BANDS 5
+#endif
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_EQ_RAMP_MS
+#define CONFIG_LVX_MUSIC_PLAYER_EQ_RAMP_MS 20
+#endif
+
+#define PCM_EQ_MAX_BANDS  CONFIG_LVX_MUSIC_PLAYER_EQ_BANDS
+#define PCM_EQ_CHANNELS   2
+
+/* Coefficients are Q3.28. 16-bit samples enter the Q31 cascade 2 bits
+ * below full scale, so boosts ahead of cuts have 12 dB of headroom.
+ */
+
+#define PCM_EQ_COEF_BITS  28
+#define PCM_EQ_IN_SHIFT   14
+
+/* Frames per stage call, also the step of a parameter ramp */
+
+#define PCM_EQ_CHUNK      32
+
+/* Band limits, gain in 0.1 dB, Q in 0.01 */
+
+#define PCM_EQ_GAIN_MAX   240
+#define PCM_EQ_Q_MIN      10
+#define PCM_EQ_Q_MAX      2000
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef enum {
+    PCM_EQ_PEAK,
+    PCM_EQ_LOW_SHELF,
+    PCM_EQ_HIGH_SHELF,
+    PCM_EQ_LOW_PASS,
+    PCM_EQ_HIGH_PASS,
+} pcm_eq_type_t;
+
+typedef struct pcm_eq_band {
+    uint8_t type;          /* pcm_eq_type_t */
+    uint32_t freq;         /* centre or corner frequency (Hz) */
+    int16_t gain;          /* 0.1 dB, peak and shelves only */
+    uint16_t q;            /* 0.01, shelves take it as their Q as well */
+} pcm_eq_band_s;
+
+/* One biquad, Q3.28, feedback terms negated so every term is added:
+ * y = b0 x + b1 x1 + b2 x2 + a1 y1 + a2 y2
+ */
+
+typedef struct pcm_eq_coef {
+    int32_t b0;
+    int32_t b1;
+    int32_t b2;
+    int32_t a1;
+    int32_t a2;
+} pcm_eq_coef_s;
+
+/* Direct form I history of one biquad, left and right side by side */
+
+typedef struct pcm_eq_state {
+    int32_t x1[PCM_EQ_CHANNELS];
+    int32_t x2[PCM_EQ_CHANNELS];
+    int32_t y1[PCM_EQ_CHANNELS];
+    int32_t y2[PCM_EQ_CHANNELS];
+} pcm_eq_state_s;
+
+/* Run one biquad over interleaved stereo Q31 samples in place */
+
+typedef void (*pcm_eq_stage_fn)(FAR int32_t *buf, size_t frames,
+                                FAR const pcm_eq_coef_s *coef,
+                                FAR pcm_eq_state_s *state);
+
+typedef struct pcm_eq_variant {
+    FAR const char *name;
+    pcm_eq_stage_fn fn;
+} pcm_eq_variant_s;
+
+typedef struct pcm_eq {
+    uint32_t rate;                /* 0 until the stream rate is known */
+    pcm_eq_stage_fn stage;
+
+    /* Posted by pcm_eq_set(), taken over by the audio thread */
+    pthread_mutex_t lock;
+    atomic_bool update;
+    int npending;
+    pcm_eq_band_s pending[PCM_EQ_MAX_BANDS];
+    pcm_eq_coef_s pending_coef[PCM_EQ_MAX_BANDS];
+
+    /* Audio thread only. During a ramp `stages` covers both the old and
+     * the new band list, missing bands pass the signal through.
+     */
+    int nbands;
+    int stages;
+    pcm_eq_coef_s coef[PCM_EQ_MAX_BANDS];
+    pcm_eq_coef_s from[PCM_EQ_MAX_BANDS];
+    pcm_eq_coef_s to[PCM_EQ_MAX_BANDS];
+    pcm_eq_state_s state[PCM_EQ_MAX_BANDS];
+    int32_t in1[PCM_EQ_CHANNELS]; /* last two input frames, the history */
+    int32_t in2[PCM_EQ_CHANNELS]; /* a band added in front starts from */
+    uint32_t ramp_pos;            /* frames */
+    uint32_t ramp_len;            /* 0 when settled */
+} pcm_eq_s;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+void pcm_eq_init(FAR pcm_eq_s *eq);
+void pcm_eq_deinit(FAR pcm_eq_s *eq);
+int pcm_eq_set(FAR pcm_eq_s *eq, FAR const pcm_eq_band_s *bands,
+               int nbands);
+int pcm_eq_get(FAR pcm_eq_s *eq, FAR pcm_eq_band_s *bands);
+void pcm_eq_set_rate(FAR pcm_eq_s *eq, uint32_t rate);
+void pcm_eq_reset(FAR pcm_eq_s *eq);
+bool pcm_eq_active(FAR pcm_eq_s *eq);
+void pcm_eq_process(FAR pcm_eq_s *eq, FAR int16_t *pcm, size_t frames);
+
+int pcm_eq_design(FAR const pcm_eq_band_s *band, uint32_t rate,
+                  FAR pcm_eq_coef_s *coef);
+int pcm_eq_parse(FAR const char *spec, FAR pcm_eq_band_s *bands, int max);
+
+FAR const char *pcm_eq_name(void);
+int pcm_eq_variants(FAR const pcm_eq_variant_s **variants);
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /* PCM_EQ_H */
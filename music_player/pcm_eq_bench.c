@@ -0,0 +1,375 @@
+/**
+ * @file pcm_eq_bench.c
+ * Microbenchmark for the parametric equalizer
+ *
+ * Usage: pcm_eq_bench [rate] [iterations] [cpu_mhz]
+ *
+ * Checks the response of every band type at its centre frequency against
+ * the design target, runs a full cascade of PCM_EQ_MAX_BANDS bands through
+ * a parameter ramp with every stage kernel and compares it bit for bit
+ * with the scalar reference, and checks that a ramp adds no click to a
+ * sine. Each kernel is then timed on the full cascade. The cost is
+ * reported per sample (one channel), in cycles when the CPU clock is
+ * given, and as the share of real time; with the clock given the bench
+ * fails when the dispatched kernel exceeds EQ_CYCLE_BUDGET.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <nuttx/config.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pcm_eq.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define BENCH_DEFAULT_RATE       48000
+#define BENCH_DEFAULT_ITERATIONS 200
+#define BENCH_FRAMES             1024
+#define BENCH_SINE_HZ            100
+#define BENCH_CLICK_MAX          4
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_EQ_CYCLE_BUDGET
+#define CONFIG_LVX_MUSIC_PLAYER_EQ_CYCLE_BUDGET 120
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+/* Speaker correction sized to PCM_EQ_MAX_BANDS */
+
+static const pcm_eq_band_s g_bench_bands[] = {
+    { PCM_EQ_HIGH_PASS,  120,   0,  71 },
+    { PCM_EQ_PEAK,       3000, -40, 200 },
+    { PCM_EQ_LOW_SHELF,  250,   60, 71 },
+    { PCM_EQ_HIGH_SHELF, 8000,  30, 71 },
+    { PCM_EQ_PEAK,       900,  -25, 140 },
+    { PCM_EQ_PEAK,       5500,  20, 300 },
+    { PCM_EQ_LOW_PASS,   18000,  0, 71 },
+    { PCM_EQ_PEAK,       400,   15, 100 },
+    { PCM_EQ_PEAK,       1800, -15, 400 },
+    { PCM_EQ_PEAK,       12000, 10, 200 },
+};
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void bench_fill(FAR int16_t *buf, size_t n, uint32_t seed)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        buf[i] = (int16_t)(seed >> 16) / 4;
+    }
+}
+
+static int bench_nbands(void)
+{
+    int n = sizeof(g_bench_bands) / sizeof(g_bench_bands[0]);
+
+    return n < PCM_EQ_MAX_BANDS ? n : PCM_EQ_MAX_BANDS;
+}
+
+/* Gain in dB of the quantized biquad at freq */
+
+static double bench_response(FAR const pcm_eq_coef_s *c, uint32_t freq,
+                             uint32_t rate)
+{
+    double one = 1 << PCM_EQ_COEF_BITS;
+    double w = 2 * M_PI * freq / rate;
+    double nr = (c->b0 + c->b1 * cos(w) + c->b2 * cos(2 * w)) / one;
+    double ni = -(c->b1 * sin(w) + c->b2 * sin(2 * w)) / one;
+    double dr = 1 - (c->a1 * cos(w) + c->a2 * cos(2 * w)) / one;
+    double di = (c->a1 * sin(w) + c->a2 * sin(2 * w)) / one;
+
+    return 10 * log10((nr * nr + ni * ni) / (dr * dr + di * di));
+}
+
+static int bench_designs(uint32_t rate)
+{
+    static FAR const char *const names[] = {
+        "peak", "lowshelf", "highshelf", "lowpass", "highpass"
+    };
+
+    pcm_eq_band_s band;
+    pcm_eq_coef_s coef;
+    double expect;
+    double got;
+    int ret = 0;
+    int t;
+
+    for (t = PCM_EQ_PEAK; t <= PCM_EQ_HIGH_PASS; t++)
+    {
+        band.type = t;
+        band.freq = 1000;
+        band.gain = 90;
+        band.q = 71;
+
+        if (pcm_eq_design(&band, rate, &coef) < 0) {
+            printf("  %-10s design failed\n", names[t]);
+            ret = -1;
+            continue;
+        }
+
+        /* Full gain at a peak, half way on a shelf, Q on a pass corner */
+
+        expect = t == PCM_EQ_PEAK ? band.gain / 10.0 :
+                 t <= PCM_EQ_HIGH_SHELF ? band.gain / 20.0 :
+                 20 * log10(band.q / 100.0);
+        got = bench_response(&coef, band.freq, rate);
+
+        printf("  %-10s %+6.2f dB at %u Hz, target %+6.2f\n", names[t], got,
+               (unsigned)band.freq, expect);
+        if (fabs(got - expect) > 0.05) {
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Stereo noise through the full cascade, a band list change in the
+ *        middle so that the ramp is covered
+ */
+static void bench_cascade(pcm_eq_stage_fn fn, uint32_t rate,
+                          FAR const int16_t *in, FAR int16_t *out,
+                          size_t frames)
+{
+    pcm_eq_band_s bands[PCM_EQ_MAX_BANDS];
+    int n = bench_nbands();
+    pcm_eq_s eq;
+
+    pcm_eq_init(&eq);
+    eq.stage = fn;
+    pcm_eq_set(&eq, g_bench_bands, n > 1 ? n - 1 : n);
+    pcm_eq_set_rate(&eq, rate);
+
+    memcpy(out, in, frames * PCM_EQ_CHANNELS * sizeof(int16_t));
+    pcm_eq_process(&eq, out, frames / 2);
+
+    memcpy(bands, g_bench_bands, n * sizeof(pcm_eq_band_s));
+    bands[0].freq *= 2;
+    bands[1].gain = -bands[1].gain;
+    pcm_eq_set(&eq, bands, n);
+
+    pcm_eq_process(&eq, out + frames / 2 * PCM_EQ_CHANNELS,
+                   frames - frames / 2);
+    pcm_eq_deinit(&eq);
+}
+
+/**
+ * @brief Click left by a parameter change
+ * @return Peak in LSB of what a steep 2 kHz high-pass lets through while a
+ *         low shelf at the frequency of a sine ramps from flat to +24 dB
+ *
+ * The sine itself is far below the high-pass, an abrupt coefficient
+ * switch shows up as broadband energy above it.
+ */
+static int bench_click(uint32_t rate)
+{
+    pcm_eq_band_s band = { PCM_EQ_LOW_SHELF, BENCH_SINE_HZ, 0, 71 };
+    pcm_eq_band_s hp[4];
+    size_t frames = rate / 5;
+    FAR int16_t *pcm;
+    pcm_eq_s eq;
+    size_t i;
+    int peak = 0;
+
+    pcm = malloc(frames * PCM_EQ_CHANNELS * sizeof(int16_t));
+    if (pcm == NULL) {
+        return -1;
+    }
+
+    for (i = 0; i < frames; i++)
+    {
+        pcm[2 * i] = lrint(6000 * sin(2 * M_PI * BENCH_SINE_HZ * i / rate));
+        pcm[2 * i + 1] = pcm[2 * i];
+    }
+
+    pcm_eq_init(&eq);
+    pcm_eq_set(&eq, &band, 1);
+    pcm_eq_set_rate(&eq, rate);
+    pcm_eq_process(&eq, pcm, frames / 4);
+    band.gain = PCM_EQ_GAIN_MAX;
+    pcm_eq_set(&eq, &band, 1);
+    pcm_eq_process(&eq, pcm + frames / 4 * PCM_EQ_CHANNELS,
+                   frames - frames / 4);
+
+    for (i = 0; i < 4; i++)
+    {
+        hp[i].type = PCM_EQ_HIGH_PASS;
+        hp[i].freq = 2000;
+        hp[i].gain = 0;
+        hp[i].q = 71;
+    }
+
+    pcm_eq_set(&eq, hp, 4);
+    pcm_eq_set_rate(&eq, rate);
+    pcm_eq_process(&eq, pcm, frames);
+    pcm_eq_deinit(&eq);
+
+    /* From after the high-pass settled to the end of the ramp */
+
+    for (i = frames / 8; i < frames / 2; i++)
+    {
+        peak = abs(pcm[2 * i]) > peak ? abs(pcm[2 * i]) : peak;
+    }
+
+    free(pcm);
+    return peak;
+}
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int main(int argc, FAR char *argv[])
+{
+    FAR const pcm_eq_variant_s *variants;
+    FAR int16_t *in;
+    FAR int16_t *ref;
+    FAR int16_t *out;
+    uint32_t rate = BENCH_DEFAULT_RATE;
+    int iterations = BENCH_DEFAULT_ITERATIONS;
+    uint32_t mhz = 0;
+    size_t frames;
+    int click;
+    int count;
+    int ret = 0;
+    int i;
+
+    if (argc > 1) {
+        rate = strtoul(argv[1], NULL, 0);
+    }
+
+    if (argc > 2) {
+        iterations = atoi(argv[2]);
+    }
+
+    if (argc > 3) {
+        mhz = strtoul(argv[3], NULL, 0);
+    }
+
+    if (rate < 40000 || iterations <= 0) {
+        printf("Usage: %s [rate >= 40000] [iterations] [cpu_mhz]\n",
+               argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    frames = rate / 2;
+    in = malloc(frames * PCM_EQ_CHANNELS * sizeof(int16_t));
+    ref = malloc(frames * PCM_EQ_CHANNELS * sizeof(int16_t));
+    out = malloc(frames * PCM_EQ_CHANNELS * sizeof(int16_t));
+    if (!in || !ref || !out) {
+        printf("Out of memory\n");
+        ret = EXIT_FAILURE;
+        goto out;
+    }
+
+    bench_fill(in, frames * PCM_EQ_CHANNELS, 1);
+    count = pcm_eq_variants(&variants);
+
+    printf("pcm_eq: %u Hz, stereo, %d bands, %d x %d frames, "
+           "dispatch = %s\n", (unsigned)rate, bench_nbands(), iterations,
+           BENCH_FRAMES, pcm_eq_name());
+
+    if (bench_designs(rate) < 0) {
+        printf("  design MISMATCH\n");
+        ret = EXIT_FAILURE;
+    }
+
+    click = bench_click(rate);
+    printf("  ramp: %d LSB above 2 kHz\n", click);
+    if (click < 0 || click > BENCH_CLICK_MAX) {
+        printf("  ramp CLICK\n");
+        ret = EXIT_FAILURE;
+    }
+
+    bench_cascade(variants[0].fn, rate, in, ref, frames);
+
+    for (i = 0; i < count; i++)
+    {
+        pcm_eq_s eq;
+        uint64_t start;
+        uint64_t elapsed;
+        double cycles;
+        int j;
+
+        bench_cascade(variants[i].fn, rate, in, out, frames);
+        if (memcmp(out, ref, frames * PCM_EQ_CHANNELS *
+                   sizeof(int16_t)) != 0) {
+            printf("  %-8s MISMATCH against scalar reference\n",
+                   variants[i].name);
+            ret = EXIT_FAILURE;
+            continue;
+        }
+
+        pcm_eq_init(&eq);
+        eq.stage = variants[i].fn;
+        pcm_eq_set(&eq, g_bench_bands, bench_nbands());
+        pcm_eq_set_rate(&eq, rate);
+
+        start = bench_now_ns();
+        for (j = 0; j < iterations; j++)
+        {
+            memcpy(out, in, BENCH_FRAMES * PCM_EQ_CHANNELS * sizeof(int16_t));
+            pcm_eq_process(&eq, out, BENCH_FRAMES);
+        }
+
+        elapsed = bench_now_ns() - start;
+        pcm_eq_deinit(&eq);
+        if (elapsed == 0) {
+            elapsed = 1;
+        }
+
+        printf("  %-8s %7.2f ns/sample", variants[i].name,
+               (double)elapsed / iterations / BENCH_FRAMES / PCM_EQ_CHANNELS);
+        if (mhz > 0) {
+            cycles = (double)elapsed * mhz / 1000.0 / iterations /
+                     BENCH_FRAMES / PCM_EQ_CHANNELS;
+            printf(" %7.1f cycles/sample", cycles);
+
+            if (variants[i].fn == variants[count - 1].fn &&
+                cycles > CONFIG_LVX_MUSIC_PLAYER_EQ_CYCLE_BUDGET) {
+                printf(" OVER BUDGET (%d)",
+                       CONFIG_LVX_MUSIC_PLAYER_EQ_CYCLE_BUDGET);
+                ret = EXIT_FAILURE;
+            }
+        }
+
+        printf("  %6.2f%% of real time\n",
+               100.0 * elapsed * rate /
+               ((double)iterations * BENCH_FRAMES * 1e9));
+    }
+
+out:
+    free(in);
+    free(ref);
+    free(out);
+    return ret;
+}
@@ -0,0 +1,269 @@
+/**
+ * @file pcm_format.c
+ * Conversion of WAV sample layouts to interleaved 16-bit stereo
+ *
+ * One kernel exists per input coding (8-bit unsigned, 16-bit, 24-bit
+ * packed, 32-bit integer, 32-bit float) and channel count (1 to 8). They
+ * are stamped out by the macros below with the sample size, the reader
+ * and the channel count as compile time constants, so the inner loop is
+ * straight-line code: mono is duplicated to both sides, stereo is copied
+ * and anything wider goes through a fixed Q14 downmix matrix.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "pcm_format.h"
+
+#include <string.h>
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+/* Q14 { left, right } gains for 3 to 8 channels in the default WAV
+ * channel order (FL FR FC LFE BL BR SL SR, BC for 6.1). Centre and
+ * surrounds enter at -3 dB, LFE is dropped, each side sums to unity so
+ * a full scale input never clips.
+ */
+
+static const int16_t g_pcm_format_downmix[6][PCM_FORMAT_MAX_CHANNELS][2] =
+{
+    /* 3.0: FL FR FC */
+
+    { { 9598, 0 }, { 0, 9598 }, { 6786, 6786 } },
+
+    /* Quad: FL FR BL BR */
+
+    { { 9598, 0 }, { 0, 9598 }, { 6786, 0 }, { 0, 6786 } },
+
+    /* 5.0: FL FR FC BL BR */
+
+    { { 6786, 0 }, { 0, 6786 }, { 4799, 4799 }, { 4799, 0 },
+      { 0, 4799 } },
+
+    /* 5.1: FL FR FC LFE BL BR */
+
+    { { 6786, 0 }, { 0, 6786 }, { 4799, 4799 }, { 0, 0 },
+      { 4799, 0 }, { 0, 4799 } },
+
+    /* 6.1: FL FR FC LFE BC SL SR */
+
+    { { 5622, 0 }, { 0, 5622 }, { 3975, 3975 }, { 0, 0 },
+      { 2811, 2811 }, { 3975, 0 }, { 0, 3975 } },
+
+    /* 7.1: FL FR FC LFE BL BR SL SR */
+
+    { { 5249, 0 }, { 0, 5249 }, { 3712, 3712 }, { 0, 0 },
+      { 3712, 0 }, { 0, 3712 }, { 3712, 0 }, { 0, 3712 } },
+};
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static inline int32_t pcm_format_sat16(int32_t v)
+{
+    return v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v;
+}
+
+/* Readers return one sample scaled to the 16-bit range, rounded */
+
+static inline int32_t pcm_format_read_u8(FAR const uint8_t *p)
+{
+    return ((int32_t)p[0] - 128) << 8;
+}
+
+static inline int32_t pcm_format_read_s16(FAR const uint8_t *p)
+{
+    return (int16_t)(p[0] | (p[1] << 8));
+}
+
+static inline int32_t pcm_format_read_s24(FAR const uint8_t *p)
+{
+    int32_t v = (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) |
+                          ((uint32_t)p[2] << 24));
+
+    return pcm_format_sat16(((v >> 15) + 1) >> 1);
+}
+
+static inline int32_t pcm_format_read_s32(FAR const uint8_t *p)
+{
+    int32_t v = (int32_t)((uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+                          ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+
+    return pcm_format_sat16(((v >> 15) + 1) >> 1);
+}
+
+static inline int32_t pcm_format_read_f32(FAR const uint8_t *p)
+{
+    uint32_t u = (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+                 ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    float x;
+
+    memcpy(&x, &u, sizeof(x));
+    x *= 32768.0f;
+
+    /* NaN fails both tests and ends up as silence */
+
+    if (!(x > -32768.0f)) {
+        x = x != x ? 0.0f : -32768.0f;
+    } else if (x > 32767.0f) {
+        x = 32767.0f;
+    }
+
+    return (int32_t)(x + (x < 0.0f ? -0.5f : 0.5f));
+}
+
+/* Kernel generators. size is the bytes per sample, read one of the
+ * readers above.
+ */
+
+#define PCM_FORMAT_MONO(coding, size, read) \
+static void pcm_format_##coding##_1(FAR int16_t *out, \
+                                    FAR const uint8_t *in, size_t frames) \
+{ \
+    size_t i; \
+    \
+    for (i = 0; i < frames; i++, in += (size), out += 2) \
+    { \
+        out[0] = out[1] = (int16_t)read(in); \
+    } \
+}
+
+#define PCM_FORMAT_STEREO(coding, size, read) \
+static void pcm_format_##coding##_2(FAR int16_t *out, \
+                                    FAR const uint8_t *in, size_t frames) \
+{ \
+    size_t i; \
+    \
+    for (i = 0; i < frames; i++, in += 2 * (size), out += 2) \
+    { \
+        out[0] = (int16_t)read(in); \
+        out[1] = (int16_t)read(in + (size)); \
+    } \
+}
+
+#define PCM_FORMAT_DOWNMIX(coding, size, read, ch) \
+static void pcm_format_##coding##_##ch(FAR int16_t *out, \
+                                       FAR const uint8_t *in, size_t frames) \
+{ \
+    FAR const int16_t (*gain)[2] = g_pcm_format_downmix[(ch) - 3]; \
+    size_t i; \
+    int c; \
+    \
+    for (i = 0; i < frames; i++, in += (ch) * (size), out += 2) \
+    { \
+        int32_t l = 1 << 13; \
+        int32_t r = 1 << 13; \
+        \
+        for (c = 0; c < (ch); c++) \
+        { \
+            int32_t s = read(in + c * (size)); \
+            \
+            l += s * gain[c][0]; \
+            r += s * gain[c][1]; \
+        } \
+        \
+        out[0] = (int16_t)pcm_format_sat16(l >> 14); \
+        out[1] = (int16_t)pcm_format_sat16(r >> 14); \
+    } \
+}
+
+#define PCM_FORMAT_CODING(coding, size) \
+    PCM_FORMAT_MONO(coding, size, pcm_format_read_##coding) \
+    PCM_FORMAT_STEREO(coding, size, pcm_format_read_##coding) \
+    PCM_FORMAT_DOWNMIX(coding, size, pcm_format_read_##coding, 3) \
+    PCM_FORMAT_DOWNMIX(coding, size, pcm_format_read_##coding, 4) \
+    PCM_FORMAT_DOWNMIX(coding, size, pcm_format_read_##coding, 5) \
+    PCM_FORMAT_DOWNMIX(coding, size, pcm_format_read_##coding, 6) \
+    PCM_FORMAT_DOWNMIX(coding, size, pcm_format_read_##coding, 7) \
+    PCM_FORMAT_DOWNMIX(coding, size, pcm_format_read_##coding, 8)
+
+PCM_FORMAT_CODING(u8, 1)
+PCM_FORMAT_CODING(s16, 2)
+PCM_FORMAT_CODING(s24, 3)
+PCM_FORMAT_CODING(s32, 4)
+PCM_FORMAT_CODING(f32, 4)
+
+#define PCM_FORMAT_ROW(coding) \
+    { \
+        pcm_format_##coding##_1, pcm_format_##coding##_2, \
+        pcm_format_##coding##_3, pcm_format_##coding##_4, \
+        pcm_format_##coding##_5, pcm_format_##coding##_6, \
+        pcm_format_##coding##_7, pcm_format_##coding##_8, \
+    }
+
+enum {
+    PCM_FORMAT_U8,
+    PCM_FORMAT_S16,
+    PCM_FORMAT_S24,
+    PCM_FORMAT_S32,
+    PCM_FORMAT_F32,
+    PCM_FORMAT_CODINGS
+};
+
+static const pcm_format_fn
+g_pcm_format_kernels[PCM_FORMAT_CODINGS][PCM_FORMAT_MAX_CHANNELS] =
+{
+    PCM_FORMAT_ROW(u8),
+    PCM_FORMAT_ROW(s16),
+    PCM_FORMAT_ROW(s24),
+    PCM_FORMAT_ROW(s32),
+    PCM_FORMAT_ROW(f32),
+};
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+/**
+ * @brief Pick the kernel for one input layout
+ * @param is_float IEEE float samples instead of integers
+ * @param bits Valid bits per sample
+ * @param container Bytes per sample in the file (blockalign / channels)
+ * @param channels Interleaved channels
+ * @return Kernel producing PCM_FORMAT_OUT_CHANNELS x PCM_FORMAT_OUT_BITS,
+ *         NULL if the layout is not supported
+ *
+ * Integer samples narrower than their container are left-justified, as
+ * WAVE_FORMAT_EXTENSIBLE requires, so 20 bits in 3 bytes or 24 bits in 4
+ * use the 24 and 32-bit kernels.
+ */
+pcm_format_fn pcm_format_select(bool is_float, int bits, int container,
+                                int channels)
+{
+    int coding;
+
+    if (channels < 1 || channels > PCM_FORMAT_MAX_CHANNELS ||
+        bits < 1 || bits > container * 8) {
+        return NULL;
+    }
+
+    if (is_float) {
+        if (bits != 32 || container != 4) {
+            return NULL;
+        }
+
+        coding = PCM_FORMAT_F32;
+    } else {
+        switch (container) {
+        case 1:
+            coding = PCM_FORMAT_U8;
+            break;
+        case 2:
+            coding = PCM_FORMAT_S16;
+            break;
+        case 3:
+            coding = PCM_FORMAT_S24;
+            break;
+        case 4:
+            coding = PCM_FORMAT_S32;
+            break;
+        default:
+            return NULL;
+        }
+    }
+
+    return g_pcm_format_kernels[coding][channels - 1];
+}
@@ -0,0 +1,52 @@
+/**
+ * @file pcm_format.h
+ * Conversion of WAV sample layouts to interleaved 16-bit stereo
+ */
+
+#ifndef PCM_FORMAT_H
+#define PCM_FORMAT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <nuttx/config.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Layout every kernel produces, the one the rest of the pipeline runs on */
+
+#define PCM_FORMAT_OUT_BITS     16
+#define PCM_FORMAT_OUT_CHANNELS 2
+
+#define PCM_FORMAT_MAX_CHANNELS 8
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* Convert frames of packed little-endian input to out */
+
+typedef void (*pcm_format_fn)(FAR int16_t *out, FAR const uint8_t *in,
+                              size_t frames);
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+pcm_format_fn pcm_format_select(bool is_float, int bits, int container,
+                                int channels);
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /* PCM_FORMAT_H */
@@ -0,0 +1,41 @@
+/**
+ * @file pcm_mix.h
+ * Fixed-point equal-power crossfade of two 16-bit PCM streams
+ */
+
+#ifndef PCM_MIX_H
+#define PCM_MIX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <nuttx/config.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Gain table resolution, one quarter sine wave in Q15 */
+
+#define PCM_MIX_TABLE_BITS 8
+#define PCM_MIX_TABLE_SIZE (1 << PCM_MIX_TABLE_BITS)
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+void pcm_mix_crossfade(FAR int16_t *in, FAR const int16_t *out,
+                       size_t frames, int channels, uint32_t pos,
+                       uint32_t len);
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /* PCM_MIX_H */
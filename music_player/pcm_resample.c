@@ -0,0 +1,515 @@
+/**
+ * @file pcm_resample.c
+ * Polyphase fixed-point sample-rate converter for 16-bit PCM
+ *
+ * The rate ratio is reduced to up / down. A Kaiser windowed sinc low-pass,
+ * cut off below the lower of the two Nyquist frequencies, is split into
+ * `up` phases of `taps` Q15 coefficients each; every phase is normalized
+ * to unity DC gain. Coefficients are designed once in pcm_resample_init(),
+ * the per-sample work is one integer dot product per channel, dispatched
+ * like pcm_convert to a NEON or SSE2 kernel when the target has one.
+ *
+ * Input history is kept planar so each dot product reads contiguous
+ * samples. Output frame m lands on input time m * down / up; half a filter
+ * of zeros is put in front of the first input frame and fed after the last
+ * one, so the stream is neither delayed nor truncated.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "pcm_resample.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PCM_RESAMPLE_HAVE_NEON 1
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define PCM_RESAMPLE_HAVE_SSE2 1
+#endif
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define PCM_RESAMPLE_PI 3.14159265358979323846
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct pcm_resample_design {
+    int taps;
+    double rolloff;   /* passband edge as a fraction of the lower Nyquist */
+    double beta;      /* Kaiser window shape */
+} pcm_resample_design_s;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static int32_t pcm_resample_dot_scalar(FAR const int16_t *coef,
+                                       FAR const int16_t *x, int n);
+#ifdef PCM_RESAMPLE_HAVE_NEON
+static int32_t pcm_resample_dot_neon(FAR const int16_t *coef,
+                                     FAR const int16_t *x, int n);
+#endif
+#ifdef PCM_RESAMPLE_HAVE_SSE2
+static int32_t pcm_resample_dot_sse2(FAR const int16_t *coef,
+                                     FAR const int16_t *x, int n);
+#endif
+static void pcm_resample_select(void);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+static const pcm_resample_design_s g_pcm_resample_designs[] =
+{
+    [PCM_RESAMPLE_FAST] = { 16, 0.80, 6.0 },
+    [PCM_RESAMPLE_HQ]   = { 32, 0.90, 8.0 },
+};
+
+static pcm_resample_variant_s g_pcm_resample_variants[3];
+static int g_pcm_resample_count;
+static pcm_resample_dot_fn g_pcm_resample_dot;
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static int32_t pcm_resample_dot_scalar(FAR const int16_t *coef,
+                                       FAR const int16_t *x, int n)
+{
+    int32_t acc = 0;
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        acc += coef[i] * x[i];
+    }
+
+    return acc;
+}
+
+#ifdef PCM_RESAMPLE_HAVE_NEON
+static int32_t pcm_resample_dot_neon(FAR const int16_t *coef,
+                                     FAR const int16_t *x, int n)
+{
+    int32x4_t acc = vdupq_n_s32(0);
+    int32x2_t sum;
+    int i;
+
+    for (i = 0; i < n; i += 8)
+    {
+        int16x8_t c = vld1q_s16(coef + i);
+        int16x8_t v = vld1q_s16(x + i);
+
+        acc = vmlal_s16(acc, vget_low_s16(c), vget_low_s16(v));
+        acc = vmlal_s16(acc, vget_high_s16(c), vget_high_s16(v));
+    }
+
+    sum = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+    sum = vpadd_s32(sum, sum);
+
+    return vget_lane_s32(sum, 0);
+}
+#endif
+
+#ifdef PCM_RESAMPLE_HAVE_SSE2
+/* pmaddwd multiplies and adds neighbouring pairs straight to 32 bits */
+
+static int32_t pcm_resample_dot_sse2(FAR const int16_t *coef,
+                                     FAR const int16_t *x, int n)
+{
+    __m128i acc = _mm_setzero_si128();
+    int i;
+
+    for (i = 0; i < n; i += 8)
+    {
+        __m128i c = _mm_loadu_si128((FAR const __m128i *)(coef + i));
+        __m128i v = _mm_loadu_si128((FAR const __m128i *)(x + i));
+
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(c, v));
+    }
+
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0x4e));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0xb1));
+
+    return _mm_cvtsi128_si32(acc);
+}
+#endif
+
+/* Every candidate writes the same value, so racing first calls are benign */
+
+static void pcm_resample_select(void)
+{
+    int count = 0;
+
+    g_pcm_resample_variants[count].name = "scalar";
+    g_pcm_resample_variants[count++].fn = pcm_resample_dot_scalar;
+
+#ifdef PCM_RESAMPLE_HAVE_NEON
+    g_pcm_resample_variants[count].name = "neon";
+    g_pcm_resample_variants[count++].fn = pcm_resample_dot_neon;
+#endif
+
+#ifdef PCM_RESAMPLE_HAVE_SSE2
+    g_pcm_resample_variants[count].name = "sse2";
+    g_pcm_resample_variants[count++].fn = pcm_resample_dot_sse2;
+#endif
+
+    /* The last registered variant is the fastest one available */
+
+    g_pcm_resample_count = count;
+    g_pcm_resample_dot = g_pcm_resample_variants[count - 1].fn;
+}
+
+static uint32_t pcm_resample_gcd(uint32_t a, uint32_t b)
+{
+    while (b != 0) {
+        uint32_t t = a % b;
+
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+/* Zeroth order modified Bessel function, for the Kaiser window */
+
+static double pcm_resample_i0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    int k;
+
+    for (k = 1; k < 32; k++)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+
+    return sum;
+}
+
+/**
+ * @brief Fill rs->coefs with the Q15 polyphase filter bank
+ */
+static void pcm_resample_design(FAR pcm_resample_s *rs,
+                                FAR const pcm_resample_design_s *d,
+                                FAR double *tmp)
+{
+    double cutoff = d->rolloff;
+    double half = rs->taps / 2.0;
+    double i0beta = pcm_resample_i0(d->beta);
+    uint32_t p;
+    int i;
+
+    /* Downsampling: the band edge follows the output Nyquist */
+
+    if (rs->down > rs->up) {
+        cutoff *= (double)rs->up / rs->down;
+    }
+
+    for (p = 0; p < rs->up; p++)
+    {
+        FAR int16_t *row = rs->coefs + p * rs->taps;
+        double frac = (double)p / rs->up;
+        double sum = 0.0;
+        int32_t qsum = 0;
+        int peak = 0;
+
+        /* Tap i weighs the input sample (taps / 2 - 1 - i + frac) input
+         * periods before the output instant.
+         */
+
+        for (i = 0; i < rs->taps; i++)
+        {
+            double u = half - 1 - i + frac;
+            double r = u / half;
+            double s = cutoff * u;
+            double v;
+
+            v = s == 0.0 ? 1.0 : sin(PCM_RESAMPLE_PI * s) / (PCM_RESAMPLE_PI * s);
+            v *= r >= 1.0 || r <= -1.0 ? 0.0 :
+                 pcm_resample_i0(d->beta * sqrt(1.0 - r * r)) / i0beta;
+
+            tmp[i] = v;
+            sum += v;
+        }
+
+        for (i = 0; i < rs->taps; i++)
+        {
+            double q = floor(tmp[i] / sum * 32768.0 + 0.5);
+
+            q = q > 32767.0 ? 32767.0 : q;
+            q = q < -32768.0 ? -32768.0 : q;
+            row[i] = (int16_t)q;
+            qsum += row[i];
+
+            if (row[i] > row[peak]) {
+                peak = i;
+            }
+        }
+
+        /* Rounding leftovers go to the largest tap: exact unity DC gain */
+
+        qsum = row[peak] + 32768 - qsum;
+        row[peak] = qsum > 32767 ? 32767 : qsum;
+    }
+}
+
+static inline int16_t pcm_resample_sat16(int32_t acc)
+{
+    acc = (acc + (1 << 14)) >> 15;
+    acc = acc > INT16_MAX ? INT16_MAX : acc;
+    acc = acc < INT16_MIN ? INT16_MIN : acc;
+
+    return (int16_t)acc;
+}
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+/**
+ * @brief Set up a converter and design its filter bank
+ * @param rs Converter state
+ * @param in_rate Input sample rate
+ * @param out_rate Output sample rate
+ * @param channels Interleaved channels of both input and output
+ * @param preset Taps per output sample
+ * @return 0 on success, negated errno on error
+ */
+int pcm_resample_init(FAR pcm_resample_s *rs, uint32_t in_rate,
+                      uint32_t out_rate, int channels,
+                      pcm_resample_preset_t preset)
+{
+    FAR const pcm_resample_design_s *d;
+    FAR double *tmp;
+    uint32_t g;
+
+    if (rs == NULL || in_rate == 0 || out_rate == 0 || channels <= 0 ||
+        preset > PCM_RESAMPLE_HQ) {
+        return -EINVAL;
+    }
+
+    if (g_pcm_resample_dot == NULL) {
+        pcm_resample_select();
+    }
+
+    memset(rs, 0, sizeof(pcm_resample_s));
+
+    d = &g_pcm_resample_designs[preset];
+    g = pcm_resample_gcd(in_rate, out_rate);
+
+    rs->in_rate = in_rate;
+    rs->out_rate = out_rate;
+    rs->up = out_rate / g;
+    rs->down = in_rate / g;
+    rs->taps = d->taps;
+    rs->channels = channels;
+    rs->dot = g_pcm_resample_dot;
+    rs->cap = d->taps + PCM_RESAMPLE_BLOCK;
+
+    rs->coefs = malloc(rs->up * rs->taps * sizeof(int16_t));
+    rs->hist = malloc(rs->cap * channels * sizeof(int16_t));
+    tmp = malloc(rs->taps * sizeof(double));
+    if (rs->coefs == NULL || rs->hist == NULL || tmp == NULL) {
+        free(tmp);
+        pcm_resample_deinit(rs);
+        return -ENOMEM;
+    }
+
+    pcm_resample_design(rs, d, tmp);
+    free(tmp);
+
+    pcm_resample_reset(rs);
+    return 0;
+}
+
+void pcm_resample_deinit(FAR pcm_resample_s *rs)
+{
+    if (rs == NULL) {
+        return;
+    }
+
+    free(rs->coefs);
+    free(rs->hist);
+    rs->coefs = NULL;
+    rs->hist = NULL;
+}
+
+/**
+ * @brief Forget the input history, the next input starts a new stream
+ */
+void pcm_resample_reset(FAR pcm_resample_s *rs)
+{
+    memset(rs->hist, 0, rs->cap * rs->channels * sizeof(int16_t));
+
+    rs->fill = rs->taps / 2 - 1;
+    rs->pos = rs->taps - 1;
+    rs->phase = 0;
+    rs->skip = 0;
+    rs->drain = rs->taps / 2;
+}
+
+/**
+ * @brief Convert a block of interleaved PCM
+ * @param rs Converter state
+ * @param in Input frames, NULL once the input has ended to flush the
+ *           filter tail
+ * @param in_frames Frames available in in, returns the frames consumed
+ * @param out Output buffer
+ * @param out_frames Capacity of out in frames
+ * @return Frames written to out; 0 with in == NULL when fully flushed
+ *
+ * Consumes input only as far as needed to fill out, so calling again with
+ * the rest of in continues seamlessly.
+ */
+size_t pcm_resample_process(FAR pcm_resample_s *rs, FAR const int16_t *in,
+                            FAR size_t *in_frames, FAR int16_t *out,
+                            size_t out_frames)
+{
+    size_t avail = in != NULL ? *in_frames : rs->drain;
+    size_t used = 0;
+    size_t produced = 0;
+    int taps = rs->taps;
+    int ch = rs->channels;
+    int c;
+
+    for (;;)
+    {
+        uint32_t from;
+        size_t n;
+        size_t i;
+
+        while (produced < out_frames && rs->pos < rs->fill)
+        {
+            FAR const int16_t *coef = rs->coefs + rs->phase * taps;
+            FAR const int16_t *x = rs->hist + rs->pos + 1 - taps;
+
+            for (c = 0; c < ch; c++)
+            {
+                out[c] = pcm_resample_sat16(rs->dot(coef, x, taps));
+                x += rs->cap;
+            }
+
+            out += ch;
+            produced++;
+
+            rs->phase += rs->down;
+            while (rs->phase >= rs->up)
+            {
+                rs->phase -= rs->up;
+                rs->pos++;
+            }
+        }
+
+        if (produced == out_frames || used == avail) {
+            break;
+        }
+
+        /* Keep the last taps - 1 frames of the window, drop older ones. A
+         * large downsampling step may leave input to skip entirely.
+         */
+
+        from = rs->pos + 1 - taps;
+        if (from >= rs->fill) {
+            rs->skip += from - rs->fill;
+            rs->fill = 0;
+        } else if (from > 0) {
+            for (c = 0; c < ch; c++)
+            {
+                memmove(rs->hist + c * rs->cap, rs->hist + c * rs->cap + from,
+                        (rs->fill - from) * sizeof(int16_t));
+            }
+
+            rs->fill -= from;
+        }
+
+        rs->pos -= from;
+
+        n = avail - used < rs->skip ? avail - used : rs->skip;
+        rs->skip -= n;
+        used += n;
+
+        n = avail - used;
+        if (n > rs->cap - rs->fill) {
+            n = rs->cap - rs->fill;
+        }
+
+        for (c = 0; c < ch; c++)
+        {
+            FAR int16_t *dst = rs->hist + c * rs->cap + rs->fill;
+
+            if (in == NULL) {
+                memset(dst, 0, n * sizeof(int16_t));
+                continue;
+            }
+
+            for (i = 0; i < n; i++)
+            {
+                dst[i] = in[(used + i) * ch + c];
+            }
+        }
+
+        rs->fill += n;
+        used += n;
+    }
+
+    if (in != NULL) {
+        *in_frames = used;
+    } else {
+        rs->drain -= used;
+    }
+
+    return produced;
+}
+
+/**
+ * @brief Output length of in_frames input frames
+ */
+uint64_t pcm_resample_out_frames(FAR const pcm_resample_s *rs,
+                                 uint64_t in_frames)
+{
+    return (in_frames * rs->up + rs->down - 1) / rs->down;
+}
+
+/**
+ * @brief Name of the dot product kernel new converters use
+ */
+FAR const char *pcm_resample_name(void)
+{
+    if (g_pcm_resample_dot == NULL) {
+        pcm_resample_select();
+    }
+
+    return g_pcm_resample_variants[g_pcm_resample_count - 1].name;
+}
+
+/**
+ * @brief List every dot product kernel usable here, scalar reference first
+ * @return Number of entries in *variants
+ */
+int pcm_resample_variants(FAR const pcm_resample_variant_s **variants)
+{
+    if (g_pcm_resample_dot == NULL) {
+        pcm_resample_select();
+    }
+
+    *variants = g_pcm_resample_variants;
+    return g_pcm_resample_count;
+}
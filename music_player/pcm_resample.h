@@ -0,0 +1,90 @@
+/**
+ * @file pcm_resample.h
+ * Polyphase fixed-point sample-rate converter for 16-bit PCM
+ */
+
+#ifndef PCM_RESAMPLE_H
+#define PCM_RESAMPLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <nuttx/config.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Input frames buffered per channel on top of the filter history */
+
+#define PCM_RESAMPLE_BLOCK 256
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* Quality / CPU trade-off, taps per output sample */
+
+typedef enum {
+    PCM_RESAMPLE_FAST,   /* 16 taps */
+    PCM_RESAMPLE_HQ,     /* 32 taps */
+} pcm_resample_preset_t;
+
+/* Q15 dot product of n samples, n a multiple of 8 */
+
+typedef int32_t (*pcm_resample_dot_fn)(FAR const int16_t *coef,
+                                       FAR const int16_t *x, int n);
+
+typedef struct pcm_resample_variant {
+    FAR const char *name;
+    pcm_resample_dot_fn fn;
+} pcm_resample_variant_s;
+
+typedef struct pcm_resample {
+    uint32_t in_rate;
+    uint32_t out_rate;
+    uint32_t up;           /* out_rate / gcd: number of filter phases */
+    uint32_t down;         /* in_rate / gcd: input step per output, in phases */
+    int taps;
+    int channels;
+    pcm_resample_dot_fn dot;
+
+    FAR int16_t *coefs;    /* up rows of taps, oldest input sample first */
+    FAR int16_t *hist;     /* one row of cap frames per channel */
+    uint32_t cap;
+    uint32_t fill;         /* frames buffered per channel */
+    uint32_t pos;          /* newest frame of the next output's window */
+    uint32_t phase;
+    uint32_t skip;         /* input frames to drop before buffering more */
+    uint32_t drain;        /* zero frames still to feed at end of input */
+} pcm_resample_s;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+int pcm_resample_init(FAR pcm_resample_s *rs, uint32_t in_rate,
+                      uint32_t out_rate, int channels,
+                      pcm_resample_preset_t preset);
+void pcm_resample_deinit(FAR pcm_resample_s *rs);
+void pcm_resample_reset(FAR pcm_resample_s *rs);
+size_t pcm_resample_process(FAR pcm_resample_s *rs, FAR const int16_t *in,
+                            FAR size_t *in_frames, FAR int16_t *out,
+                            size_t out_frames);
+uint64_t pcm_resample_out_frames(FAR const pcm_resample_s *rs,
+                                 uint64_t in_frames);
+
+FAR const char *pcm_resample_name(void);
+int pcm_resample_variants(FAR const pcm_resample_variant_s **variants);
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /* PCM_RESAMPLE_H */
@@ -0,0 +1,216 @@
+/**
+ * @file pcm_resample_bench.c
+ * Microbenchmark for the polyphase sample-rate converter
+ *
+ * Usage: pcm_resample_bench [in_rate] [out_rate] [iterations] [cpu_mhz]
+ *
+ * For both presets every dot product kernel is first checked bit for bit
+ * against the scalar reference on a full conversion, then timed on stereo
+ * blocks of PCM_RESAMPLE_BLOCK input frames. The cost is reported per
+ * block, in cycles when the CPU clock is given, and as the share of real
+ * time the conversion takes.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <nuttx/config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pcm_resample.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define BENCH_DEFAULT_IN_RATE    44100
+#define BENCH_DEFAULT_OUT_RATE   48000
+#define BENCH_DEFAULT_ITERATIONS 2000
+#define BENCH_CHANNELS           2
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void bench_fill(FAR int16_t *buf, size_t n, uint32_t seed)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        buf[i] = (int16_t)(seed >> 16);
+    }
+}
+
+/* Convert one block, return the output frames */
+
+static size_t bench_block(FAR pcm_resample_s *rs, FAR const int16_t *in,
+                          FAR int16_t *out, size_t out_cap)
+{
+    size_t produced = 0;
+    size_t used = 0;
+
+    while (used < PCM_RESAMPLE_BLOCK)
+    {
+        size_t n = PCM_RESAMPLE_BLOCK - used;
+
+        produced += pcm_resample_process(rs, in + used * BENCH_CHANNELS, &n,
+                                         out + produced * BENCH_CHANNELS,
+                                         out_cap - produced);
+        used += n;
+    }
+
+    return produced;
+}
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int main(int argc, FAR char *argv[])
+{
+    static const char *const presets[] = { "fast", "hq" };
+    FAR const pcm_resample_variant_s *variants;
+    FAR int16_t *in;
+    FAR int16_t *ref;
+    FAR int16_t *out;
+    uint32_t in_rate = BENCH_DEFAULT_IN_RATE;
+    uint32_t out_rate = BENCH_DEFAULT_OUT_RATE;
+    int iterations = BENCH_DEFAULT_ITERATIONS;
+    uint32_t mhz = 0;
+    size_t out_cap;
+    int count;
+    int ret = 0;
+    int p;
+    int i;
+
+    if (argc > 1) {
+        in_rate = strtoul(argv[1], NULL, 0);
+    }
+
+    if (argc > 2) {
+        out_rate = strtoul(argv[2], NULL, 0);
+    }
+
+    if (argc > 3) {
+        iterations = atoi(argv[3]);
+    }
+
+    if (argc > 4) {
+        mhz = strtoul(argv[4], NULL, 0);
+    }
+
+    if (in_rate == 0 || out_rate == 0 || iterations <= 0) {
+        printf("Usage: %s [in_rate] [out_rate] [iterations] [cpu_mhz]\n",
+               argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    out_cap = (size_t)PCM_RESAMPLE_BLOCK * out_rate / in_rate + 2;
+
+    in = malloc(PCM_RESAMPLE_BLOCK * BENCH_CHANNELS * sizeof(int16_t));
+    ref = malloc(out_cap * BENCH_CHANNELS * sizeof(int16_t));
+    out = malloc(out_cap * BENCH_CHANNELS * sizeof(int16_t));
+    if (!in || !ref || !out) {
+        printf("Out of memory\n");
+        ret = EXIT_FAILURE;
+        goto out;
+    }
+
+    /* Half scale so that filter overshoot never clips */
+
+    bench_fill(in, PCM_RESAMPLE_BLOCK * BENCH_CHANNELS, 1);
+    for (i = 0; i < PCM_RESAMPLE_BLOCK * BENCH_CHANNELS; i++)
+    {
+        in[i] /= 2;
+    }
+
+    count = pcm_resample_variants(&variants);
+
+    printf("pcm_resample: %u -> %u Hz, stereo, %d frame blocks x %d, "
+           "dispatch = %s\n", (unsigned)in_rate, (unsigned)out_rate,
+           PCM_RESAMPLE_BLOCK, iterations, pcm_resample_name());
+
+    for (p = PCM_RESAMPLE_FAST; p <= PCM_RESAMPLE_HQ; p++)
+    {
+        pcm_resample_s rs;
+        size_t nref;
+
+        if (pcm_resample_init(&rs, in_rate, out_rate, BENCH_CHANNELS,
+                              p) < 0) {
+            printf("Out of memory\n");
+            ret = EXIT_FAILURE;
+            goto out;
+        }
+
+        printf(" %s: %d taps, %u phases, %zu bytes of coefficients\n",
+               presets[p], rs.taps, (unsigned)rs.up,
+               rs.up * rs.taps * sizeof(int16_t));
+
+        rs.dot = variants[0].fn;
+        nref = bench_block(&rs, in, ref, out_cap);
+
+        for (i = 0; i < count; i++)
+        {
+            uint64_t start;
+            uint64_t elapsed;
+            uint64_t frames = 0;
+            size_t n;
+            int j;
+
+            pcm_resample_reset(&rs);
+            rs.dot = variants[i].fn;
+
+            n = bench_block(&rs, in, out, out_cap);
+            if (n != nref ||
+                memcmp(out, ref, n * BENCH_CHANNELS * sizeof(int16_t)) != 0) {
+                printf("  %-8s MISMATCH against scalar reference\n",
+                       variants[i].name);
+                ret = EXIT_FAILURE;
+                continue;
+            }
+
+            start = bench_now_ns();
+            for (j = 0; j < iterations; j++)
+            {
+                frames += bench_block(&rs, in, out, out_cap);
+            }
+
+            elapsed = bench_now_ns() - start;
+            if (elapsed == 0) {
+                elapsed = 1;
+            }
+
+            printf("  %-8s %9.0f ns/block", variants[i].name,
+                   (double)elapsed / iterations);
+            if (mhz > 0) {
+                printf(" %10.0f cycles/block",
+                       (double)elapsed * mhz / 1000.0 / iterations);
+            }
+
+            printf("  %6.2f%% of real time\n",
+                   100.0 * elapsed * out_rate / (frames * 1e9));
+        }
+
+        pcm_resample_deinit(&rs);
+    }
+
+out:
+    free(in);
+    free(ref);
+    free(out);
+    return ret;
+}
@@ -0,0 +1,338 @@
+/**
+ * @file pcm_ring.c
+ * Lock-free single-producer/single-consumer PCM ring buffer
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "pcm_ring.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static uint32_t pcm_ring_roundup_pow2(uint32_t n);
+static uint32_t pcm_ring_live_tail(FAR pcm_ring_s *ring);
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static uint32_t pcm_ring_roundup_pow2(uint32_t n)
+{
+    uint32_t size = 1;
+
+    while (size < n && size < (1u << 31)) {
+        size <<= 1;
+    }
+
+    return size;
+}
+
+/**
+ * @brief Read position with a pending flush already applied
+ *
+ * Bytes below a posted flush are never played, so they count as free even
+ * before the consumer moves its tail past them. A flush position behind
+ * the tail is stale and ignored.
+ */
+static uint32_t pcm_ring_live_tail(FAR pcm_ring_s *ring)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    uint32_t pos;
+
+    if (atomic_load_explicit(&ring->flush_req, memory_order_acquire)) {
+        pos = atomic_load_explicit(&ring->flush_pos, memory_order_relaxed);
+        if ((int32_t)(pos - tail) > 0) {
+            tail = pos;
+        }
+    }
+
+    return tail;
+}
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+/**
+ * @brief Allocate a ring of at least min_size bytes
+ * @param ring Ring instance
+ * @param min_size Requested capacity, rounded up to a power of two
+ * @return 0 on success, negated errno on failure
+ */
+int pcm_ring_init(FAR pcm_ring_s *ring, uint32_t min_size)
+{
+    if (ring == NULL || min_size == 0) {
+        return -EINVAL;
+    }
+
+    memset(ring, 0, sizeof(pcm_ring_s));
+
+    ring->size = pcm_ring_roundup_pow2(min_size);
+    ring->mask = ring->size - 1;
+    ring->buf = malloc(ring->size);
+    if (ring->buf == NULL) {
+        ring->size = 0;
+        return -ENOMEM;
+    }
+
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->flush_pos, 0);
+    atomic_init(&ring->flush_req, false);
+    pcm_ring_reset_stats(ring);
+
+    return 0;
+}
+
+void pcm_ring_deinit(FAR pcm_ring_s *ring)
+{
+    if (ring == NULL) {
+        return;
+    }
+
+    free(ring->buf);
+    ring->buf = NULL;
+    ring->size = 0;
+    ring->mask = 0;
+}
+
+/**
+ * @brief Bytes the consumer will still play, a pending flush excluded
+ */
+uint32_t pcm_ring_used(FAR pcm_ring_s *ring)
+{
+    uint32_t tail = pcm_ring_live_tail(ring);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    return head - tail;
+}
+
+uint32_t pcm_ring_space(FAR pcm_ring_s *ring)
+{
+    return ring->size - pcm_ring_used(ring);
+}
+
+/**
+ * @brief Total bytes ever written, wraps at 2^32
+ *
+ * Lets the producer tag a position in the stream that the consumer can
+ * later compare against pcm_ring_read_count().
+ */
+uint32_t pcm_ring_write_count(FAR pcm_ring_s *ring)
+{
+    return atomic_load_explicit(&ring->head, memory_order_acquire);
+}
+
+/**
+ * @brief Total bytes ever consumed (or flushed), wraps at 2^32
+ */
+uint32_t pcm_ring_read_count(FAR pcm_ring_s *ring)
+{
+    return atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
+
+/**
+ * @brief Copy PCM into the ring, producer side only
+ * @return Number of bytes actually written (may be short when full)
+ */
+size_t pcm_ring_write(FAR pcm_ring_s *ring, FAR const void *src, size_t len)
+{
+    FAR const uint8_t *in = src;
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = pcm_ring_live_tail(ring);
+    uint32_t space = ring->size - (head - tail);
+    uint32_t off;
+    uint32_t first;
+
+    if (len > space) {
+        len = space;
+    }
+
+    if (len == 0) {
+        return 0;
+    }
+
+    off = head & ring->mask;
+    first = ring->size - off;
+    if (first > len) {
+        first = len;
+    }
+
+    memcpy(ring->buf + off, in, first);
+    memcpy(ring->buf, in + first, len - first);
+
+    atomic_store_explicit(&ring->head, head + len, memory_order_release);
+    return len;
+}
+
+/**
+ * @brief Contiguous free space at the head, producer side only
+ *
+ * Lets the decoder synthesize straight into ring memory instead of into a
+ * staging buffer that pcm_ring_write() would copy from. The span stops at
+ * the end of the buffer, call again after committing to get the wrapped
+ * part.
+ * @param dst Returns where the producer may write
+ * @return Number of bytes that can be written at *dst
+ */
+size_t pcm_ring_write_span(FAR pcm_ring_s *ring, FAR uint8_t **dst)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = pcm_ring_live_tail(ring);
+    uint32_t space = ring->size - (head - tail);
+    uint32_t off = head & ring->mask;
+
+    *dst = ring->buf + off;
+
+    if (space > ring->size - off) {
+        space = ring->size - off;
+    }
+
+    return space;
+}
+
+/**
+ * @brief Publish len bytes written into the last pcm_ring_write_span()
+ */
+void pcm_ring_write_commit(FAR pcm_ring_s *ring, size_t len)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    atomic_store_explicit(&ring->head, head + len, memory_order_release);
+}
+
+/**
+ * @brief Ask the consumer to drop everything written so far
+ *
+ * Called by the producer after a seek. The consumer applies it on its next
+ * read, so stale PCM is never played and neither side has to block. The
+ * flushed bytes are free for the producer at once, a read copying them
+ * at this moment notices the request afterwards and discards its copy.
+ */
+void pcm_ring_flush(FAR pcm_ring_s *ring)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    atomic_store_explicit(&ring->flush_pos, head, memory_order_relaxed);
+    atomic_store_explicit(&ring->flush_req, true, memory_order_release);
+
+    /* The request is visible before any byte written over flushed data */
+
+    atomic_thread_fence(memory_order_release);
+}
+
+/**
+ * @brief Copy PCM out of the ring, consumer side only
+ * @return Number of bytes actually read (may be short when empty)
+ */
+size_t pcm_ring_read(FAR pcm_ring_s *ring, FAR void *dst, size_t len)
+{
+    FAR uint8_t *out = dst;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t used;
+    uint32_t off;
+    uint32_t first;
+    uint32_t pos;
+    size_t want = len;
+
+    for (;;) {
+        /* A flush posted before the last read finished may point behind
+         * the tail already, moving back would replay PCM and let the
+         * producer overwrite bytes not yet read.
+         */
+
+        tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        if (atomic_exchange_explicit(&ring->flush_req, false,
+                                     memory_order_acquire)) {
+            pos = atomic_load_explicit(&ring->flush_pos,
+                                       memory_order_relaxed);
+            if ((int32_t)(pos - tail) > 0) {
+                tail = pos;
+                atomic_store_explicit(&ring->tail, tail,
+                                      memory_order_release);
+            }
+        }
+
+        head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        used = head - tail;
+
+        len = want;
+        if (len > used) {
+            len = used;
+        }
+
+        if (len == 0) {
+            break;
+        }
+
+        off = tail & ring->mask;
+        first = ring->size - off;
+        if (first > len) {
+            first = len;
+        }
+
+        memcpy(out, ring->buf + off, first);
+        memcpy(out + first, ring->buf, len - first);
+
+        /* A flush posted during the copy lets the producer reuse these
+         * bytes, drop the copy and start again behind the flush.
+         */
+
+        atomic_thread_fence(memory_order_acquire);
+        if (!atomic_load_explicit(&ring->flush_req, memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    if (used < atomic_load_explicit(&ring->min_fill, memory_order_relaxed)) {
+        atomic_store_explicit(&ring->min_fill, used, memory_order_relaxed);
+    }
+
+    if (used > atomic_load_explicit(&ring->max_fill, memory_order_relaxed)) {
+        atomic_store_explicit(&ring->max_fill, used, memory_order_relaxed);
+    }
+
+    if (len == 0) {
+        return 0;
+    }
+
+    atomic_store_explicit(&ring->tail, tail + len, memory_order_release);
+    return len;
+}
+
+void pcm_ring_note_underrun(FAR pcm_ring_s *ring, size_t missing)
+{
+    atomic_fetch_add_explicit(&ring->underruns, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&ring->underrun_bytes, missing,
+                              memory_order_relaxed);
+}
+
+void pcm_ring_get_stats(FAR pcm_ring_s *ring, FAR pcm_ring_stats_s *stats)
+{
+    stats->capacity = ring->size;
+    stats->fill = pcm_ring_used(ring);
+    stats->min_fill = atomic_load_explicit(&ring->min_fill,
+                                           memory_order_relaxed);
+    stats->max_fill = atomic_load_explicit(&ring->max_fill,
+                                           memory_order_relaxed);
+    stats->underruns = atomic_load_explicit(&ring->underruns,
+                                            memory_order_relaxed);
+    stats->underrun_bytes = atomic_load_explicit(&ring->underrun_bytes,
+                                                 memory_order_relaxed);
+}
+
+void pcm_ring_reset_stats(FAR pcm_ring_s *ring)
+{
+    atomic_store_explicit(&ring->min_fill, ring->size, memory_order_relaxed);
+    atomic_store_explicit(&ring->max_fill, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->underruns, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->underrun_bytes, 0, memory_order_relaxed);
+}
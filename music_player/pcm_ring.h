@@ -0,0 +1,87 @@
+/**
+ * @file pcm_ring.h
+ * Lock-free single-producer/single-consumer PCM ring buffer
+ */
+
+#ifndef PCM_RING_H
+#define PCM_RING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <nuttx/config.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* The producer (decoder thread) only moves head, the consumer (nxaudio
+ * dequeue callback) only moves tail. Both are free running byte counters,
+ * the buffer size is a power of two so that they wrap consistently.
+ */
+
+typedef struct pcm_ring {
+    FAR uint8_t *buf;
+    uint32_t size;
+    uint32_t mask;
+    atomic_uint head;
+    atomic_uint tail;
+
+    /* Discard request posted by the producer after a seek */
+    atomic_uint flush_pos;
+    atomic_bool flush_req;
+
+    /* Fill-level counters, written by the consumer only */
+    atomic_uint min_fill;
+    atomic_uint max_fill;
+    atomic_uint underruns;
+    atomic_uint underrun_bytes;
+} pcm_ring_s;
+
+typedef struct pcm_ring_stats {
+    uint32_t capacity;       /* bytes */
+    uint32_t fill;           /* bytes ready for the consumer */
+    uint32_t min_fill;       /* low-water mark since last reset */
+    uint32_t max_fill;       /* high-water mark since last reset */
+    uint32_t underruns;      /* reads that could not be fully served */
+    uint32_t underrun_bytes; /* bytes replaced by silence */
+} pcm_ring_stats_s;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+int pcm_ring_init(FAR pcm_ring_s *ring, uint32_t min_size);
+void pcm_ring_deinit(FAR pcm_ring_s *ring);
+
+uint32_t pcm_ring_used(FAR pcm_ring_s *ring);
+uint32_t pcm_ring_space(FAR pcm_ring_s *ring);
+uint32_t pcm_ring_write_count(FAR pcm_ring_s *ring);
+uint32_t pcm_ring_read_count(FAR pcm_ring_s *ring);
+
+/* Producer side */
+size_t pcm_ring_write(FAR pcm_ring_s *ring, FAR const void *src, size_t len);
+size_t pcm_ring_write_span(FAR pcm_ring_s *ring, FAR uint8_t **dst);
+void pcm_ring_write_commit(FAR pcm_ring_s *ring, size_t len);
+void pcm_ring_flush(FAR pcm_ring_s *ring);
+
+/* Consumer side */
+size_t pcm_ring_read(FAR pcm_ring_s *ring, FAR void *dst, size_t len);
+void pcm_ring_note_underrun(FAR pcm_ring_s *ring, size_t missing);
+
+void pcm_ring_get_stats(FAR pcm_ring_s *ring, FAR pcm_ring_stats_s *stats);
+void pcm_ring_reset_stats(FAR pcm_ring_s *ring);
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /* PCM_RING_H */
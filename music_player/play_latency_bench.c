@@ -0,0 +1,358 @@
+/**
+ * @file play_latency_bench.c
+ * End-to-end latency from a UI interaction to the first audio
+ *
+ * Usage: play_latency_bench [-r rounds] [-b budget_ms] [-s script] track...
+ *
+ * Replays a script of button taps against audio_ctl and whatever nxaudio
+ * implementation is linked in, making the same calls, in the same order,
+ * as the LVGL handlers of music_player.c. The trace points record every
+ * stage of each interaction; the report gives p50/p99/max per stage for
+ * play taps and album switches. The run fails when the p99 of the first
+ * audio of either kind exceeds the budget, or an interaction never
+ * produced audio, so a latency regression breaks the test run.
+ *
+ * Script commands, one per line, '#' starts a comment:
+ *   play        tap on play_btn, starts or resumes playback
+ *   pause       tap on play_btn while playing
+ *   next, prev  album switch buttons
+ *   stop        end of the playlist, the session stays open but paused
+ *   close       release the session, the next play is a cold start
+ *   wait <ms>
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <nuttx/config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "audio_ctl.h"
+#include "audio_trace.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_PLAY_LATENCY_BUDGET_MS
+#define CONFIG_LVX_MUSIC_PLAYER_PLAY_LATENCY_BUDGET_MS 200
+#endif
+
+#define BENCH_DEFAULT_ROUNDS 10
+#define BENCH_MAX_TRACKS     16
+#define BENCH_LINE_MAX       64
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef enum {
+    BENCH_STATUS_STOP,
+    BENCH_STATUS_PLAY,
+    BENCH_STATUS_PAUSE,
+} bench_status_t;
+
+/* The playback part of the music_player.c context */
+
+typedef struct bench {
+    FAR audioctl_s *audioctl;
+    FAR char *tracks[BENCH_MAX_TRACKS];
+    int track_count;
+    int current;
+    bench_status_t status;
+    bench_status_t status_prev;
+} bench_s;
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+static FAR const char *const g_default_script[] = {
+    "play",  "wait 300",
+    "next",  "wait 300",
+    "next",  "wait 300",
+    "pause", "wait 100",
+    "play",  "wait 300",
+    "prev",  "wait 300",
+    "stop",  "wait 100",
+    "play",  "wait 300",
+    "close",
+};
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/* app_open_current_album() */
+
+static void bench_open_current(FAR bench_s *b)
+{
+    FAR const char *path = b->tracks[b->current];
+
+    if (b->audioctl != NULL) {
+        if (audio_ctl_switch(b->audioctl, path) == 0) {
+            return;
+        }
+
+        printf("Switch to %s failed\n", path);
+        audio_ctl_stop(b->audioctl);
+        audio_ctl_uninit_nxaudio(b->audioctl);
+        b->audioctl = NULL;
+    }
+
+    b->audioctl = audio_ctl_init_nxaudio(path);
+    if (b->audioctl == NULL) {
+        printf("Cannot play %s\n", path);
+    }
+}
+
+/* app_set_play_status() with the audio part of app_refresh_play_status() */
+
+static void bench_set_play_status(FAR bench_s *b, bench_status_t status)
+{
+    if (status == BENCH_STATUS_PLAY) {
+        audio_trace_mark(AUDIO_TRACE_PLAY_STATUS);
+    }
+
+    b->status_prev = b->status;
+    b->status = status;
+
+    switch (status) {
+    case BENCH_STATUS_PLAY:
+        if (b->status_prev == BENCH_STATUS_STOP) {
+            bench_open_current(b);
+        }
+
+        if (b->audioctl != NULL) {
+            audio_ctl_resume(b->audioctl);
+        }
+        break;
+    case BENCH_STATUS_STOP:
+    case BENCH_STATUS_PAUSE:
+        if (b->audioctl != NULL) {
+            audio_ctl_pause(b->audioctl);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/* app_play_status_event_handler() */
+
+static void bench_tap_play(FAR bench_s *b)
+{
+    switch (b->status) {
+    case BENCH_STATUS_STOP:
+    case BENCH_STATUS_PAUSE:
+        audio_trace_begin(AUDIO_TRACE_PLAY);
+        bench_set_play_status(b, BENCH_STATUS_PLAY);
+        break;
+    case BENCH_STATUS_PLAY:
+        bench_set_play_status(b, BENCH_STATUS_PAUSE);
+        break;
+    default:
+        break;
+    }
+}
+
+/* app_switch_album_event_handler() and app_switch_to_album() */
+
+static void bench_tap_switch(FAR bench_s *b, int step)
+{
+    audio_trace_begin(AUDIO_TRACE_SWITCH);
+
+    b->current = (b->current + step + b->track_count) % b->track_count;
+    if (b->status == BENCH_STATUS_STOP) {
+        return;
+    }
+
+    bench_open_current(b);
+    if (b->status == BENCH_STATUS_PAUSE) {
+        bench_set_play_status(b, BENCH_STATUS_PLAY);
+    }
+}
+
+static void bench_close(FAR bench_s *b)
+{
+    audio_trace_flush();
+
+    if (b->audioctl != NULL) {
+        audio_ctl_stop(b->audioctl);
+        audio_ctl_uninit_nxaudio(b->audioctl);
+        b->audioctl = NULL;
+    }
+
+    b->status = BENCH_STATUS_STOP;
+    b->status_prev = BENCH_STATUS_STOP;
+}
+
+static int bench_command(FAR bench_s *b, FAR const char *line)
+{
+    char cmd[BENCH_LINE_MAX];
+    int arg = 0;
+
+    if (sscanf(line, " %63s %d", cmd, &arg) < 1 || cmd[0] == '#') {
+        return 0;
+    }
+
+    if (strcmp(cmd, "play") == 0) {
+        if (b->status != BENCH_STATUS_PLAY) {
+            bench_tap_play(b);
+        }
+    } else if (strcmp(cmd, "pause") == 0) {
+        if (b->status == BENCH_STATUS_PLAY) {
+            bench_tap_play(b);
+        }
+    } else if (strcmp(cmd, "next") == 0) {
+        bench_tap_switch(b, 1);
+    } else if (strcmp(cmd, "prev") == 0) {
+        bench_tap_switch(b, -1);
+    } else if (strcmp(cmd, "stop") == 0) {
+        bench_set_play_status(b, BENCH_STATUS_STOP);
+    } else if (strcmp(cmd, "close") == 0) {
+        bench_close(b);
+    } else if (strcmp(cmd, "wait") == 0) {
+        usleep(arg * 1000);
+    } else {
+        printf("Unknown command: %s\n", cmd);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int bench_run_script(FAR bench_s *b, FAR const char *script)
+{
+    char line[BENCH_LINE_MAX];
+    FAR FILE *fp;
+    size_t i;
+    int ret = 0;
+
+    if (script == NULL) {
+        for (i = 0; i < sizeof(g_default_script) / sizeof(g_default_script[0]);
+             i++)
+        {
+            bench_command(b, g_default_script[i]);
+        }
+
+        return 0;
+    }
+
+    fp = fopen(script, "r");
+    if (fp == NULL) {
+        printf("Cannot open %s\n", script);
+        return -1;
+    }
+
+    while (ret == 0 && fgets(line, sizeof(line), fp) != NULL)
+    {
+        ret = bench_command(b, line);
+    }
+
+    fclose(fp);
+    return ret;
+}
+
+/* Every interaction of a kind reached audio within budget at p99 */
+
+static bool bench_check(int kind, FAR const char *name, uint32_t budget_us)
+{
+    audio_trace_stats_s stats;
+
+    audio_trace_get_stats(kind, &stats);
+    if (stats.interactions == 0) {
+        return true;
+    }
+
+    if (stats.audio.count < stats.interactions) {
+        printf("FAIL %s: %u of %u interactions produced no audio\n", name,
+               (unsigned)(stats.interactions - stats.audio.count),
+               (unsigned)stats.interactions);
+        return false;
+    }
+
+    if (stats.audio.p99 > budget_us) {
+        printf("FAIL %s: first audio p99 %u us, budget %u us\n", name,
+               (unsigned)stats.audio.p99, (unsigned)budget_us);
+        return false;
+    }
+
+    printf("PASS %s: first audio p50 %u us, p99 %u us, budget %u us\n",
+           name, (unsigned)stats.audio.p50, (unsigned)stats.audio.p99,
+           (unsigned)budget_us);
+    return true;
+}
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int main(int argc, FAR char *argv[])
+{
+    FAR const char *script = NULL;
+    uint32_t budget_ms = CONFIG_LVX_MUSIC_PLAYER_PLAY_LATENCY_BUDGET_MS;
+    int rounds = BENCH_DEFAULT_ROUNDS;
+    bench_s b;
+    bool pass;
+    int opt;
+    int i;
+
+    memset(&b, 0, sizeof(b));
+
+    while ((opt = getopt(argc, argv, "r:b:s:")) != -1)
+    {
+        switch (opt) {
+        case 'r':
+            rounds = atoi(optarg);
+            break;
+        case 'b':
+            budget_ms = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            script = optarg;
+            break;
+        default:
+            rounds = 0;
+            break;
+        }
+    }
+
+    for (i = optind; i < argc && b.track_count < BENCH_MAX_TRACKS; i++)
+    {
+        b.tracks[b.track_count++] = argv[i];
+    }
+
+    if (rounds <= 0 || budget_ms == 0 || b.track_count == 0) {
+        printf("Usage: %s [-r rounds] [-b budget_ms] [-s script] track...\n",
+               argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    printf("play_latency: %d tracks, %d rounds of %s, budget %u ms\n",
+           b.track_count, rounds, script ? script : "the default script",
+           (unsigned)budget_ms);
+
+    audio_trace_reset();
+
+    for (i = 0; i < rounds; i++)
+    {
+        if (bench_run_script(&b, script) < 0) {
+            bench_close(&b);
+            return EXIT_FAILURE;
+        }
+    }
+
+    bench_close(&b);
+    audio_trace_print();
+
+    pass = bench_check(AUDIO_TRACE_PLAY, "play", budget_ms * 1000);
+    pass = bench_check(AUDIO_TRACE_SWITCH, "switch", budget_ms * 1000) &&
+           pass;
+
+    return pass ? EXIT_SUCCESS : EXIT_FAILURE;
+}
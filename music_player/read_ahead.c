@@ -0,0 +1,364 @@
+/**
+ * @file read_ahead.c
+ * Asynchronous read-ahead stage between storage and the decoders
+ *
+ * A dedicated I/O thread keeps up to `depth` cluster-aligned blocks queued
+ * ahead of the decoder. The depth starts double-buffered and grows when the
+ * measured storage latency gets close to the time the decoder needs to
+ * consume one block, then shrinks back once storage is stable again.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "read_ahead.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define READ_AHEAD_STACKSIZE 4096
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static uint64_t read_ahead_now_us(void);
+static void read_ahead_update_latency(FAR read_ahead_s *ra, uint32_t lat);
+static void read_ahead_pop_block(FAR read_ahead_s *ra);
+static FAR void *read_ahead_thread(FAR void *arg);
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static uint64_t read_ahead_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void read_ahead_update_latency(FAR read_ahead_s *ra, uint32_t lat)
+{
+    ra->lat_avg_us = ra->lat_avg_us ? (ra->lat_avg_us * 7 + lat) / 8 : lat;
+
+    /* Peak decays by 1/8 per block so depth shrinks once storage settles */
+
+    ra->lat_peak_us -= ra->lat_peak_us / 8;
+    if (lat > ra->lat_peak_us) {
+        ra->lat_peak_us = lat;
+    }
+}
+
+/* Called with lock held once the decoder has drained the head block */
+
+static void read_ahead_pop_block(FAR read_ahead_s *ra)
+{
+    uint64_t now = read_ahead_now_us();
+    int depth;
+
+    ra->rd = (ra->rd + 1) % ra->max_depth;
+    ra->count--;
+    ra->rd_off = 0;
+
+    if (ra->consume_start_us != 0) {
+        uint32_t spent = (uint32_t)(now - ra->consume_start_us);
+
+        ra->consume_us = ra->consume_us ? (ra->consume_us * 7 + spent) / 8
+                                        : spent;
+    }
+
+    ra->consume_start_us = now;
+
+    /* Keep enough blocks queued to cover the worst recent read latency */
+
+    if (ra->consume_us > 0) {
+        depth = (ra->lat_peak_us + ra->consume_us - 1) / ra->consume_us + 1;
+        if (depth < READ_AHEAD_MIN_DEPTH) {
+            depth = READ_AHEAD_MIN_DEPTH;
+        } else if (depth > ra->max_depth) {
+            depth = ra->max_depth;
+        }
+
+        ra->depth = depth;
+    }
+
+    pthread_cond_broadcast(&ra->cond);
+}
+
+static FAR void *read_ahead_thread(FAR void *arg)
+{
+    FAR read_ahead_s *ra = (FAR read_ahead_s *)arg;
+
+    pthread_mutex_lock(&ra->lock);
+
+    while (!ra->quit)
+    {
+        FAR read_ahead_block_s *blk;
+        uint32_t generation;
+        uint64_t start;
+        off_t offset;
+        ssize_t nread;
+
+        if (ra->eof || ra->count >= ra->depth) {
+            pthread_cond_wait(&ra->cond, &ra->lock);
+            continue;
+        }
+
+        /* The slot after the queue tail is never touched by the reader */
+
+        blk = &ra->blocks[(ra->rd + ra->count) % ra->max_depth];
+        offset = ra->next_offset;
+        generation = ra->generation;
+        pthread_mutex_unlock(&ra->lock);
+
+        start = read_ahead_now_us();
+        nread = pread(ra->fd, blk->data, ra->block_size, offset);
+        if (nread < 0) {
+            nread = -errno;
+        }
+
+        pthread_mutex_lock(&ra->lock);
+
+        if (generation != ra->generation) {
+            /* A seek happened while the read was in flight */
+
+            continue;
+        }
+
+        read_ahead_update_latency(ra,
+                                  (uint32_t)(read_ahead_now_us() - start));
+
+        if (nread <= 0) {
+            ra->eof = true;
+            ra->error = nread;
+        } else {
+            blk->offset = offset;
+            blk->len = nread;
+            ra->next_offset += nread;
+            ra->count++;
+        }
+
+        pthread_cond_broadcast(&ra->cond);
+    }
+
+    pthread_mutex_unlock(&ra->lock);
+    return NULL;
+}
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+/**
+ * @brief Start reading ahead from fd
+ * @param ra Read-ahead instance
+ * @param fd Open file, only accessed through pread() from now on
+ * @param start First byte the decoder wants
+ * @return 0 on success, negated errno on failure
+ */
+int read_ahead_open(FAR read_ahead_s *ra, int fd, off_t start)
+{
+    pthread_attr_t tattr;
+    struct sched_param sparam;
+    struct stat st;
+    size_t cluster = 512;
+    int ret;
+    int i;
+
+    if (ra == NULL || fd < 0) {
+        return -EINVAL;
+    }
+
+    memset(ra, 0, sizeof(read_ahead_s));
+    ra->fd = fd;
+
+    /* Round the block up to whole clusters so every read is aligned */
+
+    if (fstat(fd, &st) == 0 && st.st_blksize > 0) {
+        cluster = st.st_blksize;
+    }
+
+    ra->block_size = (CONFIG_LVX_MUSIC_PLAYER_READAHEAD_BLOCK + cluster - 1) /
+                     cluster * cluster;
+
+    ra->max_depth = CONFIG_LVX_MUSIC_PLAYER_READAHEAD_DEPTH;
+    if (ra->max_depth < READ_AHEAD_MIN_DEPTH) {
+        ra->max_depth = READ_AHEAD_MIN_DEPTH;
+    } else if (ra->max_depth > READ_AHEAD_MAX_DEPTH) {
+        ra->max_depth = READ_AHEAD_MAX_DEPTH;
+    }
+
+    ra->depth = READ_AHEAD_MIN_DEPTH;
+
+    ra->pool = malloc(ra->block_size * ra->max_depth);
+    if (ra->pool == NULL) {
+        return -ENOMEM;
+    }
+
+    for (i = 0; i < ra->max_depth; i++) {
+        ra->blocks[i].data = ra->pool + i * ra->block_size;
+    }
+
+    ra->next_offset = start - start % ra->block_size;
+    ra->skip = start - ra->next_offset;
+    ra->rd_off = ra->skip;
+
+    pthread_mutex_init(&ra->lock, NULL);
+    pthread_cond_init(&ra->cond, NULL);
+
+    pthread_attr_init(&tattr);
+    sparam.sched_priority = sched_get_priority_max(SCHED_FIFO) - 11;
+    pthread_attr_setschedparam(&tattr, &sparam);
+    pthread_attr_setstacksize(&tattr, READ_AHEAD_STACKSIZE);
+
+    ret = pthread_create(&ra->pid, &tattr, read_ahead_thread, ra);
+    pthread_attr_destroy(&tattr);
+    if (ret != 0) {
+        pthread_cond_destroy(&ra->cond);
+        pthread_mutex_destroy(&ra->lock);
+        free(ra->pool);
+        ra->pool = NULL;
+        return -ret;
+    }
+
+    pthread_setname_np(ra->pid, "audioctl_io");
+    ra->running = true;
+
+    return 0;
+}
+
+/**
+ * @brief Copy up to len bytes, waiting only if nothing is queued yet
+ * @return Bytes copied, 0 at end of file, negated errno on I/O error
+ */
+ssize_t read_ahead_read(FAR read_ahead_s *ra, FAR void *dst, size_t len)
+{
+    FAR uint8_t *out = dst;
+    bool stalled = false;
+    size_t done = 0;
+
+    pthread_mutex_lock(&ra->lock);
+
+    while (done < len)
+    {
+        FAR read_ahead_block_s *blk;
+        size_t n;
+
+        if (ra->count == 0) {
+            if (ra->eof || done > 0) {
+                break;
+            }
+
+            if (!stalled) {
+                ra->stalls++;
+                stalled = true;
+            }
+
+            pthread_cond_wait(&ra->cond, &ra->lock);
+            continue;
+        }
+
+        blk = &ra->blocks[ra->rd];
+        if (ra->rd_off >= blk->len) {
+            read_ahead_pop_block(ra);
+            continue;
+        }
+
+        n = blk->len - ra->rd_off;
+        if (n > len - done) {
+            n = len - done;
+        }
+
+        /* Only the reader moves rd, so the block is stable while unlocked */
+
+        pthread_mutex_unlock(&ra->lock);
+        memcpy(out + done, blk->data + ra->rd_off, n);
+        pthread_mutex_lock(&ra->lock);
+
+        ra->rd_off += n;
+        done += n;
+
+        if (ra->rd_off >= blk->len) {
+            read_ahead_pop_block(ra);
+        }
+    }
+
+    if (done == 0 && ra->error < 0) {
+        done = ra->error;
+    }
+
+    pthread_mutex_unlock(&ra->lock);
+    return done;
+}
+
+/**
+ * @brief Drop queued blocks and restart reading at offset
+ */
+int read_ahead_seek(FAR read_ahead_s *ra, off_t offset)
+{
+    if (ra == NULL || !ra->running || offset < 0) {
+        return -EINVAL;
+    }
+
+    pthread_mutex_lock(&ra->lock);
+
+    ra->generation++;
+    ra->count = 0;
+    ra->next_offset = offset - offset % ra->block_size;
+    ra->skip = offset - ra->next_offset;
+    ra->rd_off = ra->skip;
+    ra->eof = false;
+    ra->error = 0;
+    ra->consume_start_us = 0;
+
+    pthread_cond_broadcast(&ra->cond);
+    pthread_mutex_unlock(&ra->lock);
+
+    return 0;
+}
+
+void read_ahead_close(FAR read_ahead_s *ra)
+{
+    if (ra == NULL || !ra->running) {
+        return;
+    }
+
+    pthread_mutex_lock(&ra->lock);
+    ra->quit = true;
+    pthread_cond_broadcast(&ra->cond);
+    pthread_mutex_unlock(&ra->lock);
+
+    pthread_join(ra->pid, NULL);
+
+    pthread_cond_destroy(&ra->cond);
+    pthread_mutex_destroy(&ra->lock);
+    free(ra->pool);
+    ra->pool = NULL;
+    ra->running = false;
+}
+
+void read_ahead_get_stats(FAR read_ahead_s *ra, FAR read_ahead_stats_s *stats)
+{
+    pthread_mutex_lock(&ra->lock);
+
+    stats->block_size = ra->block_size;
+    stats->depth = ra->depth;
+    stats->queued = ra->count;
+    stats->lat_avg_us = ra->lat_avg_us;
+    stats->lat_peak_us = ra->lat_peak_us;
+    stats->consume_us = ra->consume_us;
+    stats->stalls = ra->stalls;
+
+    pthread_mutex_unlock(&ra->lock);
+}
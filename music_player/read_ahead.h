@@ -0,0 +1,103 @@
+/**
+ * @file read_ahead.h
+ * Asynchronous read-ahead stage between storage and the decoders
+ */
+
+#ifndef READ_AHEAD_H
+#define READ_AHEAD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <nuttx/config.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_READAHEAD_BLOCK
+#define CONFIG_LVX_MUSIC_PLAYER_READAHEAD_BLOCK 8192
+#endif
+
+#ifndef CONFIG_LVX_MUSIC_PLAYER_READAHEAD_DEPTH
+#define CONFIG_LVX_MUSIC_PLAYER_READAHEAD_DEPTH 4
+#endif
+
+#define READ_AHEAD_MIN_DEPTH 2
+#define READ_AHEAD_MAX_DEPTH 16
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct read_ahead_block {
+    FAR uint8_t *data;
+    off_t offset;
+    size_t len;
+} read_ahead_block_s;
+
+typedef struct read_ahead_stats {
+    uint32_t block_size;
+    uint32_t depth;          /* current adaptive target */
+    uint32_t queued;         /* blocks ready for the decoder */
+    uint32_t lat_avg_us;     /* smoothed read() latency */
+    uint32_t lat_peak_us;    /* decaying worst-case read() latency */
+    uint32_t consume_us;     /* smoothed time the decoder spends per block */
+    uint32_t stalls;         /* decoder had to wait for storage */
+} read_ahead_stats_s;
+
+typedef struct read_ahead {
+    int fd;
+    size_t block_size;
+    int max_depth;
+    FAR uint8_t *pool;
+    read_ahead_block_s blocks[READ_AHEAD_MAX_DEPTH];
+
+    /* Block queue, protected by lock */
+    int rd;
+    int count;
+    size_t rd_off;
+    off_t next_offset;
+    size_t skip;
+    uint32_t generation;
+    bool eof;
+    bool quit;
+    int error;
+
+    /* Adaptive depth */
+    int depth;
+    uint32_t lat_avg_us;
+    uint32_t lat_peak_us;
+    uint32_t consume_us;
+    uint64_t consume_start_us;
+    uint32_t stalls;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t pid;
+    bool running;
+} read_ahead_s;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+int read_ahead_open(FAR read_ahead_s *ra, int fd, off_t start);
+ssize_t read_ahead_read(FAR read_ahead_s *ra, FAR void *dst, size_t len);
+int read_ahead_seek(FAR read_ahead_s *ra, off_t offset);
+void read_ahead_close(FAR read_ahead_s *ra);
+void read_ahead_get_stats(FAR read_ahead_s *ra, FAR read_ahead_stats_s *stats);
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /* READ_AHEAD_H */
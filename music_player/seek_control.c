@@ -133,8 +133,8 @@ int audio_ctl_seek_to_position(audioctl_s* ctl, int64_t position_ms)
     }
     
     // 设置跳转参数
-    ctl->seek = true;
     ctl->seek_position = file_offset;
+    atomic_store_explicit(&ctl->seek, true, memory_order_release);
     
     // 更新UI进度条
     update_progress_bar_immediately();
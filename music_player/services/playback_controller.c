@@ -387,3 +387,25 @@ int playback_controller_previous_track(playback_controller_t* controller)
     
     return 0;
 }
+
+/**
+ * @brief 启用/禁用交叉淡化
+ *
+ * 实际混音由 audio_ctl 的解码线程完成(CONFIG_LVX_MUSIC_PLAYER_CROSSFADE)，
+ * 这里只记录开关，音频引擎目前不读取它；淡化长度在启动时由
+ * audio_config.crossfade_duration_ms 给出。
+ */
+int playback_controller_set_crossfade(playback_controller_t* controller, bool enabled)
+{
+    if (!controller) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&controller->controller_mutex);
+    controller->crossfade_enabled = enabled;
+    pthread_mutex_unlock(&controller->controller_mutex);
+
+    printf("🔀 交叉淡化：%s\n", enabled ? "开启" : "关闭");
+
+    return 0;
+}
@@ -7,6 +7,7 @@
 #ifndef PLAYBACK_CONTROLLER_H
 #define PLAYBACK_CONTROLLER_H
 
+#include <nuttx/config.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include "../core/state_manager.h"
@@ -20,7 +21,13 @@ extern "C" {
  *      DEFINES
  *********************/
 #define MAX_RECENT_TRACKS 50
+
+// 与旧播放器共用 Kconfig 中的交叉淡化长度
+#ifdef CONFIG_LVX_MUSIC_PLAYER_CROSSFADE_MS
+#define CROSSFADE_DURATION_MS CONFIG_LVX_MUSIC_PLAYER_CROSSFADE_MS
+#else
 #define CROSSFADE_DURATION_MS 2000
+#endif
 
 /*********************
  *      TYPEDEFS